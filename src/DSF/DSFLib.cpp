@@ -21,18 +21,24 @@
  *
  */
 
-/*
-	TODO - efficient short circuiting of various reads based on passes param to make DSFLib fast for
-	special cases like reading properties only!
- */
-
-
 #include "DSFLib.h"
 #include "XChunkyFileUtils.h"
 #include <stdio.h>
 #include "md5.h"
 #include "DSFDefs.h"
 #include "DSFPointPool.h"
+#include "ThreadUtils.h"
+
+#if APL || LIN
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#elif IBM
+	#include <windows.h>
+	#include "GUI_Unicode.h"
+#endif
 
 const char *	dsfErrorMessages[] = {
 	"dsf_ErrOK",
@@ -104,6 +110,62 @@ double	R_DECODE_SCALED32(
 	return lon_raw;
 }*/
 
+// Pools with fewer total values than this (summed over the whole file) are decoded on the calling thread -
+// it's not worth spinning up threads for a small overlay DSF.
+#define DSF_PARALLEL_DECODE_MIN	65536
+
+static int	sDecodeThreads = 0;
+
+void	DSFSetDecodeThreads(int inThreads)
+{
+	sDecodeThreads = inThreads;
+}
+
+/* One point pool to decode - an atom and the interleaved double buffer it expands into. */
+struct	DSFPoolDecodeJob_t {
+	XAtomPlanerNumericTable		atom;
+	int							pool;
+	bool						is32;
+	int							planes;
+	int							size;
+	double *					dst;
+	double *					scales;
+	double *					offsets;
+};
+
+static void	DSFDecodePoolJob(int n, void * ref)
+{
+	DSFPoolDecodeJob_t * job = ((DSFPoolDecodeJob_t *) ref) + n;
+	if (job->is32)
+		job->atom.DecompressIntToDoubleInterleaved(job->planes, job->size, job->dst, job->scales, recip_4294967295, job->offsets);
+	else
+		job->atom.DecompressShortToDoubleInterleaved(job->planes, job->size, job->dst, job->scales, recip_65535, job->offsets);
+}
+
+/* Primitive vertices either go straight to AddPatchVertex_f or, if the client takes whole primitives, are
+ * gathered into one interleaved buffer at inDepth coords each, padding with zeros if a cross-pool vertex
+ * comes from a shallower pool. */
+inline void	DSFAddPrimitiveVertex(DSFCallbacks_t * inCallbacks, vector<double>& ioVerts, double * inCoords, int inDepth, int inSrcDepth, void * inRef)
+{
+	if (inCallbacks->AddPatchVertices_f == NULL)
+		inCallbacks->AddPatchVertex_f(inCoords, inRef);
+	else if (inSrcDepth >= inDepth)
+		ioVerts.insert(ioVerts.end(), inCoords, inCoords + inDepth);
+	else
+	{
+		ioVerts.insert(ioVerts.end(), inCoords, inCoords + inSrcDepth);
+		ioVerts.resize(ioVerts.size() + inDepth - inSrcDepth, 0.0);
+	}
+}
+
+inline void	DSFEndPrimitive(DSFCallbacks_t * inCallbacks, vector<double>& ioVerts, int inDepth, void * inRef)
+{
+	if (inCallbacks->AddPatchVertices_f && !ioVerts.empty())
+		inCallbacks->AddPatchVertices_f(&*ioVerts.begin(), inDepth, ioVerts.size() / inDepth, inRef);
+	ioVerts.clear();
+	inCallbacks->EndPrimitive_f(inRef);
+}
+
 #define	DECODE_SCALED(__index, __pool, __points, __depths) 	((&*__points[__pool].begin())+__index * __depths[__pool])
 
 #define	DECODE_SCALED_CURRENT(__index) 									(currentPoolPtr+__index * currentDepth)
@@ -145,11 +207,39 @@ bail:
 	return result;
 }
 
+/*
+ * DSF MD5 signature check
+ *
+ * The last 16 bytes of a DSF are the MD5 of everything in front of them.
+ *
+ */
+static int	DSFCheckSignatureMem(const char * inStart, const char * inStop)
+{
+	if((inStop - inStart) < 16)
+		return dsf_ErrNoAtoms;
+
+	MD5_CTX ctx;
+	MD5Init(&ctx);
+
+	const char *	s = inStart;
+	const char *	d = inStop - 16;
+
+	while(s < d)
+	{
+		int l = d - s;
+		if (l > DSF_SIGNATURE_BLOCK) l = DSF_SIGNATURE_BLOCK;
+		MD5Update(&ctx, (unsigned char *) s, l);
+		s += l;
+	}
+	MD5Final(&ctx);
+
+	return (memcmp(ctx.digest, d, 16) != 0) ? dsf_ErrBadChecksum : dsf_ErrOK;
+}
+
 int		DSFCheckSignature(const char * inPath)
 {
 	FILE *			fi = NULL;
 	char *			mem = NULL;
-	char * d, * s; 
 	unsigned int	file_size = 0;
 	int				result = dsf_ErrOK;
 
@@ -166,52 +256,220 @@ int		DSFCheckSignature(const char * inPath)
 	if (fread(mem, 1, file_size, fi) != file_size)
 		{ result = dsf_ErrCouldNotReadFile; goto bail; }
 
+	result = DSFCheckSignatureMem(mem, mem + file_size);
+
+bail:
+	if (fi) fclose(fi);
+	if (mem) free(mem);
+	return result;
+}
+
+/************************************************************
+ * MEMORY MAPPED READING
+ ************************************************************
+ *
+ * The file is mapped read-only and DSFReadMem decodes straight
+ * out of the mapping - there is no intermediate copy of the file.
+ * Pages are only faulted in when DSFReadMem touches the atoms a
+ * pass needs, so a properties-only read of a big DSF stays cheap.
+ *
+ */
+
+struct	DSFMappedFile_t {
+	const char *	begin;
+	const char *	end;
+#if IBM
+	HANDLE			file;
+	HANDLE			mapping;
+#else
+	int				fd;
+#endif
+};
+
+static bool	DSFMapFile(const char * inPath, DSFMappedFile_t * outFile)
+{
+	outFile->begin = NULL;
+	outFile->end = NULL;
+#if APL || LIN
+	struct stat	ss;
+	void *		addr;
+
+	outFile->fd = open(inPath, O_RDONLY, 0);
+	if (outFile->fd == -1)
+		return false;
+	if (fstat(outFile->fd, &ss) < 0 || ss.st_size == 0)
+	{
+		close(outFile->fd);
+		return false;
+	}
+	addr = mmap(NULL, ss.st_size, PROT_READ, MAP_SHARED, outFile->fd, 0);
+	if (addr == MAP_FAILED)
+	{
+		close(outFile->fd);
+		return false;
+	}
+	outFile->begin = (const char *) addr;
+	outFile->end = outFile->begin + ss.st_size;
+	return true;
+#elif IBM
+	const char *	addr = NULL;
+	outFile->mapping = NULL;
+	outFile->file = CreateFileW((const wchar_t *) convert_str_to_utf16(inPath).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (outFile->file == INVALID_HANDLE_VALUE)
+		return false;
+	DWORD len = GetFileSize(outFile->file, NULL);
+	if (len == 0 || len == INVALID_FILE_SIZE)
+		goto bail;
+	outFile->mapping = CreateFileMapping(outFile->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!outFile->mapping)
+		goto bail;
+	addr = (const char *) MapViewOfFile(outFile->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!addr)
+		goto bail;
+	outFile->begin = addr;
+	outFile->end = addr + len;
+	return true;
+bail:
+	if (outFile->mapping) CloseHandle(outFile->mapping);
+	CloseHandle(outFile->file);
+	return false;
+#endif
+}
+
+static void	DSFUnmapFile(DSFMappedFile_t * inFile)
+{
+#if APL || LIN
+	munmap((void *) inFile->begin, inFile->end - inFile->begin);
+	close(inFile->fd);
+#elif IBM
+	UnmapViewOfFile(inFile->begin);
+	CloseHandle(inFile->mapping);
+	CloseHandle(inFile->file);
+#endif
+}
+
+int		DSFReadFileMapped(
+			const char *		inPath,
+			DSFCallbacks_t *	inCallbacks,
+			const int *			inPasses,
+			void *				inRef)
+{
+	DSFMappedFile_t	mf;
+	if (!DSFMapFile(inPath, &mf))
+		return DSFReadFile(inPath, malloc, free, inCallbacks, inPasses, inRef);
+
+	int result = DSFReadMem(mf.begin, mf.end, inCallbacks, inPasses, inRef);
+	DSFUnmapFile(&mf);
+	return result;
+}
+
+int		DSFCheckSignatureMapped(const char * inPath)
+{
+	DSFMappedFile_t	mf;
+	if (!DSFMapFile(inPath, &mf))
+		return DSFCheckSignature(inPath);
+
+	int result = DSFCheckSignatureMem(mf.begin, mf.end);
+	DSFUnmapFile(&mf);
+	return result;
+}
+
+/*
+ * Batch signature check
+ *
+ * Each file is streamed through MD5 in DSF_SIGNATURE_BLOCK reads into a per-job buffer, so a thread
+ * never holds more than one block no matter how big the file is, and the files are spread across
+ * threads with TU_ParallelFor.  MD5 itself is serial; the parallelism is across files.
+ *
+ */
+struct	DSFSignatureJob_t {
+	const char *	path;
+	int				result;
+	double			bytes;
+};
+
+static int	DSFCheckSignatureStream(const char * inPath, double * outBytes)
+{
+	*outBytes = 0.0;
+	FILE * fi = fopen(inPath, "rb");
+	if (!fi) return dsf_ErrCouldNotOpenFile;
+
+	fseek(fi, 0L, SEEK_END);
+	long file_size = ftell(fi);
+	fseek(fi, 0L, SEEK_SET);
+	if (file_size < 16) { fclose(fi); return dsf_ErrNoAtoms; }
+
+	unsigned char * buf = (unsigned char *) malloc(DSF_SIGNATURE_BLOCK);
+	if (!buf) { fclose(fi); return dsf_ErrOutOfMemory; }
+
 	MD5_CTX ctx;
 	MD5Init(&ctx);
 
-	s = mem;
-	d = mem + file_size - 16;
-
-	while(s < d)
+	int		result = dsf_ErrOK;
+	long	left = file_size - 16;
+	while (left > 0)
 	{
-		int l = d - s;
-		if (l > 1024) l = 1024;
-		MD5Update(&ctx, (unsigned char *) s, l);
-		s += l;
+		long l = left > DSF_SIGNATURE_BLOCK ? DSF_SIGNATURE_BLOCK : left;
+		if (fread(buf, 1, l, fi) != l) { result = dsf_ErrCouldNotReadFile; break; }
+		MD5Update(&ctx, buf, l);
+		left -= l;
 	}
 	MD5Final(&ctx);
 
-	if(memcmp(ctx.digest, d, 16) != 0) result = dsf_ErrBadChecksum;
+	if (result == dsf_ErrOK)
+	{
+		if (fread(buf, 1, 16, fi) != 16)
+			result = dsf_ErrCouldNotReadFile;
+		else if (memcmp(ctx.digest, buf, 16) != 0)
+			result = dsf_ErrBadChecksum;
+		else
+			*outBytes = file_size;
+	}
 
-bail:
-	if (fi) fclose(fi);
-	if (mem) free(mem);
+	free(buf);
+	fclose(fi);
 	return result;
 }
 
+static void	DSFSignatureJob(int n, void * ref)
+{
+	DSFSignatureJob_t * job = ((DSFSignatureJob_t *) ref) + n;
+	job->result = DSFCheckSignatureStream(job->path, &job->bytes);
+}
+
+int		DSFCheckSignatureBatch(int inCount, const char * const * inPaths, int * outResults, int inThreads, double * outBytes)
+{
+	vector<DSFSignatureJob_t>	jobs(inCount);
+	for (int n = 0; n < inCount; ++n)
+	{
+		jobs[n].path = inPaths[n];
+		jobs[n].result = dsf_ErrOK;
+		jobs[n].bytes = 0.0;
+	}
+
+	if (inCount > 0)
+		TU_ParallelFor(inCount, DSFSignatureJob, &*jobs.begin(), inThreads);
+
+	int		bad = 0;
+	double	total = 0.0;
+	for (int n = 0; n < inCount; ++n)
+	{
+		if (outResults) outResults[n] = jobs[n].result;
+		if (jobs[n].result != dsf_ErrOK) ++bad;
+		total += jobs[n].bytes;
+	}
+	if (outBytes) *outBytes = total;
+	return bad;
+}
+
 int		DSFReadMem(const char * inStart, const char * inStop, DSFCallbacks_t * inCallbacks, const int * inPasses, void * ref)
 {
 	/* MD5 checksum...*/
 	if(inPasses && (inPasses[0] & dsf_CmdSign))
 	{
-		if((inStop - inStart) < 16)
-			return dsf_ErrNoAtoms;
-			
-		MD5_CTX ctx;
-		MD5Init(&ctx);
-		
-		const char *	s = inStart;
-		const char *	d = inStop - 16;
-		
-		while(s < d)
-		{
-			int l = d - s;
-			if (l > 1024) l = 1024;
-			MD5Update(&ctx, (unsigned char *) s, l);
-			s += l;
-		}
-		MD5Final(&ctx);
-		if(memcmp(ctx.digest, d, 16) != 0) return dsf_ErrBadChecksum;
+		int sig = DSFCheckSignatureMem(inStart, inStop);
+		if (sig != dsf_ErrOK)
+			return sig;
 	}
 
 	/* Do basic file analysis and check all headers and other basic requirements. */
@@ -223,7 +481,7 @@ someday check footer when in sloooow mode
 	XAtomContainer		dsf_container;
 	dsf_container.begin = (char *) (inStart + sizeof(DSFHeader_t));
 	dsf_container.end = (char *) (inStop - sizeof(DSFFooter_t));
-	if ((inStart - inStop) < (sizeof(DSFHeader_t) + sizeof(DSFFooter_t)))
+	if ((inStop - inStart) < (ptrdiff_t) (sizeof(DSFHeader_t) + sizeof(DSFFooter_t)))
 	{
 #if DEBUG_MESSAGES
 		printf("DSF ERROR: this file appears to not be atomic.\n");
@@ -402,6 +660,26 @@ someday check footer when in sloooow mode
 
 
 	
+	if (inPasses == NULL)
+	{
+		static int once[2] = { dsf_CmdAll, 0 };
+		inPasses = once;
+	}
+
+	/* Figure out what the passes actually need.  The 16-bit pools feed patches, polygons and objects,
+	 * the 32-bit pools feed networks - we only decode the pools somebody is going to look at, and we
+	 * skip the command atom entirely for passes that only want properties, definitions or rasters.
+	 * We still read the pool headers so that pool indices and depths in the command stream line up. */
+	int	all_flags = 0;
+	for (n = 0; inPasses[n]; ++n)
+		all_flags |= inPasses[n];
+
+	bool	want_pools   = (all_flags & (dsf_CmdPatches | dsf_CmdPolys | dsf_CmdObjects)) != 0;
+	bool	want_pools32 = (all_flags & dsf_CmdVectors) != 0;
+
+	vector<DSFPoolDecodeJob_t>		decodeJobs;
+	int								decodeTotal = 0;
+
 	n = 0;
 	while (geodContainer.GetNthAtomOfID(def_PointPoolAtom, n, poolAtom))
 	{
@@ -412,12 +690,24 @@ someday check footer when in sloooow mode
 //		planarDataRaw.push_back(vector<unsigned short>());
 //		planarDataRaw.back().resize(aSize * pCount);
 		planarData.push_back(vector<double>());
-		planarData.back().resize(aSize * pCount);
-//		poolAtom.DecompressShort(pCount, aSize, 1, (short *) &*planarDataRaw.back().begin());
-		poolAtom.DecompressShortToDoubleInterleaved(pCount, aSize, &*planarData.back().begin(),
-					&*planeScales[n].begin(),
-					recip_65535,
-					&*planeOffsets[n].begin());
+		if (want_pools && aSize > 0)
+		{
+			if (n >= planeScales.size() || planeScales[n].size() < pCount)
+			{
+#if DEBUG_MESSAGES
+				printf("DSF ERROR: 16-bit point pool %d has no matching scaling atom.\n", n);
+#endif
+				return dsf_ErrMisformattedScalingAtom;
+			}
+			planarData.back().resize(aSize * pCount);
+//			poolAtom.DecompressShort(pCount, aSize, 1, (short *) &*planarDataRaw.back().begin());
+			DSFPoolDecodeJob_t	job;
+			job.atom = poolAtom;
+			job.pool = n;
+			job.is32 = false;
+			decodeJobs.push_back(job);
+			decodeTotal += aSize * pCount;
+		}
 		++n;
 	}
 
@@ -431,17 +721,43 @@ someday check footer when in sloooow mode
 //		planarData32Raw.push_back(vector<unsigned int>());
 //		planarData32Raw.back().resize(aSize * pCount);
 		planarData32.push_back(vector<double>());
-		planarData32.back().resize(aSize * pCount);
-//		poolAtom.DecompressInt(pCount, aSize, 1, (int *) &*planarData32Raw.back().begin());
-
-		poolAtom.DecompressIntToDoubleInterleaved(pCount, aSize, &*planarData32.back().begin(),
-					&*planeScales32[n].begin(),
-					recip_4294967295,
-					&*planeOffsets32[n].begin());
-
+		if (want_pools32 && aSize > 0)
+		{
+			if (n >= planeScales32.size() || planeScales32[n].size() < pCount)
+			{
+#if DEBUG_MESSAGES
+				printf("DSF ERROR: 32-bit point pool %d has no matching scaling atom.\n", n);
+#endif
+				return dsf_ErrMisformattedScalingAtom;
+			}
+			planarData32.back().resize(aSize * pCount);
+//			poolAtom.DecompressInt(pCount, aSize, 1, (int *) &*planarData32Raw.back().begin());
+			DSFPoolDecodeJob_t	job;
+			job.atom = poolAtom;
+			job.pool = n;
+			job.is32 = true;
+			decodeJobs.push_back(job);
+			decodeTotal += aSize * pCount;
+		}
 
 		++n;
-	}	
+	}
+
+	/* Now actually decode the pools.  Each pool is an independent atom with its own output buffer, so they
+	 * can be decoded on as many cores as we have.  Don't fill in the buffer pointers until all of the pool
+	 * vectors are built - growing the outer vectors can move the inner ones. */
+	for (n = 0; n < decodeJobs.size(); ++n)
+	{
+		DSFPoolDecodeJob_t& job = decodeJobs[n];
+		job.planes  = job.is32 ? planeDepths32[job.pool] : planeDepths[job.pool];
+		job.size    = job.is32 ? planeSizes32[job.pool] : planeSizes[job.pool];
+		job.dst     = job.is32 ? &*planarData32[job.pool].begin()   : &*planarData[job.pool].begin();
+		job.scales  = job.is32 ? &*planeScales32[job.pool].begin()  : &*planeScales[job.pool].begin();
+		job.offsets = job.is32 ? &*planeOffsets32[job.pool].begin() : &*planeOffsets[job.pool].begin();
+	}
+	if (!decodeJobs.empty())
+		TU_ParallelFor(decodeJobs.size(), DSFDecodePoolJob, &*decodeJobs.begin(),
+			decodeTotal < DSF_PARALLEL_DECODE_MIN ? 1 : sDecodeThreads);
 	
 	
 
@@ -510,11 +826,6 @@ someday check footer when in sloooow mode
 		
 	const char * str;
 	int	pass_number = 0;
-	if (inPasses == NULL)
-	{
-		static int once[2] = { dsf_CmdAll, 0 };
-		inPasses = once;
-	}
 
 	while (inPasses[pass_number])
 	{
@@ -602,7 +913,15 @@ someday check footer when in sloooow mode
 	
 	
 
-	/* Now we're ready to do the commands. */
+	/* Now we're ready to do the commands - unless this pass has no use for geometry. */
+
+		if ((flags & (dsf_CmdPatches | dsf_CmdVectors | dsf_CmdPolys | dsf_CmdObjects)) == 0)
+		{
+			if (!inCallbacks->NextPass_f(pass_number, ref))
+				return dsf_ErrUserCancel;
+			++pass_number;
+			continue;
+		}
 
 		unsigned int		currentDefinition = 0xFFFFFFFF;
 		unsigned int		roadSubtype = 0xFFFFFFFF;
@@ -616,6 +935,7 @@ someday check footer when in sloooow mode
 		double *			currentPoolPtr32 = NULL;
 		int					currentDepth = -1;
 		int					currentDepth32 = -1;
+		vector<double>		primVerts;		// Gathered vertices of the current primitive for AddPatchVertices_f
 
 
 	cmdsAtom.Reset();
@@ -659,8 +979,8 @@ someday check footer when in sloooow mode
 				return dsf_ErrPoolOutOfRange;
 			}
 			
-			if (currentPool < planarData.size())	{ currentPoolPtr   = &*planarData  [currentPool].begin(); currentDepth   = planeDepths  [currentPool]; } else currentPoolPtr = NULL;
-			if (currentPool < planarData32.size())	{ currentPoolPtr32 = &*planarData32[currentPool].begin(); currentDepth32 = planeDepths32[currentPool]; } else currentPoolPtr32 = NULL;
+			if (currentPool < planarData.size() && !planarData[currentPool].empty())		{ currentPoolPtr   = &*planarData  [currentPool].begin(); currentDepth   = planeDepths  [currentPool]; } else currentPoolPtr = NULL;
+			if (currentPool < planarData32.size() && !planarData32[currentPool].empty())	{ currentPoolPtr32 = &*planarData32[currentPool].begin(); currentDepth32 = planeDepths32[currentPool]; } else currentPoolPtr32 = NULL;
 			break;
 		case dsf_Cmd_JunctionOffsetSelect		:
 			junctionOffset = cmdsAtom.ReadUInt32();
@@ -793,7 +1113,7 @@ someday check footer when in sloooow mode
 			while(count--)
 			{
 				index = cmdsAtom.ReadUInt16();
-				if (dsf_CmdPolys)
+				if (flags & dsf_CmdPolys)
 				{
 					inCallbacks->AddPolygonPoint_f(DECODE_SCALED_CURRENT(index), ref);
 				}
@@ -919,11 +1239,11 @@ someday check footer when in sloooow mode
 				index = cmdsAtom.ReadUInt16();
 					if (flags & dsf_CmdPatches)
 					{
-					inCallbacks->AddPatchVertex_f(DECODE_SCALED_CURRENT(index), ref);
+					DSFAddPrimitiveVertex(inCallbacks, primVerts, DECODE_SCALED_CURRENT(index), triCoordDim, triCoordDim, ref);
 			}
 				}
 				if (flags & dsf_CmdPatches)
-			inCallbacks->EndPrimitive_f(ref);
+			DSFEndPrimitive(inCallbacks, primVerts, triCoordDim, ref);
 			break;
 		case dsf_Cmd_TriangleCrossPool:
 				if (flags & dsf_CmdPatches)
@@ -943,11 +1263,11 @@ someday check footer when in sloooow mode
 				index = cmdsAtom.ReadUInt16();
 					if (flags & dsf_CmdPatches)
 					{
-					inCallbacks->AddPatchVertex_f(DECODE_SCALED(index, pool, planarData, planeDepths), ref);
+					DSFAddPrimitiveVertex(inCallbacks, primVerts, DECODE_SCALED(index, pool, planarData, planeDepths), triCoordDim, planeDepths[pool], ref);
 			}
 				}
 				if (flags & dsf_CmdPatches)
-			inCallbacks->EndPrimitive_f(ref);
+			DSFEndPrimitive(inCallbacks, primVerts, triCoordDim, ref);
 			break;
 
 		case dsf_Cmd_TriangleRange				:
@@ -957,6 +1277,12 @@ someday check footer when in sloooow mode
 				if (flags & dsf_CmdPatches)
 				{
 			inCallbacks->BeginPrimitive_f(dsf_Tri, ref);
+			if (inCallbacks->AddPatchVertices_f)
+			{
+				if (index2 > index1)
+					inCallbacks->AddPatchVertices_f(DECODE_SCALED_CURRENT(index1), triCoordDim, index2 - index1, ref);
+			}
+			else
 			for (index = index1; index < index2; ++index)
 			{
 					inCallbacks->AddPatchVertex_f(DECODE_SCALED_CURRENT(index), ref);
@@ -974,11 +1300,11 @@ someday check footer when in sloooow mode
 				index = cmdsAtom.ReadUInt16();
 					if (flags & dsf_CmdPatches)
 					{
-					inCallbacks->AddPatchVertex_f(DECODE_SCALED_CURRENT(index), ref);
+					DSFAddPrimitiveVertex(inCallbacks, primVerts, DECODE_SCALED_CURRENT(index), triCoordDim, triCoordDim, ref);
 			}
 				}
 				if (flags & dsf_CmdPatches)
-			inCallbacks->EndPrimitive_f(ref);
+			DSFEndPrimitive(inCallbacks, primVerts, triCoordDim, ref);
 			break;
 		case dsf_Cmd_TriangleStripCrossPool:
 				if (flags & dsf_CmdPatches)
@@ -998,11 +1324,11 @@ someday check footer when in sloooow mode
 				index = cmdsAtom.ReadUInt16();
 					if (flags & dsf_CmdPatches)
 					{
-					inCallbacks->AddPatchVertex_f(DECODE_SCALED(index, pool, planarData, planeDepths), ref);
+					DSFAddPrimitiveVertex(inCallbacks, primVerts, DECODE_SCALED(index, pool, planarData, planeDepths), triCoordDim, planeDepths[pool], ref);
 			}
 				}
 				if (flags & dsf_CmdPatches)
-			inCallbacks->EndPrimitive_f(ref);
+			DSFEndPrimitive(inCallbacks, primVerts, triCoordDim, ref);
 			break;
 
 		case dsf_Cmd_TriangleStripRange				:
@@ -1012,6 +1338,12 @@ someday check footer when in sloooow mode
 				if (flags & dsf_CmdPatches)
 				{
 			inCallbacks->BeginPrimitive_f(dsf_TriStrip, ref);
+			if (inCallbacks->AddPatchVertices_f)
+			{
+				if (index2 > index1)
+					inCallbacks->AddPatchVertices_f(DECODE_SCALED_CURRENT(index1), triCoordDim, index2 - index1, ref);
+			}
+			else
 			for (index = index1; index < index2; ++index)
 			{
 					inCallbacks->AddPatchVertex_f(DECODE_SCALED_CURRENT(index), ref);
@@ -1030,11 +1362,11 @@ someday check footer when in sloooow mode
 				index = cmdsAtom.ReadUInt16();
 					if (flags & dsf_CmdPatches)
 					{
-					inCallbacks->AddPatchVertex_f(DECODE_SCALED_CURRENT(index), ref);
+					DSFAddPrimitiveVertex(inCallbacks, primVerts, DECODE_SCALED_CURRENT(index), triCoordDim, triCoordDim, ref);
 			}
 				}
 				if (flags & dsf_CmdPatches)
-			inCallbacks->EndPrimitive_f(ref);
+			DSFEndPrimitive(inCallbacks, primVerts, triCoordDim, ref);
 			break;
 		case dsf_Cmd_TriangleFanCrossPool:
 				if (flags & dsf_CmdPatches)
@@ -1056,11 +1388,11 @@ someday check footer when in sloooow mode
 
 					if (flags & dsf_CmdPatches)
 					{
-					inCallbacks->AddPatchVertex_f(DECODE_SCALED(index, pool, planarData, planeDepths), ref);
+					DSFAddPrimitiveVertex(inCallbacks, primVerts, DECODE_SCALED(index, pool, planarData, planeDepths), triCoordDim, planeDepths[pool], ref);
 			}
 				}
 				if (flags & dsf_CmdPatches)
-			inCallbacks->EndPrimitive_f(ref);
+			DSFEndPrimitive(inCallbacks, primVerts, triCoordDim, ref);
 			
 			break;
 
@@ -1071,6 +1403,12 @@ someday check footer when in sloooow mode
 				if (flags & dsf_CmdPatches)
 				{
 			inCallbacks->BeginPrimitive_f(dsf_TriFan, ref);
+			if (inCallbacks->AddPatchVertices_f)
+			{
+				if (index2 > index1)
+					inCallbacks->AddPatchVertices_f(DECODE_SCALED_CURRENT(index1), triCoordDim, index2 - index1, ref);
+			}
+			else
 			for (index = index1; index < index2; ++index)
 			{
 					inCallbacks->AddPatchVertex_f(DECODE_SCALED_CURRENT(index), ref);
@@ -1136,7 +1474,7 @@ someday check footer when in sloooow mode
 			return dsf_ErrBadCommand;
 		}
 	}
-	if (patchOpen) inCallbacks->EndPatch_f(ref);
+	if (patchOpen && (flags & dsf_CmdPatches)) inCallbacks->EndPatch_f(ref);
 
 	if (cmdsAtom.Overrun())
 	{
@@ -181,6 +181,17 @@ struct	DSFCallbacks_t {
 					int					inFilterIndex,
 					void *				inRef);
 
+	/* Optional: if this is not NULL, the reader hands over each primitive's
+	 * vertices in one call instead of calling AddPatchVertex_f per vertex.
+	 * inCoordinates holds inVertexCount vertices of inCoordDepth doubles each,
+	 * interleaved, and is only valid for the duration of the call.  Leave
+	 * this NULL (e.g. by zeroing the struct) to get per-vertex callbacks. */
+	void (* AddPatchVertices_f)(
+					double				inCoordinates[],
+					int					inCoordDepth,
+					int					inVertexCount,
+					void *				inRef);
+
 };
 
 /************************************************************
@@ -206,6 +217,14 @@ struct	DSFCallbacks_t {
  * int in the array should be 0 to indicate the end of
  * the array.
  *
+ * DSFReadFileMapped memory-maps the file read-only and decodes
+ * straight out of the mapping; no copy of the file is made.
+ * Point pools are only decoded if one of the passes needs them
+ * and the command atom is skipped for passes that don't ask for
+ * patches, vectors, polygons or objects, so a properties or
+ * definitions-only read only touches the pages it needs.  If the
+ * file can't be mapped it falls back to DSFReadFile.
+ *
  * These functions return an error code.  See DSFLib.cpp for
  * #defines to control debug diagnostic output.
  *
@@ -213,8 +232,21 @@ struct	DSFCallbacks_t {
 
 /* Returns true if successful, false if not. */
 int		DSFReadFile(const char * inPath, void * (* malloc_func)(size_t s), void (* free_func)(void * ptr), DSFCallbacks_t * inCallbacks, const int * inPasses, void * inRef);
+int		DSFReadFileMapped(const char * inPath, DSFCallbacks_t * inCallbacks, const int * inPasses, void * inRef);
 int		DSFReadMem(const char * inStart, const char * inStop, DSFCallbacks_t * inCallbacks, const int * inPasses, void * inRef);
 int		DSFCheckSignature(const char * inPath);
+int		DSFCheckSignatureMapped(const char * inPath);
+
+/* Checks the signatures of inCount files on up to inThreads threads (0 = one per CPU), streaming each
+ * file in large blocks rather than loading it whole.  outResults (if not NULL) receives one error code
+ * per path, in the order given, and outBytes (if not NULL) the number of bytes hashed in files that
+ * passed.  Returns the number of files that failed. */
+int		DSFCheckSignatureBatch(int inCount, const char * const * inPaths, int * outResults, int inThreads, double * outBytes);
+
+/* Point pools are decoded on up to this many threads before the first pass runs; callbacks are always made
+ * on the calling thread, in file order.  0 (the default) means one thread per CPU, 1 decodes serially.  Set
+ * this to 1 if you are already reading several DSFs at once on your own threads. */
+void	DSFSetDecodeThreads(int inThreads);
 /************************************************************
  * DFS WRITING UTILS
  ************************************************************
@@ -232,6 +264,20 @@ int		DSFCheckSignature(const char * inPath);
 
 void *	DSFCreateWriter(double inWest, double inSouth, double inNorth, double inEast, double inElevMin, double inElevMax, int divisions);
 void	DSFGetWriterCallbacks(DSFCallbacks_t * ioCallbacks);
+
+/*
+ * DSFSetWriterSpill
+ *
+ * Call right after creating a writer (before any patches are added) to bound its memory use
+ * for big meshes.  With spill on, each terrain patch is moved to a temporary file (one per
+ * terrain type) as soon as EndPatch is called, and DSFWriteToFile streams the patches back
+ * from disk while encoding.  Peak memory for terrain is then the point pools plus the largest
+ * single patch, not the whole tile.  The result is a normal DSF; only the order in which
+ * vertices land in the point pools may differ.
+ *
+ */
+void	DSFSetWriterSpill(void * inRef, int inSpill);
+
 void	DSFWriteToFile(const char * inPath, void * inRef);
 void	DSFDestroyWriter(void * inRef);
 
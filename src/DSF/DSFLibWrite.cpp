@@ -33,6 +33,10 @@
 #include <set>
 #include <algorithm>
 
+#if IBM
+	#include <windows.h>
+#endif
+
 #define	POLY_POINT_POOL_COUNT	12
 
 #define ALLOW_CONTIGUOUS_PRIMITIVES 0
@@ -58,19 +62,21 @@
 
 static	void	DSFSignMD5(const char * inPath)
 {
-	unsigned char buf[1024];
 	FILE * fi = fopen(inPath, "rb");
 	if (fi == NULL) return;
+	unsigned char * buf = (unsigned char *) malloc(DSF_SIGNATURE_BLOCK);
+	if (buf == NULL) { fclose(fi); return; }
 	MD5_CTX ctx;
 	MD5Init(&ctx);
 
 	while (1)
 	{
-		size_t c = fread(buf, 1, sizeof(buf), fi);
+		size_t c = fread(buf, 1, DSF_SIGNATURE_BLOCK, fi);
 		if (c == 0) break;
 		MD5Update(&ctx, buf, c);
 	}
 	MD5Final(&ctx);
+	free(buf);
 	fclose(fi);
 	fi = fopen(inPath, "ab");
 	fwrite(ctx.digest, 1, 16, fi);
@@ -85,6 +91,46 @@ struct	StCloseAndKill {
 	string p_;
 };
 
+// Anonymous scratch file, deleted when closed.  tmpfile() on Windows wants to create its file in the
+// root of the current drive, which normal users can't do, so go through the user's temp dir there.
+static FILE *	DSFOpenSpillFile(void)
+{
+#if IBM
+	char	dir[MAX_PATH], path[MAX_PATH];
+	if (GetTempPathA(MAX_PATH, dir) == 0 || GetTempFileNameA(dir, "dsf", 0, path) == 0)
+		return NULL;
+	return fopen(path, "w+bTD");
+#else
+	return tmpfile();
+#endif
+}
+
+static void	DSFSpillWrite(const void * inData, size_t inSize, size_t inCount, FILE * fi)
+{
+	if (fwrite(inData, inSize, inCount, fi) != inCount)
+		AssertPrintf("DSF spill file write failed - is the temp disk full?");
+}
+
+static void	DSFSpillRead(void * outData, size_t inSize, size_t inCount, FILE * fi)
+{
+	if (fread(outData, inSize, inCount, fi) != inCount)
+		AssertPrintf("DSF spill file read failed.");
+}
+
+// One spilled primitive: type, vertex count, then count * depth doubles.
+static void	DSFReadSpilledPrimitive(FILE * fi, int inDepth, int& outType, DSFTupleVector& outVertices, vector<double>& buf)
+{
+	int32_t	hdr[2];
+	DSFSpillRead(hdr, sizeof(int32_t), 2, fi);
+	outType = hdr[0];
+	buf.resize(hdr[1] * inDepth);
+	DSFSpillRead(&*buf.begin(), sizeof(double), buf.size(), fi);
+	outVertices.clear();
+	outVertices.reserve(hdr[1]);
+	for (int n = 0; n < hdr[1]; ++n)
+		outVertices.push_back(DSFTuple(&buf[n * inDepth], inDepth));
+}
+
 static bool	ErasePair(multimap<int, int>& ioMap, int key, int value);
 static bool	ErasePair(multimap<int, int>& ioMap, int key, int value)
 {
@@ -245,6 +291,7 @@ public:
 		int						type;
 		unsigned char			flags;
 		int						depth;
+		int						spilled;	// Number of primitives parked in the spill file, 0 if held in memory.
 		TriPrimitiveVector		primitives;
 
 		bool	operator<(const PatchSpec& rhs) const {
@@ -261,6 +308,35 @@ public:
 	PatchSpec *					accum_patch;
 	TriPrimitive *				accum_primitive;
 
+	struct	PrimitiveStats {
+		int		prim, strip, fan, v, strip_v, fan_v;
+		PrimitiveStats() : prim(0), strip(0), fan(0), v(0), strip_v(0), fan_v(0) { }
+		void	add(int type, int count) {
+										++prim;
+			if(type == dsf_TriStrip)	++strip;
+			if(type == dsf_TriFan  )	++fan;
+										v += count;
+			if(type == dsf_TriStrip)	strip_v += count;
+			if(type == dsf_TriFan  )	fan_v += count;
+		}
+	};
+
+	/********** TERRAIN SPILL STORAGE **********/
+
+	// In spill mode each patch is written to a temp file for its terrain type as soon as it is
+	// finished and dropped from memory.  Only one patch is open at a time, so the patches of one
+	// terrain type sit in their file in the same order as in 'patches' - every pass over the spilled
+	// mesh is a sequential read, no seeking.  Sinking the vertices produces a second temp file of
+	// pool locations, read back one patch at a time by the command writer.
+	bool						mSpill;
+	map<int, FILE *>			spill_files;
+	FILE *						spill_indices;
+	PrimitiveStats				spill_stats;
+
+	void	SpillPatch(PatchSpec& ioPatch);
+	void	SinkSpilledPatches(void);
+	void	LoadSpilledPatch(PatchSpec& ioPatch);
+
 	/********** VECTOR STORAGE **********/
 	DSF32BitPointPool	vectorPool;
 	DSF32BitPointPool	vectorPoolCurved;
@@ -301,6 +377,7 @@ public:
 	vector<void *>				raster_data;
 
 	DSFFileWriterImp(double inWest, double inSouth, double inEast, double inNorth, double inElevMin, double inElevMax, int divisions);
+	~DSFFileWriterImp();
 	void WriteToFile(const char * inPath);
 
 	// DATA ACCUMULATORS
@@ -325,6 +402,11 @@ public:
 	static void AddPatchVertex(
 					double			inCoordinate[],
 					void *			inRef);
+	static void AddPatchVertices(
+					double			inCoordinates[],
+					int				inCoordDepth,
+					int				inVertexCount,
+					void *			inRef);
 	static void EndPrimitive(
 					void *			inRef);
 	static void EndPatch(
@@ -391,6 +473,13 @@ void	DSFDestroyWriter(void * inRef)
 	DSFFileWriterImp * imp = (DSFFileWriterImp *) inRef;
 	delete imp;
 }
+void	DSFSetWriterSpill(void * inRef, int inSpill)
+{
+	DSFFileWriterImp * imp = (DSFFileWriterImp *) inRef;
+	Assert(imp->patches.empty());
+	imp->mSpill = inSpill != 0;
+}
+
 void	DSFGetWriterCallbacks(DSFCallbacks_t * ioCallbacks)
 {
 	ioCallbacks->AcceptTerrainDef_f = DSFFileWriterImp::AcceptTerrainDef;
@@ -402,6 +491,7 @@ void	DSFGetWriterCallbacks(DSFCallbacks_t * ioCallbacks)
 	ioCallbacks->BeginPatch_f = DSFFileWriterImp::BeginPatch;
 	ioCallbacks->BeginPrimitive_f = DSFFileWriterImp::BeginPrimitive;
 	ioCallbacks->AddPatchVertex_f = DSFFileWriterImp::AddPatchVertex;
+	ioCallbacks->AddPatchVertices_f = DSFFileWriterImp::AddPatchVertices;
 	ioCallbacks->EndPrimitive_f = DSFFileWriterImp::EndPrimitive;
 	ioCallbacks->EndPatch_f = DSFFileWriterImp::EndPatch;
 	ioCallbacks->AddObject_f = DSFFileWriterImp::AddObject;
@@ -432,6 +522,8 @@ DSFFileWriterImp::DSFFileWriterImp(double inWest, double inSouth, double inEast,
 	mElevMin = inElevMin;
 	mElevMax = inElevMax;
 	mCurrentFilter = -1;
+	mSpill = false;
+	spill_indices = NULL;
 
 	// BUILD VECTOR POOLS
 	DSFTuple	vecRangeMin, vecRangeMax;
@@ -504,6 +596,151 @@ DSFFileWriterImp::DSFFileWriterImp(double inWest, double inSouth, double inEast,
 	// POINT POOL TERRAINS ARE DRAWN ON THE FLY
 }
 
+DSFFileWriterImp::~DSFFileWriterImp()
+{
+	for (map<int, FILE *>::iterator f = spill_files.begin(); f != spill_files.end(); ++f)
+		fclose(f->second);
+	if (spill_indices)
+		fclose(spill_indices);
+}
+
+void	DSFFileWriterImp::SpillPatch(PatchSpec& ioPatch)
+{
+	FILE *& fi = spill_files[ioPatch.type];
+	if (fi == NULL && (fi = DSFOpenSpillFile()) == NULL)
+		AssertPrintf("Could not create DSF spill file.");
+
+	vector<double>	buf;
+	ioPatch.spilled = 0;
+	for (TriPrimitiveVector::iterator p = ioPatch.primitives.begin(); p != ioPatch.primitives.end(); ++p)
+	if (!p->vertices.empty())
+	{
+		int32_t	hdr[2] = { p->type, (int32_t) p->vertices.size() };
+		buf.resize(p->vertices.size() * ioPatch.depth);
+		double * d = &*buf.begin();
+		for (DSFTupleVector::iterator v = p->vertices.begin(); v != p->vertices.end(); ++v)
+			d = copy(v->begin(), v->end(), d);
+		DSFSpillWrite(hdr, sizeof(int32_t), 2, fi);
+		DSFSpillWrite(&*buf.begin(), sizeof(double), buf.size(), fi);
+		spill_stats.add(p->type, p->vertices.size());
+		++ioPatch.spilled;
+	}
+	TriPrimitiveVector().swap(ioPatch.primitives);
+}
+
+// Same policy as the in-memory path: first place any primitive that shares no vertices as a
+// contiguous range, then sink whatever is left vertex by vertex.  Each pass streams the spill files
+// once; the final locations go to spill_indices as type, is_range, count, then count pool/index pairs.
+void	DSFFileWriterImp::SinkSpilledPatches(void)
+{
+	if (spill_files.empty())
+		return;
+
+	PatchSpecVector::iterator		patchSpec;
+	map<int, FILE *>::iterator		f;
+	DSFTupleVector					vertices;
+	vector<double>					buf;
+	vector<int32_t>					idx;
+	int								type, k, n;
+
+	FILE *	ranges = NULL;
+	if (ALLOW_CONTIGUOUS_PRIMITIVES)
+	{
+		if ((ranges = DSFOpenSpillFile()) == NULL)
+			AssertPrintf("Could not create DSF spill file.");
+		for (f = spill_files.begin(); f != spill_files.end(); ++f)
+			rewind(f->second);
+		for (patchSpec = patches.begin(); patchSpec != patches.end(); ++patchSpec)
+		for (k = 0; k < patchSpec->spilled; ++k)
+		{
+			DSFReadSpilledPrimitive(spill_files[patchSpec->type], patchSpec->depth, type, vertices, buf);
+			DSFSharedPointPool& pool(terrainPool[patchSpec->depth]);
+			int32_t loc[2] = { -1, -1 };
+			if (pool.CountShared(vertices) == 0 && pool.CanBeContiguous(vertices))
+			{
+				Assert(vertices.size() < 65536);
+				DSFPointPoolLoc l = pool.AcceptContiguous(vertices);
+				if (l.first != -1 && l.second != -1)
+					loc[0] = l.first, loc[1] = l.second;
+			}
+			DSFSpillWrite(loc, sizeof(int32_t), 2, ranges);
+		}
+		rewind(ranges);
+	}
+
+	if ((spill_indices = DSFOpenSpillFile()) == NULL)
+		AssertPrintf("Could not create DSF spill file.");
+	for (f = spill_files.begin(); f != spill_files.end(); ++f)
+		rewind(f->second);
+
+	for (patchSpec = patches.begin(); patchSpec != patches.end(); ++patchSpec)
+	for (k = 0; k < patchSpec->spilled; ++k)
+	{
+		DSFReadSpilledPrimitive(spill_files[patchSpec->type], patchSpec->depth, type, vertices, buf);
+		DSFSharedPointPool& pool(terrainPool[patchSpec->depth]);
+		int32_t loc[2] = { -1, -1 };
+		if (ranges)
+			DSFSpillRead(loc, sizeof(int32_t), 2, ranges);
+
+		int32_t hdr[3] = { type, loc[0] != -1, (int32_t) vertices.size() };
+		idx.resize(vertices.size() * 2);
+		for (n = 0; n < vertices.size(); ++n)
+		if (hdr[1])
+		{
+			idx[n*2  ] = loc[0];
+			idx[n*2+1] = loc[1] + n;
+		}
+		else
+		{
+			DSFPointPoolLoc l = pool.AcceptShared(vertices[n]);
+			if (l.second >= 65536)
+				AssertPrintf("Out of bounds sink: pool %d, point %d.\n", l.first, l.second);
+			if (l.first == -1 || l.second == -1)
+			{
+				vertices[n].dump();
+				printf(" ");
+				vertices[n].dumphex();
+				printf("\n");
+				Assert(!"ERROR: could not sink vertex:\n");
+			}
+			idx[n*2  ] = l.first;
+			idx[n*2+1] = l.second;
+		}
+		DSFSpillWrite(hdr, sizeof(int32_t), 3, spill_indices);
+		DSFSpillWrite(&*idx.begin(), sizeof(int32_t), idx.size(), spill_indices);
+	}
+
+	if (ranges)
+		fclose(ranges);
+
+	// The mesh itself is no longer needed - only the locations are.
+	for (f = spill_files.begin(); f != spill_files.end(); ++f)
+		fclose(f->second);
+	spill_files.clear();
+	rewind(spill_indices);
+}
+
+// Pulls the next patch's primitives back out of spill_indices, with pool numbers already remapped
+// to their final values.  Must be called in patch order, after the pools are processed.
+void	DSFFileWriterImp::LoadSpilledPatch(PatchSpec& ioPatch)
+{
+	DSFSharedPointPool& pool(terrainPool[ioPatch.depth]);
+	vector<int32_t>	idx;
+	ioPatch.primitives.resize(ioPatch.spilled);
+	for (TriPrimitiveVector::iterator p = ioPatch.primitives.begin(); p != ioPatch.primitives.end(); ++p)
+	{
+		int32_t hdr[3];
+		DSFSpillRead(hdr, sizeof(int32_t), 3, spill_indices);
+		idx.resize(hdr[2] * 2);
+		DSFSpillRead(&*idx.begin(), sizeof(int32_t), idx.size(), spill_indices);
+		p->type = hdr[0];
+		p->is_range = hdr[1] != 0;
+		p->indices.resize(hdr[2]);
+		for (int n = 0; n < hdr[2]; ++n)
+			p->indices[n] = DSFPointPoolLoc(pool.MapPoolNumber(idx[n*2]), idx[n*2+1]);
+	}
+}
+
 template<typename DT, void (* RF)(FILE * fi, DT data)>
 void write_raster_pile(FILE * fi, int count, const DT * data)
 {
@@ -747,25 +984,13 @@ void DSFFileWriterImp::WriteToFile(const char * inPath)
 	ChainSpecIndex::iterator			csIndex;
 
 	// Start by outputing some stats on our primitives - useful to test how the optimizer is doing!
-	int num_prim = 0;
-	int num_strip = 0;
-	int num_fan = 0;
-	int num_v = 0;
-	int num_strip_v = 0;
-	int num_fan_v = 0;
+	PrimitiveStats	stats(spill_stats);
 
 	for(patchSpec = patches.begin(); patchSpec != patches.end(); ++patchSpec)
 	for(primIter = patchSpec->primitives.begin(); primIter != patchSpec->primitives.end(); ++primIter)
-	{
-											++num_prim;
-		if(primIter->type == dsf_TriStrip)	++num_strip;
-		if(primIter->type == dsf_TriFan  )	++num_fan;
-											num_v += primIter->vertices.size();
-		if(primIter->type == dsf_TriStrip)	num_strip_v += primIter->vertices.size();
-		if(primIter->type == dsf_TriFan  )	num_fan_v += primIter->vertices.size();
-	}
-	printf("Vertices: total = %d, strip = %d, fan = %d.\n",num_v,num_strip_v, num_fan_v);
-	printf("Primitives: total = %d, strip = %d, fan = %d.\n", num_prim, num_strip, num_fan);
+		stats.add(primIter->type, primIter->vertices.size());
+	printf("Vertices: total = %d, strip = %d, fan = %d.\n",stats.v,stats.strip_v, stats.fan_v);
+	printf("Primitives: total = %d, strip = %d, fan = %d.\n", stats.prim, stats.strip, stats.fan);
 
 	// Build up a list of all primitives, sorted by depth
 	TPVM	all_primitives;
@@ -833,6 +1058,9 @@ void DSFFileWriterImp::WriteToFile(const char * inPath)
 #endif
 	}
 
+	// Spilled patches go in after the in-memory ones, streamed back from disk.
+	SinkSpilledPatches();
+
 #if ENCODING_STATS
 	int shared = 0;
 	for(DSFSharedPointPoolMap::iterator i = terrainPool.begin(); i != terrainPool.end(); ++i)
@@ -1275,12 +1503,15 @@ void DSFFileWriterImp::WriteToFile(const char * inPath)
 
 		for (patchSpec = patches.begin(); patchSpec != patches.end(); ++patchSpec)
 		{
+			if (patchSpec->spilled)
+				LoadSpilledPatch(*patchSpec);
+
 			// Prep step - build up a list of pools referenced and also
 			// mark pools as cross-pool or not.
 			set<int>	pools;
 			for (primIter = patchSpec->primitives.begin(); primIter != patchSpec->primitives.end(); ++primIter)
 			{
-				if (primIter->vertices.empty()) continue;
+				if (primIter->indices.empty()) continue;
 				if (primIter->is_range)
 				{
 					pools.insert(primIter->indices.begin()->first);
@@ -1388,6 +1619,9 @@ void DSFFileWriterImp::WriteToFile(const char * inPath)
 					WriteUInt16(fi, primIter->indices[n].second);
 				}
 			}
+
+			if (patchSpec->spilled)
+				TriPrimitiveVector().swap(patchSpec->primitives);
 		}
 
 #if ENCODING_STATS
@@ -1620,6 +1854,7 @@ void 	DSFFileWriterImp::BeginPatch(
 	REF(inRef)->accum_patch->type = inTerrainType;
 	REF(inRef)->accum_patch->flags = inFlags;
 	REF(inRef)->accum_patch->depth = inCoordDepth;
+	REF(inRef)->accum_patch->spilled = 0;
 }
 
 void 	DSFFileWriterImp::BeginPrimitive(
@@ -1641,6 +1876,19 @@ void 	DSFFileWriterImp::AddPatchVertex(
 			REF(inRef)->accum_patch->depth));
 }
 
+void 	DSFFileWriterImp::AddPatchVertices(
+				double			inCoordinates[],
+				int				inCoordDepth,
+				int				inVertexCount,
+				void *			inRef)
+{
+	DSFTupleVector&	verts(REF(inRef)->accum_primitive->vertices);
+	int				depth = REF(inRef)->accum_patch->depth;
+	verts.reserve(verts.size() + inVertexCount);
+	for (int n = 0; n < inVertexCount; ++n, inCoordinates += inCoordDepth)
+		verts.push_back(DSFTuple(inCoordinates, depth));
+}
+
 void 	DSFFileWriterImp::EndPrimitive(
 				void *			inRef)
 {
@@ -1680,6 +1928,9 @@ void	DSFFileWriterImp::EndPatch(
 			me->primitives.back().type = pp->kind;
 			swap(me->primitives.back().vertices,pp->vertices);
 		}
+
+		if (REF(inRef)->mSpill)
+			REF(inRef)->SpillPatch(*me);
 	}
 }
 
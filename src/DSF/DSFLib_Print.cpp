@@ -442,6 +442,7 @@ obj_total = 0;
 	callbacks.AddPolygonPoint_f = DSFPrint_AddPolygonPoint;
 	callbacks.EndPolygonWinding_f = DSFPrint_EndPolygonWinding;
 	callbacks.EndPolygon_f = DSFPrint_EndPolygon;
+	callbacks.AddPatchVertices_f = NULL;
 #if USE_MEM_FILE
 	int err = 0;
 	MFMemFile *	mf = MemFile_Open(inPath);
@@ -451,7 +452,7 @@ obj_total = 0;
 		MemFile_Close(mf);
 	}
 #else
-	int err = DSFReadFile(inPath, &callbacks, NULL, output);
+	int err = DSFReadFileMapped(inPath, &callbacks, NULL, output);
 #endif
 	if (print_it) fprintf(output,"Done - error = %d (%s) ", err, dsfErrorMessages[err]);
 	if (print_it) fprintf(output,"Patches=%d, Tris=%d, polys=%d, objs=%d ",
@@ -69,6 +69,7 @@ void			DSFSharedPointPool::AddPool(DSFTuple& minFrac, DSFTuple& maxFrac)
 	mPools.push_back(SharedSubPool());
 	mPools.back().mOffset = submin;
 	mPools.back().mScale = submax - submin;
+	mPools.back().mPoints.set_depth(submin.size());
 }
 
 void			DSFSharedPointPool::AddPoolDirect(DSFTuple& minFrac, DSFTuple& maxFrac)
@@ -79,6 +80,7 @@ void			DSFSharedPointPool::AddPoolDirect(DSFTuple& minFrac, DSFTuple& maxFrac)
 	mPools.push_back(SharedSubPool());
 	mPools.back().mOffset = submin;
 	mPools.back().mScale = submax - submin;
+	mPools.back().mPoints.set_depth(submin.size());
 }
 
 bool			DSFSharedPointPool::CanBeContiguous(const DSFTupleVector& inPoints)
@@ -109,7 +111,7 @@ bool			DSFSharedPointPool::CanBeContiguous(const DSFTupleVector& inPoints)
 pair<int, int>	DSFSharedPointPool::AcceptContiguous(const DSFTupleVector& inPoints)
 {
 	int n;
-	DSFTupleVector	encoded;
+	vector<uint16_t>	encoded;
 	int	first_ok_pool = -1;
 	int p = 0;
 	SharedSubPool * found = NULL;
@@ -122,24 +124,25 @@ pair<int, int>	DSFSharedPointPool::AcceptContiguous(const DSFTupleVector& inPoin
 			continue;
 		}
 		bool ok = true;
-		encoded.clear();
+		int depth = pool->mPoints.depth();
+		encoded.resize(inPoints.size() * depth);
 		for (n = 0; n < inPoints.size(); ++n)
 		{
-			encoded.push_back(inPoints[n]);
-			if (!encoded.back().encode(pool->mOffset, pool->mScale))
+			DSFTuple	pt(inPoints[n]);
+			if (!pt.encode(pool->mOffset, pool->mScale))
 			{
 				ok = false;
 				break;
 			}
+			pool->mPoints.quantize(pt, &encoded[n * depth]);
 		}
 		if (ok)
 		{
 			// This is the first pool we've found where we at least could
 			// all fit.  Check for sharing.
-			for (n = 0; n < encoded.size(); ++n)
+			for (n = 0; n < inPoints.size(); ++n)
 			{
-				if (pool->mPointsIndex.find(encoded[n]) !=
-					pool->mPointsIndex.end())
+				if (pool->mPoints.find(&encoded[n * depth]) != -1)
 				{
 					return pair<int,int>(-1,-1);
 				}
@@ -156,14 +159,14 @@ pair<int, int>	DSFSharedPointPool::AcceptContiguous(const DSFTupleVector& inPoin
 pair<int, int>	DSFSharedPointPool::AcceptContiguousPool(int p, SharedSubPool * pool, const DSFTupleVector& inPoints)
 {
 	int n;
+	uint16_t	key[MAX_TUPLE_LEN];
 	pair<int,int> retval(p, pool->mPoints.size());
 	for (n = 0; n < inPoints.size(); ++n)
 	{
 		DSFTuple	pt(inPoints[n]);
 		pt.encode(pool->mOffset,pool->mScale);
-		pool->mPointsIndex.insert(hash_map<DSFTuple, int>::value_type(
-					pt, pool->mPoints.size()));
-		pool->mPoints.push_back(pt);
+		pool->mPoints.quantize(pt, key);
+		pool->mPoints.push_back(key);
 	}
 	return retval;
 }
@@ -171,16 +174,18 @@ pair<int, int>	DSFSharedPointPool::AcceptContiguousPool(int p, SharedSubPool * p
 int	DSFSharedPointPool::CountShared(const DSFTupleVector& inPoints)
 {
 	int c = 0;
+	uint16_t	key[MAX_TUPLE_LEN];
 	for(int n = 0; n < inPoints.size(); ++n)
 	{
 		// First check every scale for the point already existing.
 		for (list<SharedSubPool>::iterator pool = mPools.begin(); pool != mPools.end(); ++pool)
+		if (!pool->mPoints.empty())
 		{
 			DSFTuple	point(inPoints[n]);
 			if (point.encode(pool->mOffset, pool->mScale))
 			{
-				hash_map<DSFTuple,int>::iterator iter = pool->mPointsIndex.find(point);
-				if (iter != pool->mPointsIndex.end())
+				pool->mPoints.quantize(point, key);
+				if (pool->mPoints.find(key) != -1)
 					++c;
 			}
 		}
@@ -191,15 +196,18 @@ int	DSFSharedPointPool::CountShared(const DSFTupleVector& inPoints)
 pair<int, int>	DSFSharedPointPool::AcceptShared(const DSFTuple& inPoint)
 {
 	int p = 0;
+	uint16_t	key[MAX_TUPLE_LEN];
 	// First check every scale for the point already existing.
 	for (list<SharedSubPool>::iterator pool = mPools.begin(); pool != mPools.end(); ++pool, ++p)
+	if (!pool->mPoints.empty())
 	{
 		DSFTuple	point(inPoint);
 		if (point.encode(pool->mOffset, pool->mScale))
 		{
-			hash_map<DSFTuple,int>::iterator iter = pool->mPointsIndex.find(point);
-			if (iter != pool->mPointsIndex.end())
-				return pair<int,int>(p, iter->second);
+			pool->mPoints.quantize(point, key);
+			int idx = pool->mPoints.find(key);
+			if (idx != -1)
+				return pair<int,int>(p, idx);
 		}
 	}
 	// Hrm...doesn't exist.  Try to add it.
@@ -213,9 +221,8 @@ pair<int, int>	DSFSharedPointPool::AcceptShared(const DSFTuple& inPoint)
 		{
 			if(pool->mPoints.size() < 65535)
 			{
-				int our_pos = pool->mPoints.size();
-				pool->mPoints.push_back(point);
-				pool->mPointsIndex.insert(hash_map<DSFTuple, int>::value_type(point, our_pos));
+				pool->mPoints.quantize(point, key);
+				int our_pos = pool->mPoints.push_back(key);
 				return pair<int, int>(p, our_pos);
 			}
 			else if(exemplar == mPools.end())
@@ -232,13 +239,13 @@ pair<int, int>	DSFSharedPointPool::AcceptShared(const DSFTuple& inPoint)
 		mPools.push_back(SharedSubPool());
 		mPools.back().mOffset = exemplar->mOffset;
 		mPools.back().mScale = exemplar->mScale;
+		mPools.back().mPoints.set_depth(exemplar->mPoints.depth());
 
 		exemplar = mPools.end();
 		--exemplar;
 
-		int our_pos = exemplar->mPoints.size();
-		exemplar->mPoints.push_back(point);
-		exemplar->mPointsIndex.insert(hash_map<DSFTuple, int>::value_type(point, our_pos));
+		exemplar->mPoints.quantize(point, key);
+		int our_pos = exemplar->mPoints.push_back(key);
 		return pair<int, int>(mPools.size()-1, our_pos);
 	}
 
@@ -249,7 +256,7 @@ pair<int, int>	DSFSharedPointPool::AcceptShared(const DSFTuple& inPoint)
 void			DSFSharedPointPool::Trim(void)
 {
 	for (list<SharedSubPool>::iterator i = mPools.begin(); i != mPools.end(); ++i)
-		trim(i->mPoints);
+		i->mPoints.trim();
 }
 
 int				DSFSharedPointPool::Count() const
@@ -306,16 +313,7 @@ int			DSFSharedPointPool::WritePoolAtoms(FILE * fi, int32_t id)
 	for (list<SharedSubPool>::iterator pool = mPools.begin(); pool != mPools.end(); ++pool)
 	{
 		StAtomWriter	poolAtom(fi, id, true);
-		vector<uint16_t>	shorts;
-		for (DSFTupleVector::iterator i = pool->mPoints.begin();
-			i != pool->mPoints.end(); ++i)
-		{
-			for (int j = 0; j < i->size(); ++j)
-			{
-				shorts.push_back((*i)[j]);
-			}
-		}
-		WritePlanarNumericAtomShort(fi, pool->mScale.size(), pool->mPoints.size(), xpna_Mode_RLE_Differenced, 1, (int16_t *) &*shorts.begin());
+		WritePlanarNumericAtomShort(fi, pool->mScale.size(), pool->mPoints.size(), xpna_Mode_RLE_Differenced, 1, (int16_t *) pool->mPoints.data());
 	}
 	return mPools.size();
 }
@@ -528,17 +526,20 @@ void			DSF32BitPointPool::SetRange(
 	mMin = min; mMax = max;
 	mOffset = min;
 	mScale = mMax - mMin;
+	mPoints.set_depth(min.size());
 }
 
 int				DSF32BitPointPool::CountShared(const DSFTupleVector& inPoints)
 {
 	int count = 0;
+	uint32_t	key[MAX_TUPLE_LEN];
 	for (int n = 0; n < inPoints.size(); ++n)
 	{
 		DSFTuple	pt(inPoints[n]);
 		if (!pt.encode32(mOffset, mScale))
 			return -1;
-		if (mPointsIndex.find(pt) != mPointsIndex.end())
+		mPoints.quantize(pt, key);
+		if (mPoints.find(key) != -1)
 			++count;
 	}
 	return count;
@@ -547,6 +548,7 @@ int				DSF32BitPointPool::CountShared(const DSFTupleVector& inPoints)
 DSFPointPoolLoc	DSF32BitPointPool::AcceptContiguous(const DSFTupleVector& inPoints)
 {
 	DSFPointPoolLoc	result(0, mPoints.size());
+	uint32_t	key[MAX_TUPLE_LEN];
 	for (int n = 0; n < inPoints.size(); ++n)
 	{
 		DSFTuple	pt(inPoints[n]);
@@ -555,8 +557,8 @@ DSFPointPoolLoc	DSF32BitPointPool::AcceptContiguous(const DSFTupleVector& inPoin
 			return DSFPointPoolLoc(-1, -1);
 		}
 
-		mPointsIndex.insert(hash_map<DSFTuple, int>::value_type(pt, mPoints.size()));
-		mPoints.push_back(pt);
+		mPoints.quantize(pt, key);
+		mPoints.push_back(key);
 	}
 	return result;
 }
@@ -567,19 +569,18 @@ DSFPointPoolLoc	DSF32BitPointPool::AcceptShared(const DSFTuple& inPoint)
 	if (!pt.encode32(mOffset, mScale))
 		return DSFPointPoolLoc(-1, -1);
 
-	hash_map<DSFTuple, int>::iterator iter = mPointsIndex.find(pt);
-	if (iter != mPointsIndex.end())
-		return DSFPointPoolLoc(0, iter->second);
+	uint32_t	key[MAX_TUPLE_LEN];
+	mPoints.quantize(pt, key);
+	int idx = mPoints.find(key);
+	if (idx != -1)
+		return DSFPointPoolLoc(0, idx);
 
-	DSFPointPoolLoc	result(0, mPoints.size());
-	mPointsIndex.insert(hash_map<DSFTuple, int>::value_type(pt, mPoints.size()));
-	mPoints.push_back(pt);
-	return result;
+	return DSFPointPoolLoc(0, mPoints.push_back(key));
 }
 
 void				DSF32BitPointPool::Trim(void)
 {
-	trim(mPoints);
+	mPoints.trim();
 }
 
 int				DSF32BitPointPool::WritePoolAtoms(FILE * fi, int32_t id)
@@ -589,16 +590,7 @@ int				DSF32BitPointPool::WritePoolAtoms(FILE * fi, int32_t id)
 		StFileSizeDebugger how_big(fi,"32-bit point pool total");
 	#endif
 	StAtomWriter	poolAtom(fi, id, true);
-	vector<uint32_t>	longs;
-	for (DSFTupleVector::iterator i = mPoints.begin();
-		i != mPoints.end(); ++i)
-	{
-		for (int j = 0; j < i->size(); ++j)
-		{
-			longs.push_back((*i)[j]);
-		}
-	}
-	WritePlanarNumericAtomInt(fi, mScale.size(), mPoints.size(), xpna_Mode_RLE_Differenced, 1, (int *) &*longs.begin());
+	WritePlanarNumericAtomInt(fi, mScale.size(), mPoints.size(), xpna_Mode_RLE_Differenced, 1, (int *) mPoints.data());
 
 	return 1;
 }
@@ -119,6 +119,49 @@ HASH_MAP_NAMESPACE_END
 typedef	vector<DSFTuple>			DSFTupleVector;
 typedef list<DSFTupleVector>		DSFTupleVectorVector;
 
+/* A point table - a flat, de-duplicated array of already-quantized points.
+ *
+ * Points are kept exactly as they will be written to the POOL/PO32 atom (16 or 32-bit ints,
+ * interleaved, depth ints per point) and indexed by an open-addressing hash on those ints, so
+ * two points that quantize to the same value are the same point.  This costs depth * sizeof(T)
+ * per point plus a few bytes of hash slots, instead of a full DSFTuple in both a vector and a
+ * hash_map node, and the point data can go straight to WritePlanarNumericAtom*. */
+
+template <typename T>
+class	DSFPointTable {
+public:
+
+	DSFPointTable() : mDepth(0), mCount(0) { }
+
+	void			set_depth(int depth) 	{ mDepth = depth;	}
+	int				depth() const			{ return mDepth;	}
+	int				size() const			{ return mCount;	}
+	bool			empty() const			{ return mCount == 0; }
+	const T *		data() const			{ return mData.empty() ? NULL : &*mData.begin(); }
+
+	// Quantize an encoded tuple (see DSFTuple::encode) into a key - truncates exactly like the atom writer.
+	inline void		quantize(const DSFTuple& encoded, T * outKey) const;
+
+	// Returns the index of the first point equal to key, or -1.
+	inline int		find(const T * key) const;
+	// Appends the point and returns its index.  If the point is already in the table, the
+	// hash keeps pointing at the first copy.
+	inline int		push_back(const T * key);
+
+	void			trim(void) 				{ ::trim(mData); }
+
+private:
+
+	inline size_t	hash_key(const T * key) const;
+	void			rehash(size_t slot_count);
+
+	int				mDepth;
+	int				mCount;
+	vector<T>		mData;			// mCount * mDepth ints, interleaved
+	vector<int>		mSlots;			// Open addressing, linear probe, -1 = empty.  Always a power of 2.
+
+};
+
 /* A shared point pool.  Every point is pooled, and the
  * points are sorted spatially.  The shared point pool
  * is really N sub-point-pools, so each point ends up
@@ -178,8 +221,7 @@ private:
 		DSFTuple					mOffset;
 		DSFTuple					mScale;
 
-		DSFTupleVector				mPoints;			// These are our points
-		hash_map<DSFTuple, int>		mPointsIndex;		// This is used to see if we already have a point.
+		DSFPointTable<uint16_t>		mPoints;			// These are our points, encoded and indexed.
 
 	};
 
@@ -265,8 +307,7 @@ private:
 	DSFTuple					mOffset;
 	DSFTuple					mScale;
 
-	DSFTupleVector				mPoints;			// These are our points
-	hash_map<DSFTuple, int>		mPointsIndex;		// This is used to see if we already have a point.
+	DSFPointTable<uint32_t>		mPoints;			// These are our points, encoded and indexed.
 
 };
 
@@ -550,16 +591,27 @@ inline void DSFTuple::dumphex(void) const
 		printf("%c%.16llx",(n==0) ? ' ' : ',', *(unsigned long long*)&mData[n]);
 }
 
+// Murmur3 finalizer - spreads every input bit over the whole word so that nearby values land in different buckets.
+inline uint32_t	dsf_hash_mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
 inline size_t DSFTuple::hash(void) const
 {
-	uint32_t	ret = 0;
-	uint32_t * p = (uint32_t *) mData;
+	uint32_t	ret = mLen;
+	const uint32_t * p = (const uint32_t *) mData;
 	int words = mLen;
 
 	while (words--)
 	{
-		ret = (ret << 5) ^ (ret >> (27)) ^ *p++;
-		ret = (ret << 7) ^ (ret >> 25) ^ *p++;
+		ret = dsf_hash_mix(ret ^ *p++);
+		ret = dsf_hash_mix(ret ^ *p++);
 	}
 	return ret;
 /*
@@ -578,6 +630,82 @@ inline size_t DSFTuple::hash(void) const
 }
 
 
+#pragma mark -
+
+template <typename T>
+inline void DSFPointTable<T>::quantize(const DSFTuple& encoded, T * outKey) const
+{
+	for (int n = 0; n < mDepth; ++n)
+		outKey[n] = (T) encoded[n];
+}
+
+template <typename T>
+inline size_t DSFPointTable<T>::hash_key(const T * key) const
+{
+	uint32_t h = mDepth;
+	for (int n = 0; n < mDepth; ++n)
+		h = dsf_hash_mix(h ^ (uint32_t) key[n]);
+	return h;
+}
+
+template <typename T>
+inline int DSFPointTable<T>::find(const T * key) const
+{
+	if (mSlots.empty())
+		return -1;
+	size_t mask = mSlots.size() - 1;
+	for (size_t slot = hash_key(key) & mask; ; slot = (slot + 1) & mask)
+	{
+		int idx = mSlots[slot];
+		if (idx == -1)
+			return -1;
+		const T * p = &mData[idx * mDepth];
+		int n = 0;
+		while (n < mDepth && p[n] == key[n])
+			++n;
+		if (n == mDepth)
+			return idx;
+	}
+}
+
+template <typename T>
+inline int DSFPointTable<T>::push_back(const T * key)
+{
+	if ((mCount + 1) * 2 > mSlots.size())
+		rehash(mSlots.empty() ? 64 : mSlots.size() * 2);
+
+	int idx = mCount;
+	bool is_new = find(key) == -1;
+	mData.insert(mData.end(), key, key + mDepth);
+	++mCount;
+
+	if (is_new)
+	{
+		size_t mask = mSlots.size() - 1;
+		size_t slot = hash_key(key) & mask;
+		while (mSlots[slot] != -1)
+			slot = (slot + 1) & mask;
+		mSlots[slot] = idx;
+	}
+	return idx;
+}
+
+template <typename T>
+void DSFPointTable<T>::rehash(size_t slot_count)
+{
+	vector<int>	old_slots(slot_count, -1);
+	mSlots.swap(old_slots);
+	size_t mask = slot_count - 1;
+	for (size_t s = 0; s < old_slots.size(); ++s)
+	if (old_slots[s] != -1)
+	{
+		size_t slot = hash_key(&mData[old_slots[s] * mDepth]) & mask;
+		while (mSlots[slot] != -1)
+			slot = (slot + 1) & mask;
+		mSlots[slot] = old_slots[s];
+	}
+}
+
 #endif
 
 
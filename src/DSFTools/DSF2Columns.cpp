@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "DSF2Columns.h"
+#include "DSFLib.h"
+#include "AssertUtils.h"
+#include <limits>
+
+struct	DSF2Columns_t {
+
+	string						defs[4];			// ter, obj, pol, net - packed null-terminated names
+
+	vector<unsigned int>		obj_type;
+	vector<double>				obj_lon;
+	vector<double>				obj_lat;
+	vector<float>				obj_heading;
+	vector<float>				obj_msl;
+
+	vector<unsigned int>		pol_type;
+	vector<unsigned int>		pol_param;
+	vector<unsigned int>		pol_depth;
+	vector<unsigned int>		pol_first_winding;
+	vector<unsigned int>		win_first_point;
+	vector<double>				pol_lon;
+	vector<double>				pol_lat;
+
+	vector<unsigned int>		net_type;
+	vector<unsigned int>		net_subtype;
+	vector<unsigned int>		net_start_node;
+	vector<unsigned int>		net_end_node;
+	vector<unsigned int>		net_first_point;
+	vector<double>				net_lon;
+	vector<double>				net_lat;
+	vector<double>				net_elev;
+
+	vector<unsigned int>		patch_type;
+	vector<float>				patch_near;
+	vector<float>				patch_far;
+	vector<unsigned int>		patch_flags;
+	vector<unsigned int>		patch_first_tri;
+	vector<double>				tri_lon;
+	vector<double>				tri_lat;
+	vector<double>				tri_elev;
+
+	int							prim_type;
+	vector<double>				prim_pts;			// lon lat elev of the primitive being decoded
+};
+
+// Each def table is just the names back to back, in the order the DSF hands them to us.
+static int DSF2Columns_AddDef(DSF2Columns_t * c, int table, const char * inPartialPath)
+{
+	c->defs[table].append(inPartialPath);
+	c->defs[table].push_back(0);
+	return 1;
+}
+
+static int DSF2Columns_AcceptTerrainDef(const char * inPartialPath, void * inRef) { return DSF2Columns_AddDef((DSF2Columns_t *) inRef, 0, inPartialPath); }
+static int DSF2Columns_AcceptObjectDef (const char * inPartialPath, void * inRef) { return DSF2Columns_AddDef((DSF2Columns_t *) inRef, 1, inPartialPath); }
+static int DSF2Columns_AcceptPolygonDef(const char * inPartialPath, void * inRef) { return DSF2Columns_AddDef((DSF2Columns_t *) inRef, 2, inPartialPath); }
+static int DSF2Columns_AcceptNetworkDef(const char * inPartialPath, void * inRef) { return DSF2Columns_AddDef((DSF2Columns_t *) inRef, 3, inPartialPath); }
+
+static void DSF2Columns_BeginPatch(
+	unsigned int	inTerrainType,
+	double 			inNearLOD,
+	double 			inFarLOD,
+	unsigned char	inFlags,
+	int				inCoordDepth,
+	void *			inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->patch_type.push_back(inTerrainType);
+	c->patch_near.push_back(inNearLOD);
+	c->patch_far.push_back(inFarLOD);
+	c->patch_flags.push_back(inFlags);
+	c->patch_first_tri.push_back(c->tri_lon.size() / 3);
+}
+
+static void DSF2Columns_BeginPrimitive(int inType, void * inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->prim_type = inType;
+	c->prim_pts.clear();
+}
+
+static void DSF2Columns_AddPatchVertex(double inCoordinates[], void * inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->prim_pts.insert(c->prim_pts.end(), inCoordinates, inCoordinates + 3);
+}
+
+static void DSF2Columns_AddPatchVertices(double inCoordinates[], int inCoordDepth, int inVertexCount, void * inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->prim_pts.reserve(c->prim_pts.size() + inVertexCount * 3);
+	for (int n = 0; n < inVertexCount; ++n, inCoordinates += inCoordDepth)
+		c->prim_pts.insert(c->prim_pts.end(), inCoordinates, inCoordinates + 3);
+}
+
+static void DSF2Columns_AddTriVertex(DSF2Columns_t * c, int v)
+{
+	const double * p = &c->prim_pts[v * 3];
+	c->tri_lon.push_back(p[0]);
+	c->tri_lat.push_back(p[1]);
+	c->tri_elev.push_back(p[2]);
+}
+
+// Strips and fans are flattened to independent triangles, keeping the winding OpenGL would give them.
+static void DSF2Columns_EndPrimitive(void * inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	int n = c->prim_pts.size() / 3;
+	switch(c->prim_type) {
+	case dsf_Tri:
+		for (int v = 0; v + 2 < n; v += 3)
+		{
+			DSF2Columns_AddTriVertex(c, v  );
+			DSF2Columns_AddTriVertex(c, v+1);
+			DSF2Columns_AddTriVertex(c, v+2);
+		}
+		break;
+	case dsf_TriStrip:
+		for (int v = 2; v < n; ++v)
+		{
+			DSF2Columns_AddTriVertex(c, (v % 2) ? v-1 : v-2);
+			DSF2Columns_AddTriVertex(c, (v % 2) ? v-2 : v-1);
+			DSF2Columns_AddTriVertex(c, v);
+		}
+		break;
+	case dsf_TriFan:
+		for (int v = 2; v < n; ++v)
+		{
+			DSF2Columns_AddTriVertex(c, 0  );
+			DSF2Columns_AddTriVertex(c, v-1);
+			DSF2Columns_AddTriVertex(c, v  );
+		}
+		break;
+	}
+	c->prim_pts.clear();
+}
+
+static void DSF2Columns_EndPatch(void * inRef)
+{
+}
+
+static void DSF2Columns_AddObject(
+	unsigned int	inObjectType,
+	double			inCoordinates[4],
+	int				inCoordCount,
+	void *			inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->obj_type.push_back(inObjectType);
+	c->obj_lon.push_back(inCoordinates[0]);
+	c->obj_lat.push_back(inCoordinates[1]);
+	c->obj_heading.push_back(inCoordinates[2]);
+	c->obj_msl.push_back(inCoordCount > 3 ? (float) inCoordinates[3] : numeric_limits<float>::quiet_NaN());
+}
+
+static void DSF2Columns_AddNetPoint(DSF2Columns_t * c, const double * inCoordinates)
+{
+	c->net_lon.push_back(inCoordinates[0]);
+	c->net_lat.push_back(inCoordinates[1]);
+	c->net_elev.push_back(inCoordinates[2]);
+}
+
+static void DSF2Columns_BeginSegment(
+	unsigned int	inNetworkType,
+	unsigned int	inNetworkSubtype,
+	double			inCoordinates[],
+	bool			inCurved,
+	void *			inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->net_type.push_back(inNetworkType);
+	c->net_subtype.push_back(inNetworkSubtype);
+	c->net_start_node.push_back(inCoordinates[3]);
+	c->net_first_point.push_back(c->net_lon.size());
+	DSF2Columns_AddNetPoint(c, inCoordinates);
+}
+
+static void DSF2Columns_AddSegmentShapePoint(double inCoordinates[], bool inCurved, void * inRef)
+{
+	DSF2Columns_AddNetPoint((DSF2Columns_t *) inRef, inCoordinates);
+}
+
+static void DSF2Columns_EndSegment(double inCoordinates[], bool inCurved, void * inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->net_end_node.push_back(inCoordinates[3]);
+	DSF2Columns_AddNetPoint(c, inCoordinates);
+}
+
+static void DSF2Columns_BeginPolygon(
+	unsigned int	inPolygonType,
+	unsigned short	inParam,
+	int				inCoordDepth,
+	void *			inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->pol_type.push_back(inPolygonType);
+	c->pol_param.push_back(inParam);
+	c->pol_depth.push_back(inCoordDepth);
+	c->pol_first_winding.push_back(c->win_first_point.size());
+}
+
+static void DSF2Columns_BeginPolygonWinding(void * inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->win_first_point.push_back(c->pol_lon.size());
+}
+
+static void DSF2Columns_AddPolygonPoint(double * inCoordinates, void * inRef)
+{
+	DSF2Columns_t * c = (DSF2Columns_t *) inRef;
+	c->pol_lon.push_back(inCoordinates[0]);
+	c->pol_lat.push_back(inCoordinates[1]);
+}
+
+static void DSF2Columns_EndPolygonWinding(void * inRef)
+{
+}
+
+static void DSF2Columns_EndPolygon(void * inRef)
+{
+}
+
+// Properties, rasters and filters have no columns, but the reader calls every callback.
+static bool DSF2Columns_NextPass(int finished_pass_index, void * inRef) { return true; }
+static int  DSF2Columns_AcceptRasterDef(const char * inPartialPath, void * inRef) { return 1; }
+static void DSF2Columns_AcceptProperty(const char * inProp, const char * inValue, void * inRef) { }
+static void DSF2Columns_AddRasterData(DSFRasterHeader_t * header, void * data, void * inRef) { }
+static void DSF2Columns_SetFilter(int inFilterIndex, void * inRef) { }
+
+/************************************************************************************************
+ * FILE OUTPUT
+ ************************************************************************************************/
+
+struct	DSF2Columns_Section {
+	const char *	name;
+	const void *	data;
+	unsigned int	elem_size;
+	size_t			count;
+};
+
+template <class T>
+static void DSF2Columns_Add(vector<DSF2Columns_Section>& io_sections, const char * name, const vector<T>& col)
+{
+	DSF2Columns_Section s = { name, col.empty() ? NULL : &*col.begin(), sizeof(T), col.size() };
+	io_sections.push_back(s);
+}
+
+static void DSF2Columns_Add(vector<DSF2Columns_Section>& io_sections, const char * name, const string& blob)
+{
+	DSF2Columns_Section s = { name, blob.data(), 1, blob.size() };
+	io_sections.push_back(s);
+}
+
+// The "first" columns get a closing entry so every range is [first[i], first[i+1]).
+static void DSF2Columns_CloseRanges(DSF2Columns_t& c)
+{
+	c.pol_first_winding.push_back(c.win_first_point.size());
+	c.win_first_point.push_back(c.pol_lon.size());
+	c.net_first_point.push_back(c.net_lon.size());
+	c.patch_first_tri.push_back(c.tri_lon.size() / 3);
+}
+
+static bool DSF2Columns_Write(const vector<DSF2Columns_Section>& sections, FILE * fi)
+{
+	DSFColumnsHeader_t	header;
+	memcpy(header.magic, "DSFC", 4);
+	header.version = DSF_COLUMNS_VERSION;
+	header.section_count = sections.size();
+	header.endian = 0x01020304;
+
+	vector<DSFColumnsSection_t>	dir(sections.size());
+	unsigned long long offset = sizeof(header) + sizeof(DSFColumnsSection_t) * sections.size();
+	for (int n = 0; n < sections.size(); ++n)
+	{
+		offset = (offset + 7) & ~7ULL;
+		memset(&dir[n], 0, sizeof(dir[n]));
+		strncpy(dir[n].name, sections[n].name, sizeof(dir[n].name) - 1);
+		dir[n].elem_size = sections[n].elem_size;
+		dir[n].count = sections[n].count;
+		dir[n].offset = offset;
+		offset += (unsigned long long) sections[n].elem_size * sections[n].count;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, fi) != 1) return false;
+	if (!dir.empty() && fwrite(&*dir.begin(), sizeof(DSFColumnsSection_t), dir.size(), fi) != dir.size()) return false;
+
+	static const char	pad[8] = { 0 };
+	unsigned long long	pos = sizeof(header) + sizeof(DSFColumnsSection_t) * sections.size();
+	for (int n = 0; n < sections.size(); ++n)
+	{
+		size_t	gap = dir[n].offset - pos;
+		if (gap && fwrite(pad, 1, gap, fi) != gap) return false;
+		if (sections[n].count && fwrite(sections[n].data, sections[n].elem_size, sections[n].count, fi) != sections[n].count) return false;
+		pos = dir[n].offset + (unsigned long long) sections[n].elem_size * sections[n].count;
+	}
+	return true;
+}
+
+bool	DSF2Columns(const char * inDSF, const char * inFileName)
+{
+	DSFCallbacks_t	cbs;
+	memset(&cbs, 0, sizeof(cbs));
+	cbs.AcceptTerrainDef_f		= DSF2Columns_AcceptTerrainDef;
+	cbs.AcceptObjectDef_f		= DSF2Columns_AcceptObjectDef;
+	cbs.AcceptPolygonDef_f		= DSF2Columns_AcceptPolygonDef;
+	cbs.AcceptNetworkDef_f		= DSF2Columns_AcceptNetworkDef;
+	cbs.BeginPatch_f			= DSF2Columns_BeginPatch;
+	cbs.BeginPrimitive_f		= DSF2Columns_BeginPrimitive;
+	cbs.AddPatchVertex_f		= DSF2Columns_AddPatchVertex;
+	cbs.AddPatchVertices_f		= DSF2Columns_AddPatchVertices;
+	cbs.EndPrimitive_f			= DSF2Columns_EndPrimitive;
+	cbs.EndPatch_f				= DSF2Columns_EndPatch;
+	cbs.AddObject_f				= DSF2Columns_AddObject;
+	cbs.BeginSegment_f			= DSF2Columns_BeginSegment;
+	cbs.AddSegmentShapePoint_f	= DSF2Columns_AddSegmentShapePoint;
+	cbs.EndSegment_f			= DSF2Columns_EndSegment;
+	cbs.BeginPolygon_f			= DSF2Columns_BeginPolygon;
+	cbs.BeginPolygonWinding_f	= DSF2Columns_BeginPolygonWinding;
+	cbs.AddPolygonPoint_f		= DSF2Columns_AddPolygonPoint;
+	cbs.EndPolygonWinding_f		= DSF2Columns_EndPolygonWinding;
+	cbs.EndPolygon_f			= DSF2Columns_EndPolygon;
+
+	cbs.NextPass_f				= DSF2Columns_NextPass;
+	cbs.AcceptRasterDef_f		= DSF2Columns_AcceptRasterDef;
+	cbs.AcceptProperty_f		= DSF2Columns_AcceptProperty;
+	cbs.AddRasterData_f			= DSF2Columns_AddRasterData;
+	cbs.SetFilter_f				= DSF2Columns_SetFilter;
+
+	DSF2Columns_t	c;
+	c.prim_type = dsf_Tri;
+	int result = DSFReadFileMapped(inDSF, &cbs, NULL, &c);
+	if (result != dsf_ErrOK)
+	{
+		fprintf(stderr, "Could not read %s: %s\n", inDSF, dsfErrorMessages[result]);
+		return false;
+	}
+
+	DSF2Columns_CloseRanges(c);
+
+	vector<DSF2Columns_Section>	sections;
+	DSF2Columns_Add(sections, "ter_defs",			c.defs[0]);
+	DSF2Columns_Add(sections, "obj_defs",			c.defs[1]);
+	DSF2Columns_Add(sections, "pol_defs",			c.defs[2]);
+	DSF2Columns_Add(sections, "net_defs",			c.defs[3]);
+	DSF2Columns_Add(sections, "obj_type",			c.obj_type);
+	DSF2Columns_Add(sections, "obj_lon",			c.obj_lon);
+	DSF2Columns_Add(sections, "obj_lat",			c.obj_lat);
+	DSF2Columns_Add(sections, "obj_heading",		c.obj_heading);
+	DSF2Columns_Add(sections, "obj_msl",			c.obj_msl);
+	DSF2Columns_Add(sections, "pol_type",			c.pol_type);
+	DSF2Columns_Add(sections, "pol_param",			c.pol_param);
+	DSF2Columns_Add(sections, "pol_depth",			c.pol_depth);
+	DSF2Columns_Add(sections, "pol_first_winding",	c.pol_first_winding);
+	DSF2Columns_Add(sections, "win_first_point",	c.win_first_point);
+	DSF2Columns_Add(sections, "pol_lon",			c.pol_lon);
+	DSF2Columns_Add(sections, "pol_lat",			c.pol_lat);
+	DSF2Columns_Add(sections, "net_type",			c.net_type);
+	DSF2Columns_Add(sections, "net_subtype",		c.net_subtype);
+	DSF2Columns_Add(sections, "net_start_node",		c.net_start_node);
+	DSF2Columns_Add(sections, "net_end_node",		c.net_end_node);
+	DSF2Columns_Add(sections, "net_first_point",	c.net_first_point);
+	DSF2Columns_Add(sections, "net_lon",			c.net_lon);
+	DSF2Columns_Add(sections, "net_lat",			c.net_lat);
+	DSF2Columns_Add(sections, "net_elev",			c.net_elev);
+	DSF2Columns_Add(sections, "patch_type",			c.patch_type);
+	DSF2Columns_Add(sections, "patch_near",			c.patch_near);
+	DSF2Columns_Add(sections, "patch_far",			c.patch_far);
+	DSF2Columns_Add(sections, "patch_flags",		c.patch_flags);
+	DSF2Columns_Add(sections, "patch_first_tri",	c.patch_first_tri);
+	DSF2Columns_Add(sections, "tri_lon",			c.tri_lon);
+	DSF2Columns_Add(sections, "tri_lat",			c.tri_lat);
+	DSF2Columns_Add(sections, "tri_elev",			c.tri_elev);
+
+	FILE * fi = fopen(inFileName, "wb");
+	if (fi == NULL)
+		return false;
+	bool ok = DSF2Columns_Write(sections, fi);
+	if (fclose(fi) != 0)
+		ok = false;
+	if (!ok)
+		fprintf(stderr, "Could not write %s\n", inFileName);
+	return ok;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef DSF2Columns_H
+#define DSF2Columns_H
+
+/*
+	DSF COLUMN EXPORT
+
+	DSF2Columns decodes a DSF and writes its contents as a set of flat, typed arrays ("columns")
+	in one binary file, so analysis tools can mmap it and walk objects, polygons, networks and
+	mesh triangles directly instead of re-parsing DSF2Text output.
+
+	Layout (native byte order - the header records which):
+
+		DSFColumnsHeader_t			magic "DSFC", version, section count, endian tag
+		DSFColumnsSection_t[n]		name, element size, element count, file offset
+		column data					each section starts on an 8-byte boundary
+
+	Definition tables (ter_defs, obj_defs, pol_defs, net_defs) are stored once per file as
+	packed null-terminated strings, in DSF index order.  Indexed ranges use "first" columns
+	with count + 1 entries, so element i spans [first[i], first[i+1]).  The sections are:
+
+		obj_type u32, obj_lon f64, obj_lat f64, obj_heading f32, obj_msl f32 (NaN if none)
+		pol_type u32, pol_param u32, pol_depth u32, pol_first_winding u32,
+			win_first_point u32, pol_lon f64, pol_lat f64
+		net_type u32, net_subtype u32, net_start_node u32, net_end_node u32, net_first_point u32,
+			net_lon f64, net_lat f64, net_elev f64
+		patch_type u32, patch_near f32, patch_far f32, patch_flags u32, patch_first_tri u32,
+			tri_lon f64, tri_lat f64, tri_elev f64 (three entries per triangle)
+
+	Strips and fans are expanded to plain triangles.  Only the location of each polygon and
+	network point is kept - UV/bezier control coordinates are dropped.
+
+	Returns false if the DSF can't be read or the output can't be written.
+*/
+
+#define DSF_COLUMNS_VERSION 1
+
+struct	DSFColumnsHeader_t {
+	char			magic[4];			// "DSFC"
+	unsigned int	version;			// DSF_COLUMNS_VERSION
+	unsigned int	section_count;
+	unsigned int	endian;				// 0x01020304 as written by the exporter
+};
+
+struct	DSFColumnsSection_t {
+	char				name[24];		// null-terminated column name
+	unsigned int		elem_size;		// bytes per element
+	unsigned int		reserved;
+	unsigned long long	count;			// number of elements
+	unsigned long long	offset;			// from the start of the file
+};
+
+bool	DSF2Columns(const char * inDSF, const char * inFileName);
+
+#endif /* DSF2Columns_H */
@@ -21,67 +21,120 @@
  *
  */
 #include <stdio.h>
+#include <stdarg.h>
 #include "DSF2Text.h"
 #include "DSFLib.h"
 #include <list>
 
 using std::list;
 
-static int sDSF2TEXT_CoordDepth;
+// Everything the printing callbacks remember between calls.  DSF2Text gives each conversion its own
+// copy (inside a DSF2Text_File) so that several files can be converted at once on different threads;
+// callers that pass a plain print_funcs_s, like WED's overlay export, share sLegacyState.
+struct	DSF2Text_State {
+	int				coord_depth;
+	int				offset_ter, offset_obj, offset_pol, offset_net;
+	int				count_ter, count_obj, count_pol, count_net;
+	string			base_name;
+	list<string>	dem_names;
+
+	DSF2Text_State() : coord_depth(0),
+		offset_ter(0), offset_obj(0), offset_pol(0), offset_net(0),
+		count_ter(0), count_obj(0), count_pol(0), count_net(0) { }
+};
+
+static DSF2Text_State	sLegacyState;
+
+#define	DSF2TEXT_BUF_SIZE	(1024 * 1024)
+
+// One text output.  Lines are formatted straight into a big buffer that goes to disk in
+// DSF2TEXT_BUF_SIZE blocks, rather than making a locked stdio call for every number.
+struct	DSF2Text_File {
+	print_funcs_s	pf;			// pf.print_func is DSF2Text_BufferedPrint, pf.ref is this.
+	DSF2Text_State	state;
+	FILE *			fi;
+	char *			buf;
+	int				used;
+};
+
+static void	DSF2Text_Flush(DSF2Text_File * f)
+{
+	if (f->used)
+		fwrite(f->buf, 1, f->used, f->fi);
+	f->used = 0;
+}
 
-static int offset_ter = 0;
-static int offset_obj = 0;
-static int offset_pol = 0;
-static int offset_net = 0;
+static int	DSF2Text_BufferedPrint(void * ref, const char * fmt, ...)
+{
+	DSF2Text_File * f = (DSF2Text_File *) ref;
+	va_list	args;
+	int		n;
 
-static int count_ter = 0;
-static int count_obj = 0;
-static int count_pol = 0;
-static int count_net = 0;
+	for (int tries = 0; tries < 2; ++tries)
+	{
+		int room = DSF2TEXT_BUF_SIZE - f->used;
+		va_start(args, fmt);
+		n = vsnprintf(f->buf + f->used, room, fmt, args);
+		va_end(args);
+		if (n >= 0 && n < room)
+		{
+			f->used += n;
+			return n;
+		}
+		DSF2Text_Flush(f);
+	}
 
-string			base_name;
-list<string>	dem_names;
+	// Bigger than the whole buffer - hand it to stdio.
+	va_start(args, fmt);
+	n = vfprintf(f->fi, fmt, args);
+	va_end(args);
+	return n;
+}
 
+static DSF2Text_State *	DSF2Text_GetState(print_funcs_s * p)
+{
+	return p->print_func == DSF2Text_BufferedPrint ? &((DSF2Text_File *) p->ref)->state : &sLegacyState;
+}
 
 
 int DSF2Text_AcceptTerrainDef(const char * inPartialPath, void * inRef)
 {
-	++count_ter;
 	print_funcs_s * p = (print_funcs_s *) inRef;
+	++DSF2Text_GetState(p)->count_ter;
 	p->print_func(p->ref, "TERRAIN_DEF %s\n", inPartialPath);
 	return 1;
 }
 
 int DSF2Text_AcceptObjectDef(const char * inPartialPath, void * inRef)
 {
-	++count_obj;
 	print_funcs_s * p = (print_funcs_s *) inRef;
+	++DSF2Text_GetState(p)->count_obj;
 	p->print_func(p->ref, "OBJECT_DEF %s\n", inPartialPath);
 	return 1;
 }
 
 int DSF2Text_AcceptPolygonDef(const char * inPartialPath, void * inRef)
 {
-	++count_pol;
 	print_funcs_s * p = (print_funcs_s *) inRef;
+	++DSF2Text_GetState(p)->count_pol;
 	p->print_func(p->ref, "POLYGON_DEF %s\n", inPartialPath);
 	return 1;
 }
 
 int DSF2Text_AcceptNetworkDef(const char * inPartialPath, void * inRef)
 {
-	++count_net;
 	print_funcs_s * p = (print_funcs_s *) inRef;
+	++DSF2Text_GetState(p)->count_net;
 	p->print_func(p->ref, "NETWORK_DEF %s\n", inPartialPath);
 	return 1;
 }
 
 int DSF2Text_AcceptRasterDef(const char * inPartialPath, void * inRef)
 {
-	++count_net;
 	print_funcs_s * p = (print_funcs_s *) inRef;
+	++DSF2Text_GetState(p)->count_net;
 	p->print_func(p->ref, "RASTER_DEF %s\n", inPartialPath);
-	dem_names.push_back(inPartialPath);
+	DSF2Text_GetState(p)->dem_names.push_back(inPartialPath);
 	return 1;
 }
 
@@ -100,8 +153,9 @@ void DSF2Text_BeginPatch(
 	void *			inRef)
 {
 	print_funcs_s * p = (print_funcs_s *) inRef;
-	sDSF2TEXT_CoordDepth = inCoordDepth;
-	p->print_func(p->ref, "BEGIN_PATCH %d %lf %lf %d %d\n", inTerrainType + offset_ter, inNearLOD, inFarLOD, inFlags, inCoordDepth);
+	DSF2Text_State * s = DSF2Text_GetState(p);
+	s->coord_depth = inCoordDepth;
+	p->print_func(p->ref, "BEGIN_PATCH %d %lf %lf %d %d\n", inTerrainType + s->offset_ter, inNearLOD, inFarLOD, inFlags, inCoordDepth);
 }
 
 void DSF2Text_BeginPrimitive(
@@ -118,7 +172,7 @@ void DSF2Text_AddPatchVertex(
 {
 	print_funcs_s * p = (print_funcs_s *) inRef;
 	p->print_func(p->ref, "PATCH_VERTEX");
-	for (int n = 0; n < sDSF2TEXT_CoordDepth; ++n)
+	for (int n = 0, d = DSF2Text_GetState(p)->coord_depth; n < d; ++n)
 		p->print_func(p->ref, " %.9lf", inCoordinates[n]);
 	p->print_func(p->ref, "\n");
 }
@@ -143,13 +197,14 @@ void DSF2Text_AddObject(
 	int				inCoordinateDepth,
 	void *			inRef)
 {
-	if(inObjectType >= count_obj)
-		printf("WARNING: out of bounds obj.\n");
 	print_funcs_s * p = (print_funcs_s *) inRef;
+	DSF2Text_State * s = DSF2Text_GetState(p);
+	if(inObjectType >= s->count_obj)
+		printf("WARNING: out of bounds obj.\n");
 	if(inCoordinateDepth == 4)
-	p->print_func(p->ref, "OBJECT_MSL %d %.9lf %.9lf %.9lf %lf\n", inObjectType + offset_obj, inCoordinates[0], inCoordinates[1], inCoordinates[3], inCoordinates[2]);
+	p->print_func(p->ref, "OBJECT_MSL %d %.9lf %.9lf %.9lf %lf\n", inObjectType + s->offset_obj, inCoordinates[0], inCoordinates[1], inCoordinates[3], inCoordinates[2]);
 	else
-	p->print_func(p->ref, "OBJECT %d %.9lf %.9lf %lf\n", inObjectType + offset_obj, inCoordinates[0], inCoordinates[1], inCoordinates[2]);
+	p->print_func(p->ref, "OBJECT %d %.9lf %.9lf %lf\n", inObjectType + s->offset_obj, inCoordinates[0], inCoordinates[1], inCoordinates[2]);
 }
 
 void DSF2Text_BeginSegment(
@@ -161,7 +216,7 @@ void DSF2Text_BeginSegment(
 {
 	print_funcs_s * p = (print_funcs_s *) inRef;
 	if (!inCurved)
-		p->print_func(p->ref, "BEGIN_SEGMENT %d %d %d %.9lf %.9lf %.9lf\n", inNetworkType + offset_net, inNetworkSubtype, (int) inCoordinates[3],
+		p->print_func(p->ref, "BEGIN_SEGMENT %d %d %d %.9lf %.9lf %.9lf\n", inNetworkType + DSF2Text_GetState(p)->offset_net, inNetworkSubtype, (int) inCoordinates[3],
 															inCoordinates[0],inCoordinates[1],inCoordinates[2]);
 	else
 		p->print_func(p->ref, "BEGIN_SEGMENT_CURVED %d %d %d %.9lf %.9lf %.9lf %.9lf %.9lf %.9lf\n", inNetworkType, inNetworkSubtype, (int) inCoordinates[3],
@@ -212,9 +267,10 @@ void DSF2Text_BeginPolygon(
 	int				inDepth,
 	void *			inRef)
 {
-	sDSF2TEXT_CoordDepth = inDepth;
 	print_funcs_s * p = (print_funcs_s *) inRef;
-	p->print_func(p->ref, "BEGIN_POLYGON %d %d %d\n", inPolygonType + offset_pol, inParam, inDepth);
+	DSF2Text_State * s = DSF2Text_GetState(p);
+	s->coord_depth = inDepth;
+	p->print_func(p->ref, "BEGIN_POLYGON %d %d %d\n", inPolygonType + s->offset_pol, inParam, inDepth);
 }
 
 void DSF2Text_BeginPolygonWinding(
@@ -229,7 +285,7 @@ void DSF2Text_AddPolygonPoint(
 {
 	print_funcs_s * p = (print_funcs_s *) inRef;
 	p->print_func(p->ref, "POLYGON_POINT");
-	for (int n = 0; n < sDSF2TEXT_CoordDepth; ++n)
+	for (int n = 0, d = DSF2Text_GetState(p)->coord_depth; n < d; ++n)
 		p->print_func(p->ref, " %.9lf", inCoordinates[n]);
 	p->print_func(p->ref, "\n");
 }
@@ -247,16 +303,17 @@ void DSF2Text_AddRaterData(
 					void *				inRef)
 {
 	print_funcs_s * p = (print_funcs_s *) inRef;
+	DSF2Text_State * s = DSF2Text_GetState(p);
 	p->print_func(p->ref,"RASTER_DATA version=%d bpp=%d flags=%d width=%d height=%d scale=%f offset=%f ",
 		header->version, header->bytes_per_pixel, header->flags, header->width, header->height, header->scale,header->offset);
 
-	if(!base_name.empty() && !dem_names.empty())
+	if(!s->base_name.empty() && !s->dem_names.empty())
 	{
-		string demp(base_name);
+		string demp(s->base_name);
 		demp += ".";
-		demp += dem_names.front();
+		demp += s->dem_names.front();
 		demp += ".raw";
-		dem_names.pop_front();
+		s->dem_names.pop_front();
 		FILE * fb = fopen(demp.c_str(),"wb");
 		if(fb)
 		{
@@ -303,6 +360,7 @@ void DSF2Text_CreateWriterCallbacks(DSFCallbacks_t * cbs)
 	cbs->AddRasterData_f			=DSF2Text_AddRaterData				;
 	cbs->NextPass_f					=DSF2Text_NextPass					;
 	cbs->SetFilter_f				=DSF2Text_SetFilter					;
+	cbs->AddPatchVertices_f			=NULL								;
 }
 
 
@@ -313,45 +371,58 @@ bool DSF2Text(char ** inDSF, int n, const char * inFileName)
 	FILE * fi = strcmp(inFileName, "-") ? fopen(inFileName, "w") : stdout;
 	if (fi == NULL) return false;
 
-	base_name = strcmp(inFileName, "-") ? inFileName : "";
-	dem_names.clear();
+	DSF2Text_File * f = new DSF2Text_File;
+	f->pf.print_func = DSF2Text_BufferedPrint;
+	f->pf.ref = f;
+	f->fi = fi;
+	f->buf = (char *) malloc(DSF2TEXT_BUF_SIZE);
+	f->used = 0;
+	if (f->buf == NULL)
+	{
+		delete f;
+		if (fi != stdout) fclose(fi);
+		return false;
+	}
+
+	DSF2Text_State& s(f->state);
+	s.base_name = strcmp(inFileName, "-") ? inFileName : "";
 	
 	#if APL
-	fprintf(fi, "A\n800\nDSF2TEXT\n\n");
+	DSF2Text_BufferedPrint(f, "A\n800\nDSF2TEXT\n\n");
 	#elif IBM
-	fprintf(fi, "I\n800\nDSF2TEXT\n\n");
+	DSF2Text_BufferedPrint(f, "I\n800\nDSF2TEXT\n\n");
 	#endif
 
 	DSFCallbacks_t	cbs;
 	DSF2Text_CreateWriterCallbacks(&cbs);
-	
-	print_funcs_s pf;
-	pf.print_func = (int (*)(void *,const char *,...)) fprintf;
-	pf.ref = fi;
 
 	while(n--)
 	{
-		fprintf(fi,"# file: %s\n\n",*inDSF);
-		int result = DSFReadFile(*inDSF, malloc, free, &cbs, NULL, &pf);
+		DSF2Text_BufferedPrint(f,"# file: %s\n\n",*inDSF);
+		int result = DSFReadFileMapped(*inDSF, &cbs, NULL, &f->pf);
 
-		fprintf(fi, "# Result code: %d\n", result);
+		DSF2Text_BufferedPrint(f, "# Result code: %d\n", result);
 		if(result == dsf_ErrNoAtoms || result == dsf_ErrBadCookie || result == dsf_ErrBadVersion)
 			fprintf(stderr,"The DFS was not readable.  Perhaps you need to unzip it with 7-zip?\n");
 
 		printf("File %s had %d ter, %d obj, %d pol, %d net.\n", *inDSF,
-			count_ter, count_obj,count_pol,count_net);
+			s.count_ter, s.count_obj,s.count_pol,s.count_net);
 
 		++inDSF;
 		
-		offset_ter += count_ter;
-		offset_obj += count_obj;
-		offset_pol += count_pol;
-		offset_net += count_net;
+		s.offset_ter += s.count_ter;
+		s.offset_obj += s.count_obj;
+		s.offset_pol += s.count_pol;
+		s.offset_net += s.count_net;
 		
-		count_ter = count_obj = count_pol = count_net = 0;
+		s.count_ter = s.count_obj = s.count_pol = s.count_net = 0;
 	}
 
-	if (strcmp(inFileName, "-"))
+	DSF2Text_Flush(f);
+	free(f->buf);
+	delete f;
+
+	if (fi != stdout)
 		fclose(fi);
 	return true;
 }
@@ -380,6 +451,8 @@ static bool Text2DSFWithWriterAny(const char * inFileName, const char * inDSF, D
 	bool is_pipe = strcmp(inFileName, "-") == 0;
 	FILE * fi = (!is_pipe) ? fopen(inFileName, "r") : stdin;
 	if (!fi) return NULL;
+	if (!is_pipe)
+		setvbuf(fi, NULL, _IOFBF, DSF2TEXT_BUF_SIZE);
 
 	int divisions = 8;
 	float west = 999.0, south = 999.0, north = 999.0, east = 999.0;
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+	DSFBench - repeatable timings for the DSF hot paths.
+
+	DSFBench builds a synthetic tile of configurable density (patch vertices, objects, polygons,
+	networks and rasters) and times:
+
+		generate		feeding the tile into a fresh writer through its callbacks
+		write			DSFWriteToFile - pool building, command encoding and signing
+		read_<pass>		DSFReadMem over the file in memory, one pass flag at a time, with
+						callbacks that only count what they are handed
+		read_mapped		DSFReadFileMapped with all passes, including the file mapping
+		dsf2text		DSF2Text of the written file
+		text2dsf		Text2DSF of that text back into a DSF
+
+	Every benchmark runs --iterations times and the results are written as CSV, one row per
+	benchmark, preceded by a # line recording the configuration.  DSFLib and DSF2Text print their
+	own diagnostics on stdout, so use --out to get a clean results file.  The random generator is
+	our own so a given --seed makes the same tile on every platform.
+
+*/
+
+#include "DSFLib.h"
+#include "DSFDefs.h"
+#include "DSF2Text.h"
+#include "AssertUtils.h"
+#include "FileUtils.h"
+#include "PlatformUtils.h"
+#include "PerfUtils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define	BENCH_WEST			-118
+#define	BENCH_SOUTH			34
+#define	BENCH_TERRAINS		8
+#define	BENCH_OBJECTS		16
+#define	BENCH_FACADES		8
+#define	BENCH_NODE_GRID		32
+
+static void AssertShellBail(const char * condition, const char * file, int line)
+{
+	fprintf(stderr,"ERROR: %s\n", condition);
+	fprintf(stderr,"(%s, %d.)\n", file, line);
+	exit(1);
+}
+
+struct	BenchConfig_t {
+	int			patches;
+	int			patch_grid;		// Each patch is patch_grid x patch_grid quads.
+	int			objects;
+	int			polygons;
+	int			networks;
+	int			rasters;
+	int			raster_size;
+	int			iterations;
+	int			threads;
+	unsigned	seed;
+	string		dir;
+	const char *out;
+	bool		keep;
+};
+
+// xorshift32 - rand() differs between C libraries and we want the same tile everywhere.
+struct	BenchRand {
+	unsigned	s;
+	BenchRand(unsigned seed) : s(seed ? seed : 1) { }
+	unsigned	next(void) { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+	double		unit(void) { return (double) (next() >> 8) / 16777216.0; }
+	int			range(int n) { return next() % n; }
+};
+
+struct	BenchResult_t {
+	string		name;
+	int			iterations;
+	double		bytes;
+	double		min_ms;
+	double		max_ms;
+	double		total_ms;
+
+	BenchResult_t(const char * n, double b) : name(n), iterations(0), bytes(b), min_ms(0), max_ms(0), total_ms(0) { }
+	void add(double ms)
+	{
+		min_ms = iterations ? min(min_ms, ms) : ms;
+		max_ms = iterations ? max(max_ms, ms) : ms;
+		total_ms += ms;
+		++iterations;
+	}
+};
+
+struct	StBenchTimer {
+	BenchResult_t&		r_;
+	unsigned long long	start_;
+	StBenchTimer(BenchResult_t& r) : r_(r), start_(query_hpc()) { }
+	~StBenchTimer() { r_.add(hpc_to_microseconds(query_hpc() - start_) / 1000.0); }
+};
+
+static double	file_size(const string& path)
+{
+	FILE * fi = fopen(path.c_str(), "rb");
+	if (fi == NULL) return 0.0;
+	fseek(fi, 0L, SEEK_END);
+	double s = ftell(fi);
+	fclose(fi);
+	return s;
+}
+
+/************************************************************************************************************
+ * SYNTHETIC TILE
+ ************************************************************************************************************/
+
+static double	bench_elev(double lon, double lat)
+{
+	return 500.0 + 300.0 * sin(lon * 40.0) * cos(lat * 40.0);
+}
+
+static void		bench_node(int id, double c[4])
+{
+	int i = (id - 1) % BENCH_NODE_GRID;
+	int j = (id - 1) / BENCH_NODE_GRID;
+	c[0] = BENCH_WEST  + (i + 0.5) / BENCH_NODE_GRID;
+	c[1] = BENCH_SOUTH + (j + 0.5) / BENCH_NODE_GRID;
+	c[2] = 0.0;
+	c[3] = id;
+}
+
+static void		GenerateTile(const BenchConfig_t& c, const vector<short *>& rasters, DSFCallbacks_t& cbs, void * w)
+{
+	BenchRand	r(c.seed);
+	char		buf[256];
+	int			n, i, j, k;
+
+	sprintf(buf, "%d", BENCH_WEST);			cbs.AcceptProperty_f("sim/west", buf, w);
+	sprintf(buf, "%d", BENCH_WEST + 1);		cbs.AcceptProperty_f("sim/east", buf, w);
+	sprintf(buf, "%d", BENCH_SOUTH);		cbs.AcceptProperty_f("sim/south", buf, w);
+	sprintf(buf, "%d", BENCH_SOUTH + 1);	cbs.AcceptProperty_f("sim/north", buf, w);
+	cbs.AcceptProperty_f("sim/planet", "earth", w);
+	cbs.AcceptProperty_f("sim/creation_agent", "DSFBench", w);
+
+	for (n = 0; n < BENCH_TERRAINS; ++n)	{ sprintf(buf, "terrain/bench%d.ter", n);	cbs.AcceptTerrainDef_f(buf, w); }
+	for (n = 0; n < BENCH_OBJECTS; ++n)		{ sprintf(buf, "objects/bench%d.obj", n);	cbs.AcceptObjectDef_f(buf, w); }
+	for (n = 0; n < BENCH_FACADES; ++n)		{ sprintf(buf, "facades/bench%d.fac", n);	cbs.AcceptPolygonDef_f(buf, w); }
+	cbs.AcceptNetworkDef_f("lib/g8/roads.net", w);
+	for (n = 0; n < c.rasters; ++n)			{ sprintf(buf, "raster%d", n);				cbs.AcceptRasterDef_f(buf, w); }
+
+	// Patches tile the DSF in a square grid; each is a grid of quads, one triangle primitive per row.
+	int side = 1;
+	while (side * side < c.patches) ++side;
+	for (k = 0; k < c.patches; ++k)
+	{
+		double	x0 = BENCH_WEST  + (double) (k % side) / side;
+		double	y0 = BENCH_SOUTH + (double) (k / side) / side;
+		double	d  = 1.0 / (side * c.patch_grid);
+		cbs.BeginPatch_f(k % BENCH_TERRAINS, 0.0, -1.0, dsf_Flag_Physical, 5, w);
+		for (i = 0; i < c.patch_grid; ++i)
+		{
+			cbs.BeginPrimitive_f(dsf_Tri, w);
+			for (j = 0; j < c.patch_grid; ++j)
+			{
+				static const int	quad[6][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+				for (n = 0; n < 6; ++n)
+				{
+					double v[5] = { x0 + (i + quad[n][0]) * d, y0 + (j + quad[n][1]) * d, 0.0, 0.0, 0.0 };
+					v[2] = bench_elev(v[0], v[1]);
+					cbs.AddPatchVertex_f(v, w);
+				}
+			}
+			cbs.EndPrimitive_f(w);
+		}
+		cbs.EndPatch_f(w);
+	}
+
+	for (n = 0; n < c.objects; ++n)
+	{
+		double o[4] = { BENCH_WEST + r.unit(), BENCH_SOUTH + r.unit(), r.unit() * 360.0, 0.0 };
+		cbs.AddObject_f(r.range(BENCH_OBJECTS), o, 3, w);
+	}
+
+	for (n = 0; n < c.polygons; ++n)
+	{
+		double	cx = BENCH_WEST + 0.001 + r.unit() * 0.998;
+		double	cy = BENCH_SOUTH + 0.001 + r.unit() * 0.998;
+		int		pts = 4 + r.range(5);
+		cbs.BeginPolygon_f(r.range(BENCH_FACADES), 10, 2, w);
+		cbs.BeginPolygonWinding_f(w);
+		for (i = 0; i < pts; ++i)
+		{
+			double p[2] = { cx + 0.0005 * cos(i * 2.0 * M_PI / pts), cy + 0.0005 * sin(i * 2.0 * M_PI / pts) };
+			cbs.AddPolygonPoint_f(p, w);
+		}
+		cbs.EndPolygonWinding_f(w);
+		cbs.EndPolygon_f(w);
+	}
+
+	// Chains run between neighboring nodes of a lattice so that junctions are shared.
+	for (n = 0; n < c.networks; ++n)
+	{
+		int		a = 1 + r.range(BENCH_NODE_GRID * BENCH_NODE_GRID);
+		int		ai = (a - 1) % BENCH_NODE_GRID, aj = (a - 1) / BENCH_NODE_GRID;
+		int		b = (r.range(2) && ai < BENCH_NODE_GRID-1) || aj == BENCH_NODE_GRID-1 ? a + 1 : a + BENCH_NODE_GRID;
+		if (ai == BENCH_NODE_GRID-1 && aj == BENCH_NODE_GRID-1)
+			b = a - 1;										// The far corner has no east or north neighbor.
+		double	s[4], e[4];
+		bench_node(a, s);
+		bench_node(b, e);
+		cbs.BeginSegment_f(0, r.range(64), s, false, w);
+		int shape = 2 + r.range(7);
+		for (i = 1; i <= shape; ++i)
+		{
+			double t = (double) i / (shape + 1);
+			double p[3] = { s[0] + (e[0] - s[0]) * t + (r.unit() - 0.5) * 0.001,
+							s[1] + (e[1] - s[1]) * t + (r.unit() - 0.5) * 0.001, 0.0 };
+			cbs.AddSegmentShapePoint_f(p, false, w);
+		}
+		cbs.EndSegment_f(e, false, w);
+	}
+
+	for (n = 0; n < rasters.size(); ++n)
+	{
+		DSFRasterHeader_t	h;
+		h.version = dsf_RasterVersion;
+		h.bytes_per_pixel = 2;
+		h.flags = dsf_Raster_Format_Int | dsf_Raster_Post;
+		h.width = c.raster_size;
+		h.height = c.raster_size;
+		h.scale = 1.0f;
+		h.offset = 0.0f;
+		cbs.AddRasterData_f(&h, rasters[n], w);
+	}
+}
+
+/************************************************************************************************************
+ * COUNTING READER
+ ************************************************************************************************************/
+
+// Every callback does a little work so nothing can be optimized away; 'items' ends up as the total
+// number of things the reader handed us.
+static double	sItems = 0.0;
+
+static bool	Count_NextPass(int, void *) { return true; }
+static int	Count_AcceptDef(const char *, void *) { ++sItems; return 1; }
+static void	Count_AcceptProperty(const char *, const char *, void *) { ++sItems; }
+static void	Count_BeginPatch(unsigned int, double, double, unsigned char, int, void *) { ++sItems; }
+static void	Count_BeginPrimitive(int, void *) { ++sItems; }
+static void	Count_AddPatchVertex(double c[], void *) { sItems += 1.0 + c[0] * 0.0; }
+static void	Count_AddPatchVertices(double c[], int, int n, void *) { sItems += n + c[0] * 0.0; }
+static void	Count_Void(void *) { }
+static void	Count_AddObject(unsigned int, double c[4], int, void *) { sItems += 1.0 + c[0] * 0.0; }
+static void	Count_BeginSegment(unsigned int, unsigned int, double c[], bool, void *) { sItems += 1.0 + c[0] * 0.0; }
+static void	Count_SegmentPoint(double c[], bool, void *) { sItems += 1.0 + c[0] * 0.0; }
+static void	Count_BeginPolygon(unsigned int, unsigned short, int, void *) { ++sItems; }
+static void	Count_AddPolygonPoint(double * c, void *) { sItems += 1.0 + c[0] * 0.0; }
+static void	Count_AddRasterData(DSFRasterHeader_t * h, void *, void *) { sItems += h->width * h->height; }
+static void	Count_SetFilter(int, void *) { }
+
+static void	GetCountingCallbacks(DSFCallbacks_t * cbs)
+{
+	cbs->NextPass_f				= Count_NextPass;
+	cbs->AcceptTerrainDef_f		= Count_AcceptDef;
+	cbs->AcceptObjectDef_f		= Count_AcceptDef;
+	cbs->AcceptPolygonDef_f		= Count_AcceptDef;
+	cbs->AcceptNetworkDef_f		= Count_AcceptDef;
+	cbs->AcceptRasterDef_f		= Count_AcceptDef;
+	cbs->AcceptProperty_f		= Count_AcceptProperty;
+	cbs->BeginPatch_f			= Count_BeginPatch;
+	cbs->BeginPrimitive_f		= Count_BeginPrimitive;
+	cbs->AddPatchVertex_f		= Count_AddPatchVertex;
+	cbs->EndPrimitive_f			= Count_Void;
+	cbs->EndPatch_f				= Count_Void;
+	cbs->AddObject_f			= Count_AddObject;
+	cbs->BeginSegment_f			= Count_BeginSegment;
+	cbs->AddSegmentShapePoint_f	= Count_SegmentPoint;
+	cbs->EndSegment_f			= Count_SegmentPoint;
+	cbs->BeginPolygon_f			= Count_BeginPolygon;
+	cbs->BeginPolygonWinding_f	= Count_Void;
+	cbs->AddPolygonPoint_f		= Count_AddPolygonPoint;
+	cbs->EndPolygonWinding_f	= Count_Void;
+	cbs->EndPolygon_f			= Count_Void;
+	cbs->AddRasterData_f		= Count_AddRasterData;
+	cbs->SetFilter_f			= Count_SetFilter;
+	cbs->AddPatchVertices_f		= NULL;
+}
+
+/************************************************************************************************************
+ * BENCHMARKS
+ ************************************************************************************************************/
+
+static const struct { const char * name; int flags; } kReadPasses[] = {
+	{ "read_props",		dsf_CmdProps	},
+	{ "read_defs",		dsf_CmdDefs		},
+	{ "read_patches",	dsf_CmdPatches	},
+	{ "read_vectors",	dsf_CmdVectors	},
+	{ "read_polys",		dsf_CmdPolys	},
+	{ "read_objects",	dsf_CmdObjects	},
+	{ "read_raster",	dsf_CmdRaster	},
+	{ "read_sign",		dsf_CmdSign		},
+	{ "read_all",		dsf_CmdAll		},
+	{ NULL,				0				}
+};
+
+static void	RunBenchmarks(const BenchConfig_t& c, vector<BenchResult_t>& results)
+{
+	string	dsf_path = c.dir + DIR_STR "dsfbench.dsf";
+	string	txt_path = c.dir + DIR_STR "dsfbench.txt";
+	string	rt_path  = c.dir + DIR_STR "dsfbench_rt.dsf";
+	int		n, k;
+
+	FILE_make_dir_exist(c.dir.c_str());
+
+	vector<short *>	rasters(c.rasters);
+	for (n = 0; n < c.rasters; ++n)
+	{
+		rasters[n] = (short *) malloc(c.raster_size * c.raster_size * sizeof(short));
+		for (k = 0; k < c.raster_size * c.raster_size; ++k)
+			rasters[n][k] = bench_elev((double) (k % c.raster_size) / c.raster_size, (double) (k / c.raster_size) / c.raster_size + n);
+	}
+
+	// Writer - a fresh one per iteration, since writing consumes its state.
+	BenchResult_t	gen("generate", 0.0), wri("write", 0.0);
+	for (k = 0; k < c.iterations; ++k)
+	{
+		fprintf(stderr, "write %d/%d\n", k+1, c.iterations);
+		DSFCallbacks_t	cbs;
+		void * w = DSFCreateWriter(BENCH_WEST, BENCH_SOUTH, BENCH_WEST + 1, BENCH_SOUTH + 1, -32768.0, 32767.0, 8);
+		DSFGetWriterCallbacks(&cbs);
+		{
+			StBenchTimer t(gen);
+			GenerateTile(c, rasters, cbs, w);
+		}
+		{
+			StBenchTimer t(wri);
+			DSFWriteToFile(dsf_path.c_str(), w);
+		}
+		DSFDestroyWriter(w);
+	}
+	gen.bytes = wri.bytes = file_size(dsf_path);
+	results.push_back(gen);
+	results.push_back(wri);
+
+	// Readers - the file is loaded once and decoded from memory, so only DSFLib is on the clock.
+	FILE * fi = fopen(dsf_path.c_str(), "rb");
+	if (fi == NULL) AssertPrintf("Could not reopen %s", dsf_path.c_str());
+	vector<char>	mem((size_t) gen.bytes);
+	if (fread(&*mem.begin(), 1, mem.size(), fi) != mem.size())
+		AssertPrintf("Could not read %s", dsf_path.c_str());
+	fclose(fi);
+
+	DSFCallbacks_t	counter;
+	GetCountingCallbacks(&counter);
+	for (int p = 0; kReadPasses[p].name; ++p)
+	{
+		BenchResult_t	r(kReadPasses[p].name, mem.size());
+		int				passes[2] = { kReadPasses[p].flags, 0 };
+		for (k = 0; k < c.iterations; ++k)
+		{
+			StBenchTimer t(r);
+			int err = DSFReadMem(&*mem.begin(), &*mem.begin() + mem.size(), &counter, passes, NULL);
+			if (err != dsf_ErrOK) AssertPrintf("%s failed: %s", kReadPasses[p].name, dsfErrorMessages[err]);
+		}
+		results.push_back(r);
+	}
+	{
+		// Same as read_patches, but taking whole primitives through AddPatchVertices_f.
+		BenchResult_t	r("read_patches_bulk", mem.size());
+		DSFCallbacks_t	bulk(counter);
+		int				passes[2] = { dsf_CmdPatches, 0 };
+		bulk.AddPatchVertices_f = Count_AddPatchVertices;
+		for (k = 0; k < c.iterations; ++k)
+		{
+			StBenchTimer t(r);
+			int err = DSFReadMem(&*mem.begin(), &*mem.begin() + mem.size(), &bulk, passes, NULL);
+			if (err != dsf_ErrOK) AssertPrintf("read_patches_bulk failed: %s", dsfErrorMessages[err]);
+		}
+		results.push_back(r);
+	}
+	{
+		BenchResult_t	r("read_mapped", mem.size());
+		for (k = 0; k < c.iterations; ++k)
+		{
+			StBenchTimer t(r);
+			int err = DSFReadFileMapped(dsf_path.c_str(), &counter, NULL, NULL);
+			if (err != dsf_ErrOK) AssertPrintf("read_mapped failed: %s", dsfErrorMessages[err]);
+		}
+		results.push_back(r);
+	}
+
+	// Text round trip.
+	BenchResult_t	d2t("dsf2text", mem.size()), t2d("text2dsf", 0.0);
+	vector<char>	dsf_arg(dsf_path.begin(), dsf_path.end());
+	dsf_arg.push_back(0);
+	char *			dsf_argv = &*dsf_arg.begin();
+	for (k = 0; k < c.iterations; ++k)
+	{
+		fprintf(stderr, "round trip %d/%d\n", k+1, c.iterations);
+		{
+			StBenchTimer t(d2t);
+			if (!DSF2Text(&dsf_argv, 1, txt_path.c_str())) AssertPrintf("dsf2text failed on %s", dsf_path.c_str());
+		}
+		{
+			StBenchTimer t(t2d);
+			if (!Text2DSF(txt_path.c_str(), rt_path.c_str())) AssertPrintf("text2dsf failed on %s", txt_path.c_str());
+		}
+	}
+	t2d.bytes = file_size(txt_path);
+	results.push_back(d2t);
+	results.push_back(t2d);
+
+	if (!c.keep)
+	{
+		FILE_delete_file(dsf_path.c_str(), false);
+		FILE_delete_file(txt_path.c_str(), false);
+		FILE_delete_file(rt_path.c_str(), false);
+		for (n = 0; n < c.rasters; ++n)
+		{
+			char buf[32];
+			sprintf(buf, ".raster%d.raw", n);
+			FILE_delete_file((txt_path + buf).c_str(), false);
+		}
+	}
+	for (n = 0; n < c.rasters; ++n)
+		free(rasters[n]);
+}
+
+int main(int argc, char * argv[])
+{
+	InstallDebugAssertHandler(AssertShellBail);
+	InstallAssertHandler(AssertShellBail);
+
+	BenchConfig_t	c;
+	c.patches = 16;
+	c.patch_grid = 64;
+	c.objects = 20000;
+	c.polygons = 5000;
+	c.networks = 5000;
+	c.rasters = 1;
+	c.raster_size = 257;
+	c.iterations = 3;
+	c.threads = 0;
+	c.seed = 1;
+	c.dir = ".";
+	c.out = NULL;
+	c.keep = false;
+
+	for (int n = 1; n < argc; ++n)
+	{
+		const char * a = argv[n];
+		const char * v = (n + 1 < argc) ? argv[n+1] : NULL;
+		if		(!strcmp(a, "--keep"))					c.keep = true;
+		else if (v == NULL)								goto help;
+		else if (!strcmp(a, "--patches"))				c.patches = atoi(v), ++n;
+		else if (!strcmp(a, "--patch_grid"))			c.patch_grid = atoi(v), ++n;
+		else if (!strcmp(a, "--objects"))				c.objects = atoi(v), ++n;
+		else if (!strcmp(a, "--polygons"))				c.polygons = atoi(v), ++n;
+		else if (!strcmp(a, "--networks"))				c.networks = atoi(v), ++n;
+		else if (!strcmp(a, "--rasters"))				c.rasters = atoi(v), ++n;
+		else if (!strcmp(a, "--raster_size"))			c.raster_size = atoi(v), ++n;
+		else if (!strcmp(a, "--iterations"))			c.iterations = atoi(v), ++n;
+		else if (!strcmp(a, "--threads"))				c.threads = atoi(v), ++n;
+		else if (!strcmp(a, "--seed"))					c.seed = atoi(v), ++n;
+		else if (!strcmp(a, "--dir"))					c.dir = v, ++n;
+		else if (!strcmp(a, "--out"))					c.out = v, ++n;
+		else											goto help;
+	}
+	if (c.patches < 0 || c.patch_grid < 1 || c.objects < 0 || c.polygons < 0 || c.networks < 0 ||
+		c.rasters < 0 || c.raster_size < 2 || c.iterations < 1)
+		goto help;
+
+	{
+		DSFSetDecodeThreads(c.threads);
+
+		vector<BenchResult_t>	results;
+		RunBenchmarks(c, results);
+
+		FILE * fo = c.out ? fopen(c.out, "w") : stdout;
+		if (fo == NULL) { fprintf(stderr, "Could not open %s\n", c.out); return 1; }
+		fprintf(fo, "# DSFBench patches=%d patch_grid=%d objects=%d polygons=%d networks=%d rasters=%d raster_size=%d iterations=%d threads=%d seed=%u\n",
+			c.patches, c.patch_grid, c.objects, c.polygons, c.networks, c.rasters, c.raster_size, c.iterations, c.threads, c.seed);
+		fprintf(fo, "benchmark,iterations,bytes,min_ms,avg_ms,max_ms,mb_per_sec\n");
+		for (vector<BenchResult_t>::iterator r = results.begin(); r != results.end(); ++r)
+			fprintf(fo, "%s,%d,%.0f,%.3f,%.3f,%.3f,%.2f\n", r->name.c_str(), r->iterations, r->bytes,
+				r->min_ms, r->total_ms / r->iterations, r->max_ms,
+				r->min_ms > 0.0 ? (r->bytes / (1024.0 * 1024.0)) / (r->min_ms / 1000.0) : 0.0);
+		if (c.out) fclose(fo);
+	}
+	return 0;
+
+help:
+	fprintf(stderr, "Usage: DSFBench [--patches n] [--patch_grid n] [--objects n] [--polygons n] [--networks n]\n");
+	fprintf(stderr, "                [--rasters n] [--raster_size n] [--iterations n] [--threads n] [--seed n]\n");
+	fprintf(stderr, "                [--dir scratch_dir] [--out results.csv] [--keep]\n");
+	fprintf(stderr, "Times DSF generation, writing, per-pass reading and the text round trip on a synthetic tile.\n");
+	fprintf(stderr, "Results are CSV; mb_per_sec is computed from min_ms and the size of the file each step consumes.\n");
+	return 1;
+}
@@ -24,6 +24,11 @@
 #include "../XPTools/version.h"
 #include <stdio.h>
 #include "AssertUtils.h"
+#include "FileUtils.h"
+#include "PlatformUtils.h"
+#include "ThreadUtils.h"
+#include "DSFLib.h"
+#include "DSF2Columns.h"
 
 #if IBM
 #include <stdlib.h>
@@ -41,6 +46,153 @@ void AssertShellBail(const char * condition, const char * file, int line)
 bool DSF2Text(char ** inDSF, int n, const char * inFileName);
 bool Text2DSF(const char * inFileName, const char * inDSF);
 
+/*
+	BATCH MODE
+
+	--batch converts a whole set of files in one run: every .dsf (or .txt) under a directory, or
+	every path listed one per line in a text file.  Each conversion is independent, so they are
+	spread over a pool of threads with TU_ParallelFor; DSF decoding inside each one is kept on its
+	own thread so we don't oversubscribe the CPUs.  Output goes next to each input with the
+	extension swapped, or into an output dir that mirrors the input tree.
+*/
+
+enum {
+	batch_ToText,
+	batch_ToDSF,
+	batch_ToColumns
+};
+
+struct	BatchJob_t {
+	string	src;
+	string	dst;
+	int		mode;
+	bool	ok;
+};
+
+static const char *	kBatchSrcExt[] = { "dsf", "txt", "dsf" };
+static const char *	kBatchDstExt[] = { ".txt", ".dsf", ".dsfc" };
+
+static string	swap_extension(const string& path, const char * new_ext)
+{
+	size_t dot = path.find_last_of('.');
+	size_t sep = path.find_last_of("\\:/");
+	if (dot == path.npos || (sep != path.npos && dot < sep))
+		return path + new_ext;
+	return path.substr(0, dot) + new_ext;
+}
+
+static bool	BatchCollect(const char * inSource, const char * inDestDir, int inMode, vector<BatchJob_t>& outJobs)
+{
+	vector<string>	files, dirs, inputs;
+	string			root(inSource);
+	while (root.size() > 1 && (root[root.size()-1] == '/' || root[root.size()-1] == DIR_CHAR))
+		root.erase(root.size()-1);
+
+	if (FILE_get_directory_recursive(root, files, dirs) >= 0)
+	{
+		for (vector<string>::iterator f = files.begin(); f != files.end(); ++f)
+		if (FILE_get_file_extension(*f) == kBatchSrcExt[inMode])
+			inputs.push_back(*f);
+	}
+	else
+	{
+		root.clear();
+		FILE * lf = fopen(inSource, "r");
+		if (lf == NULL)
+		{
+			fprintf(err_fi, "ERROR: %s is neither a directory nor a readable file list.\n", inSource);
+			return false;
+		}
+		char	line[2048];
+		while (fgets(line, sizeof(line), lf))
+		{
+			string p(line);
+			while (!p.empty() && (p[p.size()-1] == '\n' || p[p.size()-1] == '\r'))
+				p.erase(p.size()-1);
+			if (!p.empty())
+				inputs.push_back(p);
+		}
+		fclose(lf);
+	}
+
+	for (vector<string>::iterator i = inputs.begin(); i != inputs.end(); ++i)
+	{
+		BatchJob_t	job;
+		job.src = *i;
+		job.mode = inMode;
+		job.ok = false;
+		job.dst = swap_extension(*i, kBatchDstExt[inMode]);
+		if (inDestDir)
+		{
+			// Keep the layout under the source dir; files from a list just go flat into the dest dir.
+			string rel = root.empty() ? FILE_get_file_name(job.dst) : job.dst.substr(root.size() + 1);
+			job.dst = string(inDestDir) + DIR_STR + rel;
+			FILE_make_dir_exist(FILE_get_dir_name(job.dst).c_str());
+		}
+		outJobs.push_back(job);
+	}
+	return true;
+}
+
+static void	BatchConvert(int n, void * ref)
+{
+	BatchJob_t * job = ((BatchJob_t *) ref) + n;
+	switch(job->mode) {
+	case batch_ToText:
+		{
+			char * src = const_cast<char *>(job->src.c_str());
+			job->ok = DSF2Text(&src, 1, job->dst.c_str());
+		}
+		break;
+	case batch_ToDSF:
+		job->ok = Text2DSF(job->src.c_str(), job->dst.c_str());
+		break;
+	case batch_ToColumns:
+		job->ok = DSF2Columns(job->src.c_str(), job->dst.c_str());
+		break;
+	}
+}
+
+static int	DoBatch(int argc, char * argv[])
+{
+	int				threads = 0;
+	int				mode = -1;
+	const char *	source = NULL;
+	const char *	dest = NULL;
+
+	for (int n = 0; n < argc; ++n)
+	{
+		if (!strcmp(argv[n], "--threads") && n + 1 < argc)	threads = atoi(argv[++n]);
+		else if (!strcmp(argv[n], "--dsf2text"))			mode = batch_ToText;
+		else if (!strcmp(argv[n], "--text2dsf"))			mode = batch_ToDSF;
+		else if (!strcmp(argv[n], "--dsf2columns"))			mode = batch_ToColumns;
+		else if (source == NULL)							source = argv[n];
+		else if (dest == NULL)								dest = argv[n];
+		else												return -1;
+	}
+	if (mode == -1 || source == NULL)
+		return -1;
+
+	vector<BatchJob_t>	jobs;
+	if (!BatchCollect(source, dest, mode, jobs))
+		return 1;
+
+	fprintf(err_fi, "Converting %d files on %d threads.\n", (int) jobs.size(), threads ? threads : TU_GetCPUCount());
+	DSFSetDecodeThreads(1);
+	if (!jobs.empty())
+		TU_ParallelFor(jobs.size(), BatchConvert, &*jobs.begin(), threads);
+
+	int failed = 0;
+	for (vector<BatchJob_t>::iterator j = jobs.begin(); j != jobs.end(); ++j)
+	if (!j->ok)
+	{
+		fprintf(err_fi, "ERROR: Error converting %s to %s\n", j->src.c_str(), j->dst.c_str());
+		++failed;
+	}
+	fprintf(err_fi, "Converted %d of %d files.\n", (int) jobs.size() - failed, (int) jobs.size());
+	return failed ? 1 : 0;
+}
+
 int main(int argc, char * argv[])
 {
 	InstallDebugAssertHandler(AssertShellBail);
@@ -55,6 +207,13 @@ int main(int argc, char * argv[])
 		return 0;
 	}
 
+	if(!strcmp(argv[1],"--batch"))
+	{
+		int result = DoBatch(argc - 2, argv + 2);
+		if (result < 0) goto help;
+		return result;
+	}
+
 	for (int n = 1; n < argc; ++n)
 	{
 		if (!strcmp(argv[n], "-dsf2text") ||
@@ -90,6 +249,22 @@ int main(int argc, char * argv[])
 			else
 				{ fprintf(err_fi, "ERROR: Error convertiong %s to %s\n", f1, f2); exit(1); }
 		}
+		if (!strcmp(argv[n], "-dsf2columns") ||
+			!strcmp(argv[n], "--dsf2columns"))
+		{
+			++n;
+			if (n >= argc) goto help;
+			const char * f1 = argv[n];
+			++n;
+			if (n >= argc) goto help;
+			const char * f2 = argv[n];
+
+			printf("Converting %s from DSF to columns as %s\n", f1, f2);
+			if (DSF2Columns(f1, f2))
+				printf("Converted %s to %s\n",f1, f2);
+			else
+				{ fprintf(err_fi, "ERROR: Error convertiong %s to %s\n", f1, f2); exit(1); }
+		}
 		if (!strcmp(argv[n], "--version"))
 		{
 			print_product_version("DSFTool", DSFTOOL_VER, DSFTOOL_EXTRAVER);
@@ -101,6 +276,8 @@ help:
 	fprintf(err_fi, "Usage: dsftool --dsf2text [dsffile] [textfile]\n");
 	fprintf(err_fi, "       dsftool --text2dsf [textfile] [dsffile]\n");
 	fprintf(err_fi, "       dsftool --env2overlay [envfile] [dsffile]\n");
+	fprintf(err_fi, "       dsftool --dsf2columns [dsffile] [columnfile]\n");
+	fprintf(err_fi, "       dsftool --batch [--threads n] --dsf2text|--text2dsf|--dsf2columns [dir or file list] [output dir]\n");
 	fprintf(err_fi, "       dsftool --version\n");
 	fprintf(err_fi, "Please note: dsftool still supports single-hyphen (-dsf2text) syntax for backward compatibility.\n");
 	return 1;
@@ -182,6 +182,7 @@ int	main(int argc, char * argv[])
 
 
 		int				use_wat;
+		int				tile_size;
 		int				zlimit=0;
 		int				is_layer = 0;
 		int				param1;
@@ -198,6 +199,12 @@ int	main(int argc, char * argv[])
 				printf("%s DDS generation.\n", param1 ? "Enabling" : "Disabling");
 				MT_EnableDDSGeneration(param1);
 			}
+
+			if(sscanf(buf,"DSF_SPILL %d", &param1)==1)
+			{
+				printf("%s DSF patch spilling.\n", param1 ? "Enabling" : "Disabling");
+				MT_EnableDSFSpill(param1);
+			}
 			
 			if(sscanf(buf,"MESH_SPECS %d %f", &param1, &param2) == 2)
 			{
@@ -368,6 +375,10 @@ int	main(int argc, char * argv[])
 			{
 				MT_GeoTiff(cus_ter, use_wat);
 			}
+			if(sscanf(buf,"GEOTIFF_TILES %d %d %s",&use_wat,&tile_size,cus_ter)==3)
+			{
+				MT_GeoTiffTiles(cus_ter, use_wat, tile_size);
+			}
 
 			if(sscanf(buf,"ORTHOPHOTO %d %lf %lf %lf %lf %lf %lf %lf %lf %s",&use_wat,
 					&proj_lon[0],&proj_lat[0],
@@ -51,6 +51,7 @@
 #include "ShapeIO.h"
 #include "FileUtils.h"
 #include "NetAlgs.h"
+#include "ThreadUtils.h"
 
 #define MT_GAMMA 2.2f
 #define MT_USE_WIN_GAMMA (1)
@@ -494,6 +495,11 @@ void MT_EnableDDSGeneration(int create)
 	sMakeDDS = create;
 }
 
+void MT_EnableDSFSpill(int spill)
+{
+	gDSFBuildPrefs.spill_patches = spill;
+}
+
 void MT_SetMeshSpecs(int max_pts, float max_err)
 {
 	gMeshPrefs.max_points = max_pts;
@@ -683,6 +689,211 @@ void MT_GeoTiff(const char * fname, int back_with_water)
 	}
 }
 
+/*
+	GEOTIFF_TILES - a GeoTIFF too big to load (or to fit one texture) is cut into a grid of tiles of at most tile_size
+	pixels, each its own DDS, .ter and orthophoto.  We read the TIFF one band of tile rows at a time, so we never hold
+	more than a band in memory, and compress the tiles of each band in parallel.  Interior tiles are a straight copy;
+	the tiles on the right and bottom edges are short, so they are stretched to the next power of 2.
+
+	The tile corners are interpolated from the image corners, so tiles that share an edge share its coordinates
+	exactly and the orthophotos butt up without cracks.
+*/
+
+struct	geotiff_tile_t {
+	string		ter;
+	string		dds;
+	long		x1, x2;				// Source columns, within the band.
+	int			tex_w, tex_h;		// DDS size
+	bool		need_dds;
+	bool		failed;				// Set if we couldn't write the DDS - then we don't reference it either.
+	double		lon[4], lat[4];
+};
+
+struct	geotiff_band_t {
+	ImageInfo					pixels;
+	vector<geotiff_tile_t>		tiles;
+	int							compress_threads;
+};
+
+static void geotiff_make_tile(int n, void * ref)
+{
+	geotiff_band_t * band = (geotiff_band_t *) ref;
+	geotiff_tile_t& tile(band->tiles[n]);
+	if(!tile.need_dds)
+		return;
+
+	ImageInfo	tex;
+	if(CreateNewBitmap(tile.tex_w, tile.tex_h, 4, &tex) != 0)
+	{
+		tile.failed = true;
+		return;
+	}
+	long w = tile.x2 - tile.x1;
+	long h = band->pixels.height;
+	if(w == tile.tex_w && h == tile.tex_h)
+		CopyBitmapSectionDirect(band->pixels, tex, tile.x1, 0, 0, 0, w, h);
+	else
+		CopyBitmapSection(&band->pixels, &tex, tile.x1, 0, tile.x2, h, 0, 0, tile.tex_w, tile.tex_h);
+
+	MakeMipmapStack(&tex);
+	vector<unsigned char>	dds;
+	int err = CompressBitmapToDDS(tex, 5, MT_USE_WIN_GAMMA, dds, dxt_quality_best, band->compress_threads);
+	DestroyBitmap(&tex);
+	if(err != 0 || dds.empty())
+	{
+		tile.failed = true;
+		return;
+	}
+
+	FILE * fi = fopen(tile.dds.c_str(), "wb");
+	if(fi == NULL)
+	{
+		tile.failed = true;
+		return;
+	}
+	bool ok = fwrite(&*dds.begin(), dds.size(), 1, fi) == 1;
+	if(fclose(fi) != 0)
+		ok = false;
+	if(!ok)
+	{
+		// Don't leave a short DDS behind - the next run would think it's done.
+		FILE_delete_file(tile.dds.c_str(), false);
+		tile.failed = true;
+	}
+}
+
+// Bilinear blend of the four image corners (SW, SE, NW, NE lon,lat pairs) - u runs west to east, v south to north.
+static void geotiff_corner(const double c[8], double u, double v, double& lon, double& lat)
+{
+	lon = (1.0 - u) * (1.0 - v) * c[0] + u * (1.0 - v) * c[2] + (1.0 - u) * v * c[4] + u * v * c[6];
+	lat = (1.0 - u) * (1.0 - v) * c[1] + u * (1.0 - v) * c[3] + (1.0 - u) * v * c[5] + u * v * c[7];
+}
+
+void MT_GeoTiffTiles(const char * fname, int back_with_water, int tile_size)
+{
+	if(tile_size < 64 || (tile_size & (tile_size - 1)) != 0)
+	{
+		die_err("GeoTIFF tile size %d must be a power of 2, at least 64.\n", tile_size);
+		return;
+	}
+
+	double c[8];	// SW, SE, NW, NE lon,lat pairs
+	int align = dem_want_Area;
+	if(!FetchTIFFCorners(fname,c, align))
+	{
+		die_err("Unable to read corner coordinates from %s.\n",fname);
+		return;
+	}
+
+	long width, height;
+	TIFFRowReader * reader = OpenTIFFRows(fname, &width, &height);
+	if(reader == NULL)
+	{
+		die_err("Unable to open %s.\n",fname);
+		return;
+	}
+
+	string base(fname);
+	string::size_type dot = base.find_last_of('.');
+	if(dot != string::npos && base.find_first_of("/\\", dot) == string::npos)
+		base.erase(dot);
+
+	int cols = (width + tile_size - 1) / tile_size;
+	int rows = (height + tile_size - 1) / tile_size;
+	printf("GEOTIFF_TILES: %s is %ldx%ld, cutting into %dx%d tiles.\n", fname, width, height, cols, rows);
+
+	geotiff_band_t	band;
+	band.compress_threads = max(1, TU_GetCPUCount() / cols);
+
+	// Rows count down from the top of the TIFF, which is the order it is stored in.
+	for(int r = 0; r < rows; ++r)
+	{
+		long y1 = (long) r * tile_size;
+		long y2 = min(y1 + tile_size, height);
+		band.tiles.clear();
+		bool need_pixels = false;
+
+		for(int col = 0; col < cols; ++col)
+		{
+			geotiff_tile_t	tile;
+			char suffix[64];
+			sprintf(suffix, "_%d_%d", col, r);
+			tile.ter = base + suffix + ".ter";
+			tile.dds = base + suffix + ".dds";
+			tile.x1 = (long) col * tile_size;
+			tile.x2 = min(tile.x1 + tile_size, width);
+			tile.tex_w = tile.tex_h = 1;
+			while(tile.tex_w < tile.x2 - tile.x1) tile.tex_w <<= 1;
+			while(tile.tex_h < y2 - y1) tile.tex_h <<= 1;
+			tile.need_dds = sMakeDDS && !FILE_exists(tile.dds.c_str());
+			tile.failed = false;
+			need_pixels |= tile.need_dds;
+
+			// Vertex order is SW, SE, NE, NW like MT_GeoTiff.
+			double u1 = (double) tile.x1 / (double) width;
+			double u2 = (double) tile.x2 / (double) width;
+			double v1 = 1.0 - (double) y2 / (double) height;
+			double v2 = 1.0 - (double) y1 / (double) height;
+			geotiff_corner(c, u1, v1, tile.lon[0], tile.lat[0]);
+			geotiff_corner(c, u2, v1, tile.lon[1], tile.lat[1]);
+			geotiff_corner(c, u2, v2, tile.lon[2], tile.lat[2]);
+			geotiff_corner(c, u1, v2, tile.lon[3], tile.lat[3]);
+
+			band.tiles.push_back(tile);
+		}
+
+		if(need_pixels)
+		{
+			if(ReadTIFFRows(reader, y1, y2 - y1, &band.pixels) != 0)
+			{
+				CloseTIFFRows(reader);
+				die_err("Unable to read rows %ld-%ld of %s.\n", y1, y2, fname);
+				return;
+			}
+			TU_ParallelFor(cols, geotiff_make_tile, &band);
+			DestroyBitmap(&band.pixels);
+		}
+
+		int failed = 0;
+		for(vector<geotiff_tile_t>::iterator t = band.tiles.begin(); t != band.tiles.end(); ++t)
+		{
+			if(t->failed)
+			{
+				fprintf(stderr, "GEOTIFF_TILES: could not write %s - skipping its orthophoto.\n", t->dds.c_str());
+				++failed;
+				continue;
+			}
+			double s[4] = { 0.0, 1.0, 1.0, 0.0 };
+			double tc[4] = { 0.0, 0.0, 1.0, 1.0 };
+			MT_OrthoPhoto(t->ter.c_str(), t->lon, t->lat, s, tc, back_with_water);
+
+			if(!FILE_exists(t->ter.c_str()))
+			{
+				FILE * fi = fopen(t->ter.c_str(),"w");
+				if(fi)
+				{
+					fprintf(fi,
+						"A\n"
+						"800\n"
+						"TERRAIN\n\n"
+						"BASE_TEX_NOWRAP %s\n",no_path(t->dds.c_str()));
+					fprintf(fi,"LOAD_CENTER %lf %lf %d %d\n\n",0.5 * (t->lat[0] + t->lat[2]), 0.5 * (t->lon[0] + t->lon[2]),
+						(int) LonLatDistMeters(t->lon[0],t->lat[0],t->lon[2],t->lat[2]), max(t->tex_w, t->tex_h));
+					fclose(fi);
+				}
+			}
+		}
+		if(failed)
+		{
+			CloseTIFFRows(reader);
+			die_err("Unable to write %d of the tiles for rows %ld-%ld of %s (out of memory or disk space?)\n", failed, y1, y2, fname);
+			return;
+		}
+	}
+
+	CloseTIFFRows(reader);
+}
+
 void MT_QMID_Prefix(const char * prefix)
 {
 	g_qmid_prefix = prefix;
@@ -61,6 +61,7 @@ void MT_NetSegment(double lon1, double lat1, double lon2, double lat2);
 void MT_NetEnd(void);
 
 void MT_EnableDDSGeneration(int create);
+void MT_EnableDSFSpill(int spill);
 void MT_SetMeshSpecs(int max_pts, float max_err);
 
 void MT_Mask(const char * shapefile);	// or NULL
@@ -75,6 +76,8 @@ void MT_OrthoPhoto(
 					int			 back_with_water);
 
 void MT_GeoTiff(const char * fname, int back_with_water);
+// Same, but cut into a grid of DDS tiles of at most tile_size pixels, streaming the TIFF a band at a time.
+void MT_GeoTiffTiles(const char * fname, int back_with_water, int tile_size);
 void MT_QMID(const char * id, int back_with_water);
 void MT_QMID_Prefix(const char * prefix);
 
@@ -24,7 +24,11 @@
 using std::min;
 using std::max;
 
-ObjPointPool::ObjPointPool() : mDepth(8)
+// Grow the table to keep it no more than half full - probe chains stay short with linear probing.
+#define POOL_MIN_SLOTS		64
+#define POOL_MAX_LOAD(n)	((n) / 2)
+
+ObjPointPool::ObjPointPool() : mUsed(0), mDepth(8)
 {
 }
 
@@ -35,36 +39,105 @@ ObjPointPool::~ObjPointPool()
 void	ObjPointPool::clear(int depth)
 {
 	mData.clear();
-	mIndex.clear();
+	mSlots.clear();
+	mUsed = 0;
 	mDepth = depth;
 }
 
 void	ObjPointPool::resize(int pts)
 {
 	mData.resize(pts * mDepth);
-	mIndex.clear();
+	mSlots.clear();
+	mUsed = 0;
+}
+
+unsigned	ObjPointPool::hash_pt(const float pt[]) const
+{
+	unsigned h = 2166136261U;
+	for (int n = 0; n < mDepth; ++n)
+	{
+		unsigned bits = 0;
+		if (pt[n] != 0.0f)				// -0.0 == 0.0, so they must hash the same.
+			memcpy(&bits, pt + n, sizeof(bits));
+		h = (h ^ bits) * 16777619U;
+		h ^= h >> 15;
+	}
+	h ^= h >> 16;
+	h *= 0x85EBCA6BU;
+	h ^= h >> 13;
+	return h;
+}
+
+int		ObjPointPool::find_pt(const float pt[], unsigned hash) const
+{
+	if (mSlots.empty())
+		return -1;
+	unsigned mask = mSlots.size() - 1;
+	for (unsigned s = hash & mask; mSlots[s].index != -1; s = (s + 1) & mask)
+	if (mSlots[s].hash == hash)
+	{
+		const float * p = &mData[mSlots[s].index * mDepth];
+		int n = 0;
+		while (n < mDepth && p[n] == pt[n])
+			++n;
+		if (n == mDepth)
+			return mSlots[s].index;
+	}
+	return -1;
+}
+
+void	ObjPointPool::index_pt(int n, unsigned hash)
+{
+	if (mUsed + 1 > POOL_MAX_LOAD((int) mSlots.size()))
+	{
+		vector<slot_type>	old;
+		old.swap(mSlots);
+		slot_type	empty = { 0, -1 };
+		mSlots.resize(max(old.size() * 2, (size_t) POOL_MIN_SLOTS), empty);
+		mUsed = 0;
+		for (vector<slot_type>::iterator o = old.begin(); o != old.end(); ++o)
+		if (o->index != -1)
+			index_pt(o->index, o->hash);
+	}
+
+	unsigned mask = mSlots.size() - 1;
+	unsigned s = hash & mask;
+	while (mSlots[s].index != -1)
+		s = (s + 1) & mask;
+	mSlots[s].hash = hash;
+	mSlots[s].index = n;
+	++mUsed;
 }
 
 int		ObjPointPool::accumulate(const float pt[])
 {
-	index_type::iterator iter = mIndex.find(key_type(pt, pt + mDepth));
-	if (iter != mIndex.end())
-		return iter->second;
-	return append(pt);
+	unsigned hash = hash_pt(pt);
+	int ret = find_pt(pt, hash);
+	if (ret != -1)
+		return ret;
+	ret = mData.size() / mDepth;
+	mData.insert(mData.end(), pt, pt + mDepth);
+	index_pt(ret, hash);
+	return ret;
 }
 
 int		ObjPointPool::append(const float pt[])
 {
+	unsigned hash = hash_pt(pt);
+	bool dupe = find_pt(pt, hash) != -1;
 	int ret = mData.size() / mDepth;
 	mData.insert(mData.end(), pt, pt + mDepth);
-	mIndex.insert(index_type::value_type(key_type(pt,pt+mDepth), ret));
+	if (!dupe)
+		index_pt(ret, hash);
 	return ret;
 }
 
 void	ObjPointPool::set(int n, float pt[])
 {
 	memcpy(&mData[n*mDepth], pt, mDepth * sizeof(float));
-	mIndex.insert(index_type::value_type(key_type(pt,pt+mDepth), n));
+	unsigned hash = hash_pt(pt);
+	if (find_pt(pt, hash) == -1)
+		index_pt(n, hash);
 }
 
 int		ObjPointPool::count(void) const
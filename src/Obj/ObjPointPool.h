@@ -39,6 +39,17 @@ struct lex_compare_vector : public binary_function<vector<T>, vector<T>, bool> {
 	}
 };
 
+/*
+	ObjPointPool - a flat array of points, mDepth floats each, with an index so accumulate can find an existing copy
+	of a point.  The index is an open-addressed hash table (linear probing, kept at most half full) of point numbers;
+	a slot holds the point's hash and number and the point itself is compared in place in mData, so a lookup never
+	allocates.  Points match when every float compares equal, so 0.0 and -0.0 are the same point and a point with a
+	NaN in it never matches anything.
+
+	set() replaces a point in place without dropping its old slot; the stale slot still compares against the point's
+	current contents, so it can never return the wrong point.
+*/
+
 class ObjPointPool {
 public:
 	ObjPointPool();
@@ -59,12 +70,19 @@ public:
 
 private:
 
-	typedef	vector<float>									key_type;
-	typedef map<key_type, int, lex_compare_vector<float> >	index_type;
+	struct	slot_type {
+		unsigned	hash;
+		int			index;		// -1 if empty
+	};
+
+	unsigned	hash_pt(const float pt[]) const;
+	int			find_pt(const float pt[], unsigned hash) const;
+	void		index_pt(int n, unsigned hash);
 
-	vector<float>	mData;
-	index_type		mIndex;
-	int				mDepth;
+	vector<float>		mData;
+	vector<slot_type>	mSlots;		// Size is 0 or a power of 2
+	int					mUsed;		// Slots in use
+	int					mDepth;
 
 };
 
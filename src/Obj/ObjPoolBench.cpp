@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+	ObjPoolBench - timings for ObjPointPool, the vertex pool the OBJ builders and converters dedupe through.
+
+	ObjPoolBench makes a set of synthetic vertex streams and feeds each one through ObjPointPool and through
+	MapPointPool, a copy of the map<vector<float> > pool ObjPointPool used before it was hashed, as a reference:
+
+		grid8			a triangulated height field, 8 floats (xyz, normal, st) per vertex - each vertex is shared
+						by up to six triangles, like a mesh going through XObjBuilder::AccumTri
+		grid5			the same mesh with 5 floats (xyz, st), like the 3DS exporter
+		unique8			random vertices that never repeat, the worst case for the index
+		set8			resize then set every vertex, like the OBJ7 reader
+
+	Both pools must hand back the same vertex numbers and end up with the same points, or we bail.  Every
+	benchmark runs --iterations times and the results are written as CSV like DSFBench, preceded by a # line
+	recording the configuration.  The random generator is our own so a given --seed makes the same streams on
+	every platform.
+
+*/
+
+#include "ObjPointPool.h"
+#include "PerfUtils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+struct	BenchConfig_t {
+	int			grid;			// The meshes are grid x grid quads.
+	int			unique;			// Vertices in the unique stream.
+	int			iterations;
+	unsigned	seed;
+	const char *out;
+};
+
+// xorshift32 - rand() differs between C libraries and we want the same streams everywhere.
+struct	BenchRand {
+	unsigned	s;
+	BenchRand(unsigned seed) : s(seed ? seed : 1) { }
+	unsigned	next(void) { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+	float		unit(void) { return (float) (next() >> 8) / 16777216.0f; }
+};
+
+struct	BenchResult_t {
+	string		name;
+	string		pool;
+	int			iterations;
+	int			lookups;
+	int			points;
+	double		min_ms;
+	double		max_ms;
+	double		total_ms;
+
+	BenchResult_t(const char * n, const char * p, int l) : name(n), pool(p), iterations(0), lookups(l), points(0), min_ms(0), max_ms(0), total_ms(0) { }
+	void add(double ms)
+	{
+		min_ms = iterations ? min(min_ms, ms) : ms;
+		max_ms = iterations ? max(max_ms, ms) : ms;
+		total_ms += ms;
+		++iterations;
+	}
+};
+
+struct	StBenchTimer {
+	BenchResult_t&		r_;
+	unsigned long long	start_;
+	StBenchTimer(BenchResult_t& r) : r_(r), start_(query_hpc()) { }
+	~StBenchTimer() { r_.add(hpc_to_microseconds(query_hpc() - start_) / 1000.0); }
+};
+
+/************************************************************************************************************
+ * REFERENCE POOL
+ ************************************************************************************************************/
+
+// ObjPointPool as it was: every lookup builds a vector<float> key and walks a map.
+class	MapPointPool {
+public:
+	MapPointPool() : mDepth(8) { }
+
+	void	clear(int depth) { mData.clear(); mIndex.clear(); mDepth = depth; }
+	void	resize(int pts) { mData.resize(pts * mDepth); mIndex.clear(); }
+
+	int		accumulate(const float pt[])
+	{
+		index_type::iterator iter = mIndex.find(key_type(pt, pt + mDepth));
+		if (iter != mIndex.end())
+			return iter->second;
+		return append(pt);
+	}
+	int		append(const float pt[])
+	{
+		int ret = mData.size() / mDepth;
+		mData.insert(mData.end(), pt, pt + mDepth);
+		mIndex.insert(index_type::value_type(key_type(pt, pt + mDepth), ret));
+		return ret;
+	}
+	void	set(int n, float pt[])
+	{
+		memcpy(&mData[n * mDepth], pt, mDepth * sizeof(float));
+		mIndex.insert(index_type::value_type(key_type(pt, pt + mDepth), n));
+	}
+
+	int				count(void) const { return mData.size() / mDepth; }
+	const float *	get(int index) const { return &mData[index * mDepth]; }
+
+private:
+
+	typedef	vector<float>									key_type;
+	typedef map<key_type, int, lex_compare_vector<float> >	index_type;
+
+	vector<float>	mData;
+	index_type		mIndex;
+	int				mDepth;
+};
+
+/************************************************************************************************************
+ * STREAMS
+ ************************************************************************************************************/
+
+// Six vertices per quad, two triangles, in the order a builder would see them.
+static void	make_grid(int grid, int depth, vector<float>& out)
+{
+	static const int	quad[6][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	out.clear();
+	out.reserve(grid * grid * 6 * depth);
+	for (int i = 0; i < grid; ++i)
+	for (int j = 0; j < grid; ++j)
+	for (int n = 0; n < 6; ++n)
+	{
+		float x = (float) (i + quad[n][0]);
+		float z = (float) (j + quad[n][1]);
+		float v[8] = { x, 10.0f * sinf(x * 0.1f) * cosf(z * 0.1f), z, 0.0f, 1.0f, 0.0f, x / grid, z / grid };
+		if (depth == 5)
+		{
+			v[3] = v[6];
+			v[4] = v[7];
+		}
+		out.insert(out.end(), v, v + depth);
+	}
+}
+
+static void	make_unique(int count, BenchRand& r, vector<float>& out)
+{
+	out.resize(count * 8);
+	for (vector<float>::iterator f = out.begin(); f != out.end(); ++f)
+		*f = r.unit() * 1000.0f;
+}
+
+template <class Pool>
+static void	run_accumulate(Pool& pool, int depth, const vector<float>& stream, vector<int>& out_idx)
+{
+	int count = stream.size() / depth;
+	pool.clear(depth);
+	out_idx.resize(count);
+	for (int n = 0; n < count; ++n)
+		out_idx[n] = pool.accumulate(&stream[n * depth]);
+}
+
+template <class Pool>
+static void	run_set(Pool& pool, int depth, vector<float>& stream, vector<int>& out_idx)
+{
+	int count = stream.size() / depth;
+	pool.clear(depth);
+	pool.resize(count);
+	for (int n = 0; n < count; ++n)
+		pool.set(n, &stream[n * depth]);
+	// What the OBJ7 reader has built is only useful if accumulate can find it afterward.
+	out_idx.resize(count);
+	for (int n = 0; n < count; ++n)
+		out_idx[n] = pool.accumulate(&stream[n * depth]);
+}
+
+static void	check_same(const char * name, const ObjPointPool& pool, const MapPointPool& ref, const vector<int>& idx, const vector<int>& ref_idx, int depth)
+{
+	bool ok = idx == ref_idx && pool.count() == ref.count();
+	for (int n = 0; ok && n < pool.count(); ++n)
+		ok = memcmp(pool.get(n), ref.get(n), depth * sizeof(float)) == 0;
+	if (!ok)
+	{
+		fprintf(stderr, "ERROR: ObjPointPool and MapPointPool disagree on %s.\n", name);
+		exit(1);
+	}
+}
+
+static void	bench_stream(const BenchConfig_t& c, const char * name, int depth, vector<float>& stream, bool use_set, vector<BenchResult_t>& results)
+{
+	int lookups = stream.size() / depth;
+	BenchResult_t	hr(name, "hash", lookups);
+	BenchResult_t	mr(name, "map", lookups);
+	vector<int>		idx, ref_idx;
+
+	for (int i = 0; i < c.iterations; ++i)
+	{
+		ObjPointPool	pool;
+		MapPointPool	ref;
+		{
+			StBenchTimer t(mr);
+			if (use_set)	run_set(ref, depth, stream, ref_idx);
+			else			run_accumulate(ref, depth, stream, ref_idx);
+		}
+		{
+			StBenchTimer t(hr);
+			if (use_set)	run_set(pool, depth, stream, idx);
+			else			run_accumulate(pool, depth, stream, idx);
+		}
+		check_same(name, pool, ref, idx, ref_idx, depth);
+		hr.points = pool.count();
+		mr.points = ref.count();
+	}
+	results.push_back(mr);
+	results.push_back(hr);
+}
+
+int main(int argc, char * argv[])
+{
+	BenchConfig_t	c;
+	c.grid = 300;
+	c.unique = 200000;
+	c.iterations = 3;
+	c.seed = 1;
+	c.out = NULL;
+
+	for (int n = 1; n < argc; ++n)
+	{
+		const char * a = argv[n];
+		const char * v = (n + 1 < argc) ? argv[n+1] : NULL;
+		if		(v == NULL)								goto help;
+		else if (!strcmp(a, "--grid"))					c.grid = atoi(v), ++n;
+		else if (!strcmp(a, "--unique"))				c.unique = atoi(v), ++n;
+		else if (!strcmp(a, "--iterations"))			c.iterations = atoi(v), ++n;
+		else if (!strcmp(a, "--seed"))					c.seed = atoi(v), ++n;
+		else if (!strcmp(a, "--out"))					c.out = v, ++n;
+		else											goto help;
+	}
+	if (c.grid < 1 || c.unique < 1 || c.iterations < 1)
+		goto help;
+
+	{
+		BenchRand				r(c.seed);
+		vector<float>			stream;
+		vector<BenchResult_t>	results;
+
+		make_grid(c.grid, 8, stream);		bench_stream(c, "grid8", 8, stream, false, results);
+		make_grid(c.grid, 5, stream);		bench_stream(c, "grid5", 5, stream, false, results);
+		make_unique(c.unique, r, stream);	bench_stream(c, "unique8", 8, stream, false, results);
+		make_grid(c.grid, 8, stream);		bench_stream(c, "set8", 8, stream, true, results);
+
+		FILE * fo = c.out ? fopen(c.out, "w") : stdout;
+		if (fo == NULL) { fprintf(stderr, "Could not open %s\n", c.out); return 1; }
+		fprintf(fo, "# ObjPoolBench grid=%d unique=%d iterations=%d seed=%u\n", c.grid, c.unique, c.iterations, c.seed);
+		fprintf(fo, "benchmark,pool,iterations,lookups,points,min_ms,avg_ms,max_ms,mlookups_per_sec\n");
+		for (vector<BenchResult_t>::iterator r = results.begin(); r != results.end(); ++r)
+			fprintf(fo, "%s,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.2f\n", r->name.c_str(), r->pool.c_str(), r->iterations, r->lookups, r->points,
+				r->min_ms, r->total_ms / r->iterations, r->max_ms,
+				r->min_ms > 0.0 ? (r->lookups / 1000000.0) / (r->min_ms / 1000.0) : 0.0);
+		if (c.out) fclose(fo);
+	}
+	return 0;
+
+help:
+	fprintf(stderr, "Usage: ObjPoolBench [--grid n] [--unique n] [--iterations n] [--seed n] [--out results.csv]\n");
+	fprintf(stderr, "Times ObjPointPool against the old map-based pool on synthetic vertex streams.\n");
+	fprintf(stderr, "Results are CSV; mlookups_per_sec is computed from min_ms.\n");
+	return 1;
+}
@@ -93,6 +93,7 @@ void	RF_ShowPrefsDialog(void)
 						XP_END,
 						XP_COLUMN,
 							XP_ROW, XP_CHECKBOX, "Export Roads", &gDSFBuildPrefs.export_roads, XP_END,
+							XP_ROW, XP_CHECKBOX, "Spill Mesh To Disk", &gDSFBuildPrefs.spill_patches, XP_END,
 						XP_END,
 						XP_COLUMN,
 							XP_ROW, XP_CAPTION, "Road Elevation Sensitivity", XP_EDIT_FLOAT, 6, 6, 2, &gRoadPrefs.elevation_weight, XP_END,
@@ -71,6 +71,7 @@ PREFS_KEY_INT	("PROCESSING", "DO_3D_FORESTS"				,gProcessingCmdPrefs.build_3d_fo
 PREFS_KEY_INT	("PROCESSING", "DO_PLACE_BUILDINGS"			,gProcessingCmdPrefs.place_buildings)
 
 PREFS_KEY_INT	("DSF_EXPORT", "EXPORT_ROADS",				gDSFBuildPrefs.export_roads)
+PREFS_KEY_INT	("DSF_EXPORT", "SPILL_PATCHES",				gDSFBuildPrefs.spill_patches)
 
 PREFS_KEY_FLOAT	("ROADS",	"ELEV_WEIGHT",					gRoadPrefs.elevation_weight)
 PREFS_KEY_FLOAT	("ROADS",	"RADIAL_WEIGHT",				gRoadPrefs.radial_weight)
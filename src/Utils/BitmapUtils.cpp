@@ -36,6 +36,7 @@
 #include <jasper/jasper.h>
 #endif
 #include "AssertUtils.h"
+#include "ThreadUtils.h"
 
 #if IBM
 #include "GUI_Unicode.h"
@@ -1099,16 +1100,19 @@ int		CreateBitmapFromJPEGData(void * inBytes, int inLength, struct ImageInfo * o
 void my_error  (png_structp,png_const_charp err){}
 void my_warning(png_structp,png_const_charp err){}
 
-const char *			png_start_pos 	= NULL;
-const char *			png_end_pos 	= NULL;
-const char *			png_current_pos	= NULL;
+// Where we are in the PNG in memory - this rides along as libpng's io pointer, so several threads can decode at once.
+struct	png_read_pos_t {
+	const char *		current;
+	const char *		end;
+};
 
 void png_buffered_read_func(png_structp png_ptr, png_bytep data, png_size_t length)
 {
-   if((png_current_pos+length)>png_end_pos)
+   png_read_pos_t * pos = (png_read_pos_t *) png_get_io_ptr(png_ptr);
+   if((pos->current+length)>pos->end)
 		png_error(png_ptr,"PNG Read Error, overran end of buffer!");
-   memcpy(data,png_current_pos,length);
-   png_current_pos+=length;
+   memcpy(data,pos->current,length);
+   pos->current+=length;
 }
 
 // PNG is 0,0 = upper left so we vertically flip.  Lib gives us image in any component order we want.
@@ -1149,6 +1153,7 @@ int		CreateBitmapFromPNGData(const void * inStart, int inLength, struct ImageInf
 	png_infop		infoPtr = NULL;
 	outImageInfo->data = NULL;
 	char** 			rows = NULL;
+	png_read_pos_t	pos;
 
 	pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING,(png_voidp)NULL,my_error,my_warning);
 	if(!pngPtr) goto bail;
@@ -1156,11 +1161,10 @@ int		CreateBitmapFromPNGData(const void * inStart, int inLength, struct ImageInf
 	infoPtr=png_create_info_struct(pngPtr);
 	if(!infoPtr) goto bail;
 
-	png_start_pos = (const char *) inStart;
-	png_current_pos = (const char *) inStart;
-	png_end_pos = (const char *) inStart + inLength;
+	pos.current = (const char *) inStart;
+	pos.end = (const char *) inStart + inLength;
 
-	if (png_sig_cmp((unsigned char *) png_current_pos,0,8)) goto bail;
+	if (png_sig_cmp((unsigned char *) pos.current,0,8)) goto bail;
 
 	png_set_interlace_handling(pngPtr);
 
@@ -1170,8 +1174,8 @@ int		CreateBitmapFromPNGData(const void * inStart, int inLength, struct ImageInf
 	}
 
 	png_init_io      (pngPtr,NULL						);
-	png_set_read_fn  (pngPtr,NULL,png_buffered_read_func);
-	png_set_sig_bytes(pngPtr,8							);	png_current_pos+=8;
+	png_set_read_fn  (pngPtr,&pos,png_buffered_read_func);
+	png_set_sig_bytes(pngPtr,8							);	pos.current+=8;
 	png_read_info	 (pngPtr,infoPtr					);
 
 	png_get_IHDR(pngPtr,infoPtr,&width,&height,
@@ -1393,6 +1397,255 @@ bail:
 	return -1;
 }
 
+// The file is decoded one "chunk" at a time - a strip, or a row of tiles - and we keep the last chunk around since a band
+// of rows rarely starts and ends on a chunk boundary.  The chunk is kept in libtiff's RGBA format, top row first.
+//
+// Untiled TIFFs are often written as ONE strip for the whole image, and libtiff's RGBA strip reader would decode all of
+// it at once.  So past TIFF_MAX_CHUNK_BYTES we read one scanline at a time and do the RGBA conversion ourselves.  We only
+// know how to do that for plain 8-bit gray, palette and RGB(A) - anything else still goes through the strip reader.
+#define	TIFF_MAX_CHUNK_BYTES	(16 * 1024 * 1024)
+
+struct	TIFFRowReader {
+	TIFF *				tif;
+	uint32				width;
+	uint32				height;
+	uint32				chunk_rows;			// Rows per strip or tile - 1 when reading scanlines.
+	uint32				tile_width;			// 0 for strips
+	uint32				chunk_top;			// First row in the chunk, or height if nothing is loaded yet.
+	uint32				chunk_count;		// Rows actually in it - the last one can be short.
+	vector<uint32>		chunk;
+	vector<uint32>		scratch;
+
+	bool				scanline;			// Set if we convert scanlines ourselves - then the rest is filled in:
+	uint16				photometric;
+	uint16				samples;			// Samples per pixel, including any extra ones.
+	int					alpha;				// Sample index of alpha, or -1 for none...
+	bool				premultiply;		// ...and whether it needs premultiplying, like libtiff does for unassociated alpha.
+	unsigned char		cmap[256][3];		// Palette, scaled to 8 bits.
+};
+
+// Pack the way TIFFReadRGBAxxx does, so ReadTIFFRows can't tell which path the row came from.
+inline uint32	tiff_pack_rgba(uint32 r, uint32 g, uint32 b, uint32 a)
+{
+	return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+// Can we convert this file's scanlines ourselves?  Fills in the scanline fields if so.
+static bool	setup_tiff_scanlines(TIFFRowReader * r)
+{
+	uint16 bps, planar, extra_count, * extra_types;
+	TIFFGetFieldDefaulted(r->tif, TIFFTAG_BITSPERSAMPLE, &bps);
+	TIFFGetFieldDefaulted(r->tif, TIFFTAG_PLANARCONFIG, &planar);
+	TIFFGetFieldDefaulted(r->tif, TIFFTAG_SAMPLESPERPIXEL, &r->samples);
+	if(!TIFFGetField(r->tif, TIFFTAG_PHOTOMETRIC, &r->photometric))
+		return false;
+	if(bps != 8 || planar != PLANARCONFIG_CONTIG)
+		return false;
+
+	int color_samples;
+	switch(r->photometric) {
+	case PHOTOMETRIC_MINISWHITE:
+	case PHOTOMETRIC_MINISBLACK:
+		color_samples = 1;
+		break;
+	case PHOTOMETRIC_PALETTE:
+		{
+			uint16 * red, * green, * blue;
+			if(!TIFFGetField(r->tif, TIFFTAG_COLORMAP, &red, &green, &blue))
+				return false;
+			// Like libtiff, take a map with no entry over 255 to be an old-style 8-bit map.
+			int shift = 0;
+			for(int i = 0; i < 256; ++i)
+			if(red[i] >= 256 || green[i] >= 256 || blue[i] >= 256)
+				shift = 8;
+			for(int i = 0; i < 256; ++i)
+			{
+				r->cmap[i][0] = red[i] >> shift;
+				r->cmap[i][1] = green[i] >> shift;
+				r->cmap[i][2] = blue[i] >> shift;
+			}
+			color_samples = 1;
+		}
+		break;
+	case PHOTOMETRIC_RGB:
+		color_samples = 3;
+		break;
+	default:
+		return false;
+	}
+	if(r->samples < color_samples)
+		return false;
+
+	r->alpha = -1;
+	r->premultiply = false;
+	if(r->samples > color_samples && TIFFGetFieldDefaulted(r->tif, TIFFTAG_EXTRASAMPLES, &extra_count, &extra_types) && extra_count > 0)
+	if(extra_types[0] == EXTRASAMPLE_ASSOCALPHA || extra_types[0] == EXTRASAMPLE_UNASSALPHA)
+	{
+		r->alpha = color_samples;
+		r->premultiply = (extra_types[0] == EXTRASAMPLE_UNASSALPHA);
+	}
+
+	tsize_t line_size = TIFFScanlineSize(r->tif);
+	if(line_size < (tsize_t) r->width * r->samples)
+		return false;
+	r->scratch.resize((line_size + sizeof(uint32) - 1) / sizeof(uint32));
+	r->scanline = true;
+	return true;
+}
+
+static bool	load_tiff_scanline(TIFFRowReader * r, uint32 row)
+{
+	if(TIFFReadScanline(r->tif, &*r->scratch.begin(), row, 0) < 0)
+		return false;
+	r->chunk.resize(r->width);
+
+	const unsigned char * s = (const unsigned char *) &*r->scratch.begin();
+	for(uint32 x = 0; x < r->width; ++x, s += r->samples)
+	{
+		uint32 red, green, blue;
+		uint32 a = (r->alpha == -1) ? 255 : s[r->alpha];
+		switch(r->photometric) {
+		case PHOTOMETRIC_MINISWHITE:	red = green = blue = 255 - s[0];	break;
+		case PHOTOMETRIC_MINISBLACK:	red = green = blue = s[0];			break;
+		case PHOTOMETRIC_PALETTE:		red = r->cmap[s[0]][0]; green = r->cmap[s[0]][1]; blue = r->cmap[s[0]][2];	break;
+		default:						red = s[0]; green = s[1]; blue = s[2];	break;
+		}
+		if(r->premultiply)
+		{
+			red = (red * a + 127) / 255;
+			green = (green * a + 127) / 255;
+			blue = (blue * a + 127) / 255;
+		}
+		r->chunk[x] = tiff_pack_rgba(red, green, blue, a);
+	}
+	r->chunk_top = row;
+	r->chunk_count = 1;
+	return true;
+}
+
+static bool	load_tiff_chunk(TIFFRowReader * r, uint32 row)
+{
+	if(r->scanline)
+		return load_tiff_scanline(r, row);
+
+	uint32 top = row - row % r->chunk_rows;
+	uint32 count = min(r->chunk_rows, r->height - top);
+	r->chunk.resize(r->width * count);
+
+	if(r->tile_width == 0)
+	{
+		// A strip comes back lower-left origin, only as many rows as it has.
+		r->scratch.resize(r->width * r->chunk_rows);
+		if(!TIFFReadRGBAStrip(r->tif, top, &*r->scratch.begin()))
+			return false;
+		for(uint32 y = 0; y < count; ++y)
+			memcpy(&r->chunk[y * r->width], &r->scratch[(count - y - 1) * r->width], r->width * sizeof(uint32));
+	}
+	else
+	{
+		// A tile always comes back full size, lower-left origin, with its top row at the top even if it is short.
+		r->scratch.resize(r->tile_width * r->chunk_rows);
+		for(uint32 x = 0; x < r->width; x += r->tile_width)
+		{
+			if(!TIFFReadRGBATile(r->tif, x, top, &*r->scratch.begin()))
+				return false;
+			uint32 span = min(r->tile_width, r->width - x);
+			for(uint32 y = 0; y < count; ++y)
+				memcpy(&r->chunk[y * r->width + x], &r->scratch[(r->chunk_rows - y - 1) * r->tile_width], span * sizeof(uint32));
+		}
+	}
+	r->chunk_top = top;
+	r->chunk_count = count;
+	return true;
+}
+
+TIFFRowReader *	OpenTIFFRows(const char * inFilePath, long * outWidth, long * outHeight)
+{
+	TIFFSetWarningHandler(IgnoreTiffWarnings);
+	TIFFSetErrorHandler(IgnoreTiffWarnings);
+#if SUPPORT_UNICODE
+    TIFF* tif = TIFFOpenW(convert_str_to_utf16(inFilePath).c_str(), "r");
+#else
+	FILE_case_correct_path path(inFilePath);
+    TIFF* tif = TIFFOpen(path, "r");
+#endif
+	if (tif == NULL) return NULL;
+
+	TIFFRowReader * r = new TIFFRowReader;
+	r->tif = tif;
+	r->width = r->height = r->tile_width = 0;
+	r->scanline = false;
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &r->width);
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &r->height);
+	if(TIFFIsTiled(tif))
+	{
+		TIFFGetField(tif, TIFFTAG_TILEWIDTH, &r->tile_width);
+		TIFFGetField(tif, TIFFTAG_TILELENGTH, &r->chunk_rows);
+	}
+	else
+	{
+		// Rows per strip defaults to "all of them", which may be a lot more than the image has.
+		TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &r->chunk_rows);
+		r->chunk_rows = min(r->chunk_rows, r->height);
+		if((double) r->chunk_rows * r->width * sizeof(uint32) > TIFF_MAX_CHUNK_BYTES && setup_tiff_scanlines(r))
+			r->chunk_rows = 1;
+	}
+	r->chunk_rows = max(r->chunk_rows, (uint32) 1);
+	r->chunk_top = r->height;
+	r->chunk_count = 0;
+
+	*outWidth = r->width;
+	*outHeight = r->height;
+	return r;
+}
+
+// Same byte order games as CreateBitmapFromTIF - and we flip, since a band is lower-left origin too.
+int		ReadTIFFRows(TIFFRowReader * r, long inTop, long inCount, struct ImageInfo * outImageInfo)
+{
+	if(inTop < 0 || inCount <= 0 || inTop + inCount > (long) r->height)
+		return -1;
+	if(CreateNewBitmap(r->width, inCount, 4, outImageInfo) != 0)
+		return -1;
+
+	for(long y = 0; y < inCount; ++y)
+	{
+		uint32 row = inTop + y;
+		if((row < r->chunk_top || row >= r->chunk_top + r->chunk_count) && !load_tiff_chunk(r, row))
+		{
+			DestroyBitmap(outImageInfo);
+			return -1;
+		}
+
+		unsigned char * s = (unsigned char *) &r->chunk[(row - r->chunk_top) * r->width];
+		unsigned char * d = outImageInfo->data + (inCount - y - 1) * (outImageInfo->width * 4 + outImageInfo->pad);
+		for(uint32 x = 0; x < r->width; ++x)
+		{
+#if BIG
+			d[0] = s[1];	// B
+			d[1] = s[2];	// G
+			d[2] = s[3];	// R
+			d[3] = s[0];	// A
+#elif LIL
+			d[0] = s[2];	// B
+			d[1] = s[1];	// G
+			d[2] = s[0];	// R
+			d[3] = s[3];	// A
+#else
+	#error PLATFORM NOT DEFINED
+#endif
+			s += 4;
+			d += 4;
+		}
+	}
+	return 0;
+}
+
+void	CloseTIFFRows(TIFFRowReader * r)
+{
+	TIFFClose(r->tif);
+	delete r;
+}
+
 #endif
 
 #if USE_GEOJPEG2K
@@ -1498,81 +1751,118 @@ int CreateBitmapFromJP2K(const char * inFilePath, struct ImageInfo * outImageInf
 }
 #endif
 
-static void	in_place_scaleXY(int x, int y, unsigned char * src, unsigned char * dst, int channels)
-{
-	int rb = x * channels;
-	unsigned char *	s1 = src;
-	unsigned char *	s2 = src + rb;
-	unsigned char * d1 = dst;
+/*
+	FAST MIP REDUCERS
 
-	x /= 2;
-	y /= 2;
+	MakeMipmapStackFast builds each level from the one above with a 2x2 reducer that is compiled for the channel
+	count, rather than calling a filter function for every byte.  A source dimension of 1 is handled by reading its one
+	row or column twice, so 2:1 levels at the tail of a non-square stack come out as (a+b)/2.
 
-	int t1,t2,t3,t4;
-	while(y--)
-	{
-		int ctr=x;
-		while(ctr--)
-		{
-			t1=t2=t3=t4=0;
-			t1 += *s1++;	if(channels>1)t2 += *s1++;		if(channels>2)t3 += *s1++;		if(channels>3)t4 += *s1++;
-			t1 += *s1++;	if(channels>1)t2 += *s1++;		if(channels>2)t3 += *s1++;		if(channels>3)t4 += *s1++;
-			t1 += *s2++;	if(channels>1)t2 += *s2++;		if(channels>2)t3 += *s2++;		if(channels>3)t4 += *s2++;
-			t1 += *s2++;	if(channels>1)t2 += *s2++;		if(channels>2)t3 += *s2++;		if(channels>3)t4 += *s2++;
-			t1 >>= 2;		if(channels>1)t2 >>= 2;			if(channels>2)t3 >>= 2;			if(channels>3)t4 >>= 2;
-			*d1++ = t1;		if(channels>1)*d1++ = t2;		if(channels>2)*d1++ = t3;		if(channels>3)*d1++ = t4;
+	The box reducer truncates, like the in-place scalers MakeMipmapStack used to have, so it gives the same bytes it
+	always has.
+	The sRGB reducer averages colour in linear light and alpha as-is - the same math as DDSTool's srgb_filter, but in
+	16-bit fixed point via tables, so the odd pixel can come out one step off from the float version.
 
-		}
-		s1 += rb;
-		s2 += rb;
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define MIP_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+static unsigned short	s_srgb_to_linear[256];		// 8-bit sRGB -> 16-bit linear
+static unsigned char	s_linear_to_srgb[65536];	// 16-bit linear -> 8-bit sRGB, rounded
+static bool				s_srgb_tables_built = false;
+static TU_Mutex			s_srgb_tables_lock;
+
+static void	build_srgb_tables(void)
+{
+	StMutexLock	hold(s_srgb_tables_lock);
+	if(s_srgb_tables_built)
+		return;
+	for(int i = 0; i < 256; ++i)
+	{
+		float p = (float) i / 255.0f;
+		p = (p <= 0.04045f) ? p / 12.92f : powf(p * (1.0/1.055f) + (0.055f/1.055f),2.4f);
+		s_srgb_to_linear[i] = (unsigned short) (p * 65535.0f + 0.5f);
+	}
+	for(int i = 0; i < 65536; ++i)
+	{
+		float p = (float) i / 65535.0f;
+		p = (p <= 0.0031308f) ? 12.92f * p : 1.055f * powf(p,0.41666f) - 0.055f;
+		p *= 255.0f;
+		s_linear_to_srgb[i] = p <= 0.0f ? 0 : (p >= 255.0f ? 255 : (unsigned char) (p + 0.5f));
 	}
+	s_srgb_tables_built = true;
 }
 
-static void	in_place_scaleX(int x, int y, unsigned char * src, unsigned char * dst, int channels)
+#if MIP_SSE2
+// 8 RGBA pixels from each of two rows -> 4 RGBA pixels, truncating like the scalar loop.
+static inline void	box_reduce_rgba_sse2(const unsigned char * s1, const unsigned char * s2, unsigned char * d)
 {
-	unsigned char *	s1 = src;
-	unsigned char * d1 = dst;
+	__m128i	z = _mm_setzero_si128();
+	__m128i	a0 = _mm_loadu_si128((const __m128i *) s1);
+	__m128i	a1 = _mm_loadu_si128((const __m128i *) (s1 + 16));
+	__m128i	b0 = _mm_loadu_si128((const __m128i *) s2);
+	__m128i	b1 = _mm_loadu_si128((const __m128i *) (s2 + 16));
+
+	// Vertical sums in 16 bits, two pixels per register...
+	__m128i	v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, z), _mm_unpacklo_epi8(b0, z));
+	__m128i	v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, z), _mm_unpackhi_epi8(b0, z));
+	__m128i	v2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, z), _mm_unpacklo_epi8(b1, z));
+	__m128i	v3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, z), _mm_unpackhi_epi8(b1, z));
+
+	// ...then add each even pixel to its odd neighbor.
+	__m128i	h0 = _mm_add_epi16(_mm_unpacklo_epi64(v0, v1), _mm_unpackhi_epi64(v0, v1));
+	__m128i	h1 = _mm_add_epi16(_mm_unpacklo_epi64(v2, v3), _mm_unpackhi_epi64(v2, v3));
+
+	_mm_storeu_si128((__m128i *) d, _mm_packus_epi16(_mm_srli_epi16(h0, 2), _mm_srli_epi16(h1, 2)));
+}
+#endif
 
-	x /= 2;
+template <int C>
+static void	box_reduce(const unsigned char * src, int sw, int sh, unsigned char * dst)
+{
+	int dw = sw > 1 ? sw / 2 : 1;
+	int dh = sh > 1 ? sh / 2 : 1;
+	int rb = sw * C;
+	int dx = sw > 1 ? C : 0;
 
-	int t1,t2,t3,t4;
-	int ctr = x * y;
-	while(ctr--)
+	for(int y = 0; y < dh; ++y)
 	{
-		t1=t2=t3=t4=0;
-		t1 += *s1++;		if(channels>1)t2 += *s1++;		if(channels>2)t3 += *s1++;		if(channels>3)t4 += *s1++;
-		t1 += *s1++;		if(channels>1)t2 += *s1++;		if(channels>2)t3 += *s1++;		if(channels>3)t4 += *s1++;
-		t1 >>= 1;			if(channels>1)t2 >>= 1;			if(channels>2)t3 >>= 1;			if(channels>3)t4 >>= 1;
-		*d1++ = t1;			if(channels>1)*d1++ = t2;		if(channels>2)*d1++ = t3;		if(channels>3)*d1++ = t4;
+		const unsigned char * s1 = src + 2 * y * rb;
+		const unsigned char * s2 = sh > 1 ? s1 + rb : s1;
+		int x = 0;
+#if MIP_SSE2
+		if(C == 4 && dx)
+		for(; x + 4 <= dw; x += 4, s1 += 32, s2 += 32, dst += 16)
+			box_reduce_rgba_sse2(s1, s2, dst);
+#endif
+		for(; x < dw; ++x, s1 += 2 * C, s2 += 2 * C, dst += C)
+		for(int c = 0; c < C; ++c)
+			dst[c] = (s1[c] + s1[c + dx] + s2[c] + s2[c + dx]) >> 2;
 	}
 }
 
-
-static void	in_place_scaleY(int x, int y, unsigned char * src, unsigned char * dst, int channels)
+template <int C>
+static void	srgb_reduce(const unsigned char * src, int sw, int sh, unsigned char * dst)
 {
-	int rb = x * channels;
-	unsigned char *	s1 = src;
-	unsigned char *	s2 = src + rb;
-	unsigned char * d1 = dst;
-
-	x /= 2;
-	y /= 2;
+	int dw = sw > 1 ? sw / 2 : 1;
+	int dh = sh > 1 ? sh / 2 : 1;
+	int rb = sw * C;
+	int dx = sw > 1 ? C : 0;
 
-	int t1,t2,t3,t4;
-	while(y--)
+	for(int y = 0; y < dh; ++y)
 	{
-		int ctr=x;
-		while(ctr--)
-		{
-			t1=t2=t3=t4=0;
-			t1 += *s1++;		if(channels>1)t2 += *s1++;		if(channels>2)t3 += *s1++;		if(channels>3)t4 += *s1++;
-			t1 += *s2++;		if(channels>1)t2 += *s2++;		if(channels>2)t3 += *s2++;		if(channels>3)t4 += *s2++;
-			t1 >>= 1;			if(channels>1)t2 >>= 1;			if(channels>2)t3 >>= 1;			if(channels>3)t4 >>= 1;
-			*d1++ = t1;			if(channels>1)*d1++ = t2;		if(channels>2)*d1++ = t3;		if(channels>3)*d1++ = t4;
-
-		}
-		s1 += rb;
-		s2 += rb;
+		const unsigned char * s1 = src + 2 * y * rb;
+		const unsigned char * s2 = sh > 1 ? s1 + rb : s1;
+		for(int x = 0; x < dw; ++x, s1 += 2 * C, s2 += 2 * C, dst += C)
+		for(int c = 0; c < C; ++c)
+		if(c == 3)	// alpha is not corrected
+			dst[c] = (s1[c] + s1[c + dx] + s2[c] + s2[c + dx]) >> 2;
+		else
+			dst[c] = s_linear_to_srgb[(s_srgb_to_linear[s1[c]] + s_srgb_to_linear[s1[c + dx]] +
+									   s_srgb_to_linear[s2[c]] + s_srgb_to_linear[s2[c + dx]] + 2) >> 2];
 	}
 }
 
@@ -1615,42 +1905,62 @@ static void copy_mip_with_filter(const ImageInfo& src, ImageInfo& dst,int level,
 	#error BIG or LIL are not defined - what endian are we?
 #endif
 
-// This routine swaps Y and BGRA on desktop, but only BGRA on phone.
-static void swap_bgra_y(struct ImageInfo& i)
-{
-	int num_swaps = (i.height+1) / 2;	// add 1 - if we have 9 lines, do 5 swaps, line 4 swaps on itself safely.
-	for(int y=0;y<num_swaps         ;++y)
-	for(int x=0;x<i.width    ; ++x)
-	{
-		unsigned char * srcp = i.data + x * i.channels + (i.height - y - 1) * (i.channels * i.width + i.pad);
-		unsigned char * dstp = i.data + x * i.channels +				   y	  * (i.channels * i.width + i.pad);
+// DXT compresses each 4x4 block on its own, so we can cut a mip level into bands a multiple of 4 pixels tall and let
+// every core squish its own band straight into its slot in the output - the result is byte-for-byte what one big
+// CompressImage call would make.
+#define DXT_BAND_ROWS 64
 
-		swap(dstp[2], dstp[0]);
-		if(srcp != dstp)				// check for self-swap, don't undo, also don't waste time.
-		{
-			swap(srcp[0], srcp[2]);		// This swaps BGRA to RGBA
+struct	dxt_band_job_t {
+	const ImageInfo *	img;
+	int					flags;
+	int					block_size;		// 8 bytes per 4x4 block for DXT1, 16 for DXT3/5.
+	unsigned char *		dst;
+};
 
-// On mobile devices, we pre-encode DXT with 0,0 = lower left so the phone doesn't have to flip the DDS before feeding it into OpenGL.
-// This will look upside down on all viewers.
-#if !PHONE
-			for(int c = 0; c < i.channels; ++c)	// This flips the image.
-				swap(srcp[c], dstp[c]);
+static void dxt_compress_band(int band, void * ref)
+{
+	const dxt_band_job_t * job = (const dxt_band_job_t *) ref;
+	const ImageInfo& img(*job->img);
+	int w = img.width;
+	int h = img.height;
+	int y0 = band * DXT_BAND_ROWS;
+	int rows = min(DXT_BAND_ROWS, h - y0);
+	int rb = w * img.channels + img.pad;
+
+	// Get the band into RGBA upper left origin, that's what Squish/DXT/DDS wants - we do it on the way in rather than
+	// swapping the whole image in place.  On mobile devices, we pre-encode DXT with 0,0 = lower left so the phone
+	// doesn't have to flip the DDS before feeding it into OpenGL.  This will look upside down on all viewers.
+	vector<unsigned char>	rgba(w * rows * 4);
+	unsigned char * d = &*rgba.begin();
+	for(int y = y0; y < y0 + rows; ++y)
+	{
+#if PHONE
+		const unsigned char * s = img.data + y * rb;
+#else
+		const unsigned char * s = img.data + (h - y - 1) * rb;
 #endif
+		for(int x = 0; x < w; ++x, s += 4, d += 4)
+		{
+			d[0] = s[2];
+			d[1] = s[1];
+			d[2] = s[0];
+			d[3] = s[3];
 		}
 	}
 
+	squish::CompressImage(&*rgba.begin(), w, rows, job->dst + (y0 / 4) * ((w + 3) / 4) * job->block_size, job->flags);
 }
 
-// Compressed DDS.
-int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name, int use_win_gamma)
+// Compressed DDS, built in memory.
+int	CompressBitmapToDDS(struct ImageInfo& ioImage, int dxt, int use_win_gamma, vector<unsigned char>& out_dds, int quality, int max_threads)
 {
 	Assert(ioImage.channels == 4);//Your number of channels better equal 4 or else
-	FILE * fi = fopen(file_name,"wb");
-	if (fi == NULL) return -1;
-	vector<unsigned char>	src_v, dst_v;
 	int flags = (dxt == 1 ? squish::kDxt1 : (dxt == 3 ? squish::kDxt3 : squish::kDxt5));
-	dst_v.resize(squish::GetStorageRequirements(ioImage.width,ioImage.height,flags));
-	unsigned char * dst_mem = &*dst_v.begin();
+	switch(quality) {
+	case dxt_quality_fast:		flags |= squish::kColourRangeFit;				break;
+	case dxt_quality_normal:	flags |= squish::kColourClusterFit;				break;
+	default:					flags |= squish::kColourIterativeClusterFit;	break;
+	}
 
 	int x = ioImage.width;
 	int y = ioImage.height;
@@ -1662,11 +1972,17 @@ int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name,
 		++mips;
 	}
 
+	// Size the whole file up front so every band of every level goes straight to its final place.
 	struct ImageInfo img(ioImage);
+	size_t total = sizeof(TEX_dds_desc);
+	do {
+		total += squish::GetStorageRequirements(img.width,img.height,flags);
+	} while(AdvanceMipmapStack(&img));
+	out_dds.resize(total);
 
+	img = ioImage;
 	int len = squish::GetStorageRequirements(img.width,img.height,flags);
 
-
 	TEX_dds_desc header = { 0 };
 	header.dwMagic[0] = 'D';
 	header.dwMagic[1] = 'D';
@@ -1690,28 +2006,36 @@ int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name,
 	else
 		header.ddsCaps.dwCaps=SWAP32(DDSCAPS_TEXTURE|DDSCAPS_MIPMAP|DDSCAPS_COMPLEX);
 
-	fwrite(&header,sizeof(header),1,fi);
+	memcpy(&*out_dds.begin(), &header, sizeof(header));
+
+	dxt_band_job_t	job;
+	job.img = &img;
+	job.flags = flags;
+	job.block_size = (dxt == 1 ? 8 : 16);
+	job.dst = &*out_dds.begin() + sizeof(header);
 
 	do {
 
-		// Get the image into RGBA upper left origin, that's what Squish/DXT/DDS wants.
-		swap_bgra_y(img);
+		TU_ParallelFor((img.height + DXT_BAND_ROWS - 1) / DXT_BAND_ROWS, dxt_compress_band, &job, max_threads);
+		job.dst += squish::GetStorageRequirements(img.width,img.height,flags);
 
-		squish::CompressImage(img.data, img.width, img.height, dst_mem, flags|squish::kColourIterativeClusterFit);
-		len = squish::GetStorageRequirements(img.width,img.height,flags);
-		fwrite(dst_mem,len,1,fi);
+	} while (AdvanceMipmapStack(&img));
 
-		// Put it back before we advance...really necessary??!
-		swap_bgra_y(img);
+	return 0;
+}
 
-		if(!AdvanceMipmapStack(&img))
-			break;
+// Compressed DDS.
+int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name, int use_win_gamma, int quality)
+{
+	FILE * fi = fopen(file_name,"wb");
+	if (fi == NULL) return -1;
 
-	} while (1);
+	vector<unsigned char>	dds;
+	CompressBitmapToDDS(ioImage, dxt, use_win_gamma, dds, quality);
+	fwrite(&*dds.begin(),dds.size(),1,fi);
 
 	fclose(fi);
 	return 0;
-	// close file
 }
 
 // Uncomp: write BGR or BGRA, origin depends on phone or desktop - see below.
@@ -1909,47 +2233,7 @@ void	FlipImageY(struct ImageInfo&	io_image)
 
 int MakeMipmapStack(struct ImageInfo * ioImage)
 {
-	int storage = 0;
-	int mips = 0;
-	int x = ioImage->width;
-	int y = ioImage->height;
-	do {
-		storage += (x * y * ioImage->channels);
-		++mips;
-		if(x == 1 && y == 1) break;
-		if (x > 1) x >>= 1;
-		if (y > 1) y >>= 1;
-	} while (1);
-
-	unsigned char * base = (unsigned char *) malloc(storage);
-
-	ImageInfo ni;
-	ni.width = ioImage->width;
-	ni.height = ioImage->height;
-	ni.pad = 0;
-	ni.channels = ioImage->channels;
-	ni.data = base;
-
-	CopyBitmapSectionDirect(*ioImage, ni, 0, 0, 0, 0, ni.width, ni.height);
-
-	while(ni.width > 1 || ni.height > 1)
-	{
-		unsigned char * old_ptr = ni.data;
-		ni.data += (ni.channels * ni.width * ni.height);
-
-		if(ni.width > 1) {
-			if (ni.height > 1)		in_place_scaleXY(ni.width,ni.height,old_ptr,ni.data,ni.channels);
-			else					in_place_scaleX (ni.width,ni.height,old_ptr,ni.data,ni.channels);
-		} else if (ni.height > 1)	in_place_scaleY (ni.width,ni.height,old_ptr,ni.data,ni.channels);
-
-		if(ni.width > 1) ni.width >>= 1;
-		if(ni.height > 1) ni.height >>= 1;
-	}
-
-	free(ioImage->data);
-	ioImage->data = base;
-
-	return mips;
+	return MakeMipmapStackFast(ioImage, mip_filter_box);
 }
 
 int MakeMipmapStackFromImage(struct ImageInfo * ioImage)
@@ -2041,6 +2325,71 @@ int MakeMipmapStackWithFilter(struct ImageInfo * ioImage, unsigned char (* filte
 	return mips;
 }
 
+int MakeMipmapStackFast(struct ImageInfo * ioImage, int filter)
+{
+	int storage = 0;
+	int mips = 0;
+	int x = ioImage->width;
+	int y = ioImage->height;
+	do {
+		storage += (x * y * ioImage->channels);
+		++mips;
+		if(x == 1 && y == 1) break;
+		if (x > 1) x >>= 1;
+		if (y > 1) y >>= 1;
+	} while (1);
+
+	// An unpadded image is already laid out as the top of the stack - just grow it.
+	unsigned char * base;
+	if(ioImage->pad == 0)
+		base = (unsigned char *) realloc(ioImage->data, storage);
+	else
+	{
+		base = (unsigned char *) malloc(storage);
+		ImageInfo ni(*ioImage);
+		ni.pad = 0;
+		ni.data = base;
+		CopyBitmapSectionDirect(*ioImage, ni, 0, 0, 0, 0, ni.width, ni.height);
+		free(ioImage->data);
+	}
+	ioImage->data = base;
+	ioImage->pad = 0;
+
+	void (* reduce)(const unsigned char * src, int sw, int sh, unsigned char * dst) = NULL;
+	if(filter == mip_filter_srgb)
+	{
+		build_srgb_tables();
+		switch(ioImage->channels) {
+		case 1:	reduce = srgb_reduce<1>;	break;
+		case 2:	reduce = srgb_reduce<2>;	break;
+		case 3:	reduce = srgb_reduce<3>;	break;
+		case 4:	reduce = srgb_reduce<4>;	break;
+		}
+	}
+	else
+	{
+		switch(ioImage->channels) {
+		case 1:	reduce = box_reduce<1>;		break;
+		case 2:	reduce = box_reduce<2>;		break;
+		case 3:	reduce = box_reduce<3>;		break;
+		case 4:	reduce = box_reduce<4>;		break;
+		}
+	}
+	Assert(reduce);
+
+	ImageInfo ni(*ioImage);
+	while(ni.width > 1 || ni.height > 1)
+	{
+		unsigned char * next = ni.data + (ni.channels * ni.width * ni.height);
+		reduce(ni.data, ni.width, ni.height, next);
+		ni.data = next;
+		if(ni.width > 1) ni.width >>= 1;
+		if(ni.height > 1) ni.height >>= 1;
+	}
+
+	return mips;
+}
+
 int AdvanceMipmapStack(struct ImageInfo * ioImage)
 {
 	if(ioImage->width == 1 && ioImage->height == 1) return 0;
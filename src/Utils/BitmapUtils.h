@@ -92,6 +92,16 @@ int		CreateBitmapFromJPEGData(void * inBytes, int inLength, struct ImageInfo * o
 /* Create an image from a TIF file  requires libTIFF. */
 int		CreateBitmapFromTIF(const char * inFilePath, struct ImageInfo * outImageInfo);
 
+/* Read a TIF a band of rows at a time, for images too big to load in one piece.  OpenTIFFRows returns NULL if the
+ * file can't be opened.  ReadTIFFRows creates a 4-channel image of rows [inTop, inTop + inCount), counting from the
+ * top of the file, in the same format CreateBitmapFromTIF makes.  Bands are cheapest read top to bottom - each strip
+ * or row of tiles is decoded once as long as we don't go back up.  Huge strips (e.g. a whole image in one strip) of
+ * 8-bit gray, palette or RGB(A) data are read a scanline at a time, so memory follows the band, not the strip. */
+struct	TIFFRowReader;
+struct TIFFRowReader *	OpenTIFFRows(const char * inFilePath, long * outWidth, long * outHeight);
+int						ReadTIFFRows(struct TIFFRowReader * inReader, long inTop, long inCount, struct ImageInfo * outImageInfo);
+void					CloseTIFFRows(struct TIFFRowReader * inReader);
+
 #endif
 
 #if USE_GEOJPEG2K
@@ -113,11 +123,23 @@ int		WriteBitmapToFile(const struct ImageInfo * inImage, const char * inFilePath
 /* Given an imageInfo structure, this routine writes it to disk as a .png file.  Image is tagged with gamma, or 0.0f to leave untagged. */
 int		WriteBitmapToPNG(const struct ImageInfo * inImage, const char * inFilePath, char * inPalette, int inPaletteLen, float gamma);
 
+/* Speed vs. quality for the DXT encoder - these pick squish's colour fit. */
+enum {
+	dxt_quality_fast	= 0,	// Range fit - many times faster, fine for photos.
+	dxt_quality_normal	= 1,	// Cluster fit.
+	dxt_quality_best	= 2		// Iterative cluster fit - slowest, what we have always used.
+};
+
 /* This routine writes a 3 or 4 channel bitmap as a mip-mapped DXT1 or DXT3 image.
+ * Each mip level is compressed in bands across all cores.
  * NOTE: if you compile with PHONE then DDS are written upside down (lower left origin
  * instead of upper-left).  This is an optimization for the iphone, which can then
  * pass the data DIRECTLY to OpenGL. */
-int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name, int use_win_gamma);
+int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name, int use_win_gamma, int quality = dxt_quality_best);
+
+/* Same as WriteBitmapToDDS, but the whole DDS file is built in out_dds instead of written to disk.  max_threads
+ * caps how many cores compress each level - 0 for all of them. */
+int	CompressBitmapToDDS(struct ImageInfo& ioImage, int dxt, int use_win_gamma, vector<unsigned char>& out_dds, int quality = dxt_quality_best, int max_threads = 0);
 
 /* This routine writes a 3 or 4 channel bitmap as a mip-mapped DXT1 or DXT3 image. */
 int	WriteUncompressedToDDS(struct ImageInfo& ioImage, const char * file_name, int use_win_gamma);
@@ -217,6 +239,16 @@ int MakeMipmapStackFromImage(struct ImageInfo * ioImage);
 /* Make a mip-map stack with a custom filter. */
 int MakeMipmapStackWithFilter(struct ImageInfo * ioImage, unsigned char (* filter)(unsigned char src[], int count, int channel, int level));
 
+/* Built-in 2x2 reducers for MakeMipmapStackFast. */
+enum {
+	mip_filter_box = 0,		// Plain average - same output as MakeMipmapStack.
+	mip_filter_srgb = 1		// Colour averaged in linear light, alpha averaged as-is.
+};
+
+/* Make a mip-map stack with one of the built-in reducers - much faster than MakeMipmapStackWithFilter, which
+ * calls its filter for every byte.  An unpadded image is grown in place rather than copied. */
+int MakeMipmapStackFast(struct ImageInfo * ioImage, int filter);
+
 
 
 /* This routine "advances" the ptr and sizes in the image to go to the next
@@ -112,7 +112,7 @@ class	PerfTimer {
 
 public:
 
-	PerfTimer(const char * inName) :
+	PerfTimer(const char * inName = NULL) :
 		mName(inName), mTime(0), mCalls(0)
 	{
 	}
@@ -121,12 +121,19 @@ public:
 	{
 	}
 
-	void	GetStats(double& totalSeconds, unsigned long& calls)
+	void	GetStats(double& totalSeconds, unsigned long& calls) const
 	{
-		totalSeconds = mTime;
+		totalSeconds = mTime / 1000000.0;
 		calls = mCalls;
 	}
 
+	// Fold in another timer's time and calls - e.g. one kept per thread.
+	void	Add(const PerfTimer& rhs)
+	{
+		mTime += rhs.mTime;
+		mCalls += rhs.mCalls;
+	}
+
 	inline	void Start(void)
 	{
 		mStart = query_hpc();
@@ -142,6 +149,21 @@ public:
 
 };
 
+// Times one pass through a scope into a PerfTimer.  To time many sections by name, keep a map<string, PerfTimer>
+// and use StPerfTimer timer(timers["name"]).
+class	StPerfTimer {
+	PerfTimer&			mTimer;
+public:
+	StPerfTimer(PerfTimer& inTimer) : mTimer(inTimer)
+	{
+		mTimer.Start();
+	}
+	~StPerfTimer()
+	{
+		mTimer.Stop();
+	}
+};
+
 class	StElapsedTime {
 	unsigned long long 	mStartTime;
 	const char *		mName;
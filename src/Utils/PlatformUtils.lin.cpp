@@ -177,6 +177,11 @@ char *	GetMultiFilePathFromUser(
 
 void	DoUserAlert(const char * inMsg)
 {
+	if(qApp == NULL)		// Command line mode - no widgets.
+	{
+		fprintf(stderr,"%s\n",inMsg);
+		return;
+	}
 	QMessageBox::warning(0, "", QString::fromUtf8(inMsg));
 }
 
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "ThreadUtils.h"
+#include <string.h>
+
+#if APL || LIN
+	#include <unistd.h>
+#endif
+
+#if APL
+	#include <sys/types.h>
+	#include <sys/sysctl.h>
+#endif
+
+/************************************************************************************************
+ * MUTEX
+ ************************************************************************************************/
+
+#if APL || LIN
+
+TU_Mutex::TU_Mutex()			{ pthread_mutex_init(&mMutex, NULL);	}
+TU_Mutex::~TU_Mutex()			{ pthread_mutex_destroy(&mMutex);		}
+void	TU_Mutex::Lock(void)	{ pthread_mutex_lock(&mMutex);			}
+void	TU_Mutex::Unlock(void)	{ pthread_mutex_unlock(&mMutex);		}
+
+#elif IBM
+
+TU_Mutex::TU_Mutex()			{ InitializeCriticalSection(&mMutex);	}
+TU_Mutex::~TU_Mutex()			{ DeleteCriticalSection(&mMutex);		}
+void	TU_Mutex::Lock(void)	{ EnterCriticalSection(&mMutex);		}
+void	TU_Mutex::Unlock(void)	{ LeaveCriticalSection(&mMutex);		}
+
+#endif
+
+/************************************************************************************************
+ * CPU COUNT
+ ************************************************************************************************/
+
+int		TU_GetCPUCount(void)
+{
+	int n = 1;
+#if LIN
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#elif APL
+	size_t	len = sizeof(n);
+	if (sysctlbyname("hw.activecpu", &n, &len, NULL, 0) != 0)
+		n = 1;
+#elif IBM
+	SYSTEM_INFO	info;
+	GetSystemInfo(&info);
+	n = info.dwNumberOfProcessors;
+#endif
+	return n < 1 ? 1 : n;
+}
+
+/************************************************************************************************
+ * MAIN THREAD
+ ************************************************************************************************/
+
+#if APL || LIN
+static pthread_t	sMainThread = pthread_self();
+bool	TU_IsMainThread(void)	{ return pthread_equal(pthread_self(), sMainThread) != 0; }
+#elif IBM
+static DWORD		sMainThread = GetCurrentThreadId();
+bool	TU_IsMainThread(void)	{ return GetCurrentThreadId() == sMainThread; }
+#endif
+
+/************************************************************************************************
+ * PARALLEL FOR
+ ************************************************************************************************/
+
+struct	TU_ParallelForInfo_t {
+	TU_Mutex		lock;
+	int				next;
+	int				count;
+	void (*			func)(int, void *);
+	void *			ref;
+	int				failed;			// A helper threw - one of the fail_ enums below.
+	char			what[256];		// ...and what it said.
+};
+
+enum {
+	fail_none = 0,
+	fail_bad_alloc,
+	fail_exception
+};
+
+static void	TU_ParallelForWorker(TU_ParallelForInfo_t * info)
+{
+	while (1)
+	{
+		int	idx;
+		{
+			StMutexLock	hold(info->lock);
+			idx = info->next++;
+		}
+		if (idx >= info->count)
+			break;
+		info->func(idx, info->ref);
+	}
+}
+
+// Once anyone has thrown, nobody picks up any more work - we are going to throw anyway.
+static void	TU_ParallelForStop(TU_ParallelForInfo_t * info)
+{
+	StMutexLock	hold(info->lock);
+	info->next = info->count;
+}
+
+static void	TU_ParallelForFail(TU_ParallelForInfo_t * info, int how, const char * what)
+{
+	StMutexLock	hold(info->lock);
+	info->next = info->count;
+	if (info->failed == fail_none)
+	{
+		info->failed = how;
+		strncpy(info->what, what, sizeof(info->what));
+		info->what[sizeof(info->what)-1] = 0;
+	}
+}
+
+// A helper thread can't let an exception out (that's std::terminate) and C++98 can't hand the exception object itself
+// to another thread, so we keep what it said and the calling thread throws a TU_WorkerException once everyone is done.
+static void	TU_ParallelForHelper(TU_ParallelForInfo_t * info)
+{
+	try {
+		TU_ParallelForWorker(info);
+	} catch (bad_alloc&) {
+		TU_ParallelForFail(info, fail_bad_alloc, "out of memory");
+	} catch (exception& e) {
+		TU_ParallelForFail(info, fail_exception, e.what());
+	} catch (...) {
+		TU_ParallelForFail(info, fail_exception, "unknown exception");
+	}
+}
+
+#if APL || LIN
+static void *	TU_ParallelForThread(void * ref)
+{
+	TU_ParallelForHelper((TU_ParallelForInfo_t *) ref);
+	return NULL;
+}
+
+typedef	pthread_t	TU_Thread_t;
+
+static bool	TU_StartThread(TU_Thread_t& thread, TU_ParallelForInfo_t * info)
+{
+	return pthread_create(&thread, NULL, TU_ParallelForThread, info) == 0;
+}
+
+static void	TU_JoinThreads(vector<TU_Thread_t>& threads)
+{
+	for (int t = 0; t < threads.size(); ++t)
+		pthread_join(threads[t], NULL);
+	threads.clear();
+}
+#elif IBM
+static DWORD WINAPI	TU_ParallelForThread(LPVOID ref)
+{
+	TU_ParallelForHelper((TU_ParallelForInfo_t *) ref);
+	return 0;
+}
+
+typedef	HANDLE		TU_Thread_t;
+
+static bool	TU_StartThread(TU_Thread_t& thread, TU_ParallelForInfo_t * info)
+{
+	thread = CreateThread(NULL, 0, TU_ParallelForThread, info, 0, NULL);
+	return thread != NULL;
+}
+
+static void	TU_JoinThreads(vector<TU_Thread_t>& threads)
+{
+	for (int t = 0; t < threads.size(); ++t)
+	{
+		WaitForSingleObject(threads[t], INFINITE);
+		CloseHandle(threads[t]);
+	}
+	threads.clear();
+}
+#endif
+
+void	TU_ParallelFor(
+			int				inCount,
+			void (*			inFunc)(int inIndex, void * inRef),
+			void *			inRef,
+			int				inMaxThreads)
+{
+	if (inCount <= 0)
+		return;
+
+	int	thread_count = inMaxThreads > 0 ? inMaxThreads : TU_GetCPUCount();
+	if (thread_count > inCount)
+		thread_count = inCount;
+
+	if (thread_count <= 1)
+	{
+		for (int n = 0; n < inCount; ++n)
+			inFunc(n, inRef);
+		return;
+	}
+
+	TU_ParallelForInfo_t	info;
+	info.next = 0;
+	info.count = inCount;
+	info.func = inFunc;
+	info.ref = inRef;
+	info.failed = fail_none;
+	info.what[0] = 0;
+
+	// The calling thread is worker zero - we only spawn thread_count-1 helpers.  If the OS won't give us a
+	// thread we just end up doing more of the work ourselves.
+	vector<TU_Thread_t>	threads;
+	for (int t = 1; t < thread_count; ++t)
+	{
+		TU_Thread_t	thread;
+		if (TU_StartThread(thread, &info))
+			threads.push_back(thread);
+	}
+
+	// If our own share throws, the helpers still have pointers into 'info' - wait for them, then let the original
+	// exception go on its way.
+	try {
+		TU_ParallelForWorker(&info);
+	} catch (...) {
+		TU_ParallelForStop(&info);
+		TU_JoinThreads(threads);
+		throw;
+	}
+	TU_JoinThreads(threads);
+
+	if (info.failed == fail_bad_alloc)
+		throw bad_alloc();
+	if (info.failed == fail_exception)
+		throw TU_WorkerException(info.what);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#ifndef THREADUTILS_H
+#define THREADUTILS_H
+
+/*
+
+	ThreadUtils - THEORY OF OPERATION
+
+	ThreadUtils is a thin layer over pthreads (Mac, Linux) and Win32 threads for the tools that want to
+	spread CPU-bound work over several cores.  It is not a general purpose threading lib: there are no
+	thread objects to hang on to.  You hand TU_ParallelFor a function and a count; it calls func(0..count-1)
+	on a handful of worker threads (plus the calling thread) and returns once every index is done.
+
+	Indices are handed out in increasing order but may finish in any order, so work items must not depend
+	on each other.  If you need results in order, have each index write into its own slot and walk the
+	slots once TU_ParallelFor returns.
+
+	Work items may throw.  Once one does, no new indices are started; TU_ParallelFor waits for the items already
+	running and then throws on the calling thread.  An exception thrown on the calling thread is rethrown as is; one
+	from a helper thread comes back as std::bad_alloc or as a TU_WorkerException carrying its what() string.
+
+	TU_Mutex is a plain non-recursive mutex; StMutexLock holds one for the life of a stack frame.
+
+ */
+
+#if APL || LIN
+	#include <pthread.h>
+#endif
+
+#include <exception>
+#include <string.h>
+
+/* What TU_ParallelFor throws when a work item on a helper thread threw something other than bad_alloc. */
+class	TU_WorkerException : public std::exception {
+public:
+	TU_WorkerException(const char * what) _MSL_THROW { strncpy(what_, what, sizeof(what_)); what_[sizeof(what_)-1] = 0; }
+	virtual ~TU_WorkerException() _MSL_THROW { }
+	virtual const char* what() const _MSL_THROW { return what_; }
+private:
+	char	what_[256];
+};
+
+/* Number of CPU cores the OS will let us use - always at least 1. */
+int		TU_GetCPUCount(void);
+
+/* True on the thread that ran static initialization, i.e. the one main() runs on. */
+bool	TU_IsMainThread(void);
+
+/* Run inFunc(n, inRef) for n = 0..inCount-1, on at most inMaxThreads threads.  Pass 0 for inMaxThreads to use
+ * one thread per CPU.  With one thread (or one item) the work is simply done on the calling thread. */
+void	TU_ParallelFor(
+			int				inCount,
+			void (*			inFunc)(int inIndex, void * inRef),
+			void *			inRef,
+			int				inMaxThreads = 0);
+
+class	TU_Mutex {
+public:
+	TU_Mutex();
+	~TU_Mutex();
+
+	void	Lock(void);
+	void	Unlock(void);
+
+private:
+	TU_Mutex(const TU_Mutex&);
+	TU_Mutex& operator=(const TU_Mutex&);
+
+#if APL || LIN
+	pthread_mutex_t		mMutex;
+#elif IBM
+	CRITICAL_SECTION	mMutex;
+#endif
+};
+
+class	StMutexLock {
+	TU_Mutex&	mMutex;
+public:
+	StMutexLock(TU_Mutex& inMutex) : mMutex(inMutex) { mMutex.Lock(); }
+	~StMutexLock() { mMutex.Unlock(); }
+};
+
+#endif /* THREADUTILS_H */
@@ -597,6 +597,133 @@ static int DecodeNumericPlaneInterleaved(
 	return inPlaneCount;
 }	
 
+/*
+	SCALED PLANE DECODE
+
+	Scaled pools (DSF POOL/PO32 atoms) are decoded in two steps: every plane's integers are expanded into a
+	planar scratch buffer (undoing RLE and differencing), then one pass converts them to floating point,
+	applies each plane's scale and offset and writes the interleaved output front to back.  Writing whole
+	vertices at a time keeps the output in cache, where scattering one plane at a time streams it once per
+	plane.  For 16 and 32-bit ints into doubles the second pass runs 2-wide on SSE2.  The math is exactly
+	value * scale * reduce + offset, in that order and without fusing, so the SIMD and scalar paths produce
+	bit-identical coordinates.  Unscaled planes use a scale and reduce of 1 and an offset of 0, which
+	leaves the value untouched.
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define XCHUNKY_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define XCHUNKY_SSE2 0
+#endif
+
+template<class T, class F>
+inline void InterleavePlanesScalar(const T * const * inPlanes, int inPlaneSize, int inPlaneCount, int inStride, int inStart,
+					const F * inScales, const F * inReduce, const F * inOffsets, F * ioPlane)
+{
+	for (int i = inStart; i < inPlaneSize; ++i)
+	for (int p = 0; p < inPlaneCount; ++p)
+		ioPlane[i * inStride + p] = ((F) inPlanes[p][i]) * inScales[p] * inReduce[p] + inOffsets[p];
+}
+
+template<class T, class F>
+static void InterleavePlanes(const T * const * inPlanes, int inPlaneSize, int inPlaneCount, int inStride,
+					const F * inScales, const F * inReduce, const F * inOffsets, F * ioPlane)
+{
+	InterleavePlanesScalar(inPlanes, inPlaneSize, inPlaneCount, inStride, 0, inScales, inReduce, inOffsets, ioPlane);
+}
+
+#if XCHUNKY_SSE2
+
+inline void ScaleStore2(__m128d v, const double * inScales, const double * inReduce, const double * inOffsets, int p, double * ioDst, int inStride)
+{
+	v = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(v, _mm_set1_pd(inScales[p])), _mm_set1_pd(inReduce[p])), _mm_set1_pd(inOffsets[p]));
+	_mm_storel_pd(ioDst + p, v);
+	_mm_storeh_pd(ioDst + p + inStride, v);
+}
+
+template<>
+void InterleavePlanes<uint16_t, double>(const uint16_t * const * inPlanes, int inPlaneSize, int inPlaneCount, int inStride,
+					const double * inScales, const double * inReduce, const double * inOffsets, double * ioPlane)
+{
+	__m128i	zero = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 8 <= inPlaneSize; i += 8)
+	{
+		double * dst = ioPlane + i * inStride;
+		for (int p = 0; p < inPlaneCount; ++p)
+		{
+			__m128i	v  = _mm_loadu_si128((const __m128i *) (inPlanes[p] + i));
+			__m128i	lo = _mm_unpacklo_epi16(v, zero);
+			__m128i	hi = _mm_unpackhi_epi16(v, zero);
+			ScaleStore2(_mm_cvtepi32_pd(lo),											inScales, inReduce, inOffsets, p, dst                , inStride);
+			ScaleStore2(_mm_cvtepi32_pd(_mm_shuffle_epi32(lo, _MM_SHUFFLE(1,0,3,2))),	inScales, inReduce, inOffsets, p, dst + 2 * inStride, inStride);
+			ScaleStore2(_mm_cvtepi32_pd(hi),											inScales, inReduce, inOffsets, p, dst + 4 * inStride, inStride);
+			ScaleStore2(_mm_cvtepi32_pd(_mm_shuffle_epi32(hi, _MM_SHUFFLE(1,0,3,2))),	inScales, inReduce, inOffsets, p, dst + 6 * inStride, inStride);
+		}
+	}
+	InterleavePlanesScalar(inPlanes, inPlaneSize, inPlaneCount, inStride, i, inScales, inReduce, inOffsets, ioPlane);
+}
+
+// SSE2 only converts signed ints, so bias the uint32 into signed range and add the bias back as a double - exact,
+// since every 32-bit int is representable.
+template<>
+void InterleavePlanes<uint32_t, double>(const uint32_t * const * inPlanes, int inPlaneSize, int inPlaneCount, int inStride,
+					const double * inScales, const double * inReduce, const double * inOffsets, double * ioPlane)
+{
+	__m128i	bias_i = _mm_set1_epi32(0x80000000);
+	__m128d	bias_d = _mm_set1_pd(2147483648.0);
+	int i = 0;
+	for (; i + 4 <= inPlaneSize; i += 4)
+	{
+		double * dst = ioPlane + i * inStride;
+		for (int p = 0; p < inPlaneCount; ++p)
+		{
+			__m128i	v = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (inPlanes[p] + i)), bias_i);
+			ScaleStore2(_mm_add_pd(_mm_cvtepi32_pd(v), bias_d),											inScales, inReduce, inOffsets, p, dst                , inStride);
+			ScaleStore2(_mm_add_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2))), bias_d),	inScales, inReduce, inOffsets, p, dst + 2 * inStride, inStride);
+		}
+	}
+	InterleavePlanesScalar(inPlanes, inPlaneSize, inPlaneCount, inStride, i, inScales, inReduce, inOffsets, ioPlane);
+}
+
+#endif /* XCHUNKY_SSE2 */
+
+// Same stream as RLEDecoder, but a whole run at a time, optionally undoing differencing as we go.  A run that
+// would spill past the end of the plane is clipped.
+template<class T>
+static uint8_t * ExpandRLEPlane(uint8_t * p, T * outPlane, int inPlaneSize, bool inDifferenced)
+{
+	T	last = 0;
+	int	i = 0;
+	while (i < inPlaneSize)
+	{
+		uint8_t	code = *p++;
+		int		len = code & 0x7F;
+		if (len > inPlaneSize - i)
+			len = inPlaneSize - i;
+		if (code & 0x80)
+		{
+			T v = SwapValueTyped(*((T *) p));
+			p += sizeof(T);
+			if (inDifferenced)
+				while (len--)
+					outPlane[i++] = last = (T) (last + v);
+			else
+				while (len--)
+					outPlane[i++] = v;
+		}
+		else
+			while (len--)
+			{
+				T v = SwapValueTyped(*((T *) p));
+				p += sizeof(T);
+				outPlane[i++] = inDifferenced ? (last = (T) (last + v)) : v;
+			}
+	}
+	return p;
+}
+
 template<class T, class F>
 static F DecodeNumericPlaneInterleavedScaled(
 						int 					inPlaneCount,
@@ -610,85 +737,53 @@ static F DecodeNumericPlaneInterleavedScaled(
 
 {
 	int plane, i;
-	T last, val;
+	if (inPlaneCount <= 0 || inPlaneSize <= 0)
+		return inPlaneCount;
+
+	vector<T>			raw(inPlaneCount * inPlaneSize);
+	vector<const T *>	planes(inPlaneCount);
+	vector<F>			scales(inPlaneCount), reduce(inPlaneCount), offsets(inPlaneCount);
 	for (plane = 0; plane < inPlaneCount; ++plane)
 	{
-		if (inAtomData >= inAtomDataEnd) return plane;
-		F sc = *ioScales++;
-		F of = *ioOffsets++;
-		
+		if (inAtomData >= inAtomDataEnd) break;
+		T *	r = &raw[plane * inPlaneSize];
+		planes[plane] = r;
+
 		uint8_t	encodeMode = *inAtomData++;
 		if (encodeMode == xpna_Mode_Raw)
 		{
+#if BIG
 			FlatDecoder<T>	decoder(inAtomData);
-			if (sc)
-				for (i = 0; i < inPlaneSize; ++i)
-				{
-					ioPlane[i*inPlaneCount+plane] = ((F)SwapValueTyped(decoder.Fetch())) * sc * inReduce + of;					
-				}
-			else
-				for (i = 0; i < inPlaneSize; ++i)
-				{
-					ioPlane[i * inPlaneCount + plane] = SwapValueTyped(decoder.Fetch());
-				}
-			inAtomData = decoder.EndPos();
+			for (i = 0; i < inPlaneSize; ++i)
+				r[i] = SwapValueTyped(decoder.Fetch());
+#else
+			planes[plane] = (const T *) inAtomData;			// Already in native order - read it in place.
+#endif
+			inAtomData += inPlaneSize * sizeof(T);
 		}
-		if (encodeMode == xpna_Mode_Differenced)
+		else if (encodeMode == xpna_Mode_Differenced)
 		{
 			FlatDecoder<T>	decoder(inAtomData);
-			last = 0;
-			if (sc)
-				for (i = 0; i < inPlaneSize; ++i)
-				{
-					ioPlane[i*inPlaneCount+plane] = ((F)(val = last + SwapValueTyped(decoder.Fetch()))) * sc * inReduce + of;
-					last = val;
-				}
-				else
-				for (i = 0; i < inPlaneSize; ++i)
-				{
-					ioPlane[i*inPlaneCount+plane] = val = last + SwapValueTyped(decoder.Fetch());
-					last = val;
-			}
-			inAtomData = decoder.EndPos();
-		}
-		if (encodeMode == xpna_Mode_RLE)
-		{
-			RLEDecoder<T>	decoder(inAtomData);
-			if (sc)			
-				for (i = 0; i < inPlaneSize; ++i)
-				{
-					ioPlane[i*inPlaneCount+plane] = ((F)SwapValueTyped(decoder.Fetch())) * sc * inReduce + of;
-				}
-			else
-				for (i = 0; i < inPlaneSize; ++i)
-				{
-					ioPlane[i*inPlaneCount+plane] = SwapValueTyped(decoder.Fetch());			
-				}
-			inAtomData = decoder.EndPos();
-		}
-		if (encodeMode == xpna_Mode_RLE_Differenced)
-		{
-			RLEDecoder<T>	decoder(inAtomData);
-			last = 0;
-			if (sc)
+			T last = 0;
 			for (i = 0; i < inPlaneSize; ++i)
-			{
-					ioPlane[i*inPlaneCount+plane] = ((F)(val = last + SwapValueTyped(decoder.Fetch()))) * sc * inReduce + of;
-					last = val;					
-				}
-			else
-				for (i = 0; i < inPlaneSize; ++i)
-				{
-					ioPlane[i * inPlaneCount + plane] = val = last + SwapValueTyped(decoder.Fetch());
-				last = val;
-					
-			}
+				r[i] = last = (T) (last + SwapValueTyped(decoder.Fetch()));
 			inAtomData = decoder.EndPos();
 		}
+		else if (encodeMode == xpna_Mode_RLE || encodeMode == xpna_Mode_RLE_Differenced)
+			inAtomData = ExpandRLEPlane(inAtomData, r, inPlaneSize, encodeMode == xpna_Mode_RLE_Differenced);
+		else
+			break;												// Unknown encoding - we can't find the next plane either.
+
+		scales[plane]	= ioScales[plane] ? ioScales[plane] : 1;
+		reduce[plane]	= ioScales[plane] ? inReduce : 1;
+		offsets[plane]	= ioScales[plane] ? ioOffsets[plane] : 0;
 	}
-	return inPlaneCount;
+
+	InterleavePlanes<T, F>(&*planes.begin(), inPlaneSize, plane, inPlaneCount, &*scales.begin(), &*reduce.begin(), &*offsets.begin(), ioPlane);
+	return plane;
 }
 
+
 int XAtomPlanerNumericTable::DecompressShortToDoubleInterleaved(
 					int		numberOfPlanes,
 					int		planeSize,
@@ -107,9 +107,11 @@ void MD5Init (MD5_CTX *mdContext)
 
 /* The routine MD5Update updates the message-digest context to
 	 account for the presence of each of the characters inBuf[0..inLen-1]
-	 in the message whose digest is being computed.
+	 in the message whose digest is being computed.  Whole 64-byte blocks
+	 are transformed straight out of inBuf; only partial blocks are copied
+	 through the context's input buffer.
  */
-void MD5Update (MD5_CTX *mdContext, unsigned char *inBuf, unsigned short inLen)
+void MD5Update (MD5_CTX *mdContext, unsigned char *inBuf, unsigned int inLen)
 {
 	UINT4 in[16];
 	short mdi;
@@ -124,9 +126,22 @@ void MD5Update (MD5_CTX *mdContext, unsigned char *inBuf, unsigned short inLen)
 	mdContext->i[0] += ((UINT4)inLen << 3);
 	mdContext->i[1] += ((UINT4)inLen >> 29);
 
-	while (inLen--) {
+	while (inLen > 0) {
+		if (mdi == 0 && inLen >= 0x40) {
+			for (i = 0, ii = 0; i < 16; i++, ii += 4)
+				in[i] = (((UINT4)inBuf[ii+3]) << 24) |
+								(((UINT4)inBuf[ii+2]) << 16) |
+								(((UINT4)inBuf[ii+1]) << 8) |
+								((UINT4)inBuf[ii]);
+			Transform (mdContext->buf, in);
+			inBuf += 0x40;
+			inLen -= 0x40;
+			continue;
+		}
+
 		/* add new character to buffer, increment mdi */
 		mdContext->in[mdi++] = *inBuf++;
+		--inLen;
 
 		/* transform if necessary */
 		if (mdi == 0x40) {
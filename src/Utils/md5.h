@@ -55,7 +55,7 @@ typedef struct {
 
 void MD5Init (MD5_CTX *mdContext);
 void MD5Final (MD5_CTX *mdContext);
-void MD5Update (MD5_CTX *mdContext, unsigned char *inBuf, unsigned short inLen);
+void MD5Update (MD5_CTX *mdContext, unsigned char *inBuf, unsigned int inLen);
 
 #ifdef __cplusplus
     }
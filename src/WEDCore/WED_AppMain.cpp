@@ -53,6 +53,8 @@
 #include "GUI_Splitter.h"
 
 #include "WED_FileCache.h"
+#include "WED_Validate.h"
+#include "WED_Globals.h"
 
 #define	REGISTER_LIST	\
 	_R(WED_Airport) \
@@ -121,6 +123,55 @@ HINSTANCE gInstance = NULL;
 #include "initializer.h"
 #endif
 
+// Batch validation: "WED -validate <package> [-gateway]" loads the scenery package, validates every airport in it
+// and writes the usual validation_report.txt, with no windows.  The exit code is 0 if the package passes, 1 if not
+// and 2 if it could not be loaded.  This runs before the application object exists, so nothing here may touch the UI;
+// asserts go to stderr.
+static int	ValidateFromCommandLine(const char * package, bool gateway)
+{
+	WED_PackageMgr	pMgr(NULL);
+	GUI_Prefs_Read("WED");
+	WED_Document::ReadGlobalPrefs();
+	pMgr.SetXPlaneFolder(GUI_GetPrefString("packages","xsystem",""));
+	if (!pMgr.HasSystemFolder())
+	{
+		fprintf(stderr, "No X-System folder is set up - run WED once to pick one.\n");
+		return 2;
+	}
+	WED_file_cache_init();
+	WED_AssertInit(false);
+	ENUM_Init();
+
+	#define _R(x)	x##_Register();
+	REGISTER_LIST
+	#if AIRPORT_ROUTING
+	REGISTER_LIST_ATC
+	#endif
+	#undef _R
+
+	setlocale(LC_ALL,"C");
+
+	int result = 2;
+	try {
+		double b[4] = { -180, -90, 180, 90 };
+		WED_Document * doc = new WED_Document(package, b);
+		gExportTarget = (WED_Export_Target) doc->ReadIntPref("doc/export_target",gExportTarget);
+		if (gateway)
+			gExportTarget = wet_gateway;
+
+		validation_error_vector	msgs;
+		string					report;
+		result = WED_ValidateAptNoUI(doc, msgs, report) ? 0 : 1;
+		printf("%s: %d problem(s), see %s\n", package, (int) msgs.size(), report.c_str());
+		delete doc;
+	} catch(exception& e) {
+		fprintf(stderr, "%s: %s\n", package, e.what());
+	} catch (...) {
+		fprintf(stderr, "%s: an unknown error occurred.\n", package);
+	}
+	return result;
+}
+
 
 #if IBM
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
@@ -133,6 +184,23 @@ int main(int argc, char * argv[])
 	SetErrorMode(SEM_NOOPENFILEERRORBOX|SEM_FAILCRITICALERRORS);
 #endif
 	GUI_MemoryHog::InstallNewHandler();
+
+	{
+	#if IBM
+		int argc = __argc;
+		char ** argv = __argv;
+	#endif
+		const char * validate_package = NULL;
+		bool validate_gateway = false;
+		for (int a = 1; a < argc; ++a)
+		{
+			if (strcmp(argv[a], "-validate") == 0 && a + 1 < argc)	validate_package = argv[++a];
+			else if (strcmp(argv[a], "-gateway") == 0)				validate_gateway = true;
+		}
+		if (validate_package)
+			return ValidateFromCommandLine(validate_package, validate_gateway);
+	}
+
 	GUI_InitClipboard();
 #if LIN
 	Initializer linit(&argc, &argv, false);
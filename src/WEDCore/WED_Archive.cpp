@@ -69,6 +69,8 @@ void		WED_Archive::ChangedObject(WED_Persistent * inObject, int change_kind)
 {
 	if (mDying) return;
 	++mCacheKey;
+	mUnsaved.insert(inObject->GetID());
+	mObjectBroadcaster.BroadcastMessage(msg_ArchiveObjectChanged, inObject->GetID());
 #if WITHNWLINK
 	if (mNWAdapter) mNWAdapter->ObjectChanged(inObject, change_kind);
 #endif
@@ -81,6 +83,8 @@ void		WED_Archive::AddObject(WED_Persistent * inObject)
 {
 	if (mDying) return;
 	++mCacheKey;
+	mUnsaved.insert(inObject->GetID());
+	mObjectBroadcaster.BroadcastMessage(msg_ArchiveObjectChanged, inObject->GetID());
 	mID = max(mID,inObject->GetID()+1);
 	ObjectMap::iterator iter = mObjects.find(inObject->GetID());
 	DebugAssert(iter == mObjects.end() || iter->second == NULL);
@@ -100,6 +104,8 @@ void		WED_Archive::RemoveObject(WED_Persistent * inObject)
 {
 	if (mDying) return;
 	++mCacheKey;
+	mUnsaved.insert(inObject->GetID());
+	mObjectBroadcaster.BroadcastMessage(msg_ArchiveObjectChanged, inObject->GetID());
 	ObjectMap::iterator iter = mObjects.find(inObject->GetID());
 	Assert(iter != mObjects.end());
 	iter->second = NULL;
@@ -134,6 +140,30 @@ void			WED_Archive::SaveToXML(WED_XMLElement * parent)
 
 	mOpCount = 0;
 }
+
+void			WED_Archive::SaveChangesToXML(WED_XMLElement * parent)
+{
+	WED_XMLElement * obj = parent->add_sub_element("objects");
+	for (set<int>::iterator id = mUnsaved.begin(); id != mUnsaved.end(); ++id)
+	{
+		WED_Persistent * who = Fetch(*id);
+		if(who)
+			who->ToXML(obj);
+		else
+		{
+			WED_XMLElement * dead = obj->add_sub_element("deleted");
+			dead->add_attr_int("id",*id);
+		}
+		obj->flush();
+	}
+
+	mOpCount = 0;
+}
+
+void			WED_Archive::MarkSaved(void)
+{
+	mUnsaved.clear();
+}
 #if WITHNWLINK
 void			WED_Archive::SetNWLinkAdapter(WED_NWLinkAdapter * inAdapter)
 {
@@ -200,6 +230,20 @@ void		WED_Archive::StartElement(
 								const XML_Char *	name,
 								const XML_Char **	atts)
 {
+	if(strcasecmp(name,"deleted")==0)
+	{
+		const char * dead_id = get_att("id",atts);
+		if(dead_id == NULL)
+		{
+			reader->FailWithError("Deleted object missing ID.");
+			return;
+		}
+		WED_Persistent * dead = Fetch(atoi(dead_id));
+		if(dead)
+			dead->Delete();
+		return;
+	}
+
 	const XML_Char ** a = atts;
 	const char * class_name = NULL;
 	const char * id_str = NULL;
@@ -229,6 +273,11 @@ void		WED_Archive::StartElement(
 		return;
 	}
 
+	// A later copy of an object (e.g. from the save journal) replaces the one we already read.
+	WED_Persistent * old_obj = Fetch(atoi(id_str));
+	if(old_obj)
+		old_obj->Delete();
+
 	WED_Persistent * new_obj = WED_Persistent::CreateByClass(class_name, this, atoi(id_str));
 	if(new_obj==NULL)
 	{
@@ -245,6 +294,7 @@ void		WED_Archive::EndElement(void)
 
 void		WED_Archive::PopHandler(void)
 {
+	mUnsaved.clear();
 	mOpCount = 0;
 	++mCacheKey;
 }
@@ -39,6 +39,12 @@
 	This saves us database I/O - even though we have to touch the whole DB for read when we load our file (for now), we don't have
 	to touch the whole DB for right and blast the hell out of all indices.
 
+	Separately from the per-object flag, the archive keeps the IDs of every object created, changed or destroyed since the
+	last time it was written or read.  Undo and redo go through the same create/change/destroy hooks, so this set is
+	exactly what an incremental save must write - SaveChangesToXML writes those objects (or a "deleted" marker for ones
+	that are gone), and reading an object whose ID is already in the archive replaces it.  Neither save clears the set -
+	the document calls MarkSaved only once the file is known to be written, so a failed save is retried in full.
+
 	Also note that undo DOESN'T restore dirtiness yet - if we delete an obj and undo, the same data WILL be written out to the archive
 	because the undo system isn't smart enough to see what happened.
 
@@ -81,6 +87,8 @@ public:
 	void			LoadFromDB(sqlite3 * db, const map<int,int>& mapping);
 	void			SaveToDB(sqlite3 * db);
 	void			SaveToXML(WED_XMLElement * parent);
+	void			SaveChangesToXML(WED_XMLElement * parent);	// Only objects changed since the last save or load.
+	void			MarkSaved(void);							// Call once a save has safely hit the disk.
 #if WITHNWLINK
 	void			SetNWLinkAdapter(WED_NWLinkAdapter * inAdapter);
 #endif
@@ -99,6 +107,11 @@ public:
 
 	IResolver *		GetResolver(void) { return mResolver; }
 
+	// Every create, change and destroy of a single object is sent from here as msg_ArchiveObjectChanged with
+	// the object's ID.  Unlike msg_ArchiveChanged this happens mid-command (e.g. during a drag) and for undo.
+	// Changes are announced BEFORE they happen, so listeners should just note the ID and look later.
+	GUI_Broadcaster *	GetObjectBroadcaster(void) { return &mObjectBroadcaster; }
+
 	virtual void		StartElement(
 								WED_XMLReader * reader,
 								const XML_Char *	name,
@@ -118,6 +131,8 @@ private:
 	typedef hash_map<int, WED_Persistent *>	ObjectMap;
 
 	ObjectMap		mObjects;		// Our objects!
+	set<int>		mUnsaved;		// IDs created, changed or destroyed since we last matched the disk.
+	GUI_Broadcaster	mObjectBroadcaster;
 	bool			mDying;			// Flag to self - WE are killing ourselves - ignore objects.
 	WED_UndoLayer *	mUndo;
 	WED_UndoMgr *	mUndoMgr;
@@ -25,8 +25,11 @@
 #include "WED_Assert.h"
 #include "AssertUtils.h"
 #include "PlatformUtils.h"
+#include "ThreadUtils.h"
 
-static char gAssertBuf[65536];
+static TU_Mutex		sAssertLock;
+static string		sDeferredAlert;		// First alert we couldn't show, if any.
+static bool			sAssertUI = true;
 
 static const char * trim_file(const char * p)
 {
@@ -44,20 +47,42 @@ static const char * trim_file(const char * p)
 
 void WED_AssertHandler_f(const char * condition, const char * file, int line)
 {
-	FILE * efile = fopen("error.out", "a");
-	fprintf(efile ? efile : stderr, "ASSERTION FAILED: %s (%s:%d.)\n", condition, trim_file(file), line);
-	if (efile) fclose(efile);
+	char	where[1024];
+	snprintf(where, sizeof(where), " (%s:%d.)\n", trim_file(file), line);
+	string	msg = string("WorldEditor has hit an error due to a bug.  Please report the following to Ben:\n") + condition + where;
 
-	sprintf(gAssertBuf, "WorldEditor has hit an error due to a bug.  Please report the following to Ben:\n"
-						"%s (%s:%d.)\n", condition, trim_file(file), line);
+	bool	show = sAssertUI && TU_IsMainThread();
+	{
+		StMutexLock	hold(sAssertLock);
+		FILE * efile = fopen("error.out", "a");
+		fprintf(efile ? efile : stderr, "ASSERTION FAILED: %s%s", condition, where);
+		if (efile) fclose(efile);
+		if (!sAssertUI)
+			fprintf(stderr, "%s", msg.c_str());
+		else if (!show && sDeferredAlert.empty())
+			sDeferredAlert = msg;
+	}
 
-	DoUserAlert(gAssertBuf);
+	if (show)
+		DoUserAlert(msg.c_str());
 
 	throw wed_assert_fail_exception(condition, file, line);
 }
 
-void	WED_AssertInit(void)
+void	WED_ShowDeferredAssert(void)
+{
+	string	msg;
+	{
+		StMutexLock	hold(sAssertLock);
+		msg.swap(sDeferredAlert);
+	}
+	if (!msg.empty())
+		DoUserAlert(msg.c_str());
+}
+
+void	WED_AssertInit(bool with_ui)
 {
+	sAssertUI = with_ui;
 	InstallDebugAssertHandler(WED_AssertHandler_f);
 	InstallAssertHandler(WED_AssertHandler_f);
 }
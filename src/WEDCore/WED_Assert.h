@@ -42,6 +42,10 @@ public:
 };
 
 
-void	WED_AssertInit(void);
+// Asserts log to error.out, tell the user and throw a wed_assert_fail_exception.  Only the main thread can put up an
+// alert, so an assert on a worker thread (or any assert with with_ui false) keeps its message instead; code that runs
+// work on other threads calls WED_ShowDeferredAssert from the main thread once the work is done.
+void	WED_AssertInit(bool with_ui = true);
+void	WED_ShowDeferredAssert(void);
 
 #endif /* WED_ASSERT_H */
\ No newline at end of file
@@ -22,6 +22,7 @@
  */
 
 #include <stdint.h>
+#include <time.h>
 
 #if WITHNWLINK
 #include "WED_Server.h"
@@ -74,8 +75,11 @@ WED_Document::WED_Document(
 #if WITHNWLINK
 	mServer(NULL),
 	mNWLink(NULL),
-	mOnDisk(false),
 #endif
+	mOnDisk(false),
+	mJournalStamp(0),
+	mJournalStale(false),
+	mJournalTorn(false),
 	mUndo(&mArchive, this),
 	mArchive(this)
 {
@@ -161,6 +165,58 @@ void	WED_Document::Save(void)
 {
 	BroadcastMessage(msg_DocWillSave, reinterpret_cast<uintptr_t>(static_cast<IDocPrefs *>(this)));
 
+	if(mOnDisk && mJournalStamp != 0 && ReadIntPref("doc/journal_save", 0) && !JournalNeedsCompact())
+	if(SaveJournal())
+		return;
+
+	SaveFull();
+}
+
+bool	WED_Document::JournalNeedsCompact(void)
+{
+	if(mJournalTorn)
+		return true;
+	struct stat base_info, journal_info;
+	if(FILE_get_file_meta_data(mFilePath + ".xml", base_info) != 0)
+		return true;
+	if(FILE_get_file_meta_data(mFilePath + ".journal.xml", journal_info) != 0)
+		return false;
+	return journal_info.st_size > base_info.st_size / 2;
+}
+
+bool	WED_Document::SaveJournal(void)
+{
+	string journal = mFilePath + ".journal.xml";
+	bool is_new = !FILE_exists(journal.c_str());
+
+	FILE * journal_file = fopen(journal.c_str(), is_new ? "w" : "a");
+	if(journal_file == NULL)
+		return false;
+
+	// The journal's root element is never closed - each save appends one more <save> and the reader
+	// supplies the closing tag.
+	if(is_new)
+		fprintf(journal_file,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<journal stamp=\"%d\">\n", mJournalStamp);
+	{
+		WED_XMLElement	save("save",1,journal_file);
+		mArchive.SaveChangesToXML(&save);
+		WriteXMLPrefs(&save);
+	}
+	int ferrorErr = ferror(journal_file);
+	int fcloseErr = fclose(journal_file);
+	if(ferrorErr != 0 || fcloseErr != 0)
+	{
+		// The tail of the journal may be junk now - the caller does a full save, which writes everything
+		// the archive has and drops the journal.  Until one works, never append after the junk.
+		mJournalTorn = true;
+		return false;
+	}
+	mArchive.MarkSaved();
+	return true;
+}
+
+bool	WED_Document::SaveFull(void)
+{
 	enum {none,nobackup,both};
 	int stage = none;
 
@@ -225,9 +281,13 @@ void	WED_Document::Save(void)
 	if(xml_file == NULL)
 	{
 		DoUserAlert("Please check file path for errors or missing parts");
-		return;
+		return false;
 	}
 
+	// New stamp, so the old journal (which we are about to fold in) can never be replayed over this file.
+	int old_stamp = mJournalStamp;
+	mJournalStamp = max((int) time(NULL), old_stamp + 1);
+
 	int ferrorErr = ferror(xml_file);
 		//If everything else has worked
 	if(ferrorErr == 0)
@@ -263,11 +323,17 @@ void	WED_Document::Save(void)
 				DoUserAlert("Please check file path for errors or missing parts");
 				break;
 		}
+		mJournalStamp = old_stamp;
 	}	
 	else
 	{
 		// This is the save-was-okay case.
 		mOnDisk=true;
+		mArchive.MarkSaved();
+		mJournalTorn = false;
+		string journal = mFilePath + ".journal.xml";
+		if(FILE_exists(journal.c_str()))
+			FILE_delete_file(journal.c_str(), false);
 	}
 	
 	//if the second backup still exists after the error handling
@@ -276,6 +342,7 @@ void	WED_Document::Save(void)
 		//Delete it
 		FILE_delete_file(tempBakBak.c_str(), false);
 	}
+	return ferrorErr == 0 && fcloseErr == 0;
 }
 
 void	WED_Document::Revert(void)
@@ -297,6 +364,7 @@ void	WED_Document::Revert(void)
 		string fname(mFilePath);
 		fname+=".xml";
 		mArchive.ClearAll();
+		mJournalStamp = 0;
 
 		// First: try to IO the XML file.
 		bool xml_exists;
@@ -308,6 +376,25 @@ void	WED_Document::Revert(void)
 		if(xml_exists)
 		{
 			mOnDisk=true;
+
+			// Then replay any incremental saves made since earth.wed.xml was last written.
+			string jname(mFilePath);
+			jname += ".journal.xml";
+			// Each save is applied only if its </save> made it to disk - a save cut off by a crash or a full
+			// disk is dropped whole rather than half-applied.
+			bool journal_exists;
+			mJournalStale = false;
+			result = reader.ReadFile(jname.c_str(),&journal_exists,"</journal>","</save>",&mJournalTorn);
+			if(mJournalStale)
+				FILE_delete_file(jname.c_str(), false);
+			else if(journal_exists && (mJournalTorn || !result.empty()))
+			{
+				if(result.empty())
+					result = "the last save was not finished";
+				string msg = string("Warning: the last save of the package '") + mPackage + string("' could not be read completely (") + result +
+							string(").  Please check your work.");
+				DoUserAlert(msg.c_str());
+			}
 		}
 		else
 		{
@@ -375,6 +462,10 @@ bool	WED_Document::TryClose(void)
 		case close_Cancel:	return false;
 		}
 	}
+	// Fold the journal back into earth.wed.xml so the package on disk is a single file again - but only
+	// if what we have in memory is what was saved.
+	if(!IsDirty() && mOnDisk && FILE_exists((mFilePath + ".journal.xml").c_str()))
+		SaveFull();
 #if WITHNWLINK
 	if(mServer)
 	{
@@ -573,6 +664,20 @@ void		WED_Document::StartElement(
 {
 	const char * n = NULL, * v = NULL;
 
+	if(strcasecmp(name,"doc")==0)
+	{
+		const char * stamp = get_att("journal",atts);
+		mJournalStamp = stamp ? atoi(stamp) : 0;
+	}
+	if(strcasecmp(name,"journal")==0)
+	{
+		const char * stamp = get_att("stamp",atts);
+		if(stamp == NULL || mJournalStamp == 0 || atoi(stamp) != mJournalStamp)
+		{
+			mJournalStale = true;
+			reader->FailWithError("Save journal does not match the document.");
+		}
+	}
 	if(strcasecmp(name,"objects")==0)
 	{
 
@@ -671,26 +776,33 @@ void		WED_Document::WriteXML(FILE * xml_file)
 	fprintf(xml_file,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
 	{
 		WED_XMLElement	top_level("doc",0,xml_file);
+		if(mJournalStamp)
+			top_level.add_attr_int("journal",mJournalStamp);
 		mArchive.SaveToXML(&top_level);
-		WED_XMLElement * pref;
-		WED_XMLElement * prefs = top_level.add_sub_element("prefs");
-		for(map<string,set<int> >::iterator pi = mDocPrefsItems.begin(); pi != mDocPrefsItems.end(); ++pi)
-		{
-			pref = prefs->add_sub_element("pref");
-			pref->add_attr_stl_str("name",pi->first);
-			for(set<int>::iterator i = pi->second.begin(); i != pi->second.end(); ++i)
-			{
-				WED_XMLElement *item = pref->add_sub_element("item");
-				item->add_attr_int("value",*i);
-			}
-		}
-		for(map<string,string>::iterator p = mDocPrefs.begin(); p != mDocPrefs.end(); ++p)
+		WriteXMLPrefs(&top_level);
+	}
+}
+
+void		WED_Document::WriteXMLPrefs(WED_XMLElement * parent)
+{
+	WED_XMLElement * pref;
+	WED_XMLElement * prefs = parent->add_sub_element("prefs");
+	for(map<string,set<int> >::iterator pi = mDocPrefsItems.begin(); pi != mDocPrefsItems.end(); ++pi)
+	{
+		pref = prefs->add_sub_element("pref");
+		pref->add_attr_stl_str("name",pi->first);
+		for(set<int>::iterator i = pi->second.begin(); i != pi->second.end(); ++i)
 		{
-			pref = prefs->add_sub_element("pref");
-			pref->add_attr_stl_str("name",p->first);
-			pref->add_attr_stl_str("value",p->second);
+			WED_XMLElement *item = pref->add_sub_element("item");
+			item->add_attr_int("value",*i);
 		}
 	}
+	for(map<string,string>::iterator p = mDocPrefs.begin(); p != mDocPrefs.end(); ++p)
+	{
+		pref = prefs->add_sub_element("pref");
+		pref->add_attr_stl_str("name",p->first);
+		pref->add_attr_stl_str("value",p->second);
+	}
 }
 
 
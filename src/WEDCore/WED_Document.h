@@ -42,6 +42,7 @@ class	WED_Thing;
 class	WED_TexMgr;
 class	WED_LibraryMgr;
 class	WED_ResourceMgr;
+class	WED_XMLElement;
 #if WITHNWLINK
 class	WED_Server;
 class	WED_NWLinkAdapter;
@@ -63,6 +64,16 @@ class	WED_NWLinkAdapter;
 
 	Object with ID 1 is by definition "the document root" - that is, it is used as a starting point for all resolutions.
 
+	SAVING
+
+	A full save rewrites earth.wed.xml (keeping the last one as earth.wed.bak.xml).  With the doc/journal_save pref on (it
+	is off by default), a save of a document that is already on disk instead appends only the objects the archive saw
+	change since the last save to earth.wed.journal.xml, so the cost of a save follows the size of the edit.  On load the
+	journal is replayed over earth.wed.xml, one whole <save> at a time - a save whose closing tag never reached the disk is
+	skipped and the next save is a full one.  Both files carry the same stamp so a journal left over from some other
+	earth.wed.xml is never applied.  Once the journal grows past half the size of earth.wed.xml (or when a clean document
+	is closed) we do a full save to fold it back in.
+
 */
 
 
@@ -134,6 +145,10 @@ public:
 
 private:
 	void				WriteXML(FILE * fi);
+	void				WriteXMLPrefs(WED_XMLElement * parent);
+	bool				SaveFull(void);
+	bool				SaveJournal(void);
+	bool				JournalNeedsCompact(void);
 
 	//Member Variables
 
@@ -142,6 +157,9 @@ private:
 	string				mFilePath;
 	string				mPackage;
 	bool				mOnDisk;
+	int					mJournalStamp;			// Matches the stamp on earth.wed.xml, 0 if it has none.
+	bool				mJournalStale;			// Set on load if the journal belongs to some other earth.wed.xml.
+	bool				mJournalTorn;			// The journal ends in an unfinished save - the next save must be full.
 
 	//sql_db				mDB;
 	WED_Archive			mArchive;
@@ -38,6 +38,7 @@ enum {
 //	msg_SelectionChanged,
 
 	msg_ArchiveChanged,
+	msg_ArchiveObjectChanged,				// From WED_Archive::GetObjectBroadcaster - param is the object's ID.
 
 	msg_DocWillSave,
 	msg_DocLoaded,
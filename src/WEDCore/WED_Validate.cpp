@@ -25,6 +25,7 @@
 #include "WED_ValidateATCRunwayChecks.h"
 
 #include "WED_Globals.h"
+#include "WED_Assert.h"
 #include "WED_Sign_Parser.h"
 #include "WED_Runway.h"
 #include "WED_Sealane.h"
@@ -73,6 +74,7 @@
 #include "WED_ResourceMgr.h"
 
 #include "CompGeomUtils.h"
+#include "RTree2.h"
 
 #include "BitmapUtils.h"
 #include "GISUtils.h"
@@ -80,6 +82,8 @@
 #include "MemFileUtils.h"
 #include "PlatformUtils.h"
 #include "MathUtils.h"
+#include "PerfUtils.h"
+#include "ThreadUtils.h"
 
 #include "WED_FileCache.h"
 #include "WED_Url.h"
@@ -96,6 +100,40 @@
 
 #define DBG_LIN_COLOR 1,0,1,1,0,1
 
+// Time spent in each check, summed over every airport validated, so we can see what is slow on a big airport.
+// It goes at the end of the validation report.
+typedef map<string, PerfTimer>	check_timing_map;
+
+// Airports are validated in parallel.  Everything the checks touch is either read-only or belongs to a single
+// airport - except the resource manager, which loads and caches on demand, so all calls into it take this lock.
+static TU_Mutex	sResMgrLock;
+
+static bool cmp_check_time(const check_timing_map::value_type * lhs, const check_timing_map::value_type * rhs)
+{
+	double lt, rt;
+	unsigned long lc, rc;
+	lhs->second.GetStats(lt, lc);
+	rhs->second.GetStats(rt, rc);
+	return lt > rt;
+}
+
+static void WriteCheckTiming(FILE * fi, const check_timing_map& timing)
+{
+	vector<const check_timing_map::value_type *> by_time;
+	for(check_timing_map::const_iterator t = timing.begin(); t != timing.end(); ++t)
+		by_time.push_back(&*t);
+	sort(by_time.begin(), by_time.end(), cmp_check_time);
+
+	fprintf(fi, "\nValidation time by check (nested checks are also counted in their parent):\n");
+	for(vector<const check_timing_map::value_type *>::iterator t = by_time.begin(); t != by_time.end(); ++t)
+	{
+		double secs;
+		unsigned long calls;
+		(*t)->second.GetStats(secs, calls);
+		fprintf(fi, "%10.3lf sec %6lu calls  %s\n", secs, calls, (*t)->first.c_str());
+	}
+}
+
 // This table is used to find the matching opposite direction for a given runway
 // to detect head-on collisions.
 
@@ -785,9 +823,9 @@ static void ValidateOneATCRunwayUse(WED_ATCRunwayUse* use, validation_error_vect
 		msgs.push_back(validation_error_t("ATC runway use must support at least one equipment type.", err_rwy_use_must_have_at_least_one_equip, use, apt));
 }
 
-static void TJunctionTest(vector<WED_TaxiRoute*> all_taxiroutes, validation_error_vector& msgs, WED_Airport * apt)
+static void TJunctionTest(const vector<WED_TaxiRoute*>& all_taxiroutes, validation_error_vector& msgs, WED_Airport * apt)
 {
-	static CoordTranslator2 translator;
+	CoordTranslator2 translator;
 	Bbox2 box;
 	apt->GetBounds(gis_Geo, box);
 	CreateTranslatorForBounds(box,translator);
@@ -802,75 +840,98 @@ static void TJunctionTest(vector<WED_TaxiRoute*> all_taxiroutes, validation_erro
 				if end has a valence of 1
 					if the distance between A and the end node you are testing is < M meters
 						validation failure - that node is too close to a taxiway route but isn't joined.
+
+		Rather than try every pair, we index every A by its segment grown by M and only look at the A's near each
+		loose end of B.  The hits are sorted back into A, B, end order so the errors come out as they always have.
 	*/
 
-	for (vector<WED_TaxiRoute*>::iterator edge_a_itr = all_taxiroutes.begin(); edge_a_itr != all_taxiroutes.end(); ++edge_a_itr)
+	const double TJUNCTION_THRESHOLD = 1.00;
+
+	vector<TaxiRouteInfo>		routes;
+	vector<pair<Bbox2, int> >	boxes;
+	routes.reserve(all_taxiroutes.size());
+	boxes.reserve(all_taxiroutes.size());
+	for (int a = 0; a < all_taxiroutes.size(); ++a)
 	{
-		for (vector<WED_TaxiRoute*>::iterator edge_b_itr = all_taxiroutes.begin(); edge_b_itr != all_taxiroutes.end(); ++edge_b_itr)
+		routes.push_back(TaxiRouteInfo(all_taxiroutes[a],translator));
+		Bbox2 seg_box(routes[a].taxiroute_segment_m.p1, routes[a].taxiroute_segment_m.p2);
+		seg_box.expand(TJUNCTION_THRESHOLD);
+		boxes.push_back(pair<Bbox2, int>(seg_box, a));
+	}
+	RTree2<int, 16>	index;
+	index.insert(boxes.begin(), boxes.end());
+
+	vector<pair<pair<int, int>, int> >	hits;		// ((edge a, edge b), end of b)
+	vector<int>							nearby;
+	for (int b = 0; b < routes.size(); ++b)
+	{
+		const TaxiRouteInfo& edge_b(routes[b]);
+		for (int i = 0; i < 2; i++)
 		{
-			//Skip over the same ones
-			if (edge_a_itr == edge_b_itr)
-			{
-				continue;
-			}
+			set<WED_Thing*> node_viewers;
+			edge_b.nodes[i]->GetAllViewers(node_viewers);
 
-			TaxiRouteInfo edge_a(*edge_a_itr,translator);
-			TaxiRouteInfo edge_b(*edge_b_itr,translator);
- 
-			//tmp doesn't matter to us
-			Point2 tmp;
-			if (edge_a.taxiroute_segment_m.intersect(edge_b.taxiroute_segment_m,tmp) == true)
-			{
-				//An intersection is different from a T junction
+			int valence = node_viewers.size();
+			if (valence != 1)
 				continue;
-			}
 
-			bool found_duplicate = false;
-			for (int i = 0; i < 2 && found_duplicate == false; i++)
+			nearby.clear();
+			index.query_value(Bbox2(edge_b.nodes_m[i]), back_inserter(nearby));
+			for (vector<int>::iterator a = nearby.begin(); a != nearby.end(); ++a)
 			{
-				for (int j = 0; j < 2 && found_duplicate == false; j++)
-				{
-					if (edge_a.nodes_m[i] == edge_b.nodes_m[j])
-					{
-						//This is a duplicate of the doubled up vertex test
-						found_duplicate = true;
-					}
-				}
-			}
+				//Skip over the same ones
+				if (*a == b)
+					continue;
 
-			if (found_duplicate == true)
-			{
-				//Try another one
-				continue;
-			}
-
-			const double TJUNCTION_THRESHOLD = 1.00;
-			for (int i = 0; i < 2; i++)
-			{
-				set<WED_Thing*> node_viewers;
-				edge_b.nodes[i]->GetAllViewers(node_viewers);
+				const TaxiRouteInfo& edge_a(routes[*a]);
 
-				int valence = node_viewers.size();
-				if (valence == 1)
+				//tmp doesn't matter to us
+				Point2 tmp;
+				if (edge_a.taxiroute_segment_m.intersect(edge_b.taxiroute_segment_m,tmp) == true)
 				{
-					double dist_b_node_to_a_edge = sqrt(edge_a.taxiroute_segment_m.squared_distance(edge_b.nodes_m[i]));
+					//An intersection is different from a T junction
+					continue;
+				}
 
-					if (dist_b_node_to_a_edge < TJUNCTION_THRESHOLD)
+				bool found_duplicate = false;
+				for (int ii = 0; ii < 2 && found_duplicate == false; ii++)
+				{
+					for (int j = 0; j < 2 && found_duplicate == false; j++)
 					{
-						vector<WED_Thing*> problem_children;
-						problem_children.push_back(*edge_a_itr);
+						if (edge_a.nodes_m[ii] == edge_b.nodes_m[j])
+						{
+							//This is a duplicate of the doubled up vertex test
+							found_duplicate = true;
+						}
+					}
+				}
 
-						string problem_node_name;
+				if (found_duplicate == true)
+				{
+					//Try another one
+					continue;
+				}
 
-						problem_children.push_back((edge_b.nodes[i]));
-						edge_b.nodes[i]->GetName(problem_node_name);
+				double dist_b_node_to_a_edge = sqrt(edge_a.taxiroute_segment_m.squared_distance(edge_b.nodes_m[i]));
 
-						msgs.push_back(validation_error_t("Taxi route " + edge_a.taxiroute_name + " is not joined to a destination route.", err_taxi_route_not_joined_to_dest_route, problem_children, apt));
-					}
-				}
+				if (dist_b_node_to_a_edge < TJUNCTION_THRESHOLD)
+					hits.push_back(make_pair(make_pair(*a, b), i));
 			}
 		}
 	}
+
+	sort(hits.begin(), hits.end());
+	for (vector<pair<pair<int, int>, int> >::iterator h = hits.begin(); h != hits.end(); ++h)
+	{
+		const TaxiRouteInfo& edge_a(routes[h->first.first]);
+		const TaxiRouteInfo& edge_b(routes[h->first.second]);
+
+		vector<WED_Thing*> problem_children;
+		problem_children.push_back(edge_a.taxiroute_ptr);
+		problem_children.push_back(edge_b.nodes[h->second]);
+
+		msgs.push_back(validation_error_t("Taxi route " + edge_a.taxiroute_name + " is not joined to a destination route.", err_taxi_route_not_joined_to_dest_route, problem_children, apt));
+	}
 }
 
 static void ValidateOneATCFlow(WED_ATCFlow * flow, validation_error_vector& msgs, set<int>& legal_rwy_oneway, WED_Airport * apt)
@@ -974,7 +1035,7 @@ static void ValidateOneATCFlow(WED_ATCFlow * flow, validation_error_vector& msgs
 	
 }
 
-static void ValidateATC(WED_Airport* apt, validation_error_vector& msgs, set<int>& legal_rwy_oneway, set<int>& legal_rwy_twoway)
+static void ValidateATC(WED_Airport* apt, validation_error_vector& msgs, set<int>& legal_rwy_oneway, set<int>& legal_rwy_twoway, check_timing_map& timing)
 {
 	vector<WED_ATCFlow *>		flows;
 	vector<WED_TaxiRoute *>	taxi_routes;
@@ -1036,6 +1097,7 @@ static void ValidateATC(WED_Airport* apt, validation_error_vector& msgs, set<int
 		}
 	}
 
+	StPerfTimer timer(timing["taxi route T junctions"]);
 	TJunctionTest(taxi_routes, msgs, apt);
 }
 
@@ -1879,7 +1941,7 @@ static void ValidateOneTruckParking(WED_TruckParkingLocation* truck_parking,vali
 #pragma mark -
 //------------------------------------------------------------------------------------------------------------------------------------
 
-static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs, WED_LibraryMgr* lib_mgr, WED_ResourceMgr * res_mgr, MFMemFile * mf)
+static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs, WED_LibraryMgr* lib_mgr, WED_ResourceMgr * res_mgr, MFMemFile * mf, check_timing_map& timing)
 {
 	/*--Validate Airport Rules-------------------------------------------------
 		Airport Name rules
@@ -1916,23 +1978,30 @@ static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs,
 		msgs.push_back(validation_error_t(string("The Airport ID for airport '") + name + "' must contain ASCII alpha-numeric characters only.", err_airport_no_icao, apt,apt));
 
 #if !GATEWAY_IMPORT_FEATURES
-	set<WED_GISEdge*> edges;
-	WED_select_zero_recursive(apt, &edges);
-	if(edges.size())
 	{
-		msgs.push_back(validation_error_t("Airport contains zero-length ATC routing lines. These should be deleted.", err_airport_no_name, edges, apt));
+		StPerfTimer timer(timing["zero-length ATC routes"]);
+		set<WED_GISEdge*> edges;
+		WED_select_zero_recursive(apt, &edges);
+		if(edges.size())
+		{
+			msgs.push_back(validation_error_t("Airport contains zero-length ATC routing lines. These should be deleted.", err_airport_no_name, edges, apt));
+		}
 	}
-
-	set<WED_Thing*> points = WED_select_doubles(apt);
-	if(points.size())
 	{
-		msgs.push_back(validation_error_t("Airport contains doubled ATC routing nodes. These should be merged.", err_airport_no_name, points, apt));
+		StPerfTimer timer(timing["doubled ATC nodes"]);
+		set<WED_Thing*> points = WED_select_doubles(apt);
+		if(points.size())
+		{
+			msgs.push_back(validation_error_t("Airport contains doubled ATC routing nodes. These should be merged.", err_airport_no_name, points, apt));
+		}
 	}
-
-	edges = WED_do_select_crossing(apt);
-	if(edges.size())
 	{
-		msgs.push_back(validation_error_t("Airport contains crossing ATC routing lines with no node at the crossing point.  Split the lines and join the nodes.", err_airport_no_name, edges, apt));
+		StPerfTimer timer(timing["crossing ATC routes"]);
+		set<WED_GISEdge*> edges = WED_do_select_crossing(apt);
+		if(edges.size())
+		{
+			msgs.push_back(validation_error_t("Airport contains crossing ATC routing lines with no node at the crossing point.  Split the lines and join the nodes.", err_airport_no_name, edges, apt));
+		}
 	}
 #endif
 
@@ -1969,56 +2038,76 @@ static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs,
 		msgs.push_back(validation_error_t(string("The airport '") + name + "' contains no runways, sea lanes, or helipads.", err_airport_no_rwys_sealanes_or_helipads, apt,apt));
 	
 	#if !GATEWAY_IMPORT_FEATURES
-	WED_DoATCRunwayChecks(*apt, msgs);
-	#endif
-
-	ValidateATC(apt, msgs, legal_rwy_oneway, legal_rwy_twoway);
-
-	ValidateAirportFrequencies(apt,msgs);
-
-
-	for(vector<WED_AirportSign *>::iterator s = signs.begin(); s != signs.end(); ++s)
 	{
-		ValidateOneTaxiSign(*s, msgs,apt);
+		StPerfTimer timer(timing["ATC runway checks"]);
+		WED_DoATCRunwayChecks(*apt, msgs);
 	}
+	#endif
 
-	for(vector<WED_Taxiway *>::iterator t = taxiways.begin(); t != taxiways.end(); ++t)
 	{
-		ValidateOneTaxiway(*t,msgs,apt);
+		StPerfTimer timer(timing["ATC flows and taxi routes"]);
+		ValidateATC(apt, msgs, legal_rwy_oneway, legal_rwy_twoway, timing);
 	}
-
-	for (vector<WED_TruckDestination*>::iterator t_dest = truck_destinations.begin(); t_dest != truck_destinations.end(); ++t_dest)
 	{
-		ValidateOneTruckDestination(*t_dest, msgs, apt);
+		StPerfTimer timer(timing["frequencies"]);
+		ValidateAirportFrequencies(apt,msgs);
 	}
 
-	for(vector<WED_TruckParkingLocation*>::iterator t_park = truck_parking_locs.begin(); t_park != truck_parking_locs.end(); ++t_park)
 	{
-		ValidateOneTruckParking(*t_park,msgs,apt);
+		StPerfTimer timer(timing["signs"]);
+		for(vector<WED_AirportSign *>::iterator s = signs.begin(); s != signs.end(); ++s)
+		{
+			ValidateOneTaxiSign(*s, msgs,apt);
+		}
 	}
-
-	for(vector<WED_Thing *>::iterator r = runway_or_sealane.begin(); r != runway_or_sealane.end(); ++r)
 	{
-		ValidateOneRunwayOrSealane(*r, msgs,apt);
+		StPerfTimer timer(timing["taxiways"]);
+		for(vector<WED_Taxiway *>::iterator t = taxiways.begin(); t != taxiways.end(); ++t)
+		{
+			ValidateOneTaxiway(*t,msgs,apt);
+		}
 	}
-
-	for(vector<WED_Helipad *>::iterator h = helipads.begin(); h != helipads.end(); ++h)
 	{
-		ValidateOneHelipad(*h, msgs,apt);
+		StPerfTimer timer(timing["truck destinations and parking"]);
+		for (vector<WED_TruckDestination*>::iterator t_dest = truck_destinations.begin(); t_dest != truck_destinations.end(); ++t_dest)
+		{
+			ValidateOneTruckDestination(*t_dest, msgs, apt);
+		}
+
+		for(vector<WED_TruckParkingLocation*>::iterator t_park = truck_parking_locs.begin(); t_park != truck_parking_locs.end(); ++t_park)
+		{
+			ValidateOneTruckParking(*t_park,msgs,apt);
+		}
 	}
+	{
+		StPerfTimer timer(timing["runways, sealanes and helipads"]);
+		for(vector<WED_Thing *>::iterator r = runway_or_sealane.begin(); r != runway_or_sealane.end(); ++r)
+		{
+			ValidateOneRunwayOrSealane(*r, msgs,apt);
+		}
 
-	for(vector<WED_RampPosition *>::iterator r = ramps.begin(); r != ramps.end(); ++r)
+		for(vector<WED_Helipad *>::iterator h = helipads.begin(); h != helipads.end(); ++h)
+		{
+			ValidateOneHelipad(*h, msgs,apt);
+		}
+	}
 	{
-		ValidateOneRampPosition(*r,msgs,apt);
+		StPerfTimer timer(timing["ramp starts"]);
+		for(vector<WED_RampPosition *>::iterator r = ramps.begin(); r != ramps.end(); ++r)
+		{
+			ValidateOneRampPosition(*r,msgs,apt);
+		}
 	}
 
 	if(gExportTarget >= wet_xplane_1050)
 	{
+		StPerfTimer timer(timing["airport metadata"]);
 		ValidateAirportMetadata(apt,msgs,apt);
 	}
 
 	if(gExportTarget == wet_gateway)
 	{
+		StPerfTimer timer(timing["gateway rules and CIFP runways"]);
 		Bbox2 bounds;
 		apt->GetBounds(gis_Geo, bounds);
 		if(bounds.xspan() > MAX_LON_SPAN_GATEWAY ||
@@ -2049,7 +2138,10 @@ static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs,
 			pol_info_t pol;
 			
 			(*o)->GetResource(res);
-			res_mgr->GetPol(res,pol);
+			{
+				StMutexLock lock(sResMgrLock);
+				res_mgr->GetPol(res,pol);
+			}
 
 			if (!pol.mSubBoxes.size())
 			{
@@ -2221,6 +2313,7 @@ static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs,
 	}
 	else  // target is NOT the gateway
 	{
+		StPerfTimer timer(timing["UV maps"]);
 		vector<WED_TextureNode *>			tex_nodes;
 		vector<WED_TextureBezierNode *>	tex_nodes_curved;
 		CollectRecursive(apt, back_inserter(tex_nodes),WED_TextureNode::sClass);
@@ -2249,12 +2342,70 @@ static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs,
 			}
 		}
 	}
-	ValidatePointSequencesRecursive(apt, msgs,apt);
-	ValidateDSFRecursive(apt, lib_mgr, msgs, apt);
+	{
+		StPerfTimer timer(timing["point sequences"]);
+		ValidatePointSequencesRecursive(apt, msgs,apt);
+	}
+	{
+		StPerfTimer timer(timing["scenery objects and polygons"]);
+		ValidateDSFRecursive(apt, lib_mgr, msgs, apt);
+	}
 }
 
 
-bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
+// What a validator threw on a worker thread.  C++98 can't carry the exception itself across threads, so we keep enough
+// to throw the same thing again on the main thread once every airport is done.
+struct	validate_failure_t {
+	enum { none, wed_assert, out_of_memory, other } kind;
+	const char *	cond;
+	const char *	file;
+	int				line;
+	string			what;
+
+	validate_failure_t() : kind(none), cond(NULL), file(NULL), line(0) { }
+	void	rethrow(void) const
+	{
+		switch(kind) {
+		case wed_assert:	throw wed_assert_fail_exception(cond, file, line);
+		case out_of_memory:	throw bad_alloc();
+		default:			throw TU_WorkerException(what.c_str());
+		}
+	}
+};
+
+struct	validate_apt_job_t {
+	vector<WED_Airport *> *			apts;
+	WED_LibraryMgr *				lib_mgr;
+	WED_ResourceMgr *				res_mgr;
+	MFMemFile *						mf;
+	vector<validation_error_vector>	msgs;		// One slot per airport, so the merged list is in airport order
+	vector<check_timing_map>		timing;		// no matter which thread finishes first.
+	vector<validate_failure_t>		failure;
+};
+
+static void ValidateOneAirportCB(int n, void * ref)
+{
+	validate_apt_job_t * job = (validate_apt_job_t *) ref;
+	validate_failure_t& f(job->failure[n]);
+	try {
+		ValidateOneAirport((*job->apts)[n], job->msgs[n], job->lib_mgr, job->res_mgr, job->mf, job->timing[n]);
+	} catch(wed_assert_fail_exception& e) {
+		f.kind = validate_failure_t::wed_assert;
+		f.cond = e.c_;
+		f.file = e.f_;
+		f.line = e.l_;
+	} catch(bad_alloc&) {
+		f.kind = validate_failure_t::out_of_memory;
+	} catch(exception& e) {
+		f.kind = validate_failure_t::other;
+		f.what = e.what();
+	} catch(...) {
+		f.kind = validate_failure_t::other;
+		f.what = "unknown exception";
+	}
+}
+
+static bool ValidateAll(IResolver * resolver, WED_Thing * wrl, validation_error_vector& msgs, string& logfile, validation_error_vector::iterator& first_error, bool interactive)
 {
 #if DEBUG_VIS_LINES
 	//Clear the previously drawn lines before every validation
@@ -2263,7 +2414,7 @@ bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
 	gMeshPolygons.clear();
 #endif
 
-	validation_error_vector		msgs;
+	check_timing_map			timing;
 
 	if(wrl == NULL) wrl = WED_GetWorld(resolver);
 
@@ -2282,7 +2433,12 @@ bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
 		string cert;
 		
 		if(!GUI_GetTempResourcePath("gateway.crt", cert))
-			DoUserAlert("This copy of WED is damaged - the certificate for the X-Plane airport gateway is missing.");
+		{
+			if(interactive)
+				DoUserAlert("This copy of WED is damaged - the certificate for the X-Plane airport gateway is missing.");
+			else
+				fprintf(stderr, "This copy of WED is damaged - the certificate for the X-Plane airport gateway is missing.\n");
+		}
 			
 		mCacheRequest.in_cert = cert;
 		mCacheRequest.in_domain = cache_domain_metadata_csv;    // cache expiration time = 1 day
@@ -2315,15 +2471,44 @@ bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
 			stringstream ss;
 			ss << "Error downloading list of CIFP data compliant runway names and coordinates from scenery gateway.\n" << res.out_error_human;
 			ss << "\nSkipping this part of validation.";
-			DoUserAlert(ss.str().c_str());
+			if(interactive)
+				DoUserAlert(ss.str().c_str());
+			else
+				fprintf(stderr, "%s\n", ss.str().c_str());
 		}
 		else
 			mf = MemFile_Open(res.out_path.c_str());
 	}
 
-	for(vector<WED_Airport *>::iterator a = apts.begin(); a != apts.end(); ++a)
+	validate_apt_job_t	job;
+	job.apts = &apts;
+	job.lib_mgr = lib_mgr;
+	job.res_mgr = res_mgr;
+	job.mf = mf;
+	job.msgs.resize(apts.size());
+	job.timing.resize(apts.size());
+	job.failure.resize(apts.size());
+
+#if DEBUG_VIS_LINES
+	TU_ParallelFor(apts.size(), ValidateOneAirportCB, &job, 1);		// The debug lines are one global list.
+#else
+	TU_ParallelFor(apts.size(), ValidateOneAirportCB, &job);
+#endif
+
+	// If a validator blew up, fail the way a serial run would have: the first airport's exception, on this thread.
+	for(int a = 0; a < apts.size(); ++a)
+	if(job.failure[a].kind != validate_failure_t::none)
+	{
+		if (mf) MemFile_Close(mf);
+		WED_ShowDeferredAssert();
+		job.failure[a].rethrow();
+	}
+
+	for(int a = 0; a < apts.size(); ++a)
 	{
-		ValidateOneAirport(*a, msgs, lib_mgr, res_mgr, mf);
+		msgs.insert(msgs.end(), job.msgs[a].begin(), job.msgs[a].end());
+		for(check_timing_map::iterator t = job.timing[a].begin(); t != job.timing[a].end(); ++t)
+			timing[t->first].Add(t->second);
 	}
 	if (mf) MemFile_Close(mf);
 
@@ -2332,13 +2517,19 @@ bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
 	// So...IF wrl (which MIGHT be the world or MIGHt be a selection or might be an airport) turns out to
 	// be an airport, we hvae to tell it "this is our credited airport."  Dynamic cast gives us the airport
 	// or null for 'free' stuff.
-	ValidatePointSequencesRecursive(wrl, msgs,dynamic_cast<WED_Airport *>(wrl));
-	ValidateDSFRecursive(wrl, lib_mgr, msgs, dynamic_cast<WED_Airport *>(wrl));
+	{
+		StPerfTimer timer(timing["point sequences"]);
+		ValidatePointSequencesRecursive(wrl, msgs,dynamic_cast<WED_Airport *>(wrl));
+	}
+	{
+		StPerfTimer timer(timing["scenery objects and polygons"]);
+		ValidateDSFRecursive(wrl, lib_mgr, msgs, dynamic_cast<WED_Airport *>(wrl));
+	}
 	
-	string logfile(gPackageMgr->ComputePath(lib_mgr->GetLocalPackage(), "validation_report.txt"));
+	logfile = gPackageMgr->ComputePath(lib_mgr->GetLocalPackage(), "validation_report.txt");
 	FILE * fi = fopen(logfile.c_str(), "w");
 
-	validation_error_vector::iterator first_error = msgs.end();
+	first_error = msgs.end();
 	for(validation_error_vector::iterator v = msgs.begin(); v != msgs.end(); ++v)
 	{
 		const char * warn = "";
@@ -2355,7 +2546,32 @@ bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
 			fprintf(fi, "%s: %s %s\n", aname.c_str(), v->msg.c_str(), warn);
 		fprintf(stdout, "%s: %s %s\n", aname.c_str(), v->msg.c_str(), warn);
 	}
-	fclose(fi);
+	if (fi != NULL)
+	{
+		WriteCheckTiming(fi, timing);
+		fclose(fi);
+	}
+
+	if(first_error != msgs.end())
+		return GATEWAY_IMPORT_FEATURES;
+	else
+		return msgs.empty() || GATEWAY_IMPORT_FEATURES;
+}
+
+bool	WED_ValidateAptNoUI(IResolver * resolver, validation_error_vector& msgs, string& out_report, WED_Thing * wrl)
+{
+	validation_error_vector::iterator first_error;
+	return ValidateAll(resolver, wrl, msgs, out_report, first_error, false);
+}
+
+bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
+{
+	validation_error_vector				msgs;
+	string								logfile;
+	validation_error_vector::iterator	first_error;
+
+	if(wrl == NULL) wrl = WED_GetWorld(resolver);
+	bool ok = ValidateAll(resolver, wrl, msgs, logfile, first_error, true);
 
 	if(!msgs.empty())
 	{
@@ -2373,8 +2589,5 @@ bool	WED_ValidateApt(IResolver * resolver, WED_Thing * wrl)
 			                     + "\n\nFor a full list of messages see\n" + logfile).c_str());
 	}
 
-	if(first_error != msgs.end())
-		return GATEWAY_IMPORT_FEATURES;
-	else
-		return msgs.empty() || GATEWAY_IMPORT_FEATURES;
+	return ok;
 }
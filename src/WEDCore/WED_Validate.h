@@ -178,6 +178,10 @@ typedef vector<validation_error_t> validation_error_vector;
 // Collection primitives - these recursively walk the composition and pull out all entities of a given type.
 bool	WED_ValidateApt(IResolver * resolver, WED_Thing * root = NULL);	// if root not null, only do this sub-tree
 
+// Same checks and report as WED_ValidateApt, but with no UI - the selection is left alone and nothing is put up on
+// screen - for batch runs.  Airports are validated in parallel; msgs comes back in airport order either way.
+bool	WED_ValidateAptNoUI(IResolver * resolver, validation_error_vector& msgs, string& out_report, WED_Thing * root = NULL);
+
 template <typename T>
 validation_error_t::validation_error_t(const string& m, validate_error_t error_code, const T& container, WED_Airport * a) :
 	msg(m), err_code(error_code), airport(a)
@@ -49,11 +49,14 @@ void	WED_XMLReader::FailWithError(const string& e)
 	XML_StopParser(parser, false);		// we're dead!
 }
 
-string	WED_XMLReader::ReadFile(const char * filename, bool * exists)
+string	WED_XMLReader::ReadFile(const char * filename, bool * exists, const char * trailer, const char * commit_tag, bool * torn)
 {
+	err.clear();
 	XML_ParserReset(parser, NULL);
 	XML_SetElementHandler(parser, StartElementHandler, EndElementHandler);
 	XML_SetUserData(parser, reinterpret_cast<void*>(this));
+	if(torn)
+		*torn = false;
 
 	FILE * fi = fopen(filename,"rb");
 
@@ -70,22 +73,63 @@ string	WED_XMLReader::ReadFile(const char * filename, bool * exists)
 	}
 	char buf[1024];
 
-	//While there is something left to read
-	while(!feof(fi))
+	if(commit_tag)
 	{
-		//len is the amount of read in this loop
-		int len = fread(buf,1,sizeof(buf),fi);
-		if(len > 0)
-		if(XML_Parse(parser, buf, len, 0) == XML_STATUS_ERROR)
+		// We can't know where the last finished record ends until we've seen the whole file, so slurp it
+		// and hand expat only the committed part.
+		string committed;
+		while(!feof(fi))
+		{
+			int len = fread(buf,1,sizeof(buf),fi);
+			if(len > 0)
+				committed.append(buf,len);
+			else
+				break;
+		}
+		fclose(fi);
+
+		string::size_type last = committed.rfind(commit_tag);
+		string::size_type keep = (last == string::npos) ? 0 : last + strlen(commit_tag);
+		if(keep < committed.size() && committed.find_first_not_of(" \t\r\n", keep) != string::npos)
+		{
+			if(torn)
+				*torn = true;
+		}
+		// With no finished record at all there is nothing to apply - not even the header is worth reading.
+		if(keep == 0)
+			return err;
+		committed.resize(keep);
+
+		if(XML_Parse(parser, committed.c_str(), committed.size(), 0) == XML_STATUS_ERROR)
 		{
 			XML_Error e = XML_GetErrorCode(parser);
 			if(err.empty())
 				err = XML_ErrorString(e);
 			printf("%s At: %zd,%zd\n", err.c_str(), XML_GetCurrentLineNumber(parser), XML_GetCurrentColumnNumber(parser));
-			break;
 		}
-		//if total read == 0
 	}
+	else
+	{
+		//While there is something left to read
+		while(!feof(fi))
+		{
+			//len is the amount of read in this loop
+			int len = fread(buf,1,sizeof(buf),fi);
+			if(len > 0)
+			if(XML_Parse(parser, buf, len, 0) == XML_STATUS_ERROR)
+			{
+				XML_Error e = XML_GetErrorCode(parser);
+				if(err.empty())
+					err = XML_ErrorString(e);
+				printf("%s At: %zd,%zd\n", err.c_str(), XML_GetCurrentLineNumber(parser), XML_GetCurrentColumnNumber(parser));
+				break;
+			}
+			//if total read == 0
+		}
+		fclose(fi);
+	}
+	if(trailer && err.empty())
+		XML_Parse(parser, trailer, strlen(trailer), 0);
 	//It reads it again so it can finish off any last pieces remaining
 	XML_Parse(parser, buf, 0, 1);
 	XML_Error result = XML_GetErrorCode(parser);
@@ -95,7 +139,6 @@ string	WED_XMLReader::ReadFile(const char * filename, bool * exists)
 	{
 		err = XML_ErrorString(result);
 	}
-	fclose(fi);
 
 	return err;
 }
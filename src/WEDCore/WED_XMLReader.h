@@ -66,8 +66,11 @@ public:
 	void	PushHandler(WED_XMLHandler * handler);
 	void	FailWithError(const string& err);
 	
-	// Returns err msg or "" for none.
-	string	ReadFile(const char * filename, bool * exists);
+	// Returns err msg or "" for none.  If trailer is provided, it is parsed as if it was at the end of the
+	// file - this lets an append-only file leave its root element open.  If commit_tag is provided, only the
+	// file up to and including the last copy of commit_tag is parsed; anything after it is a record that was
+	// never finished (crash, full disk) and is skipped, and *torn is set.
+	string	ReadFile(const char * filename, bool * exists, const char * trailer = NULL, const char * commit_tag = NULL, bool * torn = NULL);
 
 private:
 
@@ -23,6 +23,7 @@
 
 #include "WED_HandleToolBase.h"
 #include "WED_MapZoomerNew.h"
+#include "WED_Map.h"
 #include "WED_ToolUtils.h"
 #include "WED_Entity.h"
 #include "WED_Colors.h"
@@ -456,6 +457,12 @@ int		WED_HandleToolBase::ProcessSelectionRecursive(
 	if(com && com->GetGISClass() != gis_Composite) com = NULL;
 	if(seq && seq->GetGISClass() == gis_Composite) seq = NULL;
 	if(poly && poly->GetGISClass() != gis_Polygon) poly = NULL;
+
+	// A child can only hit if its slop-grown bounds do, so the map's index can skip the rest of a big composite.
+	WED_Map *	map = dynamic_cast<WED_Map *>(GetHost());
+	Bbox2		kid_bounds(bounds.p1 - Vector2(max_slop_h,max_slop_v), bounds.p2 + Vector2(max_slop_h,max_slop_v));
+	vector<int>	kids;
+
 	//string n = "???";
 	//	if (thang) thang->GetName(n);
 	//printf("Recursive traverse on %s: com=%p seq=%p, poly=%p, choice=%d\n", n.c_str(), com,seq,poly,choice);
@@ -467,9 +474,17 @@ int		WED_HandleToolBase::ProcessSelectionRecursive(
 	case ent_Container:
 		if (com)
 		{
-			int count = com->GetNumEntities();
-			for (int n = 0; n < count; ++n)
-				if (ProcessSelectionRecursive(com->GetNthEntity(n),bounds,result,false) && pt_sel) return 1;
+			if (map && map->GetIndex()->QueryChildren(com, kid_bounds, kids))
+			{
+				for (vector<int>::iterator k = kids.begin(); k != kids.end(); ++k)
+					if (ProcessSelectionRecursive(com->GetNthEntity(*k),bounds,result,false) && pt_sel) return 1;
+			}
+			else
+			{
+				int count = com->GetNumEntities();
+				for (int n = 0; n < count; ++n)
+					if (ProcessSelectionRecursive(com->GetNthEntity(n),bounds,result,false) && pt_sel) return 1;
+			}
 		}
 		else if (seq)
 		{
@@ -490,9 +505,17 @@ int		WED_HandleToolBase::ProcessSelectionRecursive(
 			result.insert(entity);
 		else if (com)
 		{
-			int count = com->GetNumEntities();
-			for (int n = 0; n < count; ++n)
-				if (ProcessSelectionRecursive(com->GetNthEntity(n),bounds,result,false) && pt_sel) return 1;
+			if (map && map->GetIndex()->QueryChildren(com, kid_bounds, kids))
+			{
+				for (vector<int>::iterator k = kids.begin(); k != kids.end(); ++k)
+					if (ProcessSelectionRecursive(com->GetNthEntity(*k),bounds,result,false) && pt_sel) return 1;
+			}
+			else
+			{
+				int count = com->GetNumEntities();
+				for (int n = 0; n < count; ++n)
+					if (ProcessSelectionRecursive(com->GetNthEntity(n),bounds,result,false) && pt_sel) return 1;
+			}
 		}
 		else if (seq)
 		{
@@ -297,7 +297,7 @@ void		WED_Map::Draw(GUI_GraphState * state)
 
 void		WED_Map::DrawVisFor(WED_MapLayer * layer, int current, const Bbox2& bounds, IGISEntity * what, GUI_GraphState * g, ISelection * sel, int depth)
 {
-	if(!what->Cull(bounds))	return;
+	if(!mIndex.Cull(what, bounds))	return;
 	IGISComposite * c;
 
 	if(!layer->IsVisibleNow(what))	return;
@@ -313,16 +313,25 @@ void		WED_Map::DrawVisFor(WED_MapLayer * layer, int current, const Bbox2& bounds
 		Vector2 span(p1,p2);
 		if(max(span.dx, span.dy) > TOO_SMALL_TO_GO_IN || (p1 == p2) || depth == 0)		// Why p1 == p2?  If the composite contains ONLY ONE POINT it is zero-size.  We'd LOD out.  But if it contains one thing
 		{																				// then we might as well ALWAYS draw it - it's relatively cheap!
-			int t = c->GetNumEntities();												// Depth == 0 means we draw ALL top level objects -- good for airports.
-			for (int n = t-1; n >= 0; --n)
-				DrawVisFor(layer, current, bounds, c->GetNthEntity(n), g, sel, depth+1);
+			vector<int>	kids;															// Depth == 0 means we draw ALL top level objects -- good for airports.
+			if (mIndex.QueryChildren(c, bounds, kids))
+			{
+				for (int k = kids.size()-1; k >= 0; --k)
+					DrawVisFor(layer, current, bounds, c->GetNthEntity(kids[k]), g, sel, depth+1);
+			}
+			else
+			{
+				int t = c->GetNumEntities();
+				for (int n = t-1; n >= 0; --n)
+					DrawVisFor(layer, current, bounds, c->GetNthEntity(n), g, sel, depth+1);
+			}
 		}
 	}
 }
 
 void		WED_Map::DrawStrFor(WED_MapLayer * layer, int current, const Bbox2& bounds, IGISEntity * what, GUI_GraphState * g, ISelection * sel, int depth)
 {
-	if(!what->Cull(bounds))	return;
+	if(!mIndex.Cull(what, bounds))	return;
 	IGISComposite * c;
 
 	if(!layer->IsVisibleNow(what))	return;
@@ -339,9 +348,18 @@ void		WED_Map::DrawStrFor(WED_MapLayer * layer, int current, const Bbox2& bounds
 		Vector2 span(p1,p2);
 		if(max(span.dx, span.dy) > TOO_SMALL_TO_GO_IN || (p1 == p2) || depth == 0)
 		{
-			int t = c->GetNumEntities();
-			for (int n = t-1; n >= 0; --n)
-				DrawStrFor(layer, current, bounds, c->GetNthEntity(n), g, sel, depth+1);
+			vector<int>	kids;
+			if (mIndex.QueryChildren(c, bounds, kids))
+			{
+				for (int k = kids.size()-1; k >= 0; --k)
+					DrawStrFor(layer, current, bounds, c->GetNthEntity(kids[k]), g, sel, depth+1);
+			}
+			else
+			{
+				int t = c->GetNumEntities();
+				for (int n = t-1; n >= 0; --n)
+					DrawStrFor(layer, current, bounds, c->GetNthEntity(n), g, sel, depth+1);
+			}
 		}
 	}
 }
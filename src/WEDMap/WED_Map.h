@@ -28,6 +28,7 @@
 #include "GUI_Pane.h"
 #include "WED_MapZoomerNew.h"
 #include "GUI_Listener.h"
+#include "WED_MapIndex.h"
 #include <stdint.h>
 
 extern	int	gDMS;		// degrees, mins, seconds
@@ -67,6 +68,9 @@ public:
 							intptr_t				inMsg,
 							intptr_t				inParam);
 
+	// Spatial index of the GIS hierarchy - tools can use it for hit testing too.
+			WED_MapIndex *	GetIndex(void) { return &mIndex; }
+
 private:
 
 			void		DrawVisFor(WED_MapLayer * layer, int current, const Bbox2& bounds, IGISEntity * what, GUI_GraphState * g, ISelection * sel, int depth);
@@ -77,6 +81,7 @@ private:
 
 
 	vector<WED_MapLayer *>			mLayers;
+	WED_MapIndex					mIndex;
 	WED_MapToolNew *				mTool;
 	IResolver *						mResolver;
 
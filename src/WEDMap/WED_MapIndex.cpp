@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "WED_MapIndex.h"
+#include "WED_Archive.h"
+#include "WED_GISComposite.h"
+#include "WED_ObjPlacement.h"
+#include "WED_Runway.h"
+#include "WED_Messages.h"
+#include "GUI_Broadcaster.h"
+#include "RTree2.h"
+#include "IGIS.h"
+
+// Composites with fewer entities than this are just iterated - the tree wouldn't pay for itself.
+#define INDEX_MIN_CHILDREN 64
+
+// Once this many of a composite's children have moved since we built its tree, build a new one.
+#define INDEX_MAX_STALE(count) ((count) / 8 + 16)
+
+struct	WED_MapIndex::child_index {
+	RTree2<int, 16>		tree;		// Entity index, keyed on its cull box.
+	hash_map<int, int>	slot;		// Child's ID -> entity index.
+	set<int>			stale;		// Entity indices whose box may have changed since we built.
+	int					count;
+};
+
+// A box that contains every box Cull could say yes to.  Composites and objects cull with the fudge factor; runways add
+// blast pads and shoulders that hang past their bounds by less than that.
+static void	GetCullBounds(IGISEntity * e, Bbox2& out_bounds)
+{
+	e->GetBounds(gis_Geo, out_bounds);
+	if(e->GetGISClass() == gis_Composite || dynamic_cast<WED_ObjPlacement *>(e) || dynamic_cast<WED_Runway *>(e))
+		out_bounds.expand(GLOBAL_WED_ART_ASSET_FUDGE_FACTOR);
+}
+
+WED_MapIndex::WED_MapIndex() : mArchive(NULL)
+{
+}
+
+WED_MapIndex::~WED_MapIndex()
+{
+	// GUI_Listener unhooks us from the archive - it may already be gone, so don't touch it.
+	for(IndexMap::iterator i = mIndices.begin(); i != mIndices.end(); ++i)
+		delete i->second;
+}
+
+void	WED_MapIndex::ReceiveMessage(
+							GUI_Broadcaster *		inSrc,
+							intptr_t				inMsg,
+							intptr_t				inParam)
+{
+	if(inMsg == msg_ArchiveObjectChanged)
+		mChanged.insert(inParam);
+}
+
+void	WED_MapIndex::SetArchive(WED_Archive * archive)
+{
+	if(archive == mArchive) return;
+	if(mArchive)
+		mArchive->GetObjectBroadcaster()->RemoveListener(this);
+	for(IndexMap::iterator i = mIndices.begin(); i != mIndices.end(); ++i)
+		delete i->second;
+	mIndices.clear();
+	mChanged.clear();
+	mArchive = archive;
+	if(mArchive)
+		mArchive->GetObjectBroadcaster()->AddListener(this);
+}
+
+void	WED_MapIndex::Drop(int id)
+{
+	IndexMap::iterator i = mIndices.find(id);
+	if(i != mIndices.end())
+	{
+		delete i->second;
+		mIndices.erase(i);
+	}
+}
+
+void	WED_MapIndex::MarkChanged(WED_Thing * who, set<WED_Thing *>& visited)
+{
+	if(!visited.insert(who).second)
+		return;
+
+	// Anything viewing us (an edge viewing its nodes) has moved with us, wherever it lives.
+	set<WED_Thing *>	viewers;
+	who->GetAllViewers(viewers);
+	for(set<WED_Thing *>::iterator v = viewers.begin(); v != viewers.end(); ++v)
+		MarkChanged(*v, visited);
+
+	WED_Thing * parent = who->GetParent();
+	if(parent == NULL)
+		return;
+
+	IndexMap::iterator i = mIndices.find(parent->GetID());
+	if(i != mIndices.end())
+	{
+		child_index * idx = i->second;
+		hash_map<int, int>::iterator s = idx->slot.find(who->GetID());
+		if(s == idx->slot.end())
+			Drop(parent->GetID());
+		else
+		{
+			idx->stale.insert(s->second);
+			if((int) idx->stale.size() > INDEX_MAX_STALE(idx->count))
+				Drop(parent->GetID());
+		}
+	}
+	MarkChanged(parent, visited);
+}
+
+void	WED_MapIndex::Sync(void)
+{
+	if(mChanged.empty())
+		return;
+
+	set<WED_Thing *>	visited;
+	for(set<int>::iterator id = mChanged.begin(); id != mChanged.end(); ++id)
+	{
+		// If the changed object is itself indexed, its list of children may be different now.
+		Drop(*id);
+		WED_Thing * who = dynamic_cast<WED_Thing *>(mArchive->Fetch(*id));
+		if(who)
+			MarkChanged(who, visited);
+	}
+	mChanged.clear();
+}
+
+WED_MapIndex::child_index *	WED_MapIndex::GetIndex(IGISComposite * what)
+{
+	WED_GISComposite * comp = dynamic_cast<WED_GISComposite *>(what);
+	if(comp == NULL)
+		return NULL;
+
+	int count = what->GetNumEntities();
+	if(count < INDEX_MIN_CHILDREN)
+		return NULL;
+
+	SetArchive(comp->GetArchive());
+	Sync();
+
+	IndexMap::iterator i = mIndices.find(comp->GetID());
+	if(i != mIndices.end())
+		return i->second;
+
+	child_index * idx = new child_index;
+	idx->count = count;
+
+	vector<pair<Bbox2, int> >	items;
+	items.reserve(count);
+	for(int n = 0; n < count; ++n)
+	{
+		IGISEntity * ent = what->GetNthEntity(n);
+		WED_Thing * thing = dynamic_cast<WED_Thing *>(ent);
+		if(thing)
+			idx->slot[thing->GetID()] = n;
+		else
+			idx->stale.insert(n);			// Can't track it - always return it.
+
+		Bbox2	b;
+		GetCullBounds(ent, b);
+		items.push_back(pair<Bbox2, int>(b, n));
+	}
+	idx->tree.insert(items.begin(), items.end());
+
+	mIndices[comp->GetID()] = idx;
+	return idx;
+}
+
+bool	WED_MapIndex::QueryChildren(IGISComposite * what, const Bbox2& where, vector<int>& out_children)
+{
+	child_index * idx = GetIndex(what);
+	if(idx == NULL)
+		return false;
+
+	out_children.clear();
+	idx->tree.query_value(where, back_inserter(out_children));
+	out_children.insert(out_children.end(), idx->stale.begin(), idx->stale.end());
+	sort(out_children.begin(), out_children.end());
+	out_children.erase(unique(out_children.begin(), out_children.end()), out_children.end());
+	return true;
+}
+
+bool	WED_MapIndex::Cull(IGISEntity * what, const Bbox2& bounds)
+{
+	IGISComposite * c;
+	if(what->GetGISClass() != gis_Composite || (c = dynamic_cast<IGISComposite *>(what)) == NULL)
+		return what->Cull(bounds);
+
+	vector<int>	kids;
+	bool indexed = QueryChildren(c, bounds, kids);
+	if(!indexed && dynamic_cast<WED_GISComposite *>(what) == NULL)
+		return what->Cull(bounds);
+
+	// This is WED_GISComposite::Cull, but only looking at the children that can possibly pass - and
+	// going through us for the ones that are themselves composites, since they may be indexed.
+	Bbox2	me;
+	what->GetBounds(gis_Geo, me);
+	me.expand(GLOBAL_WED_ART_ASSET_FUDGE_FACTOR);
+	if(!bounds.overlap(me))
+		return false;
+
+	if(indexed)
+	{
+		for(vector<int>::iterator k = kids.begin(); k != kids.end(); ++k)
+			if(Cull(c->GetNthEntity(*k), bounds))
+				return true;
+	}
+	else
+	{
+		int n = c->GetNumEntities();
+		for(int i = 0; i < n; ++i)
+			if(Cull(c->GetNthEntity(i), bounds))
+				return true;
+	}
+	return false;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2017, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef WED_MapIndex_H
+#define WED_MapIndex_H
+
+#include "CompGeomDefs2.h"
+#include "GUI_Listener.h"
+
+class	IGISEntity;
+class	IGISComposite;
+class	WED_Archive;
+class	WED_Thing;
+
+/*
+	WED_MapIndex - THEORY OF OPERATION
+
+	Drawing and picking walk the GIS hierarchy, and a big composite (the world with thousands of airports, or an airport
+	with thousands of pieces) means thousands of Cull calls per pass, most of which say no.  So for each big composite we
+	keep an RTree2 of its children, keyed on a box that contains anything the child's Cull could say yes to: its bounds,
+	grown by the art-asset fudge factor for composites, objects and runways, which hang off their bounds.  Queries return
+	a superset of the children that matter; callers still run the exact test on each one, so the result is the same as
+	walking every child.
+
+	RTree2 can't be edited, so changes are handled lazily.  The archive tells us the ID of every object that changes; on
+	the next query we walk up from each one (and from anything viewing it, e.g. the edges on a moved taxi node), marking
+	the child it lives under in every indexed ancestor as "stale".  Stale children are always returned.  An indexed
+	composite that changes itself (children added, removed, reordered) is thrown out, as is one with too many stale
+	children; either is rebuilt the next time it is queried.
+
+*/
+
+class	WED_MapIndex : public GUI_Listener {
+public:
+
+						 WED_MapIndex();
+	virtual				~WED_MapIndex();
+
+	// Same answer as what->Cull(bounds), but uses the index to check the children of big composites.
+	bool				Cull(IGISEntity * what, const Bbox2& bounds);
+
+	// Fills out_children with the entity indices (ascending) of every child of 'what' whose bounds might hit 'where'.
+	// Returns false if 'what' is not indexed (it is small or not a WED composite) - the caller must check all children.
+	bool				QueryChildren(IGISComposite * what, const Bbox2& where, vector<int>& out_children);
+
+	virtual	void		ReceiveMessage(
+							GUI_Broadcaster *		inSrc,
+							intptr_t				inMsg,
+							intptr_t				inParam);
+
+private:
+
+	struct	child_index;
+	typedef hash_map<int, child_index *>	IndexMap;
+
+	child_index *		GetIndex(IGISComposite * what);
+	void				SetArchive(WED_Archive * archive);
+	void				Sync(void);
+	void				MarkChanged(WED_Thing * who, set<WED_Thing *>& visited);
+	void				Drop(int id);
+
+	IndexMap			mIndices;		// By the composite's ID.
+	set<int>			mChanged;		// IDs the archive has told us about since the last Sync.
+	WED_Archive *		mArchive;
+
+	WED_MapIndex(const WED_MapIndex&);
+	WED_MapIndex& operator=(const WED_MapIndex&);
+
+};
+
+#endif /* WED_MapIndex_H */
@@ -73,6 +73,7 @@
 #include "WED_HierarchyUtils.h"
 #include "WED_Orthophoto.h"
 #include "WED_FacadePlacement.h"
+#include "RTree2.h"
 
 #include <sstream>
 
@@ -1045,27 +1046,40 @@ set<WED_Thing *> WED_select_doubles(WED_Thing * t)
 	CollectRecursive(t, back_inserter(pts), ThingNotHidden, IsGraphNode);
 
 	set<WED_Thing *> doubles;
-	
-	// Ben says: yes this totally sucks - replace it someday?
+
+	// Each node is paired with the first LATER node that is too close to it - the index just saves us from
+	// looking at the ones that are far away.
+	vector<Point2>					locs(pts.size());
+	vector<pair<Bbox2, int> >		boxes;
+	boxes.reserve(pts.size());
 	for(int i = 0; i < pts.size(); ++i)
 	{
-		for(int j = i + 1; j < pts.size(); ++j)
+		IGISPoint * ii = dynamic_cast<IGISPoint *>(pts[i]);
+		DebugAssert(ii);
+		ii->GetLocation(gis_Geo, locs[i]);
+		boxes.push_back(pair<Bbox2, int>(Bbox2(locs[i]), i));
+	}
+	RTree2<int, 16>	index;
+	index.insert(boxes.begin(), boxes.end());
+
+	vector<int>	nearby;
+	for(int i = 0; i < pts.size(); ++i)
+	{
+		Bbox2	where(locs[i]);
+		where.expand(DOUBLE_PT_DIST);
+		nearby.clear();
+		index.query_value(where, back_inserter(nearby));
+
+		int first = pts.size();
+		for(vector<int>::iterator j = nearby.begin(); j != nearby.end(); ++j)
+		if(*j > i && *j < first)
+		if(locs[i].squared_distance(locs[*j]) < (DOUBLE_PT_DIST*DOUBLE_PT_DIST))
+			first = *j;
+
+		if(first < pts.size())
 		{
-			IGISPoint * ii = dynamic_cast<IGISPoint *>(pts[i]);
-			IGISPoint * jj = dynamic_cast<IGISPoint *>(pts[j]);
-			DebugAssert(ii != jj);
-			DebugAssert(ii);
-			DebugAssert(jj);
-			Point2 p1, p2;
-			ii->GetLocation(gis_Geo, p1);
-			jj->GetLocation(gis_Geo, p2);
-			
-			if(p1.squared_distance(p2) < (DOUBLE_PT_DIST*DOUBLE_PT_DIST))
-			{
-				doubles.insert(pts[i]);
-				doubles.insert(pts[j]);
-				break;
-			}			
+			doubles.insert(pts[i]);
+			doubles.insert(pts[first]);
 		}
 	}
 	return doubles;
@@ -1105,26 +1119,48 @@ set<WED_GISEdge *> WED_do_select_crossing(WED_Thing * t)
 set<WED_GISEdge *> WED_do_select_crossing(const vector<WED_GISEdge *> edges)
 {
 	set<WED_GISEdge*> crossed_edges;
-	// Ben says: yes this totally sucks - replace it someday?
+
+	// Two edges can only cross if the boxes around their end and control points overlap, so index those
+	// boxes and only run the real test on the pairs that do.
+	vector<Segment2>			segs(edges.size());
+	vector<Bezier2>				bezs(edges.size());
+	vector<bool>				is_bez(edges.size());
+	vector<pair<Bbox2, int> >	boxes;
+	boxes.reserve(edges.size());
 	for (int i = 0; i < edges.size(); ++i)
 	{
-		for (int j = i + 1; j < edges.size(); ++j)
+		IGISEdge * ii = edges[i];
+		DebugAssert(ii);
+		is_bez[i] = ii->GetSide(gis_Geo, 0, segs[i], bezs[i]);
+		Bbox2	box(bezs[i].p1, bezs[i].p2);
+		box += bezs[i].c1;
+		box += bezs[i].c2;
+		boxes.push_back(pair<Bbox2, int>(box, i));
+	}
+	RTree2<int, 16>	index;
+	index.insert(boxes.begin(), boxes.end());
+
+	vector<int>	nearby;
+	for (int i = 0; i < edges.size(); ++i)
+	{
+		Bbox2	where(bezs[i].p1, bezs[i].p2);
+		where += bezs[i].c1;
+		where += bezs[i].c2;
+		nearby.clear();
+		index.query_value(where, back_inserter(nearby));
+
+		for (vector<int>::iterator jj = nearby.begin(); jj != nearby.end(); ++jj)
 		{
-			IGISEdge * ii = edges[i];
-			IGISEdge * jj = edges[j];
-			DebugAssert(ii != jj);
-			DebugAssert(ii);
-			DebugAssert(jj);
-			Segment2 s1, s2;
-			Bezier2 b1, b2;
-			bool isb1, isb2;
-
-			isb1 = ii->GetSide(gis_Geo, 0, s1, b1);
-			isb2 = jj->GetSide(gis_Geo, 0, s2, b2);
-			
-			if (isb1 || isb2)
+			int j = *jj;
+			if (j <= i)
+				continue;
+			DebugAssert(edges[i] != edges[j]);
+			const Segment2& s1(segs[i]);
+			const Segment2& s2(segs[j]);
+
+			if (is_bez[i] || is_bez[j])
 			{   // should never get here, as edges (used for ATC routes only) are not supposed to have bezier segments
-				if (b1.intersect(b2, 10))
+				if (bezs[i].intersect(bezs[j], 10))
 				{
 					crossed_edges.insert(edges[i]);
 					crossed_edges.insert(edges[j]);
@@ -42,6 +42,7 @@
 #include "MapAlgs.h"
 #include "MapTopology.h"
 #include "Zoning.h"
+#include "ThreadUtils.h"
 
 // Minimum bathymetric depth from water surface at any point!
 #define	MIN_DEPTH 10.0f
@@ -426,21 +427,35 @@ void	ReduceToBorder(const DEMGeo& inDEM, DEMGeo& outDEM)
 	}
 }
 
+// Both blobify routines work one row of blocks at a time, spread over all CPUs.  Neighboring blocks share their
+// edge samples and the later block always won, so each row of blocks leaves its top row of samples to the row
+// above it - except the last row, which has no one above it.
+struct	blobify_job {
+	const DEMGeo *	variant_source;
+	const DEMGeo *	base;
+	DEMGeo *		derived;
+	int				xmult;
+	int				ymult;
+};
+
 // This routine takes a low res datasource and upsamples it.  It varies within a linear interpolation block
 // from the min to max seen in the corners based on another DEM used for 'noise' (usually relative elevation).
 // We blend to make sure we have linear interp at the edge of the linear interp block, so we get good tiling.
 // A weight factor also tunes this in and out.
-void BlobifyEnvironment(const DEMGeo& variant_source, const DEMGeo& base, DEMGeo& derived, int xmult, int ymult)
+static void BlobifyEnvironmentRow(int yiz, void * ref)
 {
-	derived.resize((base.mWidth-1)*xmult+1,(base.mHeight-1)*ymult+1);
-	derived.copy_geo_from(base);
+	const blobify_job * job = (const blobify_job *) ref;
+	const DEMGeo& variant_source(*job->variant_source);
+	const DEMGeo& base(*job->base);
+	DEMGeo& derived(*job->derived);
+	int xmult = job->xmult;
+	int ymult = job->ymult;
+	int dy_last = (yiz == base.mHeight-2) ? ymult : ymult-1;
 
-	// for every 'block' to be usampled
-	for (int yiz = 0; yiz < base.mHeight-1; ++yiz)
 	for (int xiz = 0; xiz < base.mWidth-1; ++xiz)
 	{
 		// fer each point
-		for (int dy = 0; dy <= ymult; ++dy)
+		for (int dy = 0; dy <= dy_last; ++dy)
 		for (int dx = 0; dx <= xmult; ++dx)
 		{
 			float dx_fac = (float) dx / (float) xmult;
@@ -488,29 +503,32 @@ void BlobifyEnvironment(const DEMGeo& variant_source, const DEMGeo& base, DEMGeo
 	}
 }
 
-// Same idea as above, but...try to "snap" enums.
-void BlobifyEnvironmentEnum(const DEMGeo& variant_source, const DEMGeo& base, DEMGeo& derived, int xmult, int ymult)
+void BlobifyEnvironment(const DEMGeo& variant_source, const DEMGeo& base, DEMGeo& derived, int xmult, int ymult, int inMaxThreads = 0)
 {
 	derived.resize((base.mWidth-1)*xmult+1,(base.mHeight-1)*ymult+1);
 	derived.copy_geo_from(base);
 
-	// for every 'block' to be usampled
-	for (int yiz = 0; yiz < base.mHeight-1; ++yiz)
+	blobify_job job = { &variant_source, &base, &derived, xmult, ymult };
+	TU_ParallelFor(base.mHeight-1, BlobifyEnvironmentRow, &job, inMaxThreads);
+}
+
+// Same idea as above, but...try to "snap" enums.
+static void BlobifyEnvironmentEnumRow(int yiz, void * ref)
+{
+	const blobify_job * job = (const blobify_job *) ref;
+	const DEMGeo& variant_source(*job->variant_source);
+	const DEMGeo& base(*job->base);
+	DEMGeo& derived(*job->derived);
+	int xmult = job->xmult;
+	int ymult = job->ymult;
+	int dy_last = (yiz == base.mHeight-2) ? ymult : ymult-1;
+
 	for (int xiz = 0; xiz < base.mWidth-1; ++xiz)
 	{
 		// fer each point
-		for (int dy = 0; dy <= ymult; ++dy)
+		for (int dy = 0; dy <= dy_last; ++dy)
 		for (int dx = 0; dx <= xmult; ++dx)
 		{
-			float dx_fac = (float) dx / (float) xmult;
-			float dy_fac = (float) dy / (float) ymult;
-
-			// This is the weights for a linear blend
-			double q1 = 	 dx_fac  * 		dy_fac;
-			double q2 = (1.0-dx_fac) * 		dy_fac;
-			double q3 = 	 dx_fac  * (1.0-dy_fac);
-			double q4 = (1.0-dx_fac) * (1.0-dy_fac);
-
 			// Four corner values
 			float v1 = base.get(xiz+1, yiz+1);
 			float v2 = base.get(xiz  , yiz+1);
@@ -541,6 +559,15 @@ void BlobifyEnvironmentEnum(const DEMGeo& variant_source, const DEMGeo& base, DE
 	}
 }
 
+void BlobifyEnvironmentEnum(const DEMGeo& variant_source, const DEMGeo& base, DEMGeo& derived, int xmult, int ymult, int inMaxThreads = 0)
+{
+	derived.resize((base.mWidth-1)*xmult+1,(base.mHeight-1)*ymult+1);
+	derived.copy_geo_from(base);
+
+	blobify_job job = { &variant_source, &base, &derived, xmult, ymult };
+	TU_ParallelFor(base.mHeight-1, BlobifyEnvironmentEnumRow, &job, inMaxThreads);
+}
+
 
 /*
  * UpsampleFromParamLinear
@@ -839,6 +866,90 @@ void RasterizePolyGreen(Pmwx::Face_const_handle face, DEMGeo& landuse, bool tree
 
 #pragma mark -
 
+/*
+ * RASTER STAGES
+ *
+ * The derived layers form a small dependency graph - most of them need only one or two inputs.  Each stage is
+ * a function plus a bit mask of the stages that must be done before it can run.  RunDEMStages runs every stage
+ * whose inputs are done at once, one per thread, and repeats until all stages are done.
+ *
+ * Many stages are threaded inside too.  Each one is told how many threads it may use - its share of the cores
+ * in this wave - and must pass that to its own TU_ParallelFor calls, or a wave of N stages would start N
+ * times as many threads as we have cores.
+ *
+ * Stages must not index the DEMGeoMap - operator[] can insert - so fetch every layer up front and swap results
+ * in once the stages are done.  Only one stage at a time may read the vector map: CGAL's lazy number types
+ * cache their exact values on first use, so even reads are not thread safe.
+ *
+ */
+struct	DEMStage_t {
+	void (*	func)(void * ref, int max_threads);
+	int		needs;		// Bit mask of the stages (by index) that must run first.
+};
+
+struct	dem_stage_wave {
+	const DEMStage_t *	stages;
+	vector<int>			ready;
+	void *				ref;
+	int					threads;	// Per stage
+};
+
+static void	RunDEMStage(int n, void * ref)
+{
+	dem_stage_wave * w = (dem_stage_wave *) ref;
+	w->stages[w->ready[n]].func(w->ref, w->threads);
+}
+
+static void	RunDEMStages(const DEMStage_t * stages, int count, void * ref)
+{
+	int done = 0;
+	dem_stage_wave	wave;
+	wave.stages = stages;
+	wave.ref = ref;
+	while (done != (1 << count) - 1)
+	{
+		wave.ready.clear();
+		for (int n = 0; n < count; ++n)
+		if ((done & (1 << n)) == 0 && (stages[n].needs & ~done) == 0)
+			wave.ready.push_back(n);
+		DebugAssert(!wave.ready.empty());		// A stage that needs itself, or a cycle.
+		if (wave.ready.empty())
+			break;
+		wave.threads = max(1, TU_GetCPUCount() / (int) wave.ready.size());
+		TU_ParallelFor(wave.ready.size(), RunDEMStage, &wave);
+		for (int n = 0; n < wave.ready.size(); ++n)
+			done |= (1 << wave.ready[n]);
+	}
+}
+
+struct	upsample_env_t {
+	const DEMGeo *	relative_elevation;
+	const DEMGeo *	clim_style;
+	const DEMGeo *	soil_style;
+	const DEMGeo *	agri_style;
+	DEMGeo			derived_clim;
+	DEMGeo			derived_soil;
+	DEMGeo			derived_agri;
+};
+
+static void UpsampleClimStyle(void * ref, int max_threads)
+{
+	upsample_env_t * env = (upsample_env_t *) ref;
+	BlobifyEnvironmentEnum(*env->relative_elevation, *env->clim_style, env->derived_clim, 60, 60, max_threads);
+}
+
+static void UpsampleSoilStyle(void * ref, int max_threads)
+{
+	upsample_env_t * env = (upsample_env_t *) ref;
+	BlobifyEnvironmentEnum(*env->relative_elevation, *env->soil_style, env->derived_soil, 60, 60, max_threads);
+}
+
+static void UpsampleAgriStyle(void * ref, int max_threads)
+{
+	upsample_env_t * env = (upsample_env_t *) ref;
+	BlobifyEnvironmentEnum(*env->relative_elevation, *env->agri_style, env->derived_agri, 60, 60, max_threads);
+}
+
 /*
  * UpsampleEnvironmentalParams
  *
@@ -889,14 +1000,19 @@ void	UpsampleEnvironmentalParams(DEMGeoMap& ioDEMs, ProgressFunc inProg)
 	DEMGeo&		soil_style	 = ioDEMs[dem_SoilStyle];
 	DEMGeo&		agri_style	 = ioDEMs[dem_AgriStyle];
 	DEMGeo&		clim_style	 = ioDEMs[dem_ClimStyle];
-	DEMGeo	derived_clim, derived_soil, derived_agri;
-	
-	BlobifyEnvironmentEnum(ioDEMs[dem_RelativeElevation], clim_style, derived_clim, 60, 60);
-	BlobifyEnvironmentEnum(ioDEMs[dem_RelativeElevation], soil_style, derived_soil, 60, 60);
-	BlobifyEnvironmentEnum(ioDEMs[dem_RelativeElevation], agri_style, derived_agri, 60, 60);
-	soil_style.swap(derived_soil);
-	clim_style.swap(derived_clim);
-	agri_style.swap(derived_agri);
+	upsample_env_t	env = { &ioDEMs[dem_RelativeElevation], &clim_style, &soil_style, &agri_style };
+
+	// The three styles only share the relative elevation, so they all go at once.
+	static const DEMStage_t	stages[] = {
+		{ UpsampleClimStyle, 0 },
+		{ UpsampleSoilStyle, 0 },
+		{ UpsampleAgriStyle, 0 }
+	};
+	RunDEMStages(stages, sizeof(stages) / sizeof(stages[0]), &env);
+
+	soil_style.swap(env.derived_soil);
+	clim_style.swap(env.derived_clim);
+	agri_style.swap(env.derived_agri);
 	
 	return;
 	
@@ -1060,159 +1176,126 @@ void	UpsampleEnvironmentalParams(DEMGeoMap& ioDEMs, ProgressFunc inProg)
 }
 
 
-/*
- * DeriveDEMs
- *
- * Given a set of DEMs for all of the input parameters, calculate all
- * of the derived parameters.  We also need a vector map to do this of course.
- *
- * Input DEMS:
- *
- *	climate, biomass, landuse, temp, temp range, elevation, rainfall
- *
- * Output DEMs:
- *
- *  terrain and vege phenom, 2d and 3d vege density, urban density and prop values
- *  nude terrain color, x-plane terrain type.
- *
- */
-void	DeriveDEMs(
-			Pmwx&			inMap,
-			DEMGeoMap& 		ioDEMs,
-			AptVector&		ioApts,
-			AptIndex&		ioAptIndex,
-			int				do_translate,
-			ProgressFunc 	inProg)
+// Everything the DeriveDEMs stages share.  Input layers are read-only; each output layer is written by exactly
+// one stage.
+struct	derive_dems_t {
+	Pmwx *			map;
+	AptVector *		apts;
+	AptIndex *		apt_index;
+	const DEMGeo *	landuse;
+	const DEMGeo *	temp;
+	const DEMGeo *	rainfall;
+	const DEMGeo *	elevation;
+	DEMGeo *		urbanSquare;
+	DEMGeo *		bathymetry;
+
+	DEMGeo			urbanTemp;		// Urban density straight from land use, derezzed - input to the urban kernels.
+	DEMGeo			urban;
+	DEMGeo			urbanRadial;
+	DEMGeo			urbanTrans;
+	DEMGeo			forests;
+};
+
+enum {
+	derive_UrbanLandUse,
+	derive_UrbanDense,
+	derive_UrbanRadial,
+	derive_UrbanTrans,
+	derive_UrbanSquare,
+	derive_Forests,
+	derive_Water
+};
+
+/********************************************************************************************************
+ * CALCULATE URBAN DENSITY AND PROPERTY VALUES
+ ********************************************************************************************************/
+
+static void	DeriveUrbanLandUse(void * ref, int max_threads)
 {
+	derive_dems_t * d = (derive_dems_t *) ref;
+	const DEMGeo& landuse(*d->landuse);
+	DEMGeo& urbanTemp(d->urbanTemp);
 	int x, y;
 
+	urbanTemp.resize(landuse.mWidth, landuse.mHeight);
+	for (y = 0; y < landuse.mHeight;++y)
+	for (x = 0; x < landuse.mWidth; ++x)
 	{
-//		ioDEMs[dem_OrigLandUse] = ioDEMs[dem_LandUse];
-		DEMGeo& lu_t = ioDEMs[dem_LandUse];
-		if(do_translate)
-		for (int y = 0; y < lu_t.mHeight; ++y)
-		for (int x = 0; x < lu_t.mWidth; ++x)
-		{
-			int luv = lu_t.get(x,y);
-			if (gLandUseTransTable.count(luv))
-				lu_t(x,y) = gLandUseTransTable[luv];
-		}
+		float e = landuse.get(x,y);
+		
+		LandClassInfoTable::iterator i = gLandClassInfo.find(e);
+		if(i != gLandClassInfo.end())
+			e = i->second.urban_density;
+		else if(e == lu_globcover_URBAN_HIGH)						e = 1.0;
+		else if(e == lu_globcover_URBAN_TOWN)						e = 0.25;
+		else if(e == lu_globcover_URBAN_LOW)						e = 0.5;
+		else if(e == lu_globcover_URBAN_MEDIUM)						e = 0.75;
+
+		else if(e == lu_globcover_URBAN_SQUARE_HIGH)				e = 1.0;
+		else if(e == lu_globcover_URBAN_SQUARE_TOWN)				e = 0.25;
+		else if(e == lu_globcover_URBAN_SQUARE_LOW)					e = 0.5;
+		else if(e == lu_globcover_URBAN_SQUARE_MEDIUM)				e = 0.75;
+		
+		else if(e == lu_globcover_URBAN_CROP_TOWN)					e = 0.1;
+		else if(e == lu_globcover_URBAN_SQUARE_CROP_TOWN)			e = 0.1;
+		else if(e == lu_globcover_INDUSTRY_SQUARE)					e = 1.0;
+		else if(e == lu_globcover_INDUSTRY)							e = 1.0;
+		else if(e == lu_usgs_URBAN_IRREGULAR)						e = 1.0;
+		else if(e == lu_usgs_URBAN_SQUARE)							e = 1.0;
 
+		else														e = 0.0;		
+			urbanTemp(x,y) = e;
 	}
+	
+	urbanTemp.derez(8);
+}
 
-//	const DEMGeo&		climate = 	ioDEMs[dem_Climate];
-//	const DEMGeo&		biomass = 	ioDEMs[dem_Biomass];
-	const DEMGeo&		landuse = 	ioDEMs[dem_LandUse];
-	const DEMGeo&		temp = 		ioDEMs[dem_Temperature];
-//	const DEMGeo&		tempRange = ioDEMs[dem_TemperatureRange];
-	const DEMGeo&		elevation = ioDEMs[dem_Elevation];
-//	const DEMGeo&		slope = 	ioDEMs[dem_Slope];
-//	const DEMGeo&		slopeHeading = ioDEMs[dem_SlopeHeading];
-	const DEMGeo&		rainfall = 	ioDEMs[dem_Rainfall];
-		  DEMGeo&		urbanSquare =ioDEMs[dem_UrbanSquare];
-
-	int reduce_1 = elevation.mWidth / 200;
-	DEMGeo elevation_reduced;
-	DownsampleDEM(elevation, elevation_reduced, reduce_1);
-//	DEMGeo	landuseBig;
-//	int reduce_2 = elevation.mWidth / 600;
-//	UpsampleDEM(landuse, landuseBig, reduce_2);
-
-//	DEMGeo	values(landuse);
-//	DEMGeo	nudeColor(landuse);
-//	DEMGeo	vegetation(elevation_reduced);
-	DEMGeo	urban;
-	DEMGeo	urbanRadial;
-	DEMGeo	urbanTrans;
-	urbanSquare = landuse;
-	DEMGeo		forests(landuse);
-
-	urban.copy_geo_from(landuse);
-	urbanRadial.copy_geo_from(landuse);
-	urbanTrans.copy_geo_from(landuse);
-
-//	double lon, lat;
-
-	/********************************************************************************************************
-	 * CALCULATE URBAN DENSITY AND PROPERTY VALUES
-	 ********************************************************************************************************/
-
-	if (inProg) inProg(0, 1, "Calculating Derived Raster Data", 0.0);
+static void	DeriveUrbanDense(void * ref, int max_threads)
+{
+	derive_dems_t * d = (derive_dems_t *) ref;
+	DEMGeo& urban(d->urban);
 
-	CalculateFilter(URBAN_DENSE_KERN_SIZE, sUrbanDenseSpreaderKernel, demFilter_Spread, true);
-	CalculateFilter(URBAN_RADIAL_KERN_SIZE, sUrbanRadialSpreaderKernel, demFilter_Linear, false);
-	CalculateFilter(URBAN_TRANS_KERN_SIZE, sUrbanTransSpreaderKernel, demFilter_Spread, true);
+	KernelFilterDEM(d->urbanTemp, urban, URBAN_DENSE_KERN_SIZE, sUrbanDenseSpreaderKernel, false, max_threads);
+	for (DEMGeo::iterator i = urban.begin(); i != urban.end(); ++i)
+		*i = max(0.0f, min(1.0f, *i));
+}
 
+static void	DeriveUrbanRadial(void * ref, int max_threads)
+{
+	derive_dems_t * d = (derive_dems_t *) ref;
+	DEMGeo& urbanRadial(d->urbanRadial);
 	double	radial_max = 0.0;
 
-	{
-		DEMGeo	urbanTemp(landuse.mWidth, landuse.mHeight);
-		for (y = 0; y < landuse.mHeight;++y)
-		for (x = 0; x < landuse.mWidth; ++x)
-		{
-			float e = landuse.get(x,y);
-			
-			LandClassInfoTable::iterator i = gLandClassInfo.find(e);
-			if(i != gLandClassInfo.end())
-				e = i->second.urban_density;
-			else if(e == lu_globcover_URBAN_HIGH)						e = 1.0;
-			else if(e == lu_globcover_URBAN_TOWN)						e = 0.25;
-			else if(e == lu_globcover_URBAN_LOW)						e = 0.5;
-			else if(e == lu_globcover_URBAN_MEDIUM)						e = 0.75;
-
-			else if(e == lu_globcover_URBAN_SQUARE_HIGH)				e = 1.0;
-			else if(e == lu_globcover_URBAN_SQUARE_TOWN)				e = 0.25;
-			else if(e == lu_globcover_URBAN_SQUARE_LOW)					e = 0.5;
-			else if(e == lu_globcover_URBAN_SQUARE_MEDIUM)				e = 0.75;
-			
-			else if(e == lu_globcover_URBAN_CROP_TOWN)					e = 0.1;
-			else if(e == lu_globcover_URBAN_SQUARE_CROP_TOWN)			e = 0.1;
-			else if(e == lu_globcover_INDUSTRY_SQUARE)					e = 1.0;
-			else if(e == lu_globcover_INDUSTRY)							e = 1.0;
-			else if(e == lu_usgs_URBAN_IRREGULAR)						e = 1.0;
-			else if(e == lu_usgs_URBAN_SQUARE)							e = 1.0;
-
-			else														e = 0.0;		
-				urbanTemp(x,y) = e;
-		}
-		
-		urbanTemp.derez(8);
-		
-		urban.resize(urbanTemp.mWidth,urbanTemp.mHeight);
-		urbanRadial.resize(urbanTemp.mWidth,urbanTemp.mHeight);
-		urbanTrans.resize(urbanTemp.mWidth,urbanTemp.mHeight);
-
-		for (y = 0; y < urbanTemp.mHeight;++y)
-		for (x = 0; x < urbanTemp.mWidth; ++x)
-		{
-			urban(x,y) 		= urbanTemp.kernelN(x,y, URBAN_DENSE_KERN_SIZE , sUrbanDenseSpreaderKernel);
-//			urban(x,y) 		= urbanTemp(x,y);
-			double local 	= urbanTemp.kernelN(x,y, URBAN_RADIAL_KERN_SIZE, sUrbanRadialSpreaderKernel);
-			urbanRadial(x,y) = local;
-			radial_max = max(local, radial_max);
-		}
-	}
+	KernelFilterDEM(d->urbanTemp, urbanRadial, URBAN_RADIAL_KERN_SIZE, sUrbanRadialSpreaderKernel, false, max_threads);
+	for (DEMGeo::iterator i = urbanRadial.begin(); i != urbanRadial.end(); ++i)
+		radial_max = max((double) *i, radial_max);
 
 	if (radial_max > 0.0) urbanRadial *= (1.0 / radial_max);
 
-	for (y = 0; y < urban.mHeight;++y)
-	for (x = 0; x < urban.mWidth; ++x)
-	{
-		urban(x,y) = max(0.0f, min(1.0f, urban(x,y)));
-		urbanRadial(x,y) = max(0.0f, min(1.0f, urbanRadial(x,y)));
-	}
+	for (DEMGeo::iterator i = urbanRadial.begin(); i != urbanRadial.end(); ++i)
+		*i = max(0.0f, min(1.0f, *i));
+}
 
-	if (inMap.number_of_halfedges() > 0)
-		BuildRoadDensityDEM(inMap, urbanTrans);
+static void	DeriveUrbanTrans(void * ref, int max_threads)
+{
+	derive_dems_t * d = (derive_dems_t *) ref;
+	const DEMGeo& landuse(*d->landuse);
+	DEMGeo& urbanTrans(d->urbanTrans);
+	int x, y;
+
+	urbanTrans.resize(d->urbanTemp.mWidth,d->urbanTemp.mHeight);
+
+	if (d->map->number_of_halfedges() > 0)
+		BuildRoadDensityDEM(*d->map, urbanTrans);
 
 //	CalcPropertyValues(values, elevation_reduced, inMap);
 
 	set<int>	apts;
 
-	FindAirports(Bbox2(landuse.mWest, landuse.mSouth, landuse.mEast, landuse.mNorth), ioAptIndex, apts);
+	FindAirports(Bbox2(landuse.mWest, landuse.mSouth, landuse.mEast, landuse.mNorth), *d->apt_index, apts);
 	for (set<int>::iterator apt = apts.begin(); apt != apts.end(); ++apt)
-	if (ioApts[*apt].kind_code == apt_airport)
-	for (AptPavementVector::iterator rwy = ioApts[*apt].pavements.begin(); rwy != ioApts[*apt].pavements.end(); ++rwy)
+	if ((*d->apts)[*apt].kind_code == apt_airport)
+	for (AptPavementVector::iterator rwy = (*d->apts)[*apt].pavements.begin(); rwy != (*d->apts)[*apt].pavements.end(); ++rwy)
 	if (rwy->surf_code == apt_surf_asphalt || rwy->surf_code == apt_surf_concrete)
 	{
 		POINT2 p = CGAL_midpoint(rwy->ends.source(), rwy->ends.target());
@@ -1222,11 +1305,20 @@ void	DeriveDEMs(
 
 	}
 
-	urbanTrans.filter_self(URBAN_TRANS_KERN_SIZE, sUrbanTransSpreaderKernel);
+	KernelFilterDEM(urbanTrans, urbanTrans, URBAN_TRANS_KERN_SIZE, sUrbanTransSpreaderKernel, false, max_threads);	// filter_self, but within our share of the cores
 
 	for (y = 0; y < urbanTrans.mHeight; ++y)
 	for (x = 0; x < urbanTrans.mWidth; ++x)
 		urbanTrans(x,y) = max(0.0f, min(urbanTrans(x,y), 1.0f));
+}
+
+static void	DeriveUrbanSquare(void * ref, int max_threads)
+{
+	derive_dems_t * d = (derive_dems_t *) ref;
+	DEMGeo& urbanSquare(*d->urbanSquare);
+	int x, y;
+
+	urbanSquare = *d->landuse;
 
 	for (y = 0; y < urbanSquare.mHeight; ++y)
 	for (x = 0; x < urbanSquare.mWidth; ++x)
@@ -1254,6 +1346,229 @@ else														e = DEM_NO_DATA;
 	SpreadDEMValues(urbanSquare);
 	if(urbanSquare.get(0,0) == DEM_NO_DATA)
 		urbanSquare = 1.0;
+}
+
+/********************************************************************************************************
+ * FORESTS
+ ********************************************************************************************************/
+
+static void	DeriveForestRow(int y, void * ref)
+{
+	derive_dems_t * d = (derive_dems_t *) ref;
+	const DEMGeo& landuse(*d->landuse);
+	const DEMGeo& temp(*d->temp);
+	const DEMGeo& rainfall(*d->rainfall);
+
+	for (int x = 0; x < landuse.mWidth; ++x)
+	{
+		int l = landuse.get(x,y);
+		float t = temp.get(temp.map_x_from(landuse,x),
+						 temp.map_y_from(landuse,y));
+		float r = rainfall.get(rainfall.map_x_from(landuse,x),
+						 rainfall.map_y_from(landuse,y));
+
+		int f = FindForest(l,t,r);
+		
+		if(f == NO_VALUE) f = DEM_NO_DATA;
+		d->forests(x,y) = f;				
+	}
+}
+
+static void	DeriveForests(void * ref, int max_threads)
+{
+	derive_dems_t * d = (derive_dems_t *) ref;
+
+	d->forests = *d->landuse;
+	TU_ParallelFor(d->landuse->mHeight, DeriveForestRow, d, max_threads);
+	d->forests.fill_nearest();
+}
+
+/************************************************************************************************************************
+ * WATER AND BATHYMETRY CALC
+ ************************************************************************************************************************/
+
+static void	DeriveWater(void * ref, int max_threads)
+{
+	derive_dems_t * d = (derive_dems_t *) ref;
+	Pmwx& inMap(*d->map);
+	const DEMGeo& elevation(*d->elevation);
+	int x, y;
+
+	DEMGeo	water_surface(WATER_SURF_DIM,WATER_SURF_DIM);
+	water_surface.mPost = 0;
+	water_surface.copy_geo_from(elevation);
+	water_surface = DEM_NO_DATA;
+
+	// These live on the heap - at 256x256 buckets they are far too big for a worker thread's stack.
+	vector<map<float, int> >	histo(WATER_SURF_DIM * WATER_SURF_DIM);
+	vector<int>					total(WATER_SURF_DIM * WATER_SURF_DIM, 0);
+	set<Halfedge_handle>	coast_edges;
+	set<Face_handle>	wet_faces;
+
+
+	for(Pmwx::Face_handle f = inMap.faces_begin(); f != inMap.faces_end(); ++f)
+	if(!f->is_unbounded())
+	if(f->data().IsWater())
+		wet_faces.insert(f);
+
+	FindEdgesForFaceSet<Pmwx>(wet_faces, coast_edges);
+
+	PolyRasterizer<double> raster;
+
+	y = SetupRasterizerForDEM(coast_edges, elevation, raster);
+	int x1, x2;
+	raster.StartScanline(0);
+	
+	while (!raster.DoneScan())
+	{
+		while (raster.GetRange(x1, x2))
+		{
+			for (x = x1; x < x2; ++x)
+			{
+				float e = elevation(x,y);
+				if(e != DEM_NO_DATA)
+				{
+					double lon = elevation.x_to_lon(x);
+					double lat = elevation.y_to_lat(y);
+					int bucket_x = water_surface.lon_to_x(lon);
+					int bucket_y = water_surface.lat_to_y(lat);
+//					debug_mesh_point(Point2(lon,lat),1,1,1);
+					histo[bucket_x + bucket_y * WATER_SURF_DIM][e]++;
+					++total[bucket_x + bucket_y * WATER_SURF_DIM];
+				}
+			}
+		}
+		++y;
+		if (y >= elevation.mHeight) 
+			break;
+		raster.AdvanceScanline(y);
+	}	
+
+	for(y = 0; y < water_surface.mHeight; ++y)
+	for(x = 0; x < water_surface.mWidth; ++x)
+	{		
+		map<float,int>& h_here(histo[x + y * WATER_SURF_DIM]);
+		int total_here = total[x + y * WATER_SURF_DIM];
+		if(total_here)
+		{
+//			for(map<float,int>::iterator h = msl_hysto[x][y].begin(); h != msl_hysto[x][y].end(); ++h)
+//				printf("%f: %d\n", h->first, h->second);
+			int want = total_here / 10;
+//			if(wet < (total /2)) want = 0;
+			for(map<float,int>::iterator h = h_here.begin(); h != h_here.end(); ++h)
+			if(h->second > want)
+			{
+				water_surface(x,y) = h->first;
+				break;
+				
+			} else
+				want -= h->second;			
+		}
+		
+	}
+	
+	water_surface.fill_nearest();
+	DEMGeo& bath_old(*d->bathymetry);
+	
+	DEMGeo	bath_new(water_surface);
+	for(y = 0; y < bath_new.mHeight; ++y)
+	for(x = 0; x < bath_new.mWidth ; ++x)
+	{
+		bath_new(x,y) = min(bath_new(x,y) - MIN_DEPTH, bath_old.value_linear(bath_new.x_to_lon(x),bath_new.y_to_lat(y)));		
+	}
+	
+	bath_old.swap(bath_new);
+}
+
+/*
+ * DeriveDEMs
+ *
+ * Given a set of DEMs for all of the input parameters, calculate all
+ * of the derived parameters.  We also need a vector map to do this of course.
+ *
+ * Input DEMS:
+ *
+ *	climate, biomass, landuse, temp, temp range, elevation, rainfall
+ *
+ * Output DEMs:
+ *
+ *  terrain and vege phenom, 2d and 3d vege density, urban density and prop values
+ *  nude terrain color, x-plane terrain type.
+ *
+ * The layers are computed as raster stages (see RunDEMStages); the land use based
+ * layers and the water surface go first, then the urban kernels, which need the
+ * derezzed urban land use.  Road density waits for the water so that only one
+ * stage reads the vector map at a time.
+ *
+ */
+void	DeriveDEMs(
+			Pmwx&			inMap,
+			DEMGeoMap& 		ioDEMs,
+			AptVector&		ioApts,
+			AptIndex&		ioAptIndex,
+			int				do_translate,
+			ProgressFunc 	inProg)
+{
+	{
+//		ioDEMs[dem_OrigLandUse] = ioDEMs[dem_LandUse];
+		DEMGeo& lu_t = ioDEMs[dem_LandUse];
+		if(do_translate)
+		for (int y = 0; y < lu_t.mHeight; ++y)
+		for (int x = 0; x < lu_t.mWidth; ++x)
+		{
+			int luv = lu_t.get(x,y);
+			if (gLandUseTransTable.count(luv))
+				lu_t(x,y) = gLandUseTransTable[luv];
+		}
+
+	}
+
+	derive_dems_t	d;
+	d.map = &inMap;
+	d.apts = &ioApts;
+	d.apt_index = &ioAptIndex;
+//	d.climate = 	&ioDEMs[dem_Climate];
+//	d.biomass = 	&ioDEMs[dem_Biomass];
+	d.landuse = 	&ioDEMs[dem_LandUse];
+	d.temp = 		&ioDEMs[dem_Temperature];
+//	d.tempRange = &ioDEMs[dem_TemperatureRange];
+	d.elevation = &ioDEMs[dem_Elevation];
+//	d.slope = 	&ioDEMs[dem_Slope];
+//	d.slopeHeading = &ioDEMs[dem_SlopeHeading];
+	d.rainfall = 	&ioDEMs[dem_Rainfall];
+	d.urbanSquare = &ioDEMs[dem_UrbanSquare];
+	d.bathymetry = &ioDEMs[dem_Bathymetry];
+
+	const DEMGeo& landuse(*d.landuse);
+
+//	DEMGeo	landuseBig;
+//	int reduce_2 = elevation.mWidth / 600;
+//	UpsampleDEM(landuse, landuseBig, reduce_2);
+
+//	DEMGeo	values(landuse);
+//	DEMGeo	nudeColor(landuse);
+//	DEMGeo	vegetation(elevation_reduced);
+
+	d.urban.copy_geo_from(landuse);
+	d.urbanRadial.copy_geo_from(landuse);
+	d.urbanTrans.copy_geo_from(landuse);
+
+	if (inProg) inProg(0, 1, "Calculating Derived Raster Data", 0.0);
+
+	CalculateFilter(URBAN_DENSE_KERN_SIZE, sUrbanDenseSpreaderKernel, demFilter_Spread, true);
+	CalculateFilter(URBAN_RADIAL_KERN_SIZE, sUrbanRadialSpreaderKernel, demFilter_Linear, false);
+	CalculateFilter(URBAN_TRANS_KERN_SIZE, sUrbanTransSpreaderKernel, demFilter_Spread, true);
+
+	static const DEMStage_t	stages[] = {
+		{ DeriveUrbanLandUse,	0 },
+		{ DeriveUrbanDense,		1 << derive_UrbanLandUse },
+		{ DeriveUrbanRadial,	1 << derive_UrbanLandUse },
+		{ DeriveUrbanTrans,		(1 << derive_UrbanLandUse) | (1 << derive_Water) },
+		{ DeriveUrbanSquare,	0 },
+		{ DeriveForests,		0 },
+		{ DeriveWater,			0 }
+	};
+	RunDEMStages(stages, sizeof(stages) / sizeof(stages[0]), &d);
 
 	/********************************************************************************************************
 	 * CALCULATE VEGETATION DENSITY
@@ -1551,25 +1866,7 @@ else														e = DEM_NO_DATA;
 
 	if (inProg) inProg(0, 1, "Calculating Derived Raster Data", 1.0);
 
-	for (y = 0; y < landuse.mHeight;++y)
-	for (x = 0; x < landuse.mWidth; ++x)
-	{
-		int l = landuse.get(x,y);
-		float t = temp.get(temp.map_x_from(landuse,x),
-						 temp.map_y_from(landuse,y));
-		float r = rainfall.get(rainfall.map_x_from(landuse,x),
-						 rainfall.map_y_from(landuse,y));
-
-		int f = FindForest(l,t,r);
-		
-		if(f == NO_VALUE) f = DEM_NO_DATA;
-		forests(x,y) = f;				
-	}
-
-	forests.fill_nearest();
-
-
-	ioDEMs[dem_UrbanDensity	   ].swap(urban);
+	ioDEMs[dem_UrbanDensity	   ].swap(d.urban);
 //	ioDEMs[dem_TerrainPhenomena].swap(phenomTerrain);
 //	ioDEMs[dem_2dVegePhenomena ].swap(phenom2d);
 //	ioDEMs[dem_3dVegePhenomena ].swap(phenom3d);
@@ -1579,97 +1876,9 @@ else														e = DEM_NO_DATA;
 //	ioDEMs[dem_TerrainType	   ].swap(terrain);
 //	ioDEMs[dem_NudeColor	   ].swap(nudeColor);
 //	ioDEMs[dem_VegetationDensity].swap(vegetation);
-	ioDEMs[dem_UrbanRadial].swap(urbanRadial);
-	ioDEMs[dem_UrbanTransport].swap(urbanTrans);
-	ioDEMs[dem_ForestType].swap(forests);
-	
-	/************************************************************************************************************************
-	 * WATER AND BATHYMETRY CALC
-	 ************************************************************************************************************************/
-
-	DEMGeo	water_surface(WATER_SURF_DIM,WATER_SURF_DIM);
-	water_surface.mPost = 0;
-	water_surface.copy_geo_from(elevation);
-	water_surface = DEM_NO_DATA;
-
-	map<float, int>	histo[WATER_SURF_DIM][WATER_SURF_DIM];
-	int total[WATER_SURF_DIM][WATER_SURF_DIM] = { 0 };
-	set<Halfedge_handle>	coast_edges;
-	set<Face_handle>	wet_faces;
-
-
-	for(Pmwx::Face_handle f = inMap.faces_begin(); f != inMap.faces_end(); ++f)
-	if(!f->is_unbounded())
-	if(f->data().IsWater())
-		wet_faces.insert(f);
-
-	FindEdgesForFaceSet<Pmwx>(wet_faces, coast_edges);
-
-	PolyRasterizer<double> raster;
-
-	y = SetupRasterizerForDEM(coast_edges, elevation, raster);
-	int x1, x2;
-	raster.StartScanline(0);
-	
-	while (!raster.DoneScan())
-	{
-		while (raster.GetRange(x1, x2))
-		{
-			for (x = x1; x < x2; ++x)
-			{
-				float e = elevation(x,y);
-				if(e != DEM_NO_DATA)
-				{
-					double lon = elevation.x_to_lon(x);
-					double lat = elevation.y_to_lat(y);
-					int bucket_x = water_surface.lon_to_x(lon);
-					int bucket_y = water_surface.lat_to_y(lat);
-//					debug_mesh_point(Point2(lon,lat),1,1,1);
-					histo[bucket_x][bucket_y][e]++;
-					++total[bucket_x][bucket_y];
-				}
-			}
-		}
-		++y;
-		if (y >= elevation.mHeight) 
-			break;
-		raster.AdvanceScanline(y);
-	}	
-
-	for(y = 0; y < water_surface.mHeight; ++y)
-	for(x = 0; x < water_surface.mWidth; ++x)
-	{		
-		if(total[x][y])
-		{
-//			for(map<float,int>::iterator h = msl_hysto[x][y].begin(); h != msl_hysto[x][y].end(); ++h)
-//				printf("%f: %d\n", h->first, h->second);
-			int want = total[x][y] / 10;
-//			if(wet < (total /2)) want = 0;
-			for(map<float,int>::iterator h = histo[x][y].begin(); h != histo[x][y].end(); ++h)
-			if(h->second > want)
-			{
-				water_surface(x,y) = h->first;
-				break;
-				
-			} else
-				want -= h->second;			
-		}
-		
-	}
-	
-	water_surface.fill_nearest();
-	DEMGeo& bath_old(ioDEMs[dem_Bathymetry]);
-	
-	DEMGeo	bath_new(water_surface);
-	for(y = 0; y < bath_new.mHeight; ++y)
-	for(x = 0; x < bath_new.mWidth ; ++x)
-	{
-		bath_new(x,y) = min(bath_new(x,y) - MIN_DEPTH, bath_old.value_linear(bath_new.x_to_lon(x),bath_new.y_to_lat(y)));		
-	}
-	
-	bath_old.swap(bath_new);
-	
-
+	ioDEMs[dem_UrbanRadial].swap(d.urbanRadial);
+	ioDEMs[dem_UrbanTransport].swap(d.urbanTrans);
+	ioDEMs[dem_ForestType].swap(d.forests);
 }
 
 void	CalcSlopeParams(DEMGeoMap& ioDEMs, bool force, ProgressFunc inProg)
@@ -1996,56 +2205,6 @@ static void normalize_kernel(float k[], int w)
 	}
 }
 
-static float sample_kernel_h(const DEMGeo& src, int x, int y, float k[], int width)
-{
-	float s = 0.0f;
-	float wt = 0.0f;
-	for(int w = -width; w <= width; ++w)
-	{
-		float e = src.get(x+w,y);
-		if(e != DEM_NO_DATA)
-		{
-			wt += *k;
-			s += e * *k;
-		}
-		++k;
-	}
-	if (wt == 0.0f) return DEM_NO_DATA;
-	return s / wt;
-}
-
-static float sample_kernel_v(const DEMGeo& src, int x, int y, float k[], int width)
-{
-	float s = 0.0f;
-	float wt = 0.0f;
-	for(int w = -width; w <= width; ++w)
-	{
-		float e = src.get(x,y+w);
-		if(e != DEM_NO_DATA)
-		{
-			wt += *k;
-			s += e * *k;
-		}
-		++k;
-	}
-	if (wt == 0.0f) return DEM_NO_DATA;
-	return s / wt;
-}
-
-static void copy_kernel_h(const DEMGeo& src, DEMGeo& dst, float k[], int width)
-{
-	for(int y = 0; y < src.mHeight; ++y)
-	for(int x = 0; x < src.mWidth; ++x)
-		dst(x,y) = sample_kernel_h(src,x,y,k,width);
-}
-
-static void copy_kernel_v(const DEMGeo& src, DEMGeo& dst, float k[], int width)
-{
-	for(int y = 0; y < src.mHeight; ++y)
-	for(int x = 0; x < src.mWidth; ++x)
-		dst(x,y) = sample_kernel_v(src,x,y,k,width);
-}
-
 void GaussianBlurDEM(DEMGeo& dem, float sigma)
 {
 	// Technically the gaussian filter NEVER drops to zero...in practice, it's too expensive to run a filter the size of the DEM.
@@ -2056,12 +2215,10 @@ void GaussianBlurDEM(DEMGeo& dem, float sigma)
 	
 	int width = ceilf(sigma * SIGMAS_NEEDED);
 	
-	DEMGeo	temp(dem.mWidth, dem.mHeight);
 	vector<float> k(width*2+1);
 	make_gaussian_kernel(&*k.begin(),width,sigma);
 	normalize_kernel(&*k.begin(),width);
-	copy_kernel_v(dem,temp,&*k.begin(),width);
-	copy_kernel_h(temp,dem,&*k.begin(),width);
+	SeparableFilterDEM(dem,dem,&*k.begin(),width,&*k.begin(),width);
 }
 
 // Line integral of the DEM over the points x1,y1 to x2,y2.  Over-sample by over_sample_ratio (should
@@ -23,8 +23,106 @@
 #include "DEMDefs.h"
 #include "CompGeomDefs3.h"
 #include "MathUtils.h"
+#include "ThreadUtils.h"
 #include <list>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define DEM_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+#if LIN || APL
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+#endif
+
+/*************************************************************************************
+ * DEM STORAGE
+ *************************************************************************************/
+
+static string	sDEMScratchDir;
+static size_t	sDEMScratchMin = 0;
+
+void		DEMGeo_SetScratchDir(const char * inDir, size_t inMinBytes)
+{
+	sDEMScratchDir = inDir ? inDir : "";
+	sDEMScratchMin = inMinBytes;
+}
+
+// Map a new, zero-filled scratch file of the given size - the file is deleted up front so the
+// OS cleans it up no matter how we exit.  Returns NULL if anything fails.
+static void *	dem_map_scratch(size_t bytes)
+{
+#if LIN || APL
+	string path = sDEMScratchDir + "/dem_XXXXXX";
+	vector<char> buf(path.begin(), path.end());
+	buf.push_back(0);
+	int fd = mkstemp(&buf[0]);
+	if (fd == -1) return NULL;
+	unlink(&buf[0]);
+	void * addr = NULL;
+	if (ftruncate(fd, bytes) == 0)
+	{
+		addr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED) addr = NULL;
+	}
+	close(fd);
+	return addr;
+#elif IBM
+	char path[MAX_PATH];
+	if (GetTempFileNameA(sDEMScratchDir.c_str(), "dem", 0, path) == 0) return NULL;
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+						FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	if (file == INVALID_HANDLE_VALUE) { DeleteFileA(path); return NULL; }
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD) ((unsigned long long) bytes >> 32), (DWORD) bytes, NULL);
+	void * addr = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes) : NULL;
+	// The view keeps the mapping and file alive; the file goes away when the view is unmapped.
+	if (mapping) CloseHandle(mapping);
+	CloseHandle(file);
+	return addr;
+#else
+	return NULL;
+#endif
+}
+
+static void		dem_unmap_scratch(void * addr, size_t bytes)
+{
+#if LIN || APL
+	munmap(addr, bytes);
+#elif IBM
+	UnmapViewOfFile(addr);
+#endif
+}
+
+// Allocate storage for w x h samples, mapped if it is big enough and we have a scratch dir,
+// malloc'd otherwise.  Mapped storage is always zero-filled; malloc'd is only if 'zero' is set.
+static float *	dem_alloc(int w, int h, int& out_mapped, bool zero)
+{
+	size_t bytes = (size_t) w * (size_t) h * sizeof(float);
+	out_mapped = 0;
+	if (bytes == 0) return NULL;
+	if (!sDEMScratchDir.empty() && bytes >= sDEMScratchMin)
+	if (float * p = (float *) dem_map_scratch(bytes))
+	{
+		out_mapped = 1;
+		return p;
+	}
+	float * p = (float *) malloc(bytes);
+	if (p && zero)
+		memset(p, 0, bytes);
+	return p;
+}
+
+static void		dem_free(float * p, int w, int h, int mapped)
+{
+	if (p == NULL) return;
+	if (mapped)
+		dem_unmap_scratch(p, (size_t) w * (size_t) h * sizeof(float));
+	else
+		free(p);
+}
+
 #define HIST_MAX	10
 
 struct	HistoHelper {
@@ -99,7 +197,8 @@ DEMGeo::DEMGeo() :
 	mWidth(0),
 	mHeight(0),
 	mPost(1),
-	mData(0)
+	mData(0),
+	mMapped(0)
 {
 }
 
@@ -112,41 +211,28 @@ DEMGeo::DEMGeo(const DEMGeo& x) :
 	mPost(x.mPost),
 	mHeight(x.mHeight)
 {
-	if (mWidth == 0 || mHeight == 0)
+	mData = dem_alloc(mWidth, mHeight, mMapped, x.mData == NULL);
+	if (mData == NULL)
 	{
-		mData = 0;
-	} else {
-		mData = (float *) malloc(mWidth * mHeight * sizeof(float));
-		if (mData == NULL)
+		if (mWidth && mHeight)
 			mWidth = mHeight = 0;
-		else {
-			if (x.mData)
-				memcpy(mData, x.mData, mWidth * mHeight * sizeof(float));
-			else
-				memset(mData, 0, mWidth * mHeight * sizeof(float));
-		}
 	}
+	else if (x.mData)
+		memcpy(mData, x.mData, (size_t) mWidth * (size_t) mHeight * sizeof(float));
 }
 
 DEMGeo::DEMGeo(int width, int height) :
 	mSouth(0.0), mNorth(0.0), mEast(0.0), mWest(0.0),
 	mWidth(width), mHeight(height), mPost(1)
 {
-	if (mWidth == 0 || mHeight == 0)
-	{
-		mData = 0;
-	} else {
-		mData = (float *) malloc(mWidth * mHeight * sizeof(float));
-		if (mData == NULL)
-			mWidth = mHeight = 0;
-		else
-			memset(mData, 0, mWidth * mHeight * sizeof(float));
-	}
+	mData = dem_alloc(mWidth, mHeight, mMapped, true);
+	if (mData == NULL && mWidth && mHeight)
+		mWidth = mHeight = 0;
 }
 
 DEMGeo::~DEMGeo()
 {
-	if (mData) free(mData);
+	dem_free(mData, mWidth, mHeight, mMapped);
 }
 
 DEMGeo& DEMGeo::operator=(float v)
@@ -224,10 +310,10 @@ DEMGeo& DEMGeo::operator=(const DEMGeo& x)
 
 	if (x.mWidth != mWidth || x.mHeight != mHeight || mData == NULL)
 	{
-		if (mData)	free(mData);
+		dem_free(mData, mWidth, mHeight, mMapped);
 		mWidth = x.mWidth;
 		mHeight = x.mHeight;
-		mData = (float *) malloc(mWidth * mHeight * sizeof(float));
+		mData = dem_alloc(mWidth, mHeight, mMapped, false);
 	}
 
 	mSouth = x.mSouth;
@@ -240,9 +326,9 @@ DEMGeo& DEMGeo::operator=(const DEMGeo& x)
 		mWidth = mHeight = 0;
 	else {
 		if (x.mData)
-			memcpy(mData, x.mData, mWidth * mHeight * sizeof(float));
+			memcpy(mData, x.mData, (size_t) mWidth * (size_t) mHeight * sizeof(float));
 		else
-			memset(mData, 0, mWidth * mHeight * sizeof(float));
+			memset(mData, 0, (size_t) mWidth * (size_t) mHeight * sizeof(float));
 	}
 	return *this;
 }
@@ -258,10 +344,10 @@ void DEMGeo::clear_from(const DEMGeo& x, float v)
 	
 	if (x.mWidth != mWidth || x.mHeight != mHeight || mData == NULL)
 	{
-		if (mData)	free(mData);
+		dem_free(mData, mWidth, mHeight, mMapped);
 		mWidth = x.mWidth;
 		mHeight = x.mHeight;
-		mData = (float *) malloc(mWidth * mHeight * sizeof(float));
+		mData = dem_alloc(mWidth, mHeight, mMapped, false);
 	}
 
 	mSouth = x.mSouth;
@@ -285,10 +371,10 @@ void DEMGeo::clear_from(const DEMGeo& x)
 	
 	if (x.mWidth != mWidth || x.mHeight != mHeight || mData == NULL)
 	{
-		if (mData)	free(mData);
+		dem_free(mData, mWidth, mHeight, mMapped);
 		mWidth = x.mWidth;
 		mHeight = x.mHeight;
-		mData = (float *) malloc(mWidth * mHeight * sizeof(float));
+		mData = dem_alloc(mWidth, mHeight, mMapped, false);
 	}
 
 	mSouth = x.mSouth;
@@ -415,20 +501,13 @@ void DEMGeo::derez_nearest(void)
 void	DEMGeo::resize(int width, int height)
 {
 	if (width == mWidth && height == mHeight) return;
-	if (mData) free(mData);
+	dem_free(mData, mWidth, mHeight, mMapped);
 
 	mWidth = width; mHeight = height;
 
-	if (mWidth == 0 || mHeight == 0)
-	{
-		mData = 0;
-	} else {
-		mData = (float *) malloc((size_t) mWidth * (size_t) mHeight * sizeof(float));
-		if (mData == NULL)
-			mWidth = mHeight = 0;
-		else
-			memset(mData, 0, (size_t) mWidth * (size_t) mHeight * sizeof(float));
-	}
+	mData = dem_alloc(mWidth, mHeight, mMapped, true);
+	if (mData == NULL && mWidth && mHeight)
+		mWidth = mHeight = 0;
 }
 
 void DEMGeo::set_rez(double x_res, double y_res)
@@ -481,6 +560,7 @@ void	DEMGeo::swap(DEMGeo& rhs)
 	std::swap(mWidth, rhs.mWidth);
 	std::swap(mHeight, rhs.mHeight);
 	std::swap(mData, rhs.mData);
+	std::swap(mMapped, rhs.mMapped);
 	std::swap(mPost, rhs.mPost);
 }
 
@@ -877,24 +957,194 @@ float	DEMGeo::local_minmax(int x1, int y1, int x2, int y2,
 
 void	DEMGeo::filter_self(int dim, float * k)
 {
-	DEMGeo	temp(*this);
-	for (int x = 0; x < temp.mWidth; ++x)
-	for (int y = 0; y < temp.mHeight;++y)
+	KernelFilterDEM(*this, *this, dim, k, false);
+}
+
+void	DEMGeo::filter_self_normalize(int dim, float * k)
+{
+	KernelFilterDEM(*this, *this, dim, k, true);
+}
+
+/*************************************************************************************
+ * FILTER ENGINE
+ *************************************************************************************
+
+	Both filters work a row at a time: for each tap of the kernel we run down a whole row of source samples
+	and add the weighted sample into a row of sums, skipping voids.  Each output pixel still sees its taps
+	in the same order as the per-pixel kernelN code did, so results are bit-identical, but the inner loop
+	is a straight run over memory that we can do four pixels at a time.  Bands of rows are then spread
+	over all CPUs.
+
+ */
+
+#define	DEM_FILTER_BAND	16		// Rows per work item
+
+// s[x] += e * k and w[x] += k for every non-void sample e = src[x]; c[x] (if not NULL) counts the samples.
+static void	dem_accum_tap(const float * src, float k, float * s, float * w, float * c, int n)
+{
+	int x = 0;
+#if DEM_SSE2
+	__m128	kk = _mm_set1_ps(k);
+	__m128	nd = _mm_set1_ps(DEM_NO_DATA);
+	__m128	one = _mm_set1_ps(1.0f);
+	for (; x + 4 <= n; x += 4)
+	{
+		__m128 e = _mm_loadu_ps(src + x);
+		__m128 m = _mm_cmpneq_ps(e, nd);
+		_mm_storeu_ps(s + x, _mm_add_ps(_mm_loadu_ps(s + x), _mm_and_ps(m, _mm_mul_ps(e, kk))));
+		_mm_storeu_ps(w + x, _mm_add_ps(_mm_loadu_ps(w + x), _mm_and_ps(m, kk)));
+		if (c)
+			_mm_storeu_ps(c + x, _mm_add_ps(_mm_loadu_ps(c + x), _mm_and_ps(m, one)));
+	}
+#endif
+	for (; x < n; ++x)
+	if (src[x] != DEM_NO_DATA)
 	{
-		(*this)(x,y) = temp.kernelN(x,y,dim,k);
+		s[x] += src[x] * k;
+		w[x] += k;
+		if (c) c[x] += 1.0f;
 	}
 }
 
-void	DEMGeo::filter_self_normalize(int dim, float * k)
+// dst[x] = s[x] / w[x], or DEM_NO_DATA where w[x] is 0.
+static void	dem_finish_normalized(const float * s, const float * w, float * dst, int n)
+{
+	int x = 0;
+#if DEM_SSE2
+	__m128	nd = _mm_set1_ps(DEM_NO_DATA);
+	__m128	zero = _mm_setzero_ps();
+	for (; x + 4 <= n; x += 4)
+	{
+		__m128 ww = _mm_loadu_ps(w + x);
+		__m128 r = _mm_div_ps(_mm_loadu_ps(s + x), ww);
+		__m128 m = _mm_cmpeq_ps(ww, zero);
+		_mm_storeu_ps(dst + x, _mm_or_ps(_mm_andnot_ps(m, r), _mm_and_ps(m, nd)));
+	}
+#endif
+	for (; x < n; ++x)
+		dst[x] = (w[x] == 0.0f) ? DEM_NO_DATA : s[x] / w[x];
+}
+
+struct	dem_sep_job {
+	const DEMGeo *	src;
+	DEMGeo *		tmp;
+	DEMGeo *		dst;
+	const float *	kx;
+	int				wx;
+	const float *	ky;
+	int				wy;
+};
+
+static void	dem_sep_vert(int band, void * ref)
+{
+	dem_sep_job * j = (dem_sep_job *) ref;
+	int w = j->src->mWidth;
+	int h = j->src->mHeight;
+	vector<float>	s(w), wt(w);
+	for (int y = band * DEM_FILTER_BAND; y < min(h, (band + 1) * DEM_FILTER_BAND); ++y)
+	{
+		fill(s.begin(), s.end(), 0.0f);
+		fill(wt.begin(), wt.end(), 0.0f);
+		for (int t = -j->wy; t <= j->wy; ++t)
+		if (y + t >= 0 && y + t < h)
+			dem_accum_tap(j->src->mData + (size_t) (y + t) * w, j->ky[t + j->wy], &s[0], &wt[0], NULL, w);
+		dem_finish_normalized(&s[0], &wt[0], j->tmp->mData + (size_t) y * w, w);
+	}
+}
+
+static void	dem_sep_horz(int band, void * ref)
 {
-	DEMGeo	temp(*this);
-	for (int x = 0; x < temp.mWidth; ++x)
-	for (int y = 0; y < temp.mHeight;++y)
+	dem_sep_job * j = (dem_sep_job *) ref;
+	int w = j->tmp->mWidth;
+	int h = j->tmp->mHeight;
+	vector<float>	s(w), wt(w);
+	vector<float>	row(w + 2 * j->wx, DEM_NO_DATA);	// Void padding stands in for the samples off the DEM.
+	for (int y = band * DEM_FILTER_BAND; y < min(h, (band + 1) * DEM_FILTER_BAND); ++y)
 	{
-		(*this)(x,y) = temp.kernelN_Normalize(x,y,dim,k);
+		memcpy(&row[j->wx], j->tmp->mData + (size_t) y * w, w * sizeof(float));
+		fill(s.begin(), s.end(), 0.0f);
+		fill(wt.begin(), wt.end(), 0.0f);
+		for (int t = -j->wx; t <= j->wx; ++t)
+			dem_accum_tap(&row[j->wx + t], j->kx[t + j->wx], &s[0], &wt[0], NULL, w);
+		dem_finish_normalized(&s[0], &wt[0], j->dst->mData + (size_t) y * w, w);
 	}
 }
 
+void		SeparableFilterDEM(const DEMGeo& src, DEMGeo& dst, const float * kx, int wx, const float * ky, int wy, int inMaxThreads)
+{
+	DEMGeo	temp(src.mWidth, src.mHeight);
+	if (src.mData == NULL || temp.mData == NULL) return;
+	dem_sep_job	job = { &src, &temp, &dst, kx, wx, ky, wy };
+	int bands = (src.mHeight + DEM_FILTER_BAND - 1) / DEM_FILTER_BAND;
+	TU_ParallelFor(bands, dem_sep_vert, &job, inMaxThreads);
+	// The vertical pass is the last to read src, so from here on dst may be src.
+	dst.resize(src.mWidth, src.mHeight);
+	TU_ParallelFor(bands, dem_sep_horz, &job, inMaxThreads);
+}
+
+struct	dem_kernel_job {
+	vector<float>	padded;		// src with hdim samples of clamped edge all around.
+	int				pw;
+	int				hdim;
+	int				dim;
+	const float *	k;
+	bool			normalize;
+	DEMGeo *		dst;
+};
+
+static void	dem_kernel_rows(int band, void * ref)
+{
+	dem_kernel_job * j = (dem_kernel_job *) ref;
+	int w = j->dst->mWidth;
+	int h = j->dst->mHeight;
+	vector<float>	s(w), wt(w), c(w);
+	for (int y = band * DEM_FILTER_BAND; y < min(h, (band + 1) * DEM_FILTER_BAND); ++y)
+	{
+		fill(s.begin(), s.end(), 0.0f);
+		fill(wt.begin(), wt.end(), 0.0f);
+		fill(c.begin(), c.end(), 0.0f);
+		// Same tap order as kernelN: dx outer, dy inner.
+		const float * k = j->k;
+		for (int dx = 0; dx < j->dim; ++dx)
+		for (int dy = 0; dy < j->dim; ++dy)
+			dem_accum_tap(&j->padded[(size_t) (y + dy) * j->pw + dx], *k++, &s[0], &wt[0], j->normalize ? NULL : &c[0], w);
+
+		float * out = j->dst->mData + (size_t) y * w;
+		if (j->normalize)
+			dem_finish_normalized(&s[0], &wt[0], out, w);
+		else
+		for (int x = 0; x < w; ++x)
+			out[x] = (c[x] == 0.0f) ? DEM_NO_DATA : s[x];
+	}
+}
+
+void		KernelFilterDEM(const DEMGeo& src, DEMGeo& dst, int dim, const float * k, bool normalize, int inMaxThreads)
+{
+	if (src.mData == NULL) return;
+	dem_kernel_job	job;
+	job.hdim = dim / 2;
+	job.dim = job.hdim * 2 + 1;
+	job.pw = src.mWidth + 2 * job.hdim;
+	job.k = k;
+	job.normalize = normalize;
+	job.dst = &dst;
+	job.padded.resize((size_t) job.pw * (src.mHeight + 2 * job.hdim));
+	for (int y = 0; y < src.mHeight + 2 * job.hdim; ++y)
+	{
+		const float * sr = src.mData + (size_t) intlim(y - job.hdim, 0, src.mHeight - 1) * src.mWidth;
+		float * dr = &job.padded[(size_t) y * job.pw];
+		for (int x = 0; x < job.hdim; ++x)
+		{
+			dr[x] = sr[0];
+			dr[job.pw - 1 - x] = sr[src.mWidth - 1];
+		}
+		memcpy(dr + job.hdim, sr, src.mWidth * sizeof(float));
+	}
+	// Everything we need from src is in the padded copy now, so dst may be src.
+	dst.resize(src.mWidth, src.mHeight);
+	TU_ParallelFor((src.mHeight + DEM_FILTER_BAND - 1) / DEM_FILTER_BAND, dem_kernel_rows, &job, inMaxThreads);
+}
+
 
 /*
  * Given DEMs that contain the minimum and maximum for a given point,
@@ -1183,6 +1433,169 @@ float	DEMGeo_LocalMinMaxWithCache(
 	return maxh - minh;
 }
 
+/************************************************************************************************
+ * MIN/MAX PYRAMID
+ ************************************************************************************************/
+
+DEMMinMaxPyramid::DEMMinMaxPyramid() : mDEM(NULL)
+{
+}
+
+void	DEMMinMaxPyramid::clear(void)
+{
+	mDEM = NULL;
+	mMin.clear();
+	mMax.clear();
+}
+
+// Level k at (x,y) is the min/max of the four level k-1 squares at (x,y), (x+h,y), (x,y+h), (x+h,y+h)
+// with h = 2^(k-1).  Only pixels where the whole square fits on the DEM are filled in.
+void	DEMMinMaxPyramid::build(const DEMGeo& inDEM, int inLevels)
+{
+	clear();
+	mDEM = &inDEM;
+	int w = inDEM.mWidth;
+	int h = inDEM.mHeight;
+	while (inLevels > 0 && (2 << (inLevels-1)) > min(w, h))
+		--inLevels;
+	mMin.resize(inLevels);
+	mMax.resize(inLevels);
+
+	for (int k = 1; k <= inLevels; ++k)
+	{
+		const float * smin = (k == 1) ? inDEM.mData : &*mMin[k-2].begin();
+		const float * smax = (k == 1) ? inDEM.mData : &*mMax[k-2].begin();
+		mMin[k-1].assign(w * h, DEM_NO_DATA);
+		mMax[k-1].assign(w * h, DEM_NO_DATA);
+		float * dmin = &*mMin[k-1].begin();
+		float * dmax = &*mMax[k-1].begin();
+		int half = 1 << (k-1);
+		int side = 1 << k;
+		for (int y = 0; y <= h - side; ++y)
+		for (int x = 0; x <= w - side; ++x)
+		{
+			int a = y * w + x;
+			int b = a + half;
+			int c = a + half * w;
+			int d = c + half;
+			dmin[a] = MIN_NODATA(MIN_NODATA(smin[a], smin[b]), MIN_NODATA(smin[c], smin[d]));
+			dmax[a] = MAX_NODATA(MAX_NODATA(smax[a], smax[b]), MAX_NODATA(smax[c], smax[d]));
+		}
+	}
+}
+
+bool	DEMMinMaxPyramid::range(int x1, int y1, int x2, int y2, float& minh, float& maxh) const
+{
+	minh = maxh = DEM_NO_DATA;
+	if (mDEM == NULL) return false;
+	x1 = max(x1, 0);
+	y1 = max(y1, 0);
+	x2 = min(x2, mDEM->mWidth);
+	y2 = min(y2, mDEM->mHeight);
+	if (x1 >= x2 || y1 >= y2) return false;
+
+	int shortest = min(x2 - x1, y2 - y1);
+	int k = 0;
+	while (k < mMin.size() && (2 << k) <= shortest)
+		++k;
+	int side = 1 << k;
+	int w = mDEM->mWidth;
+	const float * lmin = (k == 0) ? mDEM->mData : &*mMin[k-1].begin();
+	const float * lmax = (k == 0) ? mDEM->mData : &*mMax[k-1].begin();
+
+	// Walk the squares along each axis; the last one is pulled back to end exactly on the edge, so
+	// it may overlap its neighbor.  That's fine for min and max.
+	bool found = false;
+	float lo = 0.0f, hi = 0.0f;
+	for (int y = y1; ; y += side)
+	{
+		if (y > y2 - side) y = y2 - side;
+		for (int x = x1; ; x += side)
+		{
+			if (x > x2 - side) x = x2 - side;
+			float e1 = lmin[y * w + x];
+			float e2 = lmax[y * w + x];
+			if (e1 != DEM_NO_DATA)
+			{
+				if (!found) { lo = e1; hi = e2; found = true; }
+				else { lo = min(lo, e1); hi = max(hi, e2); }
+			}
+			if (x == x2 - side) break;
+		}
+		if (y == y2 - side) break;
+	}
+	if (found)
+	{
+		minh = lo;
+		maxh = hi;
+	}
+	return found;
+}
+
+float	DEMMinMaxPyramid::max_error_bound(int x1, int y1, int x2, int y2, double a, double b, double c) const
+{
+	float lo, hi;
+	if (!range(x1, y1, x2, y2, lo, hi))
+		return 0.0f;
+
+	// The plane is linear, so its extremes over the (clipped) rectangle are at the corners.
+	double xl = max(x1, 0), xh = min(x2, mDEM->mWidth) - 1;
+	double yl = max(y1, 0), yh = min(y2, mDEM->mHeight) - 1;
+	double p1 = a * xl + b * yl + c;
+	double p2 = a * xh + b * yl + c;
+	double p3 = a * xl + b * yh + c;
+	double p4 = a * xh + b * yh + c;
+	double pmin = min(min(p1, p2), min(p3, p4));
+	double pmax = max(max(p1, p2), max(p3, p4));
+	return max((double) hi - pmin, pmax - (double) lo);
+}
+
+float	DEMMinMaxPyramid::max_error_bound_tri(const double x[3], const double y[3], double a, double b, double c) const
+{
+	if (mDEM == NULL) return 0.0f;
+	int band = 1 << mMin.size();
+	int ylo = floor(min(min(y[0], y[1]), y[2]));
+	int yhi = ceil(max(max(y[0], y[1]), y[2]));
+	float worst = 0.0f;
+
+	for (int yb = ylo; yb <= yhi; yb += band)
+	{
+		double	slab_lo = yb;
+		double	slab_hi = min(yb + band - 1, yhi);
+		double	xmin = 9.9e9, xmax = -9.9e9;
+
+		// The part of the tri inside the slab is bounded by the corners in the slab plus the
+		// edges' crossings of the slab's top and bottom.
+		for (int i = 0; i < 3; ++i)
+		{
+			int j = (i + 1) % 3;
+			if (y[i] >= slab_lo && y[i] <= slab_hi)
+			{
+				xmin = min(xmin, x[i]);
+				xmax = max(xmax, x[i]);
+			}
+			double ey1 = min(y[i], y[j]);
+			double ey2 = max(y[i], y[j]);
+			if (ey1 == ey2) continue;
+			for (int s = 0; s < 2; ++s)
+			{
+				double sy = s ? slab_hi : slab_lo;
+				if (sy >= ey1 && sy <= ey2)
+				{
+					double sx = x[i] + (x[j] - x[i]) * (sy - y[i]) / (y[j] - y[i]);
+					xmin = min(xmin, sx);
+					xmax = max(xmax, sx);
+				}
+			}
+		}
+		if (xmin > xmax) continue;
+
+		// One pixel of slop on each side - rasterizers step along edges incrementally and can wander.
+		worst = max(worst, max_error_bound((int) floor(xmin) - 1, yb, (int) ceil(xmax) + 2, (int) slab_hi + 1, a, b, c));
+	}
+	return worst;
+}
+
 DEMMask::DEMMask() :
 	mWest(-180), mEast(180), mSouth(-90), mNorth(90),
 	mWidth(0),mHeight(0), mPost(1)
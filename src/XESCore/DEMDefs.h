@@ -74,7 +74,17 @@
 		on addresses.  Template with 4 for orthogonal connection or 8 for diagonal
 		conncetion.
 		
+	OUT-OF-CORE STORAGE
 	
+	By default mData is a malloc'd block.  If a scratch directory has been set with
+	DEMGeo_SetScratchDir, any DEM whose data is at least the given size is instead
+	stored in an (already deleted) scratch file in that directory that is mapped
+	into memory.  All access is still through mData, so nothing else changes, but
+	the pages of a mapped DEM are backed by the file rather than swap: the OS keeps
+	the hot blocks of each layer resident and writes the cold ones out, so a 
+	DEMGeoMap of 1 arc-second or lidar layers can be worked on with far less RAM
+	than the sum of its layers.  Row-wise passes are cheap; column-wise passes over
+	a non-resident layer page in one block per row, so prefer row order for big DEMs.
 
  */
 
@@ -148,6 +158,7 @@ struct	DEMGeo {
 	// An array of width*height data points in floating point format.
 	// The first sample is the southwest corner, we then proceed east.
 	float *	mData;
+	int		mMapped;	// If 1, mData is a mapped scratch file (see DEMGeo_SetScratchDir) and not malloc'd.
 
 	inline	float	pixel_offset() const { return mPost ? 0.0 : 0.5; }	// distance from the coordinate defining a pixel to its sampling center.
 	inline	int		pixel_area() const { return mWidth * mHeight; }
@@ -370,10 +381,84 @@ struct	DEMMask {
 	vector<bool>	mData;
 };
 
+/*************************************************************************************
+ * DEMMinMaxPyramid - FAST RANGE QUERIES
+ *************************************************************************************/
+
+/*
+	A min/max pyramid is a sparse table over one DEM: level k holds, for every pixel, the
+	min and max of the 2^k x 2^k square whose lower left corner is that pixel.  (Level 0 is
+	the DEM itself and is not copied.)  A range query picks the biggest level whose squares
+	fit in the rectangle and walks them, so it costs about (w / 2^k) * (h / 2^k) lookups
+	instead of w * h - a 64x64 rectangle on a 3 level pyramid is 64 lookups, not 4096.
+
+	This is NOT constant time: it would be with all log2(min(w,h)) levels built (then a
+	square is at most 4 lookups and only skinny rectangles cost more), but every level is
+	another 2 floats per pixel - a full table over a 1201x1201 DEM is over 100 MB.  The
+	mesher builds only 3 levels (SCAN_BAND_LEVELS in GreedyMesh.cpp) because it mostly asks
+	about thin scanline bands 8 pixels high; higher levels would not help those and would
+	cost memory on every tile.  Build more levels if you ask about big squares.
+
+	DEM_NO_DATA pixels are ignored; a range with no data at all has no min/max.
+
+	The pyramid points at the DEM it was built from; that DEM must not change or go away
+	while the pyramid is in use.  Queries are const and safe to run from several threads.
+*/
+class	DEMMinMaxPyramid {
+public:
+
+	DEMMinMaxPyramid();
+
+	void	build(const DEMGeo& inDEM, int inLevels);
+	void	clear(void);
+
+	// Min and max over x1 <= x < x2, y1 <= y < y2 (clipped to the DEM).  Returns false if there
+	// are no data points in the range.
+	bool	range(int x1, int y1, int x2, int y2, float& minh, float& maxh) const;
+
+	// Upper bound on |DEM(x,y) - (a * x + b * y + c)| over the same kind of rectangle.  This is
+	// what the meshers want: if the bound is under the error they already have, there is no
+	// point in scanning the rectangle.  0 if there's no data.
+	float	max_error_bound(int x1, int y1, int x2, int y2, double a, double b, double c) const;
+
+	// Same bound over every pixel that could be inside the triangle whose corners are given in
+	// pixel coordinates.  The triangle is cut into bands 2^levels pixels high and each band is
+	// bounded by the triangle's extent within it.
+	float	max_error_bound_tri(const double x[3], const double y[3], double a, double b, double c) const;
+
+	int		levels(void) const { return mMin.size(); }
+
+private:
+
+	const DEMGeo *			mDEM;
+	vector<vector<float> >	mMin;		// mMin[k-1] is level k, same layout as DEMGeo::mData.
+	vector<vector<float> >	mMax;
+
+	DEMMinMaxPyramid(const DEMMinMaxPyramid&);
+	DEMMinMaxPyramid& operator=(const DEMMinMaxPyramid&);
+
+};
+
 /*************************************************************************************
  * FREE LOW-LEVEL DEM PROCESSING FUNCS
  *************************************************************************************/
 
+// Sets the directory for mapped DEM storage - DEMs of at least inMinBytes allocated from now on
+// live in scratch files there.  Pass NULL to go back to malloc for all DEMs.  Existing DEMs keep
+// the storage they have.
+void		DEMGeo_SetScratchDir(const char * inDir, size_t inMinBytes);
+
+// Multi-threaded filters.  Both read all of src before writing dst, so src and dst may be the same DEM;
+// dst is resized to match src but its geo-coordinates are left alone.  DEM_NO_DATA samples are skipped and
+// a pixel where every sample is void comes out as DEM_NO_DATA.
+// SeparableFilterDEM runs ky (2*wy+1 taps) down the columns and then kx (2*wx+1 taps) along the rows.  Samples
+// off the DEM are skipped too, and each pixel is normalized by the weight of the taps that were used.
+void		SeparableFilterDEM(const DEMGeo& src, DEMGeo& dst, const float * kx, int wx, const float * ky, int wy, int inMaxThreads = 0);
+// KernelFilterDEM applies a dim x dim kernel to every pixel exactly as DEMGeo::kernelN (or kernelN_Normalize
+// if normalize is set) would - off-DEM samples are clamped to the edge.
+// inMaxThreads caps the worker threads (0 = one per core) - pass a share of the cores when calling from a thread.
+void		KernelFilterDEM(const DEMGeo& src, DEMGeo& dst, int dim, const float * k, bool normalize, int inMaxThreads = 0);
+
 void		dem_coverage_nearest(const DEMGeo& d, double lon1, double lat1, double lon2, double lat2, int bounds[4]);
 
 // IMPORTANT: the original values must ALL be filled in in orig_src - io_dst should have the voids!
@@ -51,7 +51,7 @@
 #define TIMER(x)
 #endif
 
-DSFBuildPrefs_t	gDSFBuildPrefs = { 1 };
+DSFBuildPrefs_t	gDSFBuildPrefs = { 1, 0 };
 
 #if PHONE
 	// Ben syas: 32x32 is definitely a good bucket size - when we go 16x16 our vertex count goes way up and fps tank.
@@ -1031,6 +1031,8 @@ set<int>					sLoResLU[PATCH_DIM_LO * PATCH_DIM_LO];
 	writer2 = inFileName2 ? ((inFileName1 && strcmp(inFileName1,inFileName2)==0) ? writer1 : DSFCreateWriter(inElevation.mWest, inElevation.mSouth, inElevation.mEast, inElevation.mNorth,use_min, use_max, DSF_DIVISIONS)) : NULL;
 	StNukeWriter	dontLeakWriter1(writer1);
 	StNukeWriter	dontLeakWriter2(writer2==writer1 ? NULL : writer2);
+	// The base mesh is the bulk of a tile - if asked, park finished patches on disk rather than in RAM.
+	if (writer1 && gDSFBuildPrefs.spill_patches) DSFSetWriterSpill(writer1, 1);
  	DSFGetWriterCallbacks(&cbs);
 
 	/****************************************************************
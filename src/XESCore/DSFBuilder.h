@@ -30,6 +30,7 @@
 
 struct	DSFBuildPrefs_t {
 	int	export_roads;
+	int	spill_patches;		// Park finished base mesh patches in temp files (see DSFSetWriterSpill) - off by default.
 };
 
 extern DSFBuildPrefs_t	gDSFBuildPrefs;
@@ -29,12 +29,15 @@
 #include "CompGeomDefs2.h"
 #include "CompGeomDefs3.h"
 #include "PolyRasterUtils.h"
+#include "ThreadUtils.h"
 
-static		 CDT *		sCurrentMesh = NULL;
-static const DEMGeo *	sCurrentDEM = NULL;
-static		 DEMMask *	sUsedDEM = NULL;
+// Below this many triangles a rescan isn't worth waking up worker threads for - a typical single insert
+// only touches a handful of faces.
+#define	PARALLEL_RESCAN_MIN	64
 
-static FaceQueue	sBestChoices;
+// Scanlines are bounded against the min/max pyramid in bands of this many rows (2^levels).
+#define	SCAN_BAND_LEVELS	3
+#define	SCAN_BAND			(1 << SCAN_BAND_LEVELS)
 
 struct	eval_face {
 bool operator()(const CDT::Face_handle f1, const CDT::Face_handle f2) const {
@@ -53,18 +56,18 @@ inline CDT::Face_handle CDT_Recover_Handle(CDT::Face *the_face)
 
 
 // Calc plane eq of one tri
-bool	InitOneTri(CDT::Face_handle face)
+static bool	InitOneTri(const CDT& inMesh, const DEMGeo * inDEM, CDT::Face_handle face)
 {
-	if (!sCurrentMesh->is_infinite(face))
+	if (!inMesh.is_infinite(face))
 	{
-		Point3	p1(sCurrentDEM->lon_to_x(CGAL::to_double(face->vertex(0)->point().x())),
-				   sCurrentDEM->lat_to_y(CGAL::to_double(face->vertex(0)->point().y())),
+		Point3	p1(inDEM->lon_to_x(CGAL::to_double(face->vertex(0)->point().x())),
+				   inDEM->lat_to_y(CGAL::to_double(face->vertex(0)->point().y())),
 				   face->vertex(0)->info().height);
-		Point3	p2(sCurrentDEM->lon_to_x(CGAL::to_double(face->vertex(1)->point().x())),
-				   sCurrentDEM->lat_to_y(CGAL::to_double(face->vertex(1)->point().y())),
+		Point3	p2(inDEM->lon_to_x(CGAL::to_double(face->vertex(1)->point().x())),
+				   inDEM->lat_to_y(CGAL::to_double(face->vertex(1)->point().y())),
 				   face->vertex(1)->info().height);
-		Point3	p3(sCurrentDEM->lon_to_x(CGAL::to_double(face->vertex(2)->point().x())),
-				   sCurrentDEM->lat_to_y(CGAL::to_double(face->vertex(2)->point().y())),
+		Point3	p3(inDEM->lon_to_x(CGAL::to_double(face->vertex(2)->point().x())),
+				   inDEM->lat_to_y(CGAL::to_double(face->vertex(2)->point().y())),
 				   face->vertex(2)->info().height);
 
 		Vector3	v1(p1, p2);
@@ -78,7 +81,7 @@ bool	InitOneTri(CDT::Face_handle face)
 
 	bool	first_time = !face->info().flag;
 	if (first_time)
-		face->info().self = sBestChoices.end();
+		face->info().self = -1;
 	face->info().flag = true;
 	return first_time;
 }
@@ -86,13 +89,15 @@ bool	InitOneTri(CDT::Face_handle face)
 // The rasterization of triangles is done in floating point, but this can lead to subtle errors.  This code goes back
 // and checks the final point (converted back to precise CGAL coordinates) against the original triangle.  We don't include
 // the point if (1) it is outside the triangle bounds or (2) it duplicates a corner (since corners are already exact).
-bool really_ok_point(const DEMGeo * dem, int x, int y, const CDT::Point& v1, const CDT::Point& v2, const CDT::Point& v3)
+static bool really_ok_point(const DEMGeo * dem, int x, int y, const CDT::Point& v1, const CDT::Point& v2, const CDT::Point& v3)
 {
 	CDT::Point p(dem->x_to_lon(x), dem->y_to_lat(y));
 	return p != v1 && p != v2 && p != v3 &&
 		!Triangle_2(v1,v2,v3).has_on_unbounded_side(p);
 }
 
+// Scan one row of a tri for the worst point.  If v is NULL we skip the exact check - this is the
+// thread-safe mode; the caller must vet the winner with really_ok_point itself.
 inline float ScanlineMaxError(
 					const DEMGeo *	inDEMSrc,
 					const DEMMask *	inDEMUsed,
@@ -105,9 +110,7 @@ inline float ScanlineMaxError(
 					double			a,
 					double			b,
 					double			c,
-					const CDT::Point&		v1,
-					const CDT::Point&		v2,
-					const CDT::Point&		v3)
+					const CDT::Point *		v)
 {
 	float * row = inDEMSrc->mData + y * inDEMSrc->mWidth;
 	vector<bool>::const_iterator used = inDEMUsed->mData.begin() + y * inDEMUsed->mWidth;
@@ -134,7 +137,7 @@ inline float ScanlineMaxError(
 			float diff = want - got;
 			if (diff < 0.0) diff = -diff;
 			if (diff > worst)
-			if (really_ok_point(inDEMSrc,x,y,v1,v2,v3))
+			if (v == NULL || really_ok_point(inDEMSrc,x,y,v[0],v[1],v[2]))
 			{
 				worst = diff;
 				*worst_x = x;
@@ -145,39 +148,44 @@ inline float ScanlineMaxError(
 	return worst;
 }
 
+// Everything the scanline pass needs to know about one tri, copied out of the CDT as doubles so
+// that it can be handed to another thread.
+struct	tri_scan {
+	Point2		p[3];			// Corners in DEM pixel space, or all zero if the tri is skipped.
+	double		a, b, c;		// Plane eq, from InitOneTri.
+	bool		skip;			// Out of bounds or under the size limit - err is 0.
+	float		err_floor;		// Errors at or under this don't matter (the tri won't be queued), so we can skip them.
+	float		err;
+	int			worst_x;
+	int			worst_y;
+};
 
-// Find err of one tri
-void	CalcOneTriError(CDT::Face_handle face, double size_lim)
+// Fill in the scan for one tri - this is the part that has to touch CGAL, so it always runs on the
+// calling thread.
+static void	SetupTriScan(const CDT& inMesh, const DEMGeo * inDEM, CDT::Face_handle face, double err_lim, double size_lim, tri_scan& scan)
 {
-	if (sCurrentMesh->is_infinite(face))
-	{
-		face->info().insert_err = 0.0;
+	scan.skip = true;
+	scan.err_floor = err_lim;
+	scan.err = 0.0;
+	scan.worst_x = scan.worst_y = 0;
+	if (inMesh.is_infinite(face))
 		return;
-	}
-	Point2	p0( sCurrentDEM->lon_to_x(CGAL::to_double(face->vertex(0)->point().x())),
-			    sCurrentDEM->lat_to_y(CGAL::to_double(face->vertex(0)->point().y())));
-	Point2	p1( sCurrentDEM->lon_to_x(CGAL::to_double(face->vertex(1)->point().x())),
-			    sCurrentDEM->lat_to_y(CGAL::to_double(face->vertex(1)->point().y())));
-	Point2	p2( sCurrentDEM->lon_to_x(CGAL::to_double(face->vertex(2)->point().x())),
-			    sCurrentDEM->lat_to_y(CGAL::to_double(face->vertex(2)->point().y())));
-
-	if (p0.x() < 0 || p0.x() > sCurrentDEM->mWidth ||
-		p0.y() < 0 || p0.y() > sCurrentDEM->mHeight ||
-		p1.x() < 0 || p1.x() > sCurrentDEM->mWidth ||
-		p1.y() < 0 || p1.y() > sCurrentDEM->mHeight ||
-		p2.x() < 0 || p2.x() > sCurrentDEM->mWidth ||
-		p2.y() < 0 || p2.y() > sCurrentDEM->mHeight)
+
+	for (int n = 0; n < 3; ++n)
+		scan.p[n] = Point2(inDEM->lon_to_x(CGAL::to_double(face->vertex(n)->point().x())),
+						   inDEM->lat_to_y(CGAL::to_double(face->vertex(n)->point().y())));
+
+	for (int n = 0; n < 3; ++n)
+	if (scan.p[n].x() < 0 || scan.p[n].x() > inDEM->mWidth ||
+		scan.p[n].y() < 0 || scan.p[n].y() > inDEM->mHeight)
 	{
 		fprintf(stderr, "%lf %lf, %lf %lf, %lf %lf\n",
 				CGAL::to_double(face->vertex(0)->point().x()), CGAL::to_double(face->vertex(0)->point().y()),
 				CGAL::to_double(face->vertex(1)->point().x()), CGAL::to_double(face->vertex(1)->point().y()),
 				CGAL::to_double(face->vertex(2)->point().x()), CGAL::to_double(face->vertex(2)->point().y()));
-		face->info().insert_err = 0.0;
 		return;
 	}
 
-
-
 	if (size_lim != 0.0)
 	{
 		double xmin = min(min(CGAL::to_double(face->vertex(0)->point().x()),CGAL::to_double(face->vertex(1)->point().x())),CGAL::to_double(face->vertex(2)->point().x()));
@@ -189,11 +197,124 @@ void	CalcOneTriError(CDT::Face_handle face, double size_lim)
 		double ys = ymax - ymin;
 
 		if (xs < size_lim && ys < size_lim)
-		{
-			face->info().insert_err = 0.0;
 			return;
+	}
+
+	scan.a = face->info().plane_a;
+	scan.b = face->info().plane_b;
+	scan.c = face->info().plane_c;
+	scan.skip = false;
+}
+
+// Slop for comparing a pyramid bound (done in double) against the float error the scanline would
+// compute - the float math can round up by a few ulps of the biggest value involved.
+inline float	BoundSlop(double a, double b, double c, double x, double y, float bound)
+{
+	return 1.0e-5 * (fabs(a) * x + fabs(b) * y + fabs(c) + bound) + 1.0e-3;
+}
+
+// A run of up to SCAN_BAND consecutive scanlines.  Before scanning them we ask the pyramid whether any
+// pixel in their bounding box could beat the worst error so far (or the floor); if not, the whole band is
+// skipped.  Since a point only wins with a strictly bigger error, skipping can't change which point wins.
+struct	scan_band {
+	int		y0;
+	int		count;
+	double	x1[SCAN_BAND];
+	double	x2[SCAN_BAND];
+};
+
+static float	ScanBandMaxError(
+					const DEMGeo *				inDEMSrc,
+					const DEMMask *				inDEMUsed,
+					const DEMMinMaxPyramid *	inRange,
+					scan_band&					band,
+					float						err_floor,
+					float						worst,
+					int *						worst_x,
+					int *						worst_y,
+					double						a,
+					double						b,
+					double						c,
+					const CDT::Point *			v)
+{
+	if (band.count == 0)
+		return worst;
+	if (inRange)
+	{
+		double	lo = 9.9e9, hi = -9.9e9;
+		for (int n = 0; n < band.count; ++n)
+		{
+			lo = min(lo, min(band.x1[n], band.x2[n]));
+			hi = max(hi, max(band.x1[n], band.x2[n]));
+		}
+		int	ix1 = ceil(lo);
+		int	ix2 = floor(hi);
+		int	y_top = band.y0 + band.count - 1;
+		float bound = inRange->max_error_bound(ix1, band.y0, ix2 + 1, y_top + 1, a, b, c);
+		if (bound + BoundSlop(a, b, c, ix2, y_top, bound) <= max(worst, err_floor))
+		{
+			band.count = 0;
+			return worst;
 		}
 	}
+	for (int n = 0; n < band.count; ++n)
+		worst = ScanlineMaxError(inDEMSrc, inDEMUsed, band.y0 + n, band.x1[n], band.x2[n], worst, worst_x, worst_y, a, b, c, v);
+	band.count = 0;
+	return worst;
+}
+
+inline float	AddBandScanline(
+					const DEMGeo *				inDEMSrc,
+					const DEMMask *				inDEMUsed,
+					const DEMMinMaxPyramid *	inRange,
+					scan_band&					band,
+					int							y,
+					double						x1,
+					double						x2,
+					float						err_floor,
+					float						worst,
+					int *						worst_x,
+					int *						worst_y,
+					double						a,
+					double						b,
+					double						c,
+					const CDT::Point *			v)
+{
+	if (band.count == 0)
+		band.y0 = y;
+	DebugAssert(band.y0 + band.count == y);
+	band.x1[band.count] = x1;
+	band.x2[band.count] = x2;
+	if (++band.count == SCAN_BAND)
+		worst = ScanBandMaxError(inDEMSrc, inDEMUsed, inRange, band, err_floor, worst, worst_x, worst_y, a, b, c, v);
+	return worst;
+}
+
+// Rasterize one tri and find its worst point.  v is the exact corners, or NULL to skip the exact
+// point check (see ScanlineMaxError).  inRange may be NULL to scan every pixel.
+static void	ScanTriMaxError(const DEMGeo * inDEM, const DEMMask * inUsed, const DEMMinMaxPyramid * inRange, tri_scan& scan, const CDT::Point * v)
+{
+	scan.err = 0.0;
+	if (scan.skip)
+		return;
+
+	Point2	p0(scan.p[0]);
+	Point2	p1(scan.p[1]);
+	Point2	p2(scan.p[2]);
+
+	// Tris only a band or so tall are cheaper to just scan.
+	if (max(max(p0.y(), p1.y()), p2.y()) - min(min(p0.y(), p1.y()), p2.y()) < SCAN_BAND)
+		inRange = NULL;
+
+	// Cheap early out: a lot of tris are already within the error limit everywhere.
+	if (inRange)
+	{
+		double	tx[3] = { p0.x(), p1.x(), p2.x() };
+		double	ty[3] = { p0.y(), p1.y(), p2.y() };
+		float	bound = inRange->max_error_bound_tri(tx, ty, scan.a, scan.b, scan.c);
+		if (bound + BoundSlop(scan.a, scan.b, scan.c, inDEM->mWidth, inDEM->mHeight, bound) <= scan.err_floor)
+			return;
+	}
 
 //	gMeshLines.push_back(pair<Point2,Point3>(Point2(face->vertex(0)->point().x(),face->vertex(0)->point().y()), Point3(1,0,0)));
 //	gMeshLines.push_back(pair<Point2,Point3>(Point2(face->vertex(1)->point().x(),face->vertex(1)->point().y()), Point3(1,0,0)));
@@ -210,7 +331,6 @@ void	CalcOneTriError(CDT::Face_handle face, double size_lim)
 	if(p0.y() == p2.y())
 	{
 		// WTF?  Well, maybe the vector data has a micr-sliver, and the floating point equivalent is so damned thin...bail out.
-		face->info().insert_err = 0.0;
 		return;
 	}
 
@@ -227,9 +347,9 @@ void	CalcOneTriError(CDT::Face_handle face, double size_lim)
 
 	double dx1, dx2, x1, x2;
 
-	double a = face->info().plane_a;
-	double b = face->info().plane_b;
-	double c = face->info().plane_c;
+	double a = scan.a;
+	double b = scan.b;
+	double c = scan.c;
 
 	x1 = x2 = p0.x();
 /*	
@@ -246,14 +366,13 @@ void	CalcOneTriError(CDT::Face_handle face, double size_lim)
 		dx2 = (p2.x() - p0.x()) / (p2.y() - p0.y());
 
 	int 	worst_x = 0, worst_y = 0;
+	float	err_floor = scan.err_floor;
+	scan_band	band;
+	band.y0 = band.count = 0;
 
 	double partial = p0yc-p0.y();
 	x2 += dx2 * partial;
 
-	CDT::Point v1(face->vertex(0)->point());
-	CDT::Point v2(face->vertex(1)->point());
-	CDT::Point v3(face->vertex(2)->point());
-
 	// SPECIAL CASE: if p1 and p2 are horizontal, there is no section 2 of the tri - it has a flat top.  Do NOT miss that top scanline!
 	// Basically use floor + 1 to INCLDE the top scanline if we have a perfect match.
 	if (p1.y() == p2.y())
@@ -265,9 +384,9 @@ void	CalcOneTriError(CDT::Face_handle face, double size_lim)
 		x1 += dx1 * partial;
 		for (y = y0; y < y1; ++y)
 		{
-//			gMeshPoints.push_back(pair<Point2,Point3>(Point2(sCurrentDEM->x_to_lon_double(x1), sCurrentDEM->y_to_lat_double(y)),Point3(0,0,1)));
-//			gMeshPoints.push_back(pair<Point2,Point3>(Point2(sCurrentDEM->x_to_lon_double(x2), sCurrentDEM->y_to_lat_double(y)),Point3(0,0,1)));
-			err = ScanlineMaxError(sCurrentDEM, sUsedDEM, y, x1, x2, err, &worst_x, &worst_y, a, b, c, v1, v2, v3);
+//			gMeshPoints.push_back(pair<Point2,Point3>(Point2(inDEM->x_to_lon_double(x1), inDEM->y_to_lat_double(y)),Point3(0,0,1)));
+//			gMeshPoints.push_back(pair<Point2,Point3>(Point2(inDEM->x_to_lon_double(x2), inDEM->y_to_lat_double(y)),Point3(0,0,1)));
+			err = AddBandScanline(inDEM, inUsed, inRange, band, y, x1, x2, err_floor, err, &worst_x, &worst_y, a, b, c, v);
 			x1 += dx1;
 			x2 += dx2;
 		}
@@ -282,137 +401,336 @@ void	CalcOneTriError(CDT::Face_handle face, double size_lim)
 
 		for (y = y1; y < y2; ++y)
 		{
-			err = ScanlineMaxError(sCurrentDEM, sUsedDEM, y, x1, x2, err, &worst_x, &worst_y, a, b, c, v1, v2, v3);
+			err = AddBandScanline(inDEM, inUsed, inRange, band, y, x1, x2, err_floor, err, &worst_x, &worst_y, a, b, c, v);
 			x1 += dx1;
 			x2 += dx2;
 		}
 	}
 
-	face->info().insert_err = err;
-	if (err > 0)
+	err = ScanBandMaxError(inDEM, inUsed, inRange, band, err_floor, err, &worst_x, &worst_y, a, b, c, v);
+
+	scan.err = err;
+	scan.worst_x = worst_x;
+	scan.worst_y = worst_y;
+}
+
+// Find err of one tri
+static void	CalcOneTriError(const CDT& inMesh, const DEMGeo * inDEM, const DEMMask * inUsed, const DEMMinMaxPyramid * inRange, CDT::Face_handle face, double err_lim, double size_lim)
+{
+	tri_scan	scan;
+	SetupTriScan(inMesh, inDEM, face, err_lim, size_lim, scan);
+	if (!scan.skip)
 	{
-		face->info().insert_x = worst_x;
-		face->info().insert_y = worst_y;
+		CDT::Point v[3] = { face->vertex(0)->point(), face->vertex(1)->point(), face->vertex(2)->point() };
+		ScanTriMaxError(inDEM, inUsed, inRange, scan, v);
+	}
+	face->info().insert_err = scan.err;
+	if (scan.err > 0)
+	{
+		face->info().insert_x = scan.worst_x;
+		face->info().insert_y = scan.worst_y;
 	}
 }
 
-// Init the whole mesh - all tris, calc errs, queue
-void	InitMesh(CDT& inCDT, const DEMGeo& inDem, DEMMask& inUsed, double err_cutoff, double size_lim)
+struct	rescan_job {
+	const DEMGeo *				dem;
+	const DEMMask *				used;
+	const DEMMinMaxPyramid *	range;
+	tri_scan *					scans;
+};
+
+static void	RescanOneTri(int n, void * ref)
 {
-	sBestChoices.clear();
-	sCurrentDEM = &inDem;
-	sUsedDEM = &inUsed;
-	sCurrentMesh = &inCDT;
+	rescan_job * job = (rescan_job *) ref;
+	ScanTriMaxError(job->dem, job->used, job->range, job->scans[n], NULL);
+}
 
-	for (CDT::All_faces_iterator face = inCDT.all_faces_begin(); face != inCDT.all_faces_end(); ++face)
+/************************************************************************************************************************
+ * GREEDY MESHER
+ ************************************************************************************************************************/
+
+GreedyMesher::GreedyMesher(CDT& inCDT, const DEMGeo& inAvail, DEMMask& ioUsed) :
+	mCDT(&inCDT),
+	mDEM(&inAvail),
+	mUsed(&ioUsed),
+	mBatchSize(1),
+	mMaxThreads(0),
+	mSeq(0),
+	mRange(new DEMMinMaxPyramid)
+{
+	mRange->build(inAvail, SCAN_BAND_LEVELS);
+}
+
+GreedyMesher::~GreedyMesher()
+{
+	delete mRange;
+}
+
+void	GreedyMesher::SetBatchSize(int batch_size)
+{
+	mBatchSize = max(batch_size, 1);
+}
+
+void	GreedyMesher::SetMaxThreads(int max_threads)
+{
+	mMaxThreads = max(max_threads, 0);
+}
+
+// Worst error first; among equal errors, whoever was queued first - same order the old multimap gave us.
+inline bool	GreedyMesher::heap_less(const heap_entry& lhs, const heap_entry& rhs) const
+{
+	if (lhs.err != rhs.err)
+		return lhs.err < rhs.err;
+	return lhs.seq > rhs.seq;
+}
+
+inline void	GreedyMesher::heap_set(int slot, const heap_entry& e)
+{
+	mHeap[slot] = e;
+	((CDT::Face *) e.face)->info().self = slot;
+}
+
+void	GreedyMesher::heap_up(int slot)
+{
+	heap_entry e(mHeap[slot]);
+	while (slot > 0)
 	{
-		if (!sCurrentMesh->is_infinite(face)) {
-			face->info().flag = 0;
-			InitOneTri(face);
-			CalcOneTriError(face, size_lim);
-			if (face->info().insert_err > err_cutoff)
-			{
-//				printf("Initing 0x%08x because err is %f at %d,%d\n", &*face, face->info().insert_err,face->info().insert_x,face->info().insert_y);
-			
-				face->info().self = sBestChoices.insert(FaceQueue::value_type(face->info().insert_err, &*face));
-			}
-		}
+		int parent = (slot - 1) / 2;
+		if (!heap_less(mHeap[parent], e))
+			break;
+		heap_set(slot, mHeap[parent]);
+		slot = parent;
+	}
+	heap_set(slot, e);
+}
+
+void	GreedyMesher::heap_down(int slot)
+{
+	heap_entry e(mHeap[slot]);
+	int count = mHeap.size();
+	while (1)
+	{
+		int child = slot * 2 + 1;
+		if (child >= count)
+			break;
+		if (child + 1 < count && heap_less(mHeap[child], mHeap[child+1]))
+			++child;
+		if (!heap_less(e, mHeap[child]))
+			break;
+		heap_set(slot, mHeap[child]);
+		slot = child;
 	}
+	heap_set(slot, e);
 }
 
-// Cleanup
-void	DoneMesh(void)
+void	GreedyMesher::heap_push(void * face, float err)
 {
-	sBestChoices.clear();
-	sCurrentDEM = NULL;
-	sUsedDEM = NULL;
-	sCurrentMesh = NULL;
+	heap_entry e;
+	e.err = err;
+	e.seq = mSeq++;
+	e.face = face;
+	mHeap.push_back(e);
+	heap_up(mHeap.size()-1);
 }
 
-void	GreedyMeshBuild(CDT& inCDT, const DEMGeo& inAvail, DEMMask& ioUsed, double err_lim, double size_lim, int max_num, ProgressFunc func)
+void	GreedyMesher::heap_remove(int slot)
+{
+	DebugAssert(slot >= 0 && slot < mHeap.size());
+	((CDT::Face *) mHeap[slot].face)->info().self = -1;
+	int last = mHeap.size()-1;
+	if (slot != last)
+	{
+		heap_set(slot, mHeap[last]);
+		mHeap.pop_back();
+		if (slot > 0 && heap_less(mHeap[(slot-1)/2], mHeap[slot]))
+			heap_up(slot);
+		else
+			heap_down(slot);
+	}
+	else
+		mHeap.pop_back();
+}
+
+// Recompute the error of a set of faces (whose planes are already set up), pulling them out of the
+// heap and requeueing the ones that are still over the limit.  Big sets are scanned on worker threads;
+// the results are then vetted and queued in order on this thread, so the heap sees exactly the same
+// sequence of pushes either way.  Returns the number of tris that needed an exact rescan.
+int		GreedyMesher::rescan(void ** faces, int count, double err_lim, double size_lim)
+{
+	int exact_rescans = 0;
+	bool threaded = mMaxThreads != 1 && count >= PARALLEL_RESCAN_MIN;
+
+	vector<tri_scan>	scans;
+	if (threaded)
+	{
+		scans.resize(count);
+		for (int n = 0; n < count; ++n)
+		{
+			CDT::Face_handle f(CDT_Recover_Handle((CDT::Face *) faces[n]));
+			if (f->info().self != -1)
+				heap_remove(f->info().self);
+			SetupTriScan(*mCDT, mDEM, f, err_lim, size_lim, scans[n]);
+		}
+
+		rescan_job	job = { mDEM, mUsed, mRange, &*scans.begin() };
+		TU_ParallelFor(count, RescanOneTri, &job, mMaxThreads);
+	}
+
+	for (int n = 0; n < count; ++n)
+	{
+		CDT::Face_handle f(CDT_Recover_Handle((CDT::Face *) faces[n]));
+		if (threaded)
+		{
+			// The threaded scan found the worst point without the exact in-tri test.  If that point passes,
+			// it's the same point the exact scan would have picked; if not, we have to do it the slow way.
+			tri_scan& scan(scans[n]);
+			if (scan.err > 0 && !really_ok_point(mDEM, scan.worst_x, scan.worst_y, f->vertex(0)->point(), f->vertex(1)->point(), f->vertex(2)->point()))
+			{
+				CDT::Point v[3] = { f->vertex(0)->point(), f->vertex(1)->point(), f->vertex(2)->point() };
+				ScanTriMaxError(mDEM, mUsed, mRange, scan, v);
+				++exact_rescans;
+			}
+			f->info().insert_err = scan.err;
+			if (scan.err > 0)
+			{
+				f->info().insert_x = scan.worst_x;
+				f->info().insert_y = scan.worst_y;
+			}
+		}
+		else
+		{
+			if (f->info().self != -1)
+				heap_remove(f->info().self);
+			CalcOneTriError(*mCDT, mDEM, mUsed, mRange, f, err_lim, size_lim);
+		}
+
+		if (f->info().insert_err > err_lim)
+		{
+//			printf("Queueing 0x%08x because err is %f at %d,%d\n", &*f, f->info().insert_err,f->info().insert_x,f->info().insert_y);
+			heap_push(&*f, f->info().insert_err);
+		}
+	}
+	return exact_rescans;
+}
+
+int		GreedyMesher::Build(double err_lim, double size_lim, int max_num, ProgressFunc func)
 {
 //	fprintf(stderr,"Building Mesh err=%lf size=%lf max=%d\n", err_lim, size_lim, max_num);
 	PROGRESS_START(func, 0, 1, "Building Mesh")
-	InitMesh(inCDT, inAvail, ioUsed, err_lim, size_lim);
+
+	CDT& inCDT(*mCDT);
+	const DEMGeo& inAvail(*mDEM);
+	DEMMask& ioUsed(*mUsed);
+
+	// Init the whole mesh - all tris, calc errs, queue
+	mHeap.clear();
+	mSeq = 0;
+	vector<void *>	work;
+	for (CDT::All_faces_iterator face = inCDT.all_faces_begin(); face != inCDT.all_faces_end(); ++face)
+	if (!inCDT.is_infinite(face))
+	{
+		face->info().flag = 0;
+		InitOneTri(inCDT, mDEM, face);
+		work.push_back(&*face);
+	}
+	int cnt_exact = work.empty() ? 0 : rescan(&*work.begin(), work.size(), err_lim, size_lim);
 
 	if (max_num == 0) max_num = INT_MAX;
 	int cnt_insert = 0, cnt_new = 0, cnt_recalc = 0;
 
-//	if(!sBestChoices.empty())
-//		printf("GD start, worst err is: %f\n", sBestChoices.begin()->first);
+//	if(!mHeap.empty())
+//		printf("GD start, worst err is: %f\n", mHeap.front().err);
 
-	for (int n = 0; n < max_num; ++n)
+	vector<void *>	batch;
+	while (cnt_insert < max_num)
 	{
-		if (sBestChoices.empty()) 
+		if (mHeap.empty()) 
 		{
 //			printf("Done with greedy mesh - we met our criteria.\n");
 			break;
 		}
-		PROGRESS_CHECK(func, 0, 1, "Building mesh", n, max_num, max_num / 200)
-		++cnt_insert;
-		CDT::Face * the_face = (CDT::Face *) sBestChoices.begin()->second;
 
+		// Pull the worst tris off the heap.  Each one we don't insert is going to be in the affected
+		// set (that's why we skip it), so it will be requeued below.
+		batch.clear();
+		while (!mHeap.empty() && (int) batch.size() < mBatchSize && cnt_insert + (int) batch.size() < max_num)
+		{
+			batch.push_back(mHeap.front().face);
+			heap_remove(0);
+		}
 
-		CDT::Face_handle	face_handle(CDT_Recover_Handle(the_face));
+		set<CDT::Face_handle>	affected;
+		for (vector<void *>::iterator b = batch.begin(); b != batch.end(); ++b)
+		{
+			CDT::Face * the_face = (CDT::Face *) *b;
+			CDT::Face_handle	face_handle(CDT_Recover_Handle(the_face));
 
-		DebugAssert(!inCDT.is_infinite(face_handle));
+			DebugAssert(!inCDT.is_infinite(face_handle));
 
-		CDT::Point p(inAvail.x_to_lon(the_face->info().insert_x),
-					  inAvail.y_to_lat(the_face->info().insert_y));
+			// An earlier insert this round changed this tri - its point may be gone or no longer inside it.
+			if (affected.count(face_handle))
+				continue;
 
-//		gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(0)->point().x(),the_face->vertex(0)->point().y()), Point3(1,0,1)));
-//		gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(1)->point().x(),the_face->vertex(1)->point().y()), Point3(1,0,1)));
-//		gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(1)->point().x(),the_face->vertex(1)->point().y()), Point3(1,0,1)));
-//		gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(2)->point().x(),the_face->vertex(2)->point().y()), Point3(1,0,1)));
-//		gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(2)->point().x(),the_face->vertex(2)->point().y()), Point3(1,0,1)));
-//		gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(0)->point().x(),the_face->vertex(0)->point().y()), Point3(1,0,1)));
-//		gMeshPoints.push_back(pair<Point2,Point3>(Point2(p.x(), p.y()), Point3(1,1,1)));
+			PROGRESS_CHECK(func, 0, 1, "Building mesh", cnt_insert, max_num, max_num / 200)
+			++cnt_insert;
 
-		double h = inAvail.get(the_face->info().insert_x, the_face->info().insert_y);
-		#if DEV
-		
-		bool hh = ioUsed.get(the_face->info().insert_x, the_face->info().insert_y);
-		if(hh)
-		{
-			printf("ERROR: we want to do this.\n");
-			printf("Inserting: 0x%p, %d,%d, err was %f\n",&*the_face, the_face->info().insert_x,the_face->info().insert_y, the_face->info().insert_err);
-			printf("But the point is not available for insert.\n");
-		}
-		DebugAssert(!hh);
-		#endif
-//		printf("Inserting: 0x%08lx, %d,%d, err was %f\n",&*the_face, the_face->info().insert_x,the_face->info().insert_y, the_face->info().insert_err);
-		DebugAssert(h != DEM_NO_DATA);
-		ioUsed.set(the_face->info().insert_x, the_face->info().insert_y,true);
+			CDT::Point p(inAvail.x_to_lon(the_face->info().insert_x),
+						  inAvail.y_to_lat(the_face->info().insert_y));
 
-		set<CDT::Face_handle>	affected;
-		CDT::Vertex_handle new_v = inCDT.insert_collect_flips(p,face_handle, affected);
-		new_v->info().height = h;
+//			gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(0)->point().x(),the_face->vertex(0)->point().y()), Point3(1,0,1)));
+//			gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(1)->point().x(),the_face->vertex(1)->point().y()), Point3(1,0,1)));
+//			gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(1)->point().x(),the_face->vertex(1)->point().y()), Point3(1,0,1)));
+//			gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(2)->point().x(),the_face->vertex(2)->point().y()), Point3(1,0,1)));
+//			gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(2)->point().x(),the_face->vertex(2)->point().y()), Point3(1,0,1)));
+//			gMeshLines.push_back(pair<Point2,Point3>(Point2(the_face->vertex(0)->point().x(),the_face->vertex(0)->point().y()), Point3(1,0,1)));
+//			gMeshPoints.push_back(pair<Point2,Point3>(Point2(p.x(), p.y()), Point3(1,1,1)));
 
+			double h = inAvail.get(the_face->info().insert_x, the_face->info().insert_y);
+			#if DEV
+			
+			bool hh = ioUsed.get(the_face->info().insert_x, the_face->info().insert_y);
+			if(hh)
+			{
+				printf("ERROR: we want to do this.\n");
+				printf("Inserting: 0x%p, %d,%d, err was %f\n",&*the_face, the_face->info().insert_x,the_face->info().insert_y, the_face->info().insert_err);
+				printf("But the point is not available for insert.\n");
+			}
+			DebugAssert(!hh);
+			#endif
+//			printf("Inserting: 0x%08lx, %d,%d, err was %f\n",&*the_face, the_face->info().insert_x,the_face->info().insert_y, the_face->info().insert_err);
+			DebugAssert(h != DEM_NO_DATA);
+			ioUsed.set(the_face->info().insert_x, the_face->info().insert_y,true);
+
+			CDT::Vertex_handle new_v = inCDT.insert_collect_flips(p,face_handle, affected);
+			new_v->info().height = h;
+		}
+
+		// CGAL reuses the split and flipped faces, so every face that changed shape (or is brand new) is
+		// in affected; nothing in the heap is left dangling.
+		work.clear();
 		for(set<CDT::Face_handle>::iterator a = affected.begin(); a != affected.end(); ++a)
 		{
 			CDT::Face_handle circ(*a);
-			
-			if (InitOneTri(circ))
+			if (InitOneTri(inCDT, mDEM, circ))
 			{
 				++cnt_new;
 			}
-			if (circ->info().self != sBestChoices.end())
-			{
-				sBestChoices.erase(circ->info().self);
-				circ->info().self = sBestChoices.end();
-			}
-			CalcOneTriError(circ, size_lim);
-			if (circ->info().insert_err > err_lim)
-			{
-//				printf("Reinserting 0x%08x because err is %f at %d,%d\n", &*circ, circ->info().insert_err,circ->info().insert_x,circ->info().insert_y);
-				circ->info().self = sBestChoices.insert(FaceQueue::value_type(circ->info().insert_err, &*circ));
-			}
-		} 
-
+			work.push_back(&*circ);
+		}
+		cnt_recalc += work.size();
+		if (!work.empty())
+			cnt_exact += rescan(&*work.begin(), work.size(), err_lim, size_lim);
 	}
 
-	DoneMesh();
+	mHeap.clear();
 	PROGRESS_DONE(func, 0, 1, "Building Mesh")
 
-	printf("Greedy insert: %d pts, %d recalcs, %d new faces\n", cnt_insert, cnt_recalc, cnt_new);
+	printf("Greedy insert: %d pts, %d recalcs, %d new faces, %d exact rescans\n", cnt_insert, cnt_recalc, cnt_new, cnt_exact);
+	return cnt_insert;
+}
+
+void	GreedyMeshBuild(CDT& inCDT, const DEMGeo& inAvail, DEMMask& ioUsed, double err_lim, double size_lim, int max_num, ProgressFunc func)
+{
+	GreedyMesher	mesher(inCDT, inAvail, ioUsed);
+	mesher.Build(err_lim, size_lim, max_num, func);
 }
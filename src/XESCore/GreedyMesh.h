@@ -28,6 +28,80 @@
 class CDT;
 struct DEMGeo;
 struct DEMMask;
+class DEMMinMaxPyramid;
+
+/*
+
+	GREEDY MESHER
+
+	The greedy mesher refines a CDT by repeatedly inserting the DEM point with the worst vertical error
+	until every triangle is within err_lim (and, if size_lim is not 0, smaller than size_lim degrees),
+	or until max_num points have gone in.  All state lives in the GreedyMesher object, so several
+	meshes can be built at once from different threads as long as they don't share a CDT or mask.
+
+	Triangles are kept in an indexed binary heap keyed on their insert error; each face's info().self
+	is its slot in the heap (or -1 if it isn't queued).  Ties go to the face queued first, so results
+	do not depend on heap layout.
+
+	A min/max pyramid over the DEM lets the scanline pass skip whole triangles, and bands of rows
+	within a triangle, that can't hold a point worse than the best found so far or the error limit.
+	Triangles at or under the limit may report a smaller error than they really have, since they
+	are not queued anyway; the points chosen are the same as a full scan.
+
+	When a large number of triangles need their error recomputed (the initial pass, or a big batch)
+	the scanline pass runs on several threads.  CGAL's lazy number types are not thread safe, so the
+	threaded pass only sees plain doubles copied out of the mesh; the chosen point is then checked
+	against the exact triangle on the calling thread, and the rare loser is rescanned exactly.
+
+	batch_size lets each round insert up to that many of the worst points at once.  A point whose
+	triangle was changed by an earlier insert in the same round is skipped (its triangle gets
+	re-evaluated with the rest), so the points that go in never conflict.  A batch size of 1 gives
+	exactly the classic one-point-at-a-time result; bigger batches are faster but place slightly
+	different points.
+
+ */
+class	GreedyMesher {
+public:
+
+	GreedyMesher(CDT& inCDT, const DEMGeo& inAvail, DEMMask& ioUsed);
+	~GreedyMesher();
+
+	void	SetBatchSize(int batch_size);			// Points inserted per round, default 1.
+	void	SetMaxThreads(int max_threads);			// 0 = one per CPU (default), 1 = never thread.
+
+	// Returns the number of points inserted.
+	int		Build(double err_lim, double size_lim, int max_num, ProgressFunc func);
+
+private:
+
+	struct	heap_entry {
+		float		err;
+		unsigned	seq;
+		void *		face;		// CDT::Face *, same hard-cast trick as the old queue.
+	};
+
+	bool	heap_less(const heap_entry& lhs, const heap_entry& rhs) const;
+	void	heap_set(int slot, const heap_entry& e);
+	void	heap_up(int slot);
+	void	heap_down(int slot);
+	void	heap_push(void * face, float err);
+	void	heap_remove(int slot);
+
+	int		rescan(void ** faces, int count, double err_lim, double size_lim);
+
+	CDT *				mCDT;
+	const DEMGeo *		mDEM;
+	DEMMask *			mUsed;
+	int					mBatchSize;
+	int					mMaxThreads;
+	unsigned			mSeq;
+	vector<heap_entry>	mHeap;
+	DEMMinMaxPyramid *	mRange;
+
+	GreedyMesher(const GreedyMesher&);
+	GreedyMesher& operator=(const GreedyMesher&);
+
+};
 
 void	GreedyMeshBuild(CDT& inCDT, const DEMGeo& inAvail, DEMMask& ioUsed, double err_lim, double size_lim, int max_num, ProgressFunc func);
 
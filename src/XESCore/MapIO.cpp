@@ -33,7 +33,9 @@
 // Ratio of operations to an update of the progress bar.
 #define	PROGRESS_RATIO	5000
 
-const int kMainMapID = 'MAP2';
+const int kMainMapID = 'MAP2';			// Legacy: points are written out in full.
+const int kFlatMapID = 'MAP3';			// Points are pairs of indices into the coord table.
+const int kMapCoordsID = 'PTS1';
 
 template <class	T, class F>
 void WriteVector(IOWriter& writer, const T& v, F func)
@@ -309,6 +311,92 @@ void ReadCoordinate(IOReader& inReader, NT& c)
 #endif	
 }
 
+#pragma mark -
+
+XESCoordWriter::XESCoordWriter(bool inShare) : mShare(inShare)
+{
+}
+
+int		XESCoordWriter::add(const NT& c)
+{
+	double d = CGAL::to_double(c);
+	bool is_double = (NT(d) == c);
+	if (is_double && mShare)
+	{
+		map<double, int>::iterator i = mIndex.find(d);
+		if (i != mIndex.end())
+			return i->second;
+	}
+	int idx = mValues.size();
+	mValues.push_back(d);
+	if (!is_double)
+	{
+		mExact.push_back(idx);
+		mExactValues.push_back(c);
+	}
+	else if (mShare)
+		mIndex[d] = idx;
+	return idx;
+}
+
+void	XESCoordWriter::write(FILE * fi, int atomID) const
+{
+	StAtomWriter	coordAtom(fi, atomID);
+	FileWriter		writer(fi);
+	writer.WriteInt(mValues.size());
+	writer.WriteInt(mExact.size());
+#if LIL
+	if (!mValues.empty())
+		writer.WriteBulk((const char *) &*mValues.begin(), mValues.size() * sizeof(double), false);
+#else
+	for (vector<double>::const_iterator v = mValues.begin(); v != mValues.end(); ++v)
+		writer.WriteDouble(*v);
+#endif
+	for (int n = 0; n < mExact.size(); ++n)
+	{
+		writer.WriteInt(mExact[n]);
+		WriteCoordinate(writer, mExactValues[n]);
+	}
+}
+
+bool	ReadCoordTable(XAtomContainer& container, int atomID, vector<NT>& outTable)
+{
+	XAtom	coordAtom;
+	XSpan	coordData;
+	outTable.clear();
+	if (!container.GetNthAtomOfID(atomID, 0, coordAtom)) return false;
+	coordAtom.GetContents(coordData);
+
+	int count = 0, exact_count = 0;
+	MemFileReader	header(coordData.begin, coordData.end);
+	header.ReadInt(count);
+	header.ReadInt(exact_count);
+	const char * values = coordData.begin + 2 * sizeof(int);
+	const char * exact = values + count * sizeof(double);
+	if (count < 0 || exact_count < 0 || exact > coordData.end) return false;
+
+	// One copy out of the file, one pass to make the numbers.
+	vector<double>	raw(count);
+	if (count > 0)
+	{
+		memcpy(&*raw.begin(), values, count * sizeof(double));
+		EndianSwapArray(platform_LittleEndian, platform_Native, count, sizeof(double), &*raw.begin());
+	}
+	outTable.reserve(count);
+	for (int n = 0; n < count; ++n)
+		outTable.push_back(NT(raw[n]));
+
+	MemFileReader	reader(exact, coordData.end);
+	while (exact_count--)
+	{
+		int idx = -1;
+		reader.ReadInt(idx);
+		if (idx < 0 || idx >= count) return false;
+		ReadCoordinate(reader, outTable[idx]);
+	}
+	return true;
+}
+
 void WritePoint(IOWriter& inWriter, const Point_2& p)
 {
 	WriteCoordinate(inWriter,p.x());
@@ -350,8 +438,36 @@ public:
 	IOReader *					reader;
 	IOWriter *					writer;
 	const TokenConversionMap * 	token_map;
-	PmwxFmt(IOReader * r, const TokenConversionMap * t) : reader(r), writer(NULL), token_map(t) { }
-	PmwxFmt(IOWriter * w) : reader(NULL), writer(w), token_map(NULL) { }
+	XESCoordWriter *			coords_out;		// If set, points are written as table indices...
+	const vector<NT> *			coords_in;		// ...and read back from this table.
+	PmwxFmt(IOReader * r, const TokenConversionMap * t, const vector<NT> * c) : reader(r), writer(NULL), token_map(t), coords_out(NULL), coords_in(c) { }
+	PmwxFmt(IOWriter * w, XESCoordWriter * c) : reader(NULL), writer(w), token_map(NULL), coords_out(c), coords_in(NULL) { }
+
+	void put_point(const Point_2& p)
+	{
+		if (coords_out)
+		{
+			writer->WriteInt(coords_out->add(p.x()));
+			writer->WriteInt(coords_out->add(p.y()));
+		}
+		else
+			WritePoint(*writer, p);
+	}
+
+	void get_point(Point_2& p)
+	{
+		if (coords_in)
+		{
+			int x = 0, y = 0;
+			reader->ReadInt(x);
+			reader->ReadInt(y);
+			DebugAssert(x >= 0 && x < coords_in->size());
+			DebugAssert(y >= 0 && y < coords_in->size());
+			p = Point_2((*coords_in)[x], (*coords_in)[y]);
+		}
+		else
+			ReadPoint(*reader, p);
+	}
 
 	void write_size (const char *label, Size size)
 	{
@@ -384,7 +500,7 @@ public:
 
 	virtual void write_point (const Point_2& p)
 	{
-		WritePoint(*writer, p);
+		put_point(p);
 	}
 
 	virtual void write_vertex_data (Vertex_const_handle  v)
@@ -401,8 +517,8 @@ public:
 
 	virtual void write_x_monotone_curve (const X_monotone_curve_2& cv)
 	{
-		WritePoint(*writer, cv.source());
-		WritePoint(*writer, cv.target());
+		put_point(cv.source());
+		put_point(cv.target());
 		writer->WriteInt(cv.data().size());
 		for(EdgeKey_container::const_iterator e = cv.data().begin(); e != cv.data().end(); ++e)
 			writer->WriteInt(*e);
@@ -471,7 +587,7 @@ public:
 
 	virtual void read_point (Point_2& p) 
 	{
-		ReadPoint(*reader,p);
+		get_point(p);
 	}
 
 	virtual void read_vertex_data (Vertex_handle v)
@@ -498,8 +614,8 @@ public:
 		Point_2 s, t;
 		int n, v;
 		EdgeKey_container d;
-		ReadPoint(*reader,s);
-		ReadPoint(*reader,t);
+		get_point(s);
+		get_point(t);
 		reader->ReadInt(n);
 		while(n--)
 		{
@@ -557,7 +673,7 @@ private:
 
 #pragma mark -
 
-void	WriteMap(FILE * fi, const Pmwx& inMap, ProgressFunc inProgress, int atomID)
+void	WriteMap(FILE * fi, const Pmwx& inMap, ProgressFunc inProgress, int atomID, bool inFlatCoords)
 {
 	StAtomWriter	mapAtom(fi, atomID);
 
@@ -566,16 +682,19 @@ void	WriteMap(FILE * fi, const Pmwx& inMap, ProgressFunc inProgress, int atomID)
 	double	total = inMap.number_of_faces() + inMap.number_of_halfedges() + inMap.number_of_vertices();
 	int	ctr = 0;
 
+	XESCoordWriter	coords(true);
 	{
-		StAtomWriter 	mainMap(fi, kMainMapID);
+		StAtomWriter 	mainMap(fi, inFlatCoords ? kFlatMapID : kMainMapID);
 		FileWriter		writer(fi);
 
-		PmwxFmt	write_formatter(&writer);
+		PmwxFmt	write_formatter(&writer, inFlatCoords ? &coords : NULL);
 		
 		CGAL::Arrangement_2_writer<Pmwx>	arr_writer(inMap);
 		
 		arr_writer(write_formatter);
 	}
+	if (inFlatCoords)
+		coords.write(fi, kMapCoordsID);
 
 	if (inProgress) inProgress(0, 1, "Writing", 1.0);
 }
@@ -589,11 +708,17 @@ void	ReadMap(XAtomContainer& container, Pmwx& inMap, ProgressFunc inProgress, in
 	if (!container.GetNthAtomOfID(atomID, 0, meAtom)) return;
 	meAtom.GetContents(meContainer);
 
-	if (!meContainer.GetNthAtomOfID(kMainMapID, 0, mapAtom)) return;
+	vector<NT>	coords;
+	bool		flat = meContainer.GetNthAtomOfID(kFlatMapID, 0, mapAtom);
+	if (flat)
+	{
+		if (!ReadCoordTable(meContainer, kMapCoordsID, coords)) return;
+	}
+	else if (!meContainer.GetNthAtomOfID(kMainMapID, 0, mapAtom)) return;
 	mapAtom.GetContents(mapContainer);
 	MemFileReader	readMainMap(mapContainer.begin, mapContainer.end);
 	
-	PmwxFmt	read_formatter(&readMainMap, &c);
+	PmwxFmt	read_formatter(&readMainMap, &c, flat ? &coords : NULL);
 		
 	CGAL::Arrangement_2_reader<Pmwx>	arr_reader(inMap);
 		
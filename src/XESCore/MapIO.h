@@ -54,7 +54,58 @@
 
  struct	XAtomContainer;
 
-void	WriteMap(FILE * fi, const 	Pmwx& inMap, ProgressFunc inProgress, int atomID);
+// inFlatCoords writes MAP3 + PTS1 (see COORDINATE TABLES below) instead of MAP2.  Readers older than
+// the coordinate tables can't open those files, so MAP2 stays the default.
+void	WriteMap(FILE * fi, const 	Pmwx& inMap, ProgressFunc inProgress, int atomID, bool inFlatCoords = false);
 void	ReadMap(XAtomContainer& container, Pmwx& inMap, ProgressFunc inProgress, int atomID, const TokenConversionMap& c);
 
+/*
+	COORDINATE TABLES
+
+	Exact coordinates are expensive to decode: each one is a quotient of two MP_Floats, and
+	each of those is a variable-length vector of limbs.  But almost every coordinate we ever
+	store is really just a double.  So meshes, and maps written with inFlatCoords, put their
+	coordinates in a table atom:
+
+	  int count, int exact_count
+	  count doubles - one fixed-size record per coordinate
+	  exact_count records of int index + the full exact value (same encoding as WriteCoordinate)
+
+	A coordinate that is exactly its double only lives in the double array, and comes back as
+	a lazy number built from that double - no exact arithmetic is done at all.  The few that
+	aren't doubles (e.g. the result of intersecting two segments) get their exact value too,
+	so the round trip is always exact.
+
+	The double array is read with one bulk copy straight out of the mapped file.  When sharing
+	is on, equal coordinates are only written once and come back as copies of the same lazy
+	number, so a vertex shared by six curves is decoded once, not six times.
+
+	The map (MAP3 atom) refers to its points as pairs of table indices; meshes store one x,y pair
+	per vertex in vertex order.  Readers accept both MAP2 and MAP3, and double-only meshes.
+
+	COMPATIBILITY: a MAP3 map can NOT be read by a build that predates the coordinate tables -
+	it only knows MAP2 and will find no map at all.  That's why WriteMap writes MAP2 unless asked
+	(GISTool -xes_flat_map 1).  The mesh table is only an extra atom next to dat1, so meshes always
+	get it; old readers skip it.
+*/
+
+class	XESCoordWriter {
+public:
+	XESCoordWriter(bool inShare);
+
+	int		add(const NT& c);					// Returns the table index
+	int		size(void) const { return mValues.size(); }
+	void	write(FILE * fi, int atomID) const;
+
+private:
+	bool				mShare;
+	vector<double>		mValues;
+	vector<int>			mExact;				// Table indices that need an exact record...
+	vector<NT>			mExactValues;		// ...and their values
+	map<double, int>	mIndex;				// Double -> index, when sharing
+};
+
+// Reads the table atom, or returns false if the container doesn't have it.
+bool	ReadCoordTable(XAtomContainer& container, int atomID, vector<NT>& outTable);
+
 #endif
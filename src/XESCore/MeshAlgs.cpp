@@ -43,6 +43,8 @@
 #include "MeshSimplify.h"
 #include "NetHelpers.h"
 #include "Zoning.h"	// for urban cheat table.
+#include "EnumSystem.h"
+#include "ThreadUtils.h"
 #if OPENGL_MAP
 #include "GISTool_Globals.h"
 #endif
@@ -2823,132 +2825,262 @@ double	MeshHeightAtPoint(CDT& inMesh, double inLon, double inLat, int hint_id)
 	}
 }
 
-int	CalcMeshError(CDT& mesh, DEMGeo& elev, float& out_min, float& out_max, float& out_ave, float& std_dev, ProgressFunc inFunc)
+void	MeshErrorStats::add(float err)
 {
-	if (inFunc) inFunc(0, 1, "Calculating Error", 0.0);
-	int ctr = 0;
-	
-	out_max = 0.0;
-	out_ave = 0.0;
-	std_dev = 0.0;
-	out_min = 9.9e9;
-	
-	CDT::Face_handle	last_tri;
-	Plane3				last_plane;
-	Point2				last_tri_loc[3];
-	double				DEG_TO_NM_LON = DEG_TO_NM_LAT;
-
-	float				worst_pos = 0.0;
-	float				worst_neg = 0.0;
-	Point2				worst_pos_p;
-	Point2				worst_neg_p;
-	
-	if(mesh.number_of_faces() >= 1)
-	for (int y = 0; y < elev.mHeight; ++y)
+	if (count == 0)
+		minv = maxv = err;
+	else
+	{
+		minv = min(minv, err);
+		maxv = max(maxv, err);
+	}
+	++count;
+	sum += err;
+	sum_sq += (double) err * (double) err;
+}
+
+void	MeshErrorStats::merge(const MeshErrorStats& rhs)
+{
+	if (rhs.count == 0) return;
+	if (count == 0)
 	{
-		if (inFunc && (y % 20) == 0) inFunc(0, 1, "Calculating Error", (float) y / (float) elev.mHeight);
+		*this = rhs;
+		return;
+	}
+	minv = min(minv, rhs.minv);
+	maxv = max(maxv, rhs.maxv);
+	count += rhs.count;
+	sum += rhs.sum;
+	sum_sq += rhs.sum_sq;
+}
+
+// Plain-double copy of one finite mesh triangle, for the error walk.
+struct	err_tri {
+	double	x[3];
+	double	y[3];
+	int		nbr[3];			// Index of the tri across from vertex n, -1 if infinite.
+	Plane3	plane;
+	int		terrain;
+};
+
+#define	ERR_STRIP_ROWS		16
+
+struct	mesh_err_job {
+	const DEMGeo *				elev;
+	const vector<err_tri> *		tris;
+	int							strip_base;
+	vector<MeshErrorReport> *	strips;
+};
+
+inline double err_orient(double ax, double ay, double bx, double by, double px, double py)
+{
+	return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
 
-		for (int x = 0; x < elev.mWidth ; ++x)
+// Walk from 'start' toward (px,py), crossing whichever edge the point is outside of.  We rotate which edge we
+// check first so a CDT (which isn't quite Delaunay) can't trap us in a cycle.  If the walk runs off the mesh we
+// return -1; if it goes on suspiciously long we fall back to checking every tri.
+static int	err_walk(const vector<err_tri>& tris, int start, double px, double py)
+{
+	int f = start;
+	int limit = 1000 + tris.size();
+	for (int step = 0; step < limit; ++step)
+	{
+		const err_tri& t(tris[f]);
+		int out = -1;
+		for (int k = 0; k < 3; ++k)
 		{
-			float ideal = elev.get(x,y);
-			if (ideal != DEM_NO_DATA)
+			int i = (k + step) % 3;
+			int i1 = (i + 1) % 3;
+			int i2 = (i + 2) % 3;
+			if (err_orient(t.x[i1], t.y[i1], t.x[i2], t.y[i2], px, py) < 0.0)
 			{
-				Point2	ll(elev.x_to_lon(x), elev.y_to_lat(y));
-				if(last_tri == CDT::Face_handle() ||
-				   Segment2(last_tri_loc[0],last_tri_loc[1]).on_right_side(ll) ||
-				   Segment2(last_tri_loc[1],last_tri_loc[2]).on_right_side(ll) ||
-				   Segment2(last_tri_loc[2],last_tri_loc[0]).on_right_side(ll))
-				{
-
-					CDT::Face_handle	f = CDT::Face_handle();
-					int	n;
-					CDT::Locate_type lt;
-					f = mesh.locate(CDT::Point(ll.x(), ll.y()), lt, n, last_tri);
-					if (lt == CDT::EDGE && mesh.is_infinite(f))
-					{
-						f = f->neighbor(n);
-					}
-					
-					if(!mesh.is_infinite(f))
-					{
-						last_tri = f;
+				out = i;
+				break;
+			}
+		}
+		if (out == -1)
+			return f;
+		f = t.nbr[out];
+		if (f == -1)
+			return -1;
+	}
 
-						last_tri_loc[0] = cgal2ben(f->vertex(0)->point());
-						last_tri_loc[1] = cgal2ben(f->vertex(1)->point());
-						last_tri_loc[2] = cgal2ben(f->vertex(2)->point());
-						
+	for (int n = 0; n < tris.size(); ++n)
+	{
+		const err_tri& t(tris[n]);
+		if (err_orient(t.x[1], t.y[1], t.x[2], t.y[2], px, py) >= 0.0 &&
+			err_orient(t.x[2], t.y[2], t.x[0], t.y[0], px, py) >= 0.0 &&
+			err_orient(t.x[0], t.y[0], t.x[1], t.y[1], px, py) >= 0.0)
+			return n;
+	}
+	return -1;
+}
 
-						DEG_TO_NM_LON = DEG_TO_NM_LAT * cos(CGAL::to_double(ll.y()) * DEG_TO_RAD);
+static void	CalcMeshErrorStrip(int n, void * ref)
+{
+	mesh_err_job * job = (mesh_err_job *) ref;
+	const DEMGeo& elev(*job->elev);
+	const vector<err_tri>& tris(*job->tris);
+	MeshErrorReport& r((*job->strips)[n]);
+	int strip = job->strip_base + n;
+
+	int y1 = strip * ERR_STRIP_ROWS;
+	int y2 = min(y1 + ERR_STRIP_ROWS, elev.mHeight);
+	int last = 0;
+
+	for (int y = y1; y < y2; ++y)
+	for (int x = 0; x < elev.mWidth; ++x)
+	{
+		float ideal = elev.get(x,y);
+		if (ideal == DEM_NO_DATA)
+			continue;
+		Point2	ll(elev.x_to_lon(x), elev.y_to_lat(y));
+		int f = err_walk(tris, last, ll.x(), ll.y());
+		if (f == -1)
+			continue;
+		last = f;
+
+		float derr = tris[f].plane.distance_denormaled(Point3(ll.x(),ll.y(),ideal));
+
+		if (derr > r.worst_pos)
+		{
+			r.worst_pos = derr;
+			r.worst_pos_p = ll;
+		}
+		if (derr < r.worst_neg)
+		{
+			r.worst_neg = derr;
+			r.worst_neg_p = ll;
+		}
 
-						Point3	p1((last_tri_loc[0].x()),// * (DEG_TO_NM_LON * NM_TO_MTR)),
-								   (last_tri_loc[0].y()),// * (DEG_TO_NM_LAT * NM_TO_MTR)),
-								   (last_tri->vertex(0)->info().height));
+		r.total.add(derr);
+		r.by_terrain[tris[f].terrain].add(derr);
+		++r.histogram[(int) floor(derr / r.bin_size)];
+	}
+}
 
-						Point3	p2((last_tri_loc[1].x()),// * (DEG_TO_NM_LON * NM_TO_MTR)),
-								   (last_tri_loc[1].y()),// * (DEG_TO_NM_LAT * NM_TO_MTR)),
-								   (last_tri->vertex(1)->info().height));
+int	CalcMeshErrorReport(CDT& mesh, const DEMGeo& elev, MeshErrorReport& out_report, ProgressFunc inFunc, int inMaxThreads)
+{
+	PROGRESS_START(inFunc, 0, 1, "Calculating Error")
+
+	out_report.total = MeshErrorStats();
+	out_report.by_terrain.clear();
+	out_report.histogram.clear();
+	out_report.worst_pos = out_report.worst_neg = 0.0;
+
+	// Number the finite faces and copy out everything the walk needs.  Tri planes are built exactly the
+	// way the old single-threaded code built them.
+	vector<CDT::Face *>	faces;
+	for (CDT::Finite_faces_iterator f = mesh.finite_faces_begin(); f != mesh.finite_faces_end(); ++f)
+		faces.push_back(&*f);
+	sort(faces.begin(), faces.end());
+
+	vector<err_tri>	tris(faces.size());
+	for (int n = 0; n < faces.size(); ++n)
+	{
+		CDT::Face * f = faces[n];
+		err_tri& t(tris[n]);
+		Point3	p[3];
+		for (int v = 0; v < 3; ++v)
+		{
+			Point2 loc(cgal2ben(f->vertex(v)->point()));
+			t.x[v] = loc.x();
+			t.y[v] = loc.y();
+			p[v] = Point3(loc.x(), loc.y(), f->vertex(v)->info().height);
+
+			CDT::Face * nf = &*f->neighbor(v);
+			vector<CDT::Face *>::iterator i = lower_bound(faces.begin(), faces.end(), nf);
+			t.nbr[v] = (i != faces.end() && *i == nf) ? (i - faces.begin()) : -1;
+		}
+		Vector3	s1(p[1], p[2]);
+		Vector3	s2(p[1], p[0]);
+		Vector3	nrm = s1.cross(s2);
+		nrm.normalize();
+		t.plane = Plane3(p[0],nrm);
+		t.terrain = f->info().terrain;
+	}
 
-						Point3	p3((last_tri_loc[2].x()),// * (DEG_TO_NM_LON * NM_TO_MTR)),
-								   (last_tri_loc[2].y()),// * (DEG_TO_NM_LAT * NM_TO_MTR)),
-								   (last_tri->vertex(2)->info().height));
+	if (!tris.empty() && elev.mHeight > 0)
+	{
+		// Strips are run a wave at a time so we can report progress from this thread, then merged in
+		// order - ties for worst go to the first post in scan order, like the old code.
+		int	strip_count = (elev.mHeight + ERR_STRIP_ROWS - 1) / ERR_STRIP_ROWS;
+		int	wave = 4 * (inMaxThreads > 0 ? inMaxThreads : TU_GetCPUCount());
+		for (int base = 0; base < strip_count; base += wave)
+		{
+			PROGRESS_SHOW(inFunc, 0, 1, "Calculating Error", base, strip_count)
+			int count = min(wave, strip_count - base);
+			vector<MeshErrorReport>	strips(count, MeshErrorReport(out_report.bin_size));
+			mesh_err_job	job = { &elev, &tris, base, &strips };
+			TU_ParallelFor(count, CalcMeshErrorStrip, &job, inMaxThreads);
 
-						Vector3	s1(p2, p3);
-						Vector3	s2(p2, p1);
-						Vector3	n = s1.cross(s2);
-						n.normalize();
-						last_plane = Plane3(p1,n);
-					}
+			for (int n = 0; n < count; ++n)
+			{
+				const MeshErrorReport& r(strips[n]);
+				out_report.total.merge(r.total);
+				for (map<int, MeshErrorStats>::const_iterator t = r.by_terrain.begin(); t != r.by_terrain.end(); ++t)
+					out_report.by_terrain[t->first].merge(t->second);
+				for (map<int, int>::const_iterator h = r.histogram.begin(); h != r.histogram.end(); ++h)
+					out_report.histogram[h->first] += h->second;
+				if (r.worst_pos > out_report.worst_pos)
+				{
+					out_report.worst_pos = r.worst_pos;
+					out_report.worst_pos_p = r.worst_pos_p;
 				}
-				
-				if(last_tri != CDT::Face_handle())
+				if (r.worst_neg < out_report.worst_neg)
 				{
-					double real = (last_plane.n.dx * ll.x() +
-								   last_plane.n.dy * ll.y() -
-								   last_plane.ndotp) / -last_plane.n.dz;
-					
-					double	close = last_plane.distance_denormaled(Point3(ll.x(),ll.y(),ideal));
-					float derr = real - ideal;
-					derr = close;
-
-					Point2	me(elev.x_to_lon(x), elev.y_to_lat(y));
-					if(derr > worst_pos)
-					{
-						worst_pos = derr;
-						worst_pos_p = me;
-					}
-					if(derr < worst_neg)
-					{
-						worst_neg = derr;
-						worst_neg_p = me;
-					}
-					
-					out_min = min(out_min,derr);
-					out_max = max(out_max,derr);
-					out_ave += derr;
-					std_dev += (derr*derr);
-					++ctr;
+					out_report.worst_neg = r.worst_neg;
+					out_report.worst_neg_p = r.worst_neg_p;
 				}
 			}
 		}
 	}
-	if(worst_pos > 0.0)
-	{	
-//		debug_mesh_point(worst_pos_p,1,0,0);
-		printf("Worst positive error is %f meters at %+08.6lf, %+09.7lf\n", worst_pos, worst_pos_p.x(), worst_pos_p.y());
-	}	
-	if(worst_neg < 0.0)
+
+	PROGRESS_DONE(inFunc, 0, 1, "Calculating Error")
+	return out_report.total.count;
+}
+
+bool	WriteMeshErrorCSV(const char * inPath, const MeshErrorReport& inReport)
+{
+	FILE * fi = fopen(inPath, "w");
+	if (fi == NULL) return false;
+
+	fprintf(fi, "type,key,lo,hi,count,mean,std_dev,min,max\n");
+	const MeshErrorStats& t(inReport.total);
+	fprintf(fi, "total,,,,%d,%f,%f,%f,%f\n", t.count, t.mean(), t.std_dev(), t.minv, t.maxv);
+	for (map<int, MeshErrorStats>::const_iterator i = inReport.by_terrain.begin(); i != inReport.by_terrain.end(); ++i)
 	{
-		printf("Worst negative error is %f meters at %+08.6lf, %+09.7lf\n", worst_neg, worst_neg_p.x(), worst_neg_p.y());	
-//		debug_mesh_point(worst_neg_p,1,0,1);
+		const MeshErrorStats& s(i->second);
+		fprintf(fi, "terrain,%s,,,%d,%f,%f,%f,%f\n", i->first == DEM_NO_DATA ? "none" : FetchTokenString(i->first), s.count, s.mean(), s.std_dev(), s.minv, s.maxv);
 	}
-	
-	if(ctr > 0)
+	for (map<int, int>::const_iterator h = inReport.histogram.begin(); h != inReport.histogram.end(); ++h)
+		fprintf(fi, "histogram,,%f,%f,%d,,,,\n", h->first * inReport.bin_size, (h->first + 1) * inReport.bin_size, h->second);
+
+	fclose(fi);
+	return true;
+}
+
+int	CalcMeshError(CDT& mesh, DEMGeo& elev, float& out_min, float& out_max, float& out_ave, float& std_dev, ProgressFunc inFunc)
+{
+	MeshErrorReport	report;
+	int ctr = CalcMeshErrorReport(mesh, elev, report, inFunc);
+
+	if(report.worst_pos > 0.0)
+	{	
+//		debug_mesh_point(report.worst_pos_p,1,0,0);
+		printf("Worst positive error is %f meters at %+08.6lf, %+09.7lf\n", report.worst_pos, report.worst_pos_p.x(), report.worst_pos_p.y());
+	}	
+	if(report.worst_neg < 0.0)
 	{
-		out_ave /= (float) ctr;
-		std_dev = sqrt(std_dev / float(ctr));
+		printf("Worst negative error is %f meters at %+08.6lf, %+09.7lf\n", report.worst_neg, report.worst_neg_p.x(), report.worst_neg_p.y());	
+//		debug_mesh_point(report.worst_neg_p,1,0,1);
 	}
-	
-	if (inFunc) inFunc(0, 1, "Calculating Error", 1.0);
+
+	out_min = ctr ? report.total.minv : 9.9e9;
+	out_max = ctr ? report.total.maxv : 0.0;
+	out_ave = report.total.mean();
+	std_dev = report.total.std_dev();
 	return ctr;
 }
 
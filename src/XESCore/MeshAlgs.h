@@ -63,6 +63,41 @@ double	HeightWithinTri(CDT& inMesh, CDT::Face_handle tri, CDT::Point in);
 double	MeshHeightAtPoint(CDT& inMesh, double inLon, double inLat, int hint_id);
 void	Calc2ndDerivative(DEMGeo& ioDEM);
 int		CalcMeshError(CDT& mesh, DEMGeo& elev, float& out_min, float& out_max, float& out_ave, float& std_dev, ProgressFunc inFunc);
+
+// Mesh error QA.  Error is measured at every DEM post the mesh covers, against the plane of the
+// triangle the post lands in.  The DEM is cut into strips of rows that run in parallel; each strip walks
+// from the last triangle it found to the next post, over a plain-double copy of the mesh (CGAL's number
+// types can't be shared between threads).  Results don't depend on the thread count.
+struct	MeshErrorStats {
+	MeshErrorStats() : count(0), minv(0), maxv(0), sum(0), sum_sq(0) { }
+	void	add(float err);
+	void	merge(const MeshErrorStats& rhs);
+	double	mean(void) const { return count ? sum / count : 0.0; }
+	double	std_dev(void) const { return count ? sqrt(sum_sq / count) : 0.0; }	// RMS about zero, same as CalcMeshError
+
+	int		count;
+	float	minv;
+	float	maxv;
+	double	sum;
+	double	sum_sq;
+};
+
+struct	MeshErrorReport {
+	MeshErrorReport(float inBinSize = 1.0f) : bin_size(inBinSize), worst_pos(0), worst_neg(0) { }
+
+	float					bin_size;			// Histogram bin n counts errors in [n * bin_size, (n+1) * bin_size)
+	MeshErrorStats			total;
+	map<int, MeshErrorStats>	by_terrain;		// Keyed by the triangle's terrain token
+	map<int, int>			histogram;
+	float					worst_pos;
+	float					worst_neg;
+	Point2					worst_pos_p;
+	Point2					worst_neg_p;
+};
+
+int		CalcMeshErrorReport(CDT& mesh, const DEMGeo& elev, MeshErrorReport& out_report, ProgressFunc inFunc, int inMaxThreads = 0);
+// Writes total, per-terrain and histogram rows to one CSV; returns false if the file can't be opened.
+bool	WriteMeshErrorCSV(const char * inPath, const MeshErrorReport& inReport);
 int		CalcMeshTextures(CDT& inMesh, map<int, int>& out_lus);
 
 
@@ -76,7 +76,6 @@
  */
 
 
-typedef multimap<float, void *, greater<float> >			FaceQueue;	// YUCK - hard cast to avoid snarky problems with forward decls
 typedef multimap<double, void *>							VertexQueue;
 
 struct	MeshVertexInfo {
@@ -158,7 +157,7 @@ struct	MeshFaceInfo {
 
 	Face_handle		orig_face;				// If a face caused us to get the terrain we did, this is who!
 
-	FaceQueue::iterator	self;					// Queue ref to self!
+	int				self;					// Greedy mesher heap slot, -1 if not queued.
 
 	float			mesh_temp;				// These are not debug - beach code uses this.
 	float			mesh_rain;
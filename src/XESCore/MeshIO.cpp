@@ -26,9 +26,11 @@
 #include "IODefs.h"
 #include "SimpleIO.h"
 #include "XChunkyFileUtils.h"
+#include "MapIO.h"
 
 const int kMeshControlID = 'mesh';
 const int kMeshData1ID = 'dat1';
+const int kMeshCoordsID = 'mpts';		// Exact vertex locations - x,y per vertex in file order.  See MapIO.h.
 
 void WriteMesh(FILE * fi, CDT& mesh, int inAtomID, ProgressFunc func)
 {
@@ -157,6 +159,16 @@ void WriteMesh(FILE * fi, CDT& mesh, int inAtomID, ProgressFunc func)
 			}
 		}
 	}
+
+	// The doubles in dat1 are kept for old readers; this is what we actually load.
+	XESCoordWriter	coords(false);
+	for (j = 0; j < vnum; ++j)
+	{
+		coords.add(VT[j]->point().x());
+		coords.add(VT[j]->point().y());
+	}
+	coords.write(fi, kMeshCoordsID);
+
 	PROGRESS_DONE(func, 0, 1, "Writing terrain mesh...")
 }
 
@@ -174,19 +186,32 @@ void ReadMesh(XAtomContainer& container, CDT& mesh, int atomID, const TokenConve
 	if (!meContainer.GetNthAtomOfID(kMeshData1ID, 0, data1Atom)) return;
 	data1Atom.GetContents(data1Container);
 
-	MemFileReader	readCtrl(ctrlContainer.begin, ctrlContainer.end);
 	MemFileReader	readData1(data1Container.begin, data1Container.end);
 
 	if (mesh.tds().number_of_vertices() != 0)    { mesh.tds().clear(); mesh.cache_reset(); }
 
+	// The control atom is nothing but ints - pull the whole thing out of the file in one copy.
+	vector<int>	ctrl((ctrlContainer.end - ctrlContainer.begin) / sizeof(int));
+	if (ctrl.size() < 3) return;
+	memcpy(&*ctrl.begin(), ctrlContainer.begin, ctrl.size() * sizeof(int));
+	EndianSwapArray(platform_LittleEndian, platform_Native, ctrl.size(), sizeof(int), &*ctrl.begin());
+	const int * readCtrl = &*ctrl.begin();
+
 	int n, m, d;	// number of verts, faces, dimension
 	int i, j;
-	readCtrl.ReadInt(n);
-	readCtrl.ReadInt(m);
-	readCtrl.ReadInt(d);
+	n = *readCtrl++;
+	m = *readCtrl++;
+	d = *readCtrl++;
 
 	if (n == 0) return;
 
+	int dim = (d == -1 ? 1 :  d + 1);
+	if ((int) ctrl.size() < 3 + m * (dim + d + 1 + 3)) return;
+
+	vector<NT>	coords;
+	if (ReadCoordTable(meContainer, kMeshCoordsID, coords) && coords.size() != 2 * n)
+		coords.clear();
+
 	int ctr = 0;
 	int tot = n * 2 + m * 4;
 	int step = tot / 150;
@@ -207,7 +232,6 @@ void ReadMesh(XAtomContainer& container, CDT& mesh, int atomID, const TokenConve
 
 	// Create faces
 	int index;
-	int dim = (mesh.tds().dimension() == -1 ? 1 :  mesh.tds().dimension() + 1);
 
 	for(i = 0; i < m; ++i, ++ctr)
 	{
@@ -215,7 +239,7 @@ void ReadMesh(XAtomContainer& container, CDT& mesh, int atomID, const TokenConve
 		F[i] = mesh.tds().create_face() ;
 		for(j = 0; j < dim ; ++j)
 		{
-			readCtrl.ReadInt(index);
+			index = *readCtrl++;
 			F[i]->set_vertex(j, V[index]);
 			V[index]->set_face(F[i]);
 		}
@@ -227,7 +251,7 @@ void ReadMesh(XAtomContainer& container, CDT& mesh, int atomID, const TokenConve
 		PROGRESS_CHECK(func, 0, 1, "Reading mesh...", ctr, tot, step)
 		for(j = 0; j < mesh.tds().dimension()+1; ++j)
 		{
-			readCtrl.ReadInt(index);
+			index = *readCtrl++;
 			F[i]->set_neighbor(j, F[index]);
 		}
 	}
@@ -238,7 +262,7 @@ void ReadMesh(XAtomContainer& container, CDT& mesh, int atomID, const TokenConve
 		PROGRESS_CHECK(func, 0, 1, "Reading mesh...", ctr, tot, step)
 		for(j = 0; j < 3; ++j)
 		{
-			readCtrl.ReadInt(index);
+			index = *readCtrl++;
 			F[i]->set_constraint(j, index != 0);
 		}
 	}
@@ -283,7 +307,10 @@ void ReadMesh(XAtomContainer& container, CDT& mesh, int atomID, const TokenConve
 			vi.border_blend[btype] = blev;
 		}
 
-		V[j]->set_point(CDT::Point(x,y));
+		if (coords.empty())
+			V[j]->set_point(CDT::Point(x,y));
+		else
+			V[j]->set_point(CDT::Point(coords[2*j], coords[2*j+1]));
 		V[j]->info() = vi;
 
 	}
@@ -41,13 +41,14 @@ void	WriteXESFile(
 					  CDT&		inMesh,
 				DEMGeoMap&		inDEM,
 				const AptVector& inApts,
-				ProgressFunc	inFunc)
+				ProgressFunc	inFunc,
+				bool			inFlatMap)
 {
 	FILE * fi = fopen(inFileName, "wb");
 	if (!fi) return;
 
 	WriteEnumsAtomToFile(fi, gTokens, kTokensID);
-	WriteMap(fi, inMap, inFunc, kMapID);
+	WriteMap(fi, inMap, inFunc, kMapID, inFlatMap);
 	WriteMesh(fi, inMesh, kMeshID, inFunc);
 
 	{
@@ -49,7 +49,8 @@ void	WriteXESFile(
 					  CDT&		inMesh,
 				DEMGeoMap&		inDEM,
 				const AptVector& inApts,
-				ProgressFunc	inFunc);
+				ProgressFunc	inFunc,
+				bool			inFlatMap = false);	// MAP3 coordinate tables - see MapIO.h
 
 void	ReadXESFile(
 				MFMemFile *		inFile,
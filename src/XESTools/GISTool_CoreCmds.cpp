@@ -45,6 +45,8 @@
 #include "RF_Msgs.h"
 #endif
 
+static bool	sFlatMap = false;		// Write maps as MAP3 coordinate tables - see MapIO.h.
+
 static int DoExtent(const vector<const char *>& args)
 {
 	gMapWest = atoi(args[0]);
@@ -338,7 +340,7 @@ static int DoSave(const vector<const char *>& args)
 	if (/*!gDem.empty() || */(nland > 0) || distance(gMap.unbounded_face()->holes_begin(),gMap.unbounded_face()->holes_end()) > 1)
 	{
 		if (gVerbose) printf("Saving file %s\n", args[0]);
-		WriteXESFile(args[0], gMap, gTriangulationHi, gDem, gApts, gProgress);
+		WriteXESFile(args[0], gMap, gTriangulationHi, gDem, gApts, gProgress, sFlatMap);
 		return 0;
 	} else {
 		printf("Not writing file %s - no DEMs and no land!\n", args[0]);
@@ -350,11 +352,18 @@ static int DoSave(const vector<const char *>& args)
 static int DoSaveForce(const vector<const char *>& args)
 {
 	if (gVerbose) printf("Saving file %s (always)\n", args[0]);
-	WriteXESFile(args[0], gMap, gTriangulationHi, gDem, gApts, gProgress);
+	WriteXESFile(args[0], gMap, gTriangulationHi, gDem, gApts, gProgress, sFlatMap);
 	return 0;
 }
 
 
+static int DoFlatMap(const vector<const char *>& args)
+{
+	sFlatMap = atoi(args[0]) != 0;
+	if (gVerbose) printf("Maps will be saved as %s\n", sFlatMap ? "MAP3 (coordinate tables)" : "MAP2 (legacy)");
+	return 0;
+}
+
 static int DoIfEmpty(const vector<const char *>& args)
 {
 	if(args.size() == 1)
@@ -432,7 +441,7 @@ static int DoCropSave(const vector<const char *>& args)
 			DEMGeoMap	dem;
 			AptVector	apt;
 			CDT			mesh;
-			WriteXESFile(fbuf, cutout, mesh, dem, apt, gProgress);
+			WriteXESFile(fbuf, cutout, mesh, dem, apt, gProgress, sFlatMap);
 		} else {
 			printf("Not writing file %s - no DEMs and no land!\n", args[0]);
 			fprintf(stderr, "Not writing file %s - no DEMs and no land!\n", args[0]);
@@ -3000,6 +3009,7 @@ static	GISTool_RegCmd_t		sCoreCmds[] = {
 { "-load", 			1, 1, DoLoad, 			"Load an XES file.", "" },
 { "-save", 			1, 1, DoSave, 			"Save an XES file.", "" },
 { "-force_save", 	1, 1, DoSaveForce,		"Save an XES file, even if empty.", "" },
+{ "-xes_flat_map",	1, 1, DoFlatMap,		"1 = save maps with coordinate tables (MAP3, needs a new reader), 0 = legacy MAP2.", "" },
 { "-ifempty",		1, 2, DoIfEmpty,		"Skip the next N commands unless the map or a layer is empty.", "" },
 { "-cropsave", 		1, 1, DoCropSave, 		"Save only extent as an XES file.", "" },
 { "-overlay", 		1, 1, DoOverlay, 		"Superimpose/replace a second vector map.", "" },
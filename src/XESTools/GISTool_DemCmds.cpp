@@ -469,6 +469,28 @@ int DoRasterInit(const vector<const char *>& args)
 	return 0;
 }
 
+#define DoDEMScratch_HELP \
+"USAGE: -dem_scratch dir [min_mb]\n"\
+"Store raster layers of at least min_mb megabytes (default 64) that are\n"\
+"created from now on in memory-mapped scratch files in dir, so that big\n"\
+"DEMs do not have to be fully resident.  Use - for dir to turn this off.\n"
+int DoDEMScratch(const vector<const char *>& args)
+{
+	if (strcmp(args[0], "-") == 0)
+	{
+		DEMGeo_SetScratchDir(NULL, 0);
+		return 0;
+	}
+	int mb = args.size() > 1 ? atoi(args[1]) : 64;
+	if (!FILE_exists(args[0]) && FILE_make_dir_exist(args[0]) != 0)
+	{
+		fprintf(stderr,"Could not create DEM scratch directory %s.\n",args[0]);
+		return 1;
+	}
+	DEMGeo_SetScratchDir(args[0], (size_t) max(mb, 0) * 1024 * 1024);
+	return 0;
+}
+
 #define DoRasterScale_HELP \
 "USAGE: -raster_scale scale layer\n"\
 "Resize a layer down by a scale factor."
@@ -992,6 +1014,7 @@ static	GISTool_RegCmd_t		sDemCmds[] = {
 { "-raster_import",	4, 7, DoRasterImport,		"Import one raster DEM file.", DoRasterImport_HELP },
 { "-raster_export", 4, 5, DoRasterExport,		"Export one raster DEM file.", DoRasterExport_HELP }, 
 { "-raster_init",	4, 5, DoRasterInit,			"Create new empty raster layer.", DoRasterInit_HELP }, 
+{ "-dem_scratch",	1, 2, DoDEMScratch,			"Keep big raster layers in mapped scratch files.", DoDEMScratch_HELP },
 { "-raster_scale",	2, 2, DoRasterScale,		"Resize a raster layer.", DoRasterScale_HELP },
 { "-raster_resample",4, 4, DoRasterResample,	"Resample raster layer.", DoRasterResample_HELP }, 
 { "-raster_resample_median",4, 4, DoRasterResampleMedian,	"Resample raster layer with median.", DoRasterResampleMedian_HELP },
@@ -204,7 +204,7 @@ static int DoDumpDSF(const vector<const char *>& args)
 	int err = 0;
 	for (int n = 0; n < args.size(); ++n)
 	{
-		if(DSFCheckSignature(args[n]) != dsf_ErrOK)
+		if(DSFCheckSignatureMapped(args[n]) != dsf_ErrOK)
 		{
 			fprintf(stderr, "DSF Checksum failed for %s.\n", args[n]);
 			return 1;
@@ -224,15 +224,51 @@ static int DoPreCheckWaterConform(const vector<const char *>& args)
 
 
 
+// Checks DSF signatures on a thread pool, deleting the ones that fail.  Returns the number of bad files.
+static int KillBadDSFs(const vector<const char *>& paths, int threads)
+{
+	vector<int>	results(paths.size());
+	double		bytes = 0.0;
+
+	unsigned long long start = query_hpc();
+	int bad = paths.empty() ? 0 : DSFCheckSignatureBatch(paths.size(), &*paths.begin(), &*results.begin(), threads, &bytes);
+	double secs = hpc_to_microseconds(query_hpc() - start) / 1000000.0;
+
+	for (int n = 0; n < paths.size(); ++n)
+	if (results[n] != dsf_ErrOK)
+	{
+		if (gVerbose) printf("Checksum failed: deleting %s\n", paths[n]);
+		FILE_delete_file(paths[n],false);
+	}
+	else if (gVerbose)
+		printf("Checksum okay for: %s\n", paths[n]);
+
+	if (gVerbose)
+		printf("Checked %d DSFs (%d bad), %.1f MB in %.2f seconds: %.1f MB/s\n",
+			(int) paths.size(), bad, bytes / (1024.0 * 1024.0), secs, secs > 0.0 ? bytes / (1024.0 * 1024.0 * secs) : 0.0);
+	return bad;
+}
+
 int KillBadDSF(const vector<const char *>& args)
 {
-	if (DSFCheckSignature(args[0]) != dsf_ErrOK)
+	return KillBadDSFs(args, 1) ? 1 : 0;
+}
+
+static int KillBadDSFTree(const vector<const char *>& args)
+{
+	vector<string>	files, dirs;
+	if (FILE_get_directory_recursive(args[0], files, dirs) < 0)
 	{
-		if (gVerbose) printf("Checksum failed: deleting %s\n", args[0]);
-		FILE_delete_file(args[0],false);
+		fprintf(stderr, "Could not read directory %s\n", args[0]);
 		return 1;
 	}
-	if(gVerbose) printf("Checksum okay for: %s\n", args[0]);
+
+	vector<const char *>	dsfs;
+	for (vector<string>::iterator f = files.begin(); f != files.end(); ++f)
+	if (FILE_get_file_extension(*f) == "dsf")
+		dsfs.push_back(f->c_str());
+
+	KillBadDSFs(dsfs, args.size() > 1 ? atoi(args[1]) : 0);
 	return 0;
 }
 
@@ -614,15 +650,31 @@ static int DoHackTestrasterizer(const vector<const char *>& args)
 
 static int DoMeshErrStats(const vector<const char *>& s)
 {
-	float minv, maxv, mean, devsq;
-	int n = CalcMeshError(gTriangulationHi, gDem[dem_Elevation], minv, maxv,mean,devsq, ConsoleProgressFunc);
-
-	printf("mean=%f min=%f max=%f std dev = %f", mean, minv, maxv, devsq);
+	MeshErrorReport	report(s.size() > 1 ? atof(s[1]) : 1.0f);
+	if (report.bin_size <= 0.0f)
+	{
+		fprintf(stderr, "Bad histogram bin size: %s\n", s[1]);
+		return 1;
+	}
+	CalcMeshErrorReport(gTriangulationHi, gDem[dem_Elevation], report, ConsoleProgressFunc);
+	const MeshErrorStats& t(report.total);
+	if(report.worst_pos > 0.0)
+		printf("Worst positive error is %f meters at %+08.6lf, %+09.7lf\n", report.worst_pos, report.worst_pos_p.x(), report.worst_pos_p.y());
+	if(report.worst_neg < 0.0)
+		printf("Worst negative error is %f meters at %+08.6lf, %+09.7lf\n", report.worst_neg, report.worst_neg_p.x(), report.worst_neg_p.y());
+	printf("mean=%f min=%f max=%f std dev = %f\n", t.mean(), t.minv, t.maxv, t.std_dev());
+
+	if (!s.empty() && !WriteMeshErrorCSV(s[0], report))
+	{
+		fprintf(stderr, "Could not write mesh error report %s\n", s[0]);
+		return 1;
+	}
 	return 0;
 }
 
 static	GISTool_RegCmd_t		sMiscCmds[] = {
 { "-kill_bad_dsf", 1, 1, KillBadDSF,				"Delete a DSF file if its checksum fails.", "" },
+{ "-kill_bad_dsf_tree", 1, 2, KillBadDSFTree,		"dir [threads] - delete every DSF under dir whose checksum fails.", "Checks all .dsf files in a directory tree, several at a time (one thread per CPU unless a thread count is given), and deletes the ones whose checksum fails.  With -v, prints each file and the overall throughput.\n" },
 { "-showcoverage", 1, 2, DoShowCoverage,			"Show coverage of a file as text", "Given a raw 360x180 file, this prints the lat-lon of every none-black point.\n" },
 { "-diffcoverage", 2, 2, DoDiffCoverage,			"Difference two coverages.","Given two raw 360x180s, shows a list of all tiles in the first but NOT the second one.\n" },
 { "-coverage", 4, 4, DoMakeCoverage, 				"prefix suffix master md5|- - make coverage.", "This makes a black & white coverage indicating what files exist.  Optionally also prints md5 signature of each file to another text file." },
@@ -637,7 +689,7 @@ static	GISTool_RegCmd_t		sMiscCmds[] = {
 { "-forest_types",	0,	1, DoDumpForests,			"Output types of forests from the spreadsaheet.", dump_forests_HELP },
 { "-make_terrain_package", 1, 1, DoMakeTerrainPackage, "Create or update a terrain package based on the spreadsheets.", make_terrain_package_HELP },
 { "-test_terrain_package", 1, 1, DoTestTerrainPackage, "Check a terrain package based on the spreadsheets.", test_terrain_package_HELP },
-{ "-mesh_err_stats", 0, 0, DoMeshErrStats,			"Print statistics about mesh error.", "" },
+{ "-mesh_err_stats", 0, 2, DoMeshErrStats,			"[csv_file [bin_size]] Print statistics about mesh error.", "Prints the mean, min, max and RMS error of the mesh against the elevation DEM.  Given a file, also writes a CSV with the totals, a row per terrain type and a histogram of error in bin_size meter bins (default 1).\n" },
 #if OPENGL_MAP
 { "-clear_block",		   0, 0, DoClear, "", "" },
 #endif
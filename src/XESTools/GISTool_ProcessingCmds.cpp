@@ -543,6 +543,13 @@ static int DoAssignLandUse(const vector<const char *>& args)
 }
 
 
+static int DoDSFSpill(const vector<const char *>& args)
+{
+	gDSFBuildPrefs.spill_patches = atoi(args[0]);
+	if(gVerbose) printf("%s DSF patch spilling.\n", gDSFBuildPrefs.spill_patches ? "Enabling" : "Disabling");
+	return 0;
+}
+
 static int DoBuildDSF(const vector<const char *>& args)
 {
 	char buf1[1024], buf2[1024];
@@ -577,6 +584,7 @@ static	GISTool_RegCmd_t		sProcessCmds[] = {
 { "-instobjs", 		0, 0, DoInstantiateObjs, "Instantiate Objects.", 			  "" },
 { "-buildroads", 	0, 0, DoBuildRoads, 	"Pick Road Types.", 	  			"" },
 { "-assignterrain", 1, 1, DoAssignLandUse, 	"Assign Terrain to Mesh.", 	 		 "" },
+{ "-dsf_spill",		1, 1, DoDSFSpill,		"1 = stream mesh patches through temp files on export (less RAM).", "" },
 { "-exportdsf", 	2, 2, DoBuildDSF, 		"Build DSF file.", 					  "" },
 
 
@@ -26,6 +26,9 @@
 #include "QuiltUtils.h"
 #include "FileUtils.h"
 #include "MathUtils.h"
+#include "PlatformUtils.h"
+#include "ThreadUtils.h"
+#include "PerfUtils.h"
 
 #if PHONE
 	#define WANT_PVR 1
@@ -405,6 +408,359 @@ unsigned char fade_2_black_filter(unsigned char src[], int count, int channel, i
 }
 
 
+/*
+
+	DXT CONVERSION AND BATCH MODE
+
+	A --png2dxt conversion is four stages: decode (read the PNG and scale it to a power of 2), mips (build the mip-map
+	stack), compress (DXT) and write.  The single-file mode runs them in a row.
+
+	--batch runs the same conversion on a whole folder of PNGs, or on a manifest listing them.  Each worker takes the
+	next file and runs all four stages on it, so with N workers we have N files in flight at once: while one worker is
+	stuck in libpng, another is compressing and a third is waiting on the disk.  Every stage of every file is timed so
+	we can see where the time goes.  A file whose DDS is newer than its PNG is skipped, so a batch that is stopped can
+	just be run again.
+
+	We use one worker per core; when there are fewer files than cores, the leftover cores help compress each level.
+	Each worker holds one image and its mips in memory, so --jobs can cap this on big images.
+
+*/
+
+// Everything on a --png2dxt command line between the convert mode and the files.
+struct	dxt_options_t {
+	int		dxt_type;		// 1, 3 or 5 - or 0 to pick based on whether the PNG has alpha.
+	int		has_mips;
+	int		quality;
+	float	gamma;
+	bool	scale_up;
+	bool	scale_down;
+	bool	scale_half;
+};
+
+static void parse_dxt_options(const char * mode, char * argv[], int& arg_base, dxt_options_t& opts)
+{
+	opts.dxt_type = mode[9] ? mode[9]-'0' : 0;
+	opts.has_mips = 0;
+
+	if(strcmp(argv[arg_base], "--std_mips") == 0)
+	{
+		opts.has_mips = 0;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--pre_mips") == 0)
+	{
+		opts.has_mips = 1;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--night_mips") == 0)
+	{
+		opts.has_mips = 2;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--fade_mips") == 0)
+	{
+		opts.has_mips = 3;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--ctl_mips") == 0)
+	{
+		opts.has_mips = 4;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--ref_mips") == 0)
+	{
+		opts.has_mips = 5;
+		++arg_base;
+	}
+
+	// Optional: trade DXT quality for speed - on big photo sets the fast fit is hard to tell apart.
+	opts.quality = dxt_quality_best;
+	if(strcmp(argv[arg_base], "--dxt_fast") == 0)
+	{
+		opts.quality = dxt_quality_fast;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--dxt_normal") == 0)
+	{
+		opts.quality = dxt_quality_normal;
+		++arg_base;
+	}
+
+	opts.gamma = (strcmp(argv[arg_base], "--gamma_22") == 0) ? 2.2f : 1.8f;
+	arg_base +=1;
+
+
+	opts.scale_up = strcmp(argv[arg_base], "--scale_up") == 0;
+	opts.scale_down = strcmp(argv[arg_base], "--scale_down") == 0;
+	opts.scale_half = strcmp(argv[arg_base], "--scale_half") == 0;
+	arg_base +=1;
+}
+
+// Decode stage: load the PNG and get it to a power of 2.  Returns false (and the image is not allocated) on failure.
+static bool dxt_decode(const char * in_file, const dxt_options_t& opts, ImageInfo& info, string& out_error)
+{
+	char buf[1024];
+	if (CreateBitmapFromPNG(in_file, &info, false, opts.gamma)!=0)
+	{
+		sprintf(buf, "Unable to open png file %s\n", in_file);
+		out_error = buf;
+		return false;
+	}
+
+	if (!HandleScale(info, opts.scale_up, opts.scale_down, opts.scale_half, false))
+	{
+		// Image does NOT meet our power of 2 needs.
+		if(!opts.scale_up && !opts.scale_down && !opts.scale_half)
+		{
+			sprintf(buf, "The imager is not a power of 2.  It is: %ld by %ld\n", info.width, info.height);
+			out_error = buf;
+			DestroyBitmap(&info);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Mips stage: returns the DXT type to compress with.
+static int dxt_make_mips(ImageInfo& info, const dxt_options_t& opts)
+{
+	int dxt_type = opts.dxt_type;
+	if(dxt_type == 0)
+	{
+		if(info.channels == 3)  dxt_type=1;
+		else					dxt_type=5;
+	}
+
+	ConvertBitmapToAlpha(&info,false);
+	switch(opts.has_mips) {
+//	case 0:			MakeMipmapStack(&info);							break;
+	case 0:			MakeMipmapStackFast(&info,mip_filter_srgb);		break;
+	case 1:			MakeMipmapStackFromImage(&info);				break;
+	case 2:			MakeMipmapStackWithFilter(&info,night_filter);	break;
+	case 3:			MakeMipmapStackWithFilter(&info,fade_filter);	break;
+	case 4:			MakeMipmapStackWithFilter(&info,fade_2_black_filter);	break;
+	case 5:			MakeMipmapStackWithFilter(&info,srgb_filter);	break;	// Reference for --std_mips, in float.
+	}
+	return dxt_type;
+}
+
+enum {
+	stage_decode = 0,
+	stage_mips,
+	stage_compress,
+	stage_write,
+	stage_count
+};
+
+static const char * k_stage_names[stage_count] = { "decode", "mips", "compress", "write" };
+
+struct	dxt_batch_file_t {
+	string		in_file;
+	string		out_file;
+	string		error;
+	double		pixels;					// Base level only.
+	double		bytes;					// Size of the DDS.
+	double		usecs[stage_count];		// Time this file spent in each stage.
+};
+
+struct	dxt_batch_t {
+	dxt_options_t				opts;
+	vector<dxt_batch_file_t>	files;
+	int							compress_threads;
+	int							done;
+	TU_Mutex					lock;		// Guards done and stdout.
+};
+
+static void dxt_batch_one(int n, void * ref)
+{
+	dxt_batch_t * batch = (dxt_batch_t *) ref;
+	dxt_batch_file_t& f(batch->files[n]);
+
+	unsigned long long	t0 = query_hpc();
+	ImageInfo	info;
+	if(dxt_decode(f.in_file.c_str(), batch->opts, info, f.error))
+	{
+		f.pixels = (double) info.width * (double) info.height;
+
+		unsigned long long	t1 = query_hpc();
+		int dxt_type = dxt_make_mips(info, batch->opts);
+
+		unsigned long long	t2 = query_hpc();
+		vector<unsigned char>	dds;
+		CompressBitmapToDDS(info, dxt_type, batch->opts.gamma == GAMMA_SRGB, dds, batch->opts.quality, batch->compress_threads);
+		DestroyBitmap(&info);
+		f.bytes = dds.size();
+
+		unsigned long long	t3 = query_hpc();
+		FILE * fi = fopen(f.out_file.c_str(), "wb");
+		if(fi == NULL || fwrite(&*dds.begin(), dds.size(), 1, fi) != 1)
+			f.error = "Unable to write DDS file " + f.out_file + "\n";
+		if(fi)
+			fclose(fi);
+
+		unsigned long long	t4 = query_hpc();
+		f.usecs[stage_decode] = hpc_to_microseconds(t1 - t0);
+		f.usecs[stage_mips] = hpc_to_microseconds(t2 - t1);
+		f.usecs[stage_compress] = hpc_to_microseconds(t3 - t2);
+		f.usecs[stage_write] = hpc_to_microseconds(t4 - t3);
+	}
+
+	StMutexLock	hold(batch->lock);
+	++batch->done;
+	if(f.error.empty())
+		printf("[%d/%d] %s\n", batch->done, (int) batch->files.size(), f.out_file.c_str());
+	else
+		printf("[%d/%d] %s", batch->done, (int) batch->files.size(), f.error.c_str());
+	fflush(stdout);
+}
+
+// The DDS for a PNG goes right next to it.
+static string dds_path_for_png(const string& png)
+{
+	return png.substr(0, png.size() - 4) + ".dds";
+}
+
+// Input is either a folder (every .png in it) or a text file with one PNG per line, optionally followed by a tab
+// and the DDS to write.  Blank lines and lines starting with # are ignored.
+static bool gather_batch_files(const string& input, vector<pair<string, string> >& out_files)
+{
+	vector<string>	names;
+	if(FILE_get_directory(input, &names, NULL) >= 0)
+	{
+		sort(names.begin(), names.end());
+		for(vector<string>::iterator n = names.begin(); n != names.end(); ++n)
+		if(FILE_get_file_extension(*n) == "png")
+		{
+			string png = input + DIR_STR + *n;
+			out_files.push_back(pair<string, string>(png, dds_path_for_png(png)));
+		}
+		return true;
+	}
+
+	string	manifest;
+	if(FILE_read_file_to_string(input, manifest) != 0)
+		return false;
+
+	string::size_type	p = 0;
+	while(p < manifest.size())
+	{
+		string::size_type e = manifest.find_first_of("\r\n", p);
+		if(e == string::npos) e = manifest.size();
+		string line = manifest.substr(p, e - p);
+		p = e + 1;
+
+		if(line.empty() || line[0] == '#')
+			continue;
+		string::size_type tab = line.find('\t');
+		if(tab == string::npos)
+			out_files.push_back(pair<string, string>(line, dds_path_for_png(line)));
+		else
+			out_files.push_back(pair<string, string>(line.substr(0, tab), line.substr(tab + 1)));
+	}
+	return true;
+}
+
+// DDSTool --batch [--jobs <n>] --png2dxt[1|3|5] <options> <input folder or manifest>
+static int do_batch(int argc, char * argv[])
+{
+	int arg_base = 2;
+	int jobs = 0;
+	if(arg_base + 1 < argc && strcmp(argv[arg_base], "--jobs") == 0)
+	{
+		jobs = atoi(argv[arg_base+1]);
+		arg_base += 2;
+	}
+
+	if(arg_base >= argc || strncmp(argv[arg_base], "--png2dxt", 9) != 0 || strlen(argv[arg_base]) > 10)
+	{
+		printf("Batch mode only supports the --png2dxt modes.\n");
+		return 1;
+	}
+
+	dxt_batch_t	batch;
+	const char * mode = argv[arg_base++];
+	if(arg_base + 2 >= argc)
+	{
+		printf("Batch mode needs a gamma, scale and input folder or manifest.\n");
+		return 1;
+	}
+	parse_dxt_options(mode, argv, arg_base, batch.opts);
+	if(arg_base >= argc)
+	{
+		printf("Batch mode needs an input folder or manifest.\n");
+		return 1;
+	}
+
+	vector<pair<string, string> >	all;
+	if(!gather_batch_files(argv[arg_base], all))
+	{
+		printf("Unable to read folder or manifest %s\n", argv[arg_base]);
+		return 1;
+	}
+
+	int skipped = 0;
+	for(vector<pair<string, string> >::iterator i = all.begin(); i != all.end(); ++i)
+	{
+		if(FILE_date_cmpr(i->second.c_str(), i->first.c_str()) == dcr_firstIsNew)
+		{
+			++skipped;
+			continue;
+		}
+		dxt_batch_file_t	f;
+		f.in_file = i->first;
+		f.out_file = i->second;
+		f.pixels = 0.0;
+		f.bytes = 0.0;
+		for(int s = 0; s < stage_count; ++s)
+			f.usecs[s] = 0.0;
+		batch.files.push_back(f);
+	}
+	printf("%d files to convert, %d already up to date.\n", (int) batch.files.size(), skipped);
+	if(batch.files.empty())
+		return 0;
+
+	int cores = TU_GetCPUCount();
+	int workers = jobs > 0 ? jobs : cores;
+	workers = min(workers, (int) batch.files.size());
+	batch.compress_threads = max(1, cores / workers);
+	batch.done = 0;
+
+	unsigned long long	start = query_hpc();
+	TU_ParallelFor(batch.files.size(), dxt_batch_one, &batch, workers);
+	double wall = hpc_to_microseconds(query_hpc() - start) / 1000000.0;
+
+	// Stage throughput is per worker: how fast one file moves through that stage.
+	double	usecs[stage_count] = { 0 };
+	double	pixels = 0.0, bytes = 0.0;
+	int		converted = 0, failed = 0;
+	for(vector<dxt_batch_file_t>::iterator f = batch.files.begin(); f != batch.files.end(); ++f)
+	{
+		if(!f->error.empty())
+		{
+			++failed;
+			continue;
+		}
+		++converted;
+		pixels += f->pixels;
+		bytes += f->bytes;
+		for(int s = 0; s < stage_count; ++s)
+			usecs[s] += f->usecs[s];
+	}
+
+	printf("Converted %d files (%d failed) on %d workers in %.1lf seconds: %.2lf files/sec, %.1lf MPix/sec.\n",
+		converted, failed, workers, wall, converted / wall, pixels / 1000000.0 / wall);
+	for(int s = 0; s < stage_count; ++s)
+	{
+		double secs = usecs[s] / 1000000.0;
+		if(s == stage_write)
+			printf("  %-10s %9.1lf sec  %8.1lf MB/sec/worker\n", k_stage_names[s], secs, secs > 0.0 ? bytes / 1048576.0 / secs : 0.0);
+		else
+			printf("  %-10s %9.1lf sec  %8.1lf MPix/sec/worker\n", k_stage_names[s], secs, secs > 0.0 ? pixels / 1000000.0 / secs : 0.0);
+	}
+	return failed ? 1 : 0;
+}
+
+
 int main(int argc, char * argv[])
 {
 	char	my_dir[2048];
@@ -476,11 +832,17 @@ int main(int argc, char * argv[])
 
 	if (argc < 4) {
 		printf("Usage: %s <convert mode> <options> <input_file> <output_file>|-\n",argv[0]);
+		printf("Usage: %s --batch [--jobs <n>] <--png2dxt mode> <options> <input_folder>|<manifest_file>\n",argv[0]);
 		printf("Usage: %s --quilt <input_file> <width> <height> <patch size> <overlap> <trials> <output_files>n",argv[0]);
 		printf("       %s --version\n",argv[0]);
 		exit(1);
 	}
 
+	if(strcmp(argv[1],"--batch")==0)
+	{
+		return do_batch(argc, argv);
+	}
+
 	if(strcmp(argv[1],"--info")==0)
 	{
 		ImageInfo	info;
@@ -664,60 +1026,17 @@ int main(int argc, char * argv[])
 	   strcmp(argv[1],"--png2dxt5")==0)
 	{
 		int arg_base = 2;
-		int has_mips = 0;
-
-		if(strcmp(argv[arg_base], "--std_mips") == 0)
-		{
-			has_mips = 0;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--pre_mips") == 0)
-		{
-			has_mips = 1;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--night_mips") == 0)
-		{
-			has_mips = 2;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--fade_mips") == 0)
-		{
-			has_mips = 3;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--ctl_mips") == 0)
-		{
-			has_mips = 4;
-			++arg_base;
-		}
-
-		float gamma = (strcmp(argv[arg_base], "--gamma_22") == 0) ? 2.2f : 1.8f;
-		arg_base +=1;
-
-
-		bool scale_up = strcmp(argv[arg_base], "--scale_up") == 0;
-		bool scale_down = strcmp(argv[arg_base], "--scale_down") == 0;
-		bool scale_half = strcmp(argv[arg_base], "--scale_half") == 0;
-		arg_base +=1;
+		dxt_options_t	opts;
+		parse_dxt_options(argv[1], argv, arg_base, opts);
 
 		ImageInfo	info;
-		if (CreateBitmapFromPNG(argv[arg_base], &info, false, gamma)!=0)
+		string		err;
+		if (!dxt_decode(argv[arg_base], opts, info, err))
 		{
-			printf("Unable to open png file %s\n", argv[arg_base]);
+			printf("%s", err.c_str());
 			return 1;
 		}
 
-		if (!HandleScale(info, scale_up, scale_down, scale_half, false))
-		{
-			// Image does NOT meet our power of 2 needs.
-			if(!scale_up && !scale_down && !scale_half)
-			{
-				printf("The imager is not a power of 2.  It is: %ld by %ld\n", info.width, info.height);
-				return 1;
-			}
-		}
-
 		char buf[1024];
 		const char * outf = argv[arg_base+1];
 		if(strcmp(outf,"-")==0)
@@ -732,24 +1051,9 @@ int main(int argc, char * argv[])
 		{
 			printf("Unable to write DDS file from alpha-only PNG %s\n", argv[arg_base+1]);
 		}
-		int dxt_type = argv[1][9]-'0';
-		if(argv[1][9]==0)
-		{
-			if(info.channels == 3)  dxt_type=1;
-			else					dxt_type=5;
-		}
-
-		ConvertBitmapToAlpha(&info,false);
-		switch(has_mips) {
-//		case 0:			MakeMipmapStack(&info);							break;
-		case 0:			MakeMipmapStackWithFilter(&info,srgb_filter);	break;
-		case 1:			MakeMipmapStackFromImage(&info);				break;
-		case 2:			MakeMipmapStackWithFilter(&info,night_filter);	break;
-		case 3:			MakeMipmapStackWithFilter(&info,fade_filter);	break;
-		case 4:			MakeMipmapStackWithFilter(&info,fade_2_black_filter);	break;
-		}
+		int dxt_type = dxt_make_mips(info, opts);
 
-		if (WriteBitmapToDDS(info, dxt_type, outf, gamma == GAMMA_SRGB)!=0)
+		if (WriteBitmapToDDS(info, dxt_type, outf, opts.gamma == GAMMA_SRGB, opts.quality)!=0)
 		{
 			printf("Unable to write DDS file %s\n", argv[arg_base+1]);
 			return 1;